@@ -0,0 +1,22 @@
+#version 300 es
+
+precision highp float;
+
+#include "uniforms.glsl"
+
+layout(location = 0) in vec4 vertex_position;
+layout(location = 2) in vec4 vertex_normal;
+layout(location = 3) in vec3 instance_position;
+layout(location = 4) in vec4 instance_color;
+
+out vec4 color;
+out vec4 vertex;
+out vec4 normal;
+
+void main(void)
+{
+    vertex = view * vec4(vertex_position.xyz * instance_sizes[level].xyz + instance_position, 1.0);
+    gl_Position = projection * vertex;
+    normal = view * vec4(vertex_normal.xyz, 0.0);
+    color = instance_color;
+}
@@ -0,0 +1,6 @@
+#version 450 core
+
+// ./emote.frag for ./emote_mdi.vert, GLSL ES and desktop GLSL shaders do
+// not link together
+
+#include "emote_shading.glsl"
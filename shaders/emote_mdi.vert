@@ -0,0 +1,27 @@
+#version 450 core
+#extension GL_ARB_shader_draw_parameters : require
+
+// ./emote.vert for the emote wall drawn with a single
+// glMultiDrawArraysIndirect(), one draw per level of detail
+
+// The draws of a multi-draw are numbered by gl_DrawIDARB from the `level`
+// of the material, the draws one by one have a material per level
+#include "uniforms.glsl"
+
+layout(location = 0) in vec4 vertex_position;
+layout(location = 2) in vec4 vertex_normal;
+layout(location = 3) in vec3 instance_position;
+layout(location = 4) in vec4 instance_color;
+
+out vec4 color;
+out vec4 vertex;
+out vec4 normal;
+
+void main(void)
+{
+    vec3 instance_size = instance_sizes[level + gl_DrawIDARB].xyz;
+    vertex = view * vec4(vertex_position.xyz * instance_size + instance_position, 1.0);
+    gl_Position = projection * vertex;
+    normal = view * vec4(vertex_normal.xyz, 0.0);
+    color = instance_color;
+}
@@ -0,0 +1,49 @@
+#version 300 es
+
+precision highp float;
+
+// ./emote.vert without the vertex buffers of the cube: its vertices are
+// computed from gl_VertexID, so the wall only takes the memory of the
+// instances
+
+#include "uniforms.glsl"
+
+layout(location = 3) in vec3 instance_position;
+layout(location = 4) in vec4 instance_color;
+
+out vec4 color;
+out vec4 vertex;
+out vec4 normal;
+
+// generate_cube_mesh() of ./src/geo.c: 2 triangles per face, the faces of
+// a pair span the first two axes of cube_face_pairs and sit at 0 and 1 on
+// the last one
+const ivec3 cube_face_pairs[3] = ivec3[3](ivec3(0, 1, 2), ivec3(2, 1, 0), ivec3(0, 2, 1));
+
+void cube_vertex(int id, out vec3 position, out vec3 face_normal)
+{
+    int tri = id / 3;
+    int strip_index = tri % 2 + id % 3;
+    int face = tri / 2;
+    ivec3 axes = cube_face_pairs[face / 2];
+    float side = float(face % 2);
+
+    position = vec3(0.0);
+    position[axes.x] = float(strip_index & 1);
+    position[axes.y] = float(strip_index >> 1);
+    position[axes.z] = side;
+    face_normal = vec3(0.0);
+    face_normal[axes.z] = 2.0 * side - 1.0;
+}
+
+void main(void)
+{
+    vec3 vertex_position;
+    vec3 vertex_normal;
+    cube_vertex(gl_VertexID, vertex_position, vertex_normal);
+
+    vertex = view * vec4(vertex_position * instance_sizes[level].xyz + instance_position, 1.0);
+    gl_Position = projection * vertex;
+    normal = view * vec4(vertex_normal, 0.0);
+    color = instance_color;
+}
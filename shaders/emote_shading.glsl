@@ -0,0 +1,23 @@
+// Shared by ./emote.frag and ./emote_mdi.frag
+
+in vec4 color;
+in vec4 vertex;
+in vec4 normal;
+out vec4 frag_color;
+
+#include "uniforms.glsl"
+
+#define FOG_MIN (0.3 * fog_distance)
+#define FOG_MAX fog_distance
+#define AMBIENT 0.3
+
+#include "fog.glsl"
+
+void main(void) {
+    float a = abs(dot(normalize(-vertex.xyz), normalize(normal.xyz)));
+
+    frag_color = mix(
+        vec4(color.rgb * mix(AMBIENT, 1.0, a), 1.0),
+        vec4(0.0, 0.0, 0.0, 1.0),
+        fog_factor(length(vertex.xyz)));
+}
@@ -0,0 +1,8 @@
+// Linear fog from FOG_MIN to FOG_MAX, which the includer defines
+
+float fog_factor(float d)
+{
+    if (d <= FOG_MIN) return 0.0;
+    if (d >= FOG_MAX) return 1.0;
+    return 1.0 - (FOG_MAX - d) / (FOG_MAX - FOG_MIN);
+}
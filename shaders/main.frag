@@ -3,30 +3,37 @@
 precision mediump float;
 
 uniform sampler2D pog;
-uniform float time;
 
 in vec2 uv;
 in vec4 vertex;
 in vec4 normal;
 out vec4 frag_color;
 
+// Can be overridden with `shader_define` in scene.conf
+#ifndef FOG_MIN
 #define FOG_MIN 1.0
+#endif
+#ifndef FOG_MAX
 #define FOG_MAX 50.0
+#endif
 
-float fog_factor(float d)
-{
-    if (d <= FOG_MIN) return 0.0;
-    if (d >= FOG_MAX) return 1.0;
-    return 1.0 - (FOG_MAX - d) / (FOG_MAX - FOG_MIN);
-}
+#include "fog.glsl"
 
+// FOG, LIGHTING and EXPLODE are defined by the shader variant, see F8 to
+// F10 in the README
 void main(void) {
+    float a = 1.0;
+#ifdef LIGHTING
     vec3 light_source = vec3(0.0, 0.0, 00.0);
-    float a = abs(dot(normalize(light_source - vertex.xyz), normal.xyz));
+    a = abs(dot(normalize(light_source - vertex.xyz), normal.xyz));
+#endif
     vec4 t = texture(pog, uv);
 
+    frag_color = vec4(t.xyz * vec3(1.0, 1.0, 1.0) * a, 1.0);
+#ifdef FOG
     frag_color = mix(
-        vec4(t.xyz * vec3(1.0, 1.0, 1.0) * a, 1.0),
+        frag_color,
         vec4(0.0, 0.0, 0.0, 1.0),
         fog_factor(length(vertex)));
+#endif
 }
@@ -0,0 +1,5 @@
+#version 300 es
+
+precision mediump float;
+
+#include "mesh_shading.glsl"
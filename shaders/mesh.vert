@@ -0,0 +1,21 @@
+#version 300 es
+
+precision highp float;
+
+#include "uniforms.glsl"
+
+layout(location = 0) in vec4 vertex_position;
+layout(location = 1) in vec2 vertex_uv;
+layout(location = 2) in vec4 vertex_normal;
+
+out vec2 uv;
+out vec4 vertex;
+out vec4 normal;
+
+void main(void)
+{
+    vertex = view * vec4(vertex_position.xyz, 1.0);
+    gl_Position = projection * vertex;
+    normal = view * vec4(vertex_normal.xyz, 0.0);
+    uv = vertex_uv;
+}
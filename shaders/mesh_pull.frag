@@ -0,0 +1,6 @@
+#version 450 core
+
+// ./mesh.frag for ./mesh_pull.vert, GLSL ES and desktop GLSL shaders do
+// not link together
+
+#include "mesh_shading.glsl"
@@ -0,0 +1,49 @@
+#version 450 core
+
+// ./mesh.vert with the vertices pulled from shader storage buffers instead
+// of the attributes: the VAO only has the indices, gl_VertexID is the
+// vertex and gl_InstanceID the instance. The layouts are the ones of
+// ./src/vpack.h.
+
+#include "uniforms.glsl"
+
+struct Instance {
+    vec4 position_min;
+    vec4 position_extent;
+};
+
+layout(std430, binding = 0) readonly buffer Mesh_Vertices {
+    uvec4 vertices[];
+};
+
+layout(std430, binding = 1) readonly buffer Mesh_Instances {
+    Instance instances[];
+};
+
+out vec2 uv;
+out vec4 vertex;
+out vec4 normal;
+
+vec3 octahedral_decode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    if (n.z < 0.0) {
+        vec2 s = mix(vec2(-1.0), vec2(1.0), greaterThanEqual(n.xy, vec2(0.0)));
+        n.xy = (1.0 - abs(n.yx)) * s;
+    }
+    return normalize(n);
+}
+
+void main(void)
+{
+    uvec4 v = vertices[gl_VertexID];
+    Instance instance = instances[gl_InstanceID];
+
+    vec3 position = vec3(unpackUnorm2x16(v.x), unpackUnorm2x16(v.y).x);
+    position = instance.position_min.xyz + position * instance.position_extent.xyz;
+
+    vertex = view * vec4(position, 1.0);
+    gl_Position = projection * vertex;
+    normal = view * vec4(octahedral_decode(unpackSnorm2x16(v.w)), 0.0);
+    uv = unpackHalf2x16(v.z);
+}
@@ -0,0 +1,20 @@
+// Uniform blocks shared by all of the shaders, the C side is
+// ../src/uniforms.h. The members are highp so the blocks of the vertex and
+// the fragment shaders match whatever their default precision.
+
+layout(std140, row_major) uniform Frame {
+    highp vec2 resolution;
+    highp float time;
+};
+
+layout(std140, row_major) uniform View {
+    highp mat4 projection;
+    highp mat4 view;
+    highp float fog_distance;
+};
+
+// Cubes of the coarser levels of detail of the emote wall are bigger
+layout(std140, row_major) uniform Material {
+    highp vec4 instance_sizes[4];
+    highp int level;
+};
@@ -0,0 +1,246 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "./sv.h"
+#include "./bvh.h"
+#include "./cull.h"
+#include "./timer.h"
+
+// Builds the BVH over 10K, 100K and 1M random cubes and compares frustum
+// culling against the flat SIMD culling of cull.c, and ray picking against
+// testing every cube.
+//   $ ./bench_bvh -j 8
+
+#define BENCH_MIN_SECS 0.5
+#define BENCH_QUERIES 64
+// Cubes per unit of volume stays the same whatever their amount
+#define BENCH_SPACING 4.0f
+
+typedef struct {
+    size_t count;
+    Aabb *aabbs;
+    float *centers;
+    float *extents;
+    float size;
+    Frustum frustums[BENCH_QUERIES];
+    float origins[BENCH_QUERIES][V3_COMPS];
+    float directions[BENCH_QUERIES][V3_COMPS];
+    Bvh bvh;
+    uint32_t *visible;
+} Bench;
+
+typedef size_t (*Bench_Query)(Bench *bench, size_t query);
+
+static uint32_t rand_state = 0x12345678;
+
+// xorshift32, so every run builds the same scene
+uint32_t rand_next(void)
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+float rand_float(float min, float max)
+{
+    return min + (max - min) * ((float) rand_next() / (float) UINT32_MAX);
+}
+
+void bench_init(Bench *bench, size_t count)
+{
+    memset(bench, 0, sizeof(*bench));
+    bench->count = count;
+    bench->aabbs = malloc(count * sizeof(*bench->aabbs));
+    bench->centers = malloc(count * V3_COMPS * sizeof(*bench->centers));
+    bench->extents = malloc(count * V3_COMPS * sizeof(*bench->extents));
+    bench->visible = malloc(count * sizeof(*bench->visible));
+    if (bench->aabbs == NULL || bench->centers == NULL ||
+            bench->extents == NULL || bench->visible == NULL) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+
+    bench->size = cbrtf((float) count) * BENCH_SPACING;
+    for (size_t i = 0; i < count; ++i) {
+        for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+            const float center = rand_float(0.0f, bench->size);
+            const float extent = rand_float(0.25f, 0.75f);
+            bench->aabbs[i].min[axis] = center - extent;
+            bench->aabbs[i].max[axis] = center + extent;
+            bench->centers[axis * count + i] = center;
+            bench->extents[axis * count + i] = extent;
+        }
+    }
+
+    // Cameras and rays from inside of the scene looking anywhere, so a
+    // part of it is in view and the rest is behind or too far
+    const Mat4 projection = mat4_perspective(MY_PI * 0.5f, 4.0f / 3.0f, 1.0f, bench->size * 0.25f);
+    for (size_t q = 0; q < BENCH_QUERIES; ++q) {
+        float origin[V3_COMPS];
+        for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+            origin[axis] = rand_float(0.0f, bench->size);
+        }
+        const float yaw = rand_float(0.0f, 2.0f * MY_PI);
+
+        const Mat4 view = mat4_mult_mat4(mat4_rotate_y(yaw),
+                                         mat4_translate(-origin[X], -origin[Y], -origin[Z]));
+        bench->frustums[q] = frustum_from_mat4(mat4_mult_mat4(projection, view));
+
+        memcpy(bench->origins[q], origin, sizeof(origin));
+        const float pitch = rand_float(-0.5f * MY_PI, 0.5f * MY_PI);
+        bench->directions[q][X] = cosf(pitch) * sinf(yaw);
+        bench->directions[q][Y] = sinf(pitch);
+        bench->directions[q][Z] = -cosf(pitch) * cosf(yaw);
+    }
+}
+
+void bench_free(Bench *bench)
+{
+    free(bench->aabbs);
+    free(bench->centers);
+    free(bench->extents);
+    free(bench->visible);
+}
+
+size_t query_bvh_cull(Bench *bench, size_t query)
+{
+    return bvh_cull(&bench->bvh, &bench->frustums[query], bench->visible);
+}
+
+size_t query_flat_cull(Bench *bench, size_t query)
+{
+    const size_t n = bench->count;
+    const Cull_Aabbs aabbs = {
+        .center = {bench->centers, bench->centers + n, bench->centers + 2 * n},
+        .extent = {bench->extents, bench->extents + n, bench->extents + 2 * n},
+        .count = n,
+    };
+    return cull_aabbs(&bench->frustums[query], &aabbs, 0, n, bench->visible);
+}
+
+// The results of the ray queries are the hit cubes plus one, so the ones
+// of both methods can be compared
+size_t query_bvh_ray(Bench *bench, size_t query)
+{
+    uint32_t hit = 0;
+    float t = 0.0f;
+    if (!bvh_raycast(&bench->bvh, bench->origins[query], bench->directions[query], &hit, &t)) return 0;
+    return (size_t) hit + 1;
+}
+
+size_t query_brute_ray(Bench *bench, size_t query)
+{
+    uint32_t hit = 0;
+    float t = 0.0f;
+    if (!bvh_raycast_brute(&bench->bvh, bench->origins[query], bench->directions[query], &hit, &t)) return 0;
+    return (size_t) hit + 1;
+}
+
+// Runs the queries round robin for at least BENCH_MIN_SECS and returns the
+// average seconds per query. `results` receives the sum of the results of
+// the first BENCH_QUERIES queries.
+double measure(Bench *bench, Bench_Query query, size_t *results)
+{
+    size_t queries = 0;
+    double elapsed = 0.0;
+    *results = 0;
+
+    const double start = timer_now();
+    do {
+        const size_t result = query(bench, queries % BENCH_QUERIES);
+        if (queries < BENCH_QUERIES) *results += result;
+        queries += 1;
+        elapsed = timer_now() - start;
+    } while (elapsed < BENCH_MIN_SECS || queries < BENCH_QUERIES);
+
+    return elapsed / (double) queries;
+}
+
+void usage(FILE *stream, const char *program)
+{
+    fprintf(stream, "Usage: %s [-j <threads>]\n", program);
+}
+
+int main(int argc, char **argv)
+{
+    const char *const program = argv[0];
+    size_t threads = pool_hardware_threads();
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            threads = (size_t) sv_to_u64(sv_from_cstr(argv[++i]));
+            if (threads == 0) threads = 1;
+        } else {
+            usage(stderr, program);
+            fprintf(stderr, "ERROR: unexpected argument `%s`\n", argv[i]);
+            exit(1);
+        }
+    }
+
+    Pool *pool = pool_create(threads - 1);
+    if (pool == NULL) {
+        fprintf(stderr, "ERROR: could not create %zu threads: %s\n", threads, strerror(errno));
+        exit(1);
+    }
+
+    static const size_t counts[] = {10 * 1000, 100 * 1000, 1000 * 1000};
+    const size_t counts_count = sizeof(counts) / sizeof(counts[0]);
+
+    printf("%d objects per leaf, %d bins, %zu threads, %d queries\n",
+           BVH_LEAF_SIZE, BVH_BINS, threads, BENCH_QUERIES);
+
+    for (size_t i = 0; i < counts_count; ++i) {
+        Bench bench;
+        bench_init(&bench, counts[i]);
+        Region region = region_with_capacity(bvh_memory_size(bench.count));
+
+        double build_secs[2];
+        for (size_t parallel = 0; parallel <= 1; ++parallel) {
+            region_clean(&region);
+            const double start = timer_now();
+            if (!bvh_build(&region, parallel ? pool : NULL, bench.aabbs, bench.count, &bench.bvh)) {
+                fprintf(stderr, "ERROR: could not build the BVH: %s\n", strerror(errno));
+                exit(1);
+            }
+            build_secs[parallel] = timer_now() - start;
+        }
+
+        printf("\n%zu objects: %zu nodes, %zu KB\n", bench.count, bench.bvh.nodes_count,
+               (bench.bvh.nodes_count * sizeof(Bvh_Node) + bench.count * sizeof(uint32_t)) / 1024);
+        printf("  build       %10.3f ms serial, %.3f ms on %zu threads\n",
+               build_secs[0] * 1000.0, build_secs[1] * 1000.0, threads);
+
+        size_t bvh_visible = 0;
+        size_t flat_visible = 0;
+        const double bvh_cull_secs = measure(&bench, query_bvh_cull, &bvh_visible);
+        const double flat_cull_secs = measure(&bench, query_flat_cull, &flat_visible);
+        printf("  cull bvh    %10.3f ms/query, %zu visible on average\n",
+               bvh_cull_secs * 1000.0, bvh_visible / BENCH_QUERIES);
+        printf("  cull flat   %10.3f ms/query, %zu visible on average\n",
+               flat_cull_secs * 1000.0, flat_visible / BENCH_QUERIES);
+
+        size_t bvh_hits = 0;
+        size_t brute_hits = 0;
+        const double bvh_ray_secs = measure(&bench, query_bvh_ray, &bvh_hits);
+        const double brute_ray_secs = measure(&bench, query_brute_ray, &brute_hits);
+        printf("  ray bvh     %10.3f us/query\n", bvh_ray_secs * 1000000.0);
+        printf("  ray brute   %10.3f us/query\n", brute_ray_secs * 1000000.0);
+
+        // Culling may disagree on a box touching a plane by rounding, the
+        // nearest hit has to be the same
+        if (bvh_hits != brute_hits) {
+            fprintf(stderr, "ERROR: the BVH and testing every cube hit different cubes\n");
+            exit(1);
+        }
+
+        region_free(&region);
+        bench_free(&bench);
+    }
+
+    pool_destroy(pool);
+    return 0;
+}
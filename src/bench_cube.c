@@ -0,0 +1,358 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#define GL_GLEXT_PROTOTYPES
+#include <GLFW/glfw3.h>
+
+#include "./geo.h"
+#include "./timer.h"
+
+// Draws grids of instanced cubes offscreen with the vertices of the cube
+// from buffers like ./shaders/emote.vert, and computed from gl_VertexID
+// like ./shaders/emote_procedural.vert, with the instances from a buffer
+// and computed from gl_InstanceID too. Reports the time of a frame and the
+// vertex memory of every way.
+//   $ ./bench_cube
+//   $ ./bench_cube 1000 10000000
+
+#define BENCH_WIDTH 512
+#define BENCH_HEIGHT 512
+#define BENCH_MIN_FRAMES 4
+#define BENCH_MIN_SECS 0.5
+#define BENCH_MAX_COUNTS 16
+
+#define INSTANCE_POSITION_INDEX 3
+#define INSTANCE_COLOR_INDEX 4
+
+// Like Emote_Instance
+typedef struct {
+    float position[V3_COMPS];
+    uint32_t color;
+} Bench_Instance;
+
+typedef enum {
+    SOURCE_BUFFERED = 0,
+    SOURCE_PROCEDURAL,
+    SOURCE_PROCEDURAL_INSTANCES,
+    COUNT_SOURCES,
+} Source;
+
+static const char *const source_names[COUNT_SOURCES] = {
+    [SOURCE_BUFFERED]             = "buffered",
+    [SOURCE_PROCEDURAL]           = "gl_VertexID",
+    [SOURCE_PROCEDURAL_INSTANCES] = "gl_VertexID+gl_InstanceID",
+};
+
+#define SHADER_HEADER                                                   \
+    "#version 300 es\n"                                                 \
+    "precision highp float;\n"                                          \
+    "uniform mat4 mvp;\n"                                               \
+    "uniform int side;\n"                                               \
+    "out vec4 color;\n"
+
+// The same function as in ./shaders/emote_procedural.vert
+#define SHADER_CUBE_VERTEX                                                              \
+    "const ivec3 cube_face_pairs[3] = ivec3[3](ivec3(0, 1, 2), ivec3(2, 1, 0), ivec3(0, 2, 1));\n" \
+    "void cube_vertex(int id, out vec3 position, out vec3 face_normal)\n"               \
+    "{\n"                                                                               \
+    "    int tri = id / 3;\n"                                                           \
+    "    int strip_index = tri % 2 + id % 3;\n"                                         \
+    "    int face = tri / 2;\n"                                                         \
+    "    ivec3 axes = cube_face_pairs[face / 2];\n"                                     \
+    "    float side = float(face % 2);\n"                                               \
+    "    position = vec3(0.0);\n"                                                       \
+    "    position[axes.x] = float(strip_index & 1);\n"                                  \
+    "    position[axes.y] = float(strip_index >> 1);\n"                                 \
+    "    position[axes.z] = side;\n"                                                    \
+    "    face_normal = vec3(0.0);\n"                                                    \
+    "    face_normal[axes.z] = 2.0 * side - 1.0;\n"                                     \
+    "}\n"
+
+#define SHADER_SHADE                                                    \
+    "    float light = 0.5 + 0.5 * abs(dot(vertex_normal, normalize(vec3(1.0, 2.0, 3.0))));\n" \
+    "    color = vec4(instance_color.rgb * light, 1.0);\n"
+
+static const char *const vertex_sources[COUNT_SOURCES] = {
+    [SOURCE_BUFFERED] =
+        SHADER_HEADER
+        "layout(location = 0) in vec4 vertex_position;\n"
+        "layout(location = 2) in vec4 vertex_normal4;\n"
+        "layout(location = 3) in vec3 instance_position;\n"
+        "layout(location = 4) in vec4 instance_color;\n"
+        "void main(void)\n"
+        "{\n"
+        "    vec3 vertex_normal = vertex_normal4.xyz;\n"
+        "    gl_Position = mvp * vec4(vertex_position.xyz * 0.5 + instance_position, 1.0);\n"
+        SHADER_SHADE
+        "}\n",
+    [SOURCE_PROCEDURAL] =
+        SHADER_HEADER
+        "layout(location = 3) in vec3 instance_position;\n"
+        "layout(location = 4) in vec4 instance_color;\n"
+        SHADER_CUBE_VERTEX
+        "void main(void)\n"
+        "{\n"
+        "    vec3 vertex_position, vertex_normal;\n"
+        "    cube_vertex(gl_VertexID, vertex_position, vertex_normal);\n"
+        "    gl_Position = mvp * vec4(vertex_position * 0.5 + instance_position, 1.0);\n"
+        SHADER_SHADE
+        "}\n",
+    [SOURCE_PROCEDURAL_INSTANCES] =
+        SHADER_HEADER
+        SHADER_CUBE_VERTEX
+        "void main(void)\n"
+        "{\n"
+        "    vec3 vertex_position, vertex_normal;\n"
+        "    cube_vertex(gl_VertexID, vertex_position, vertex_normal);\n"
+        "    ivec3 cell = ivec3(gl_InstanceID % side, gl_InstanceID / side % side, gl_InstanceID / (side * side));\n"
+        "    vec3 instance_position = vec3(cell);\n"
+        "    uint hash = uint(gl_InstanceID) * 2654435761u;\n"
+        "    vec4 instance_color = vec4(uvec4(hash, hash >> 8, hash >> 16, 255u) & 255u) / 255.0;\n"
+        "    gl_Position = mvp * vec4(vertex_position * 0.5 + instance_position, 1.0);\n"
+        SHADER_SHADE
+        "}\n",
+};
+
+static const char *const fragment_source =
+    "#version 300 es\n"
+    "precision mediump float;\n"
+    "in vec4 color;\n"
+    "out vec4 frag_color;\n"
+    "void main(void)\n"
+    "{\n"
+    "    frag_color = color;\n"
+    "}\n";
+
+GLuint compile_program(const char *vertex_source)
+{
+    const char *sources[] = {vertex_source, fragment_source};
+    const GLenum types[] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER};
+    GLuint program = glCreateProgram();
+    for (size_t i = 0; i < 2; ++i) {
+        GLuint shader = glCreateShader(types[i]);
+        glShaderSource(shader, 1, &sources[i], NULL);
+        glCompileShader(shader);
+        GLint compiled = 0;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            GLchar message[1024];
+            GLsizei message_size = 0;
+            glGetShaderInfoLog(shader, sizeof(message), &message_size, message);
+            fprintf(stderr, "ERROR: could not compile the bench shader: %.*s\n", message_size, message);
+            exit(1);
+        }
+        glAttachShader(program, shader);
+        glDeleteShader(shader);
+    }
+    glLinkProgram(program);
+    GLint linked = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        GLchar message[1024];
+        GLsizei message_size = 0;
+        glGetProgramInfoLog(program, sizeof(message), &message_size, message);
+        fprintf(stderr, "ERROR: could not link the bench shaders: %.*s\n", message_size, message);
+        exit(1);
+    }
+    return program;
+}
+
+typedef struct {
+    GLuint vao;
+    GLuint cube_buffers[2];
+    GLuint instance_buffer;
+    GLuint programs[COUNT_SOURCES];
+    GLuint query;
+    size_t side;
+    size_t count;
+} Bench;
+
+// Fills a cube of side×side×side cells with the first `count` cubes
+void bench_upload_instances(Bench *bench, size_t count)
+{
+    size_t side = 1;
+    while (side * side * side < count) side += 1;
+    bench->side = side;
+    bench->count = count;
+
+    Bench_Instance *instances = malloc(count * sizeof(*instances) + 1);
+    if (instances == NULL) {
+        fprintf(stderr, "ERROR: not enough memory for %zu instances\n", count);
+        exit(1);
+    }
+    for (size_t i = 0; i < count; ++i) {
+        instances[i].position[X] = (float) (i % side);
+        instances[i].position[Y] = (float) (i / side % side);
+        instances[i].position[Z] = (float) (i / (side * side));
+        const uint32_t hash = (uint32_t) i * 2654435761u;
+        instances[i].color = hash | 0xFF000000u;
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, bench->instance_buffer);
+    glBufferData(GL_ARRAY_BUFFER, count * sizeof(*instances), instances, GL_STATIC_DRAW);
+    free(instances);
+}
+
+void bench_bind(Bench *bench, Source source)
+{
+    glBindVertexArray(bench->vao);
+    glDisableVertexAttribArray(0);
+    glDisableVertexAttribArray(2);
+    glDisableVertexAttribArray(INSTANCE_POSITION_INDEX);
+    glDisableVertexAttribArray(INSTANCE_COLOR_INDEX);
+
+    if (source == SOURCE_BUFFERED) {
+        glBindBuffer(GL_ARRAY_BUFFER, bench->cube_buffers[0]);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, V4_COMPS, GL_FLOAT, GL_FALSE, 0, NULL);
+        glBindBuffer(GL_ARRAY_BUFFER, bench->cube_buffers[1]);
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, V4_COMPS, GL_FLOAT, GL_FALSE, 0, NULL);
+    }
+    if (source != SOURCE_PROCEDURAL_INSTANCES) {
+        glBindBuffer(GL_ARRAY_BUFFER, bench->instance_buffer);
+        glEnableVertexAttribArray(INSTANCE_POSITION_INDEX);
+        glVertexAttribPointer(INSTANCE_POSITION_INDEX, V3_COMPS, GL_FLOAT, GL_FALSE,
+                              sizeof(Bench_Instance), (void*) offsetof(Bench_Instance, position));
+        glVertexAttribDivisor(INSTANCE_POSITION_INDEX, 1);
+        glEnableVertexAttribArray(INSTANCE_COLOR_INDEX);
+        glVertexAttribPointer(INSTANCE_COLOR_INDEX, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+                              sizeof(Bench_Instance), (void*) offsetof(Bench_Instance, color));
+        glVertexAttribDivisor(INSTANCE_COLOR_INDEX, 1);
+    }
+
+    // The whole grid from a corner, looking at its center
+    const float side = (float) bench->side;
+    const float distance = 1.5f * side + 2.0f;
+    const Mat4 projection = mat4_perspective(MY_PI * 0.5f, (float) BENCH_WIDTH / BENCH_HEIGHT, 0.5f, 4.0f * distance);
+    const Mat4 view = mat4_mult_mat4(
+        mat4_mult_mat4(mat4_translate(0.0f, 0.0f, -distance), mat4_rotate_y(0.6f)),
+        mat4_translate(-0.5f * side, -0.5f * side, -0.5f * side));
+    const Mat4 mvp = mat4_mult_mat4(projection, view);
+
+    glUseProgram(bench->programs[source]);
+    // Mat4 is row-major
+    glUniformMatrix4fv(glGetUniformLocation(bench->programs[source], "mvp"), 1, GL_TRUE, &mvp.vs[0][0]);
+    glUniform1i(glGetUniformLocation(bench->programs[source], "side"), (GLint) bench->side);
+}
+
+// Seconds per frame on the GPU from the timer query, and on the wall clock
+// from the first command until glFinish() returns. Software rasterizers
+// tend to do all the work in glFinish(), out of reach of the query.
+void bench_measure(Bench *bench, Source source, double *gpu_secs, double *frame_secs)
+{
+    bench_bind(bench, source);
+
+    // Warms the driver up, the first draw compiles the shaders for real
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glDrawArraysInstanced(GL_TRIANGLES, 0, TRIS_PER_CUBE * TRI_VERTICES, (GLsizei) bench->count);
+    glFinish();
+
+    size_t frames = 0;
+    double gpu = 0.0;
+    double frame = 0.0;
+    const double start = timer_now();
+    do {
+        glBeginQuery(GL_TIME_ELAPSED, bench->query);
+        const double frame_start = timer_now();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, TRIS_PER_CUBE * TRI_VERTICES, (GLsizei) bench->count);
+        glEndQuery(GL_TIME_ELAPSED);
+        glFinish();
+        frame += timer_now() - frame_start;
+
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(bench->query, GL_QUERY_RESULT, &elapsed);
+        gpu += (double) elapsed * 1e-9;
+        frames += 1;
+    } while (frames < BENCH_MIN_FRAMES || timer_now() - start < BENCH_MIN_SECS);
+
+    *gpu_secs = gpu / (double) frames;
+    *frame_secs = frame / (double) frames;
+}
+
+int main(int argc, char **argv)
+{
+    size_t counts[BENCH_MAX_COUNTS] = {10 * 1000, 100 * 1000, 1000 * 1000};
+    size_t counts_count = 3;
+    if (argc > 1) {
+        counts_count = 0;
+        for (int i = 1; i < argc; ++i) {
+            char *end = NULL;
+            const unsigned long long count = strtoull(argv[i], &end, 10);
+            if (*end != '\0' || count == 0 || counts_count >= BENCH_MAX_COUNTS) {
+                fprintf(stderr, "Usage: %s [cubes...]\n", argv[0]);
+                fprintf(stderr, "ERROR: unexpected argument `%s`\n", argv[i]);
+                exit(1);
+            }
+            counts[counts_count++] = (size_t) count;
+        }
+    }
+
+    if (!glfwInit()) {
+        fprintf(stderr, "ERROR: could not initialize GLFW\n");
+        exit(1);
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow *window = glfwCreateWindow(BENCH_WIDTH, BENCH_HEIGHT, "bench_cube", NULL, NULL);
+    if (window == NULL) {
+        fprintf(stderr, "ERROR: could not create a window\n");
+        glfwTerminate();
+        exit(1);
+    }
+    glfwMakeContextCurrent(window);
+    if (GLEW_OK != glewInit()) {
+        fprintf(stderr, "ERROR: could not initialize GLEW\n");
+        exit(1);
+    }
+    if (!GLEW_VERSION_3_3 && !GLEW_ARB_timer_query) {
+        fprintf(stderr, "ERROR: the driver has no timer queries\n");
+        exit(1);
+    }
+    printf("%s\n", (const char *) glGetString(GL_RENDERER));
+
+    Bench bench = {0};
+    glGenVertexArrays(1, &bench.vao);
+    glGenBuffers(2, bench.cube_buffers);
+    glGenBuffers(1, &bench.instance_buffer);
+    glGenQueries(1, &bench.query);
+    for (size_t source = 0; source < COUNT_SOURCES; ++source) {
+        bench.programs[source] = compile_program(vertex_sources[source]);
+    }
+
+    static Cube_Mesh cube = {0};
+    static RGBA colors[TRIS_PER_CUBE][TRI_VERTICES];
+    generate_cube_mesh(cube.mesh, colors, cube.uvs, cube.normals);
+    glBindBuffer(GL_ARRAY_BUFFER, bench.cube_buffers[0]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(cube.mesh), cube.mesh, GL_STATIC_DRAW);
+    glBindBuffer(GL_ARRAY_BUFFER, bench.cube_buffers[1]);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(cube.normals), cube.normals, GL_STATIC_DRAW);
+
+    glViewport(0, 0, BENCH_WIDTH, BENCH_HEIGHT);
+    glEnable(GL_DEPTH_TEST);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    printf("%10s  %-26s %12s %12s %14s\n", "cubes", "vertices", "gpu ms", "frame ms", "vertex bytes");
+    for (size_t i = 0; i < counts_count; ++i) {
+        bench_upload_instances(&bench, counts[i]);
+        for (size_t source = 0; source < COUNT_SOURCES; ++source) {
+            size_t bytes = 0;
+            if (source == SOURCE_BUFFERED) bytes += sizeof(cube.mesh) + sizeof(cube.normals);
+            if (source != SOURCE_PROCEDURAL_INSTANCES) bytes += counts[i] * sizeof(Bench_Instance);
+
+            double gpu_secs = 0.0, frame_secs = 0.0;
+            bench_measure(&bench, (Source) source, &gpu_secs, &frame_secs);
+            printf("%10zu  %-26s %12.3f %12.3f %14zu\n", counts[i], source_names[source],
+                   gpu_secs * 1000.0, frame_secs * 1000.0, bytes);
+        }
+    }
+
+    glfwDestroyWindow(window);
+    glfwTerminate();
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "./image.h"
+#include "./timer.h"
+
+// Compares decoding throughput of the texture image formats. Every input
+// is converted in memory to each format first, so the numbers do not
+// include any disk IO.
+//   $ ./bench_image images/*.png
+
+#define BENCH_MIN_SECS 0.25
+
+Region source_region;
+Region encoded_regions[COUNT_IMAGE_FORMATS];
+Region decode_region;
+
+typedef struct {
+    const uint8_t *data;
+    size_t size;
+} Encoded_Image;
+
+typedef struct {
+    size_t decoded_bytes;
+    double secs;
+} Bench_Total;
+
+double bench_decode(Image_Format format, Encoded_Image encoded, size_t *decoded_bytes)
+{
+    static uint8_t destination[REGION_CAPACITY];
+
+    size_t iterations = 0;
+    size_t bytes = 0;
+    const double start = timer_now();
+    double elapsed = 0.0;
+    do {
+        region_clean(&decode_region);
+        Image image = {0};
+        if (!image_decode(&decode_region, format, encoded.data, encoded.size, &image)) {
+            fprintf(stderr, "ERROR: could not decode %s: %s\n",
+                    image_format_name(format), image_failure_reason());
+            exit(1);
+        }
+
+        const size_t size = (size_t) image.width * image.height * IMAGE_COMPS;
+        if (format == IMAGE_FORMAT_RAW) {
+            // RAW decoding is zero-copy, so count the copy it takes to
+            // actually bring the pixels into memory
+            memcpy(destination, image.pixels, size);
+        }
+
+        bytes += size;
+        iterations += 1;
+        elapsed = timer_now() - start;
+    } while (elapsed < BENCH_MIN_SECS);
+
+    *decoded_bytes = bytes;
+    return elapsed;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <image...>\n", argv[0]);
+        fprintf(stderr, "ERROR: no input images provided\n");
+        exit(1);
+    }
+
+    Bench_Total totals[COUNT_IMAGE_FORMATS] = {0};
+
+    printf("%-24s", "image");
+    for (Image_Format format = 0; format < COUNT_IMAGE_FORMATS; ++format) {
+        printf(" %14s", image_format_name(format));
+    }
+    printf("\n");
+
+    for (int i = 1; i < argc; ++i) {
+        const char *const file_path = argv[i];
+        region_clean(&source_region);
+
+        Encoded_Image encoded[COUNT_IMAGE_FORMATS] = {0};
+        Image image = {0};
+        {
+            size_t size = 0;
+            const char *data = region_slurp_file_sized(&source_region, file_path, &size);
+            if (data == NULL) {
+                fprintf(stderr, "ERROR: could not read file %s: %s\n", file_path, strerror(errno));
+                exit(1);
+            }
+
+            const Image_Format source_format = image_format_by_file_path(file_path);
+            if (!image_decode(&source_region, source_format, data, size, &image)) {
+                fprintf(stderr, "ERROR: could not decode file %s: %s\n", file_path, image_failure_reason());
+                exit(1);
+            }
+            encoded[source_format].data = (const uint8_t*) data;
+            encoded[source_format].size = size;
+        }
+
+        for (Image_Format format = 0; format < COUNT_IMAGE_FORMATS; ++format) {
+            region_clean(&encoded_regions[format]);
+            if (encoded[format].data == NULL) {
+                uint8_t *data = NULL;
+                if (!image_encode(&encoded_regions[format], format, image, &data, &encoded[format].size)) {
+                    // There is no PNG encoder, so a non-PNG input is only
+                    // benchmarked in the formats we can produce
+                    continue;
+                }
+                encoded[format].data = data;
+            }
+        }
+
+        printf("%-24s", file_path);
+        for (Image_Format format = 0; format < COUNT_IMAGE_FORMATS; ++format) {
+            if (encoded[format].data == NULL) {
+                printf(" %14s", "-");
+                continue;
+            }
+
+            size_t decoded_bytes = 0;
+            const double secs = bench_decode(format, encoded[format], &decoded_bytes);
+            totals[format].decoded_bytes += decoded_bytes;
+            totals[format].secs += secs;
+            printf(" %9.1f MB/s", (double) decoded_bytes / secs / 1e6);
+        }
+        printf("\n");
+    }
+
+    printf("%-24s", "total");
+    for (Image_Format format = 0; format < COUNT_IMAGE_FORMATS; ++format) {
+        if (totals[format].secs > 0.0) {
+            printf(" %9.1f MB/s", (double) totals[format].decoded_bytes / totals[format].secs / 1e6);
+        } else {
+            printf(" %14s", "-");
+        }
+    }
+    printf("\n");
+
+    return 0;
+}
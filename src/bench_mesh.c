@@ -0,0 +1,278 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <math.h>
+
+#include "./sv.h"
+#include "./kmesh.h"
+#include "./mapped_file.h"
+#include "./timer.h"
+
+// Parses OBJ and binary PLY meshes on 1..N threads and reports the
+// throughput, then loads the same mesh from the binary cache. Without
+// files it generates a wavy grid of a couple of million triangles in both
+// formats in memory.
+//   $ ./bench_mesh -j 8
+//   $ ./bench_mesh -j 8 bunny.obj dragon.ply
+
+#define BENCH_MIN_SECS 0.5
+#define BENCH_GRID 1024
+#define BENCH_KMESH_FILE_PATH "./bench_mesh.kmesh"
+
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+} Buffer;
+
+void buffer_append(Buffer *buffer, const void *data, size_t size)
+{
+    if (buffer->size + size > buffer->capacity) {
+        size_t new_capacity = buffer->capacity == 0 ? 4096 : buffer->capacity;
+        while (buffer->size + size > new_capacity) new_capacity *= 2;
+        char *new_data = realloc(buffer->data, new_capacity);
+        if (new_data == NULL) {
+            fprintf(stderr, "ERROR: out of memory\n");
+            exit(1);
+        }
+        buffer->data = new_data;
+        buffer->capacity = new_capacity;
+    }
+    memcpy(buffer->data + buffer->size, data, size);
+    buffer->size += size;
+}
+
+void buffer_printf(Buffer *buffer, const char *format, ...)
+{
+    char line[1024];
+    va_list args;
+    va_start(args, format);
+    const int n = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    buffer_append(buffer, line, (size_t) n);
+}
+
+float grid_height(size_t x, size_t y)
+{
+    return 0.1f * sinf((float) x * 0.05f) * cosf((float) y * 0.07f);
+}
+
+size_t grid_index(size_t x, size_t y)
+{
+    return y * (BENCH_GRID + 1) + x;
+}
+
+// Every quad of the grid is a single OBJ face, so the parser triangulates
+// and deduplicates the shared v/vt/vn triples
+void generate_obj(Buffer *buffer)
+{
+    for (size_t y = 0; y <= BENCH_GRID; ++y) {
+        for (size_t x = 0; x <= BENCH_GRID; ++x) {
+            buffer_printf(buffer, "v %f %f %f\n", (float) x, (float) y, grid_height(x, y));
+            buffer_printf(buffer, "vt %f %f\n", (float) x / BENCH_GRID, (float) y / BENCH_GRID);
+            buffer_printf(buffer, "vn 0 0 1\n");
+        }
+    }
+    for (size_t y = 0; y < BENCH_GRID; ++y) {
+        for (size_t x = 0; x < BENCH_GRID; ++x) {
+            const size_t a = grid_index(x, y) + 1, b = grid_index(x + 1, y) + 1;
+            const size_t c = grid_index(x + 1, y + 1) + 1, d = grid_index(x, y + 1) + 1;
+            buffer_printf(buffer, "f %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu %zu/%zu/%zu\n",
+                          a, a, a, b, b, b, c, c, c, d, d, d);
+        }
+    }
+}
+
+void generate_ply(Buffer *buffer)
+{
+    const size_t vertices = (BENCH_GRID + 1) * (BENCH_GRID + 1);
+    buffer_printf(buffer,
+                  "ply\n"
+                  "format binary_little_endian 1.0\n"
+                  "element vertex %zu\n"
+                  "property float x\nproperty float y\nproperty float z\n"
+                  "property float nx\nproperty float ny\nproperty float nz\n"
+                  "property float u\nproperty float v\n"
+                  "element face %zu\n"
+                  "property list uchar int vertex_indices\n"
+                  "end_header\n",
+                  vertices, (size_t) BENCH_GRID * BENCH_GRID);
+
+    for (size_t y = 0; y <= BENCH_GRID; ++y) {
+        for (size_t x = 0; x <= BENCH_GRID; ++x) {
+            const float vertex[] = {
+                (float) x, (float) y, grid_height(x, y),
+                0.0f, 0.0f, 1.0f,
+                (float) x / BENCH_GRID, (float) y / BENCH_GRID,
+            };
+            buffer_append(buffer, vertex, sizeof(vertex));
+        }
+    }
+    for (size_t y = 0; y < BENCH_GRID; ++y) {
+        for (size_t x = 0; x < BENCH_GRID; ++x) {
+            const uint8_t n = 4;
+            const int32_t quad[] = {
+                (int32_t) grid_index(x, y), (int32_t) grid_index(x + 1, y),
+                (int32_t) grid_index(x + 1, y + 1), (int32_t) grid_index(x, y + 1),
+            };
+            buffer_append(buffer, &n, sizeof(n));
+            buffer_append(buffer, quad, sizeof(quad));
+        }
+    }
+}
+
+// Average seconds per parse
+double bench(const char *name, const char *data, size_t size, Pool *pool, Mesh *mesh)
+{
+    size_t runs = 0;
+    double elapsed = 0.0;
+    for (bool warmup = true; ; warmup = false) {
+        const char *error = NULL;
+        const double start = timer_now();
+        const bool ok = mesh_parse(name, data, size, pool, mesh, &error);
+        const double secs = timer_now() - start;
+        if (!ok) {
+            fprintf(stderr, "ERROR: could not parse %s: %s\n", name, error);
+            exit(1);
+        }
+
+        if (!warmup) {
+            runs += 1;
+            elapsed += secs;
+            if (elapsed >= BENCH_MIN_SECS) break;
+        }
+        mesh_free(mesh);
+    }
+    return elapsed / (double) runs;
+}
+
+// Average seconds to map the binary cache and copy it into `vertices` and
+// `indices`, where kidito calls glBufferData() instead
+double bench_kmesh(const char *file_path, size_t *file_size, void *vertices, void *indices)
+{
+    size_t runs = 0;
+    double elapsed = 0.0;
+    for (bool warmup = true; ; warmup = false) {
+        Kmesh kmesh = {0};
+        const char *error = NULL;
+        const double start = timer_now();
+        if (!kmesh_open(file_path, &kmesh, &error)) {
+            fprintf(stderr, "ERROR: could not open %s: %s\n", file_path, error);
+            exit(1);
+        }
+        memcpy(vertices, kmesh.vertices, kmesh.header->vertices_count * kmesh.header->vertex_size);
+        memcpy(indices, kmesh_lod_indices(&kmesh, 0), kmesh.lods[0].indices_count * sizeof(uint32_t));
+        *file_size = kmesh.header->file_size;
+        kmesh_close(&kmesh);
+        const double secs = timer_now() - start;
+
+        if (!warmup) {
+            runs += 1;
+            elapsed += secs;
+            if (elapsed >= BENCH_MIN_SECS) break;
+        }
+    }
+    return elapsed / (double) runs;
+}
+
+void report(const char *name, const char *data, size_t size, Pool **pools, size_t max_threads)
+{
+    Mesh mesh = {0};
+    for (size_t threads = 1; threads <= max_threads; ++threads) {
+        mesh_free(&mesh);
+        const double secs = bench(name, data, size, pools[threads], &mesh);
+        printf("%-24s %8zu %12zu %10zu %10.1f %10.1f\n",
+               name, threads, mesh.indices_count / TRI_VERTICES, mesh.vertices_count,
+               secs * 1000.0, (double) size / secs / (1000.0 * 1000.0));
+    }
+
+    if (!kmesh_save(BENCH_KMESH_FILE_PATH, &mesh, NULL, 0, 0)) {
+        fprintf(stderr, "ERROR: could not write file %s: %s\n", BENCH_KMESH_FILE_PATH, strerror(errno));
+        exit(1);
+    }
+    size_t file_size = 0;
+    const double secs = bench_kmesh(BENCH_KMESH_FILE_PATH, &file_size, mesh.vertices, mesh.indices);
+    remove(BENCH_KMESH_FILE_PATH);
+    printf("%-24s %8s %12zu %10zu %10.1f %10.1f\n",
+           "  as "KMESH_EXTENSION, "-", mesh.indices_count / TRI_VERTICES, mesh.vertices_count,
+           secs * 1000.0, (double) file_size / secs / (1000.0 * 1000.0));
+    mesh_free(&mesh);
+}
+
+void usage(FILE *stream, const char *program)
+{
+    fprintf(stream, "Usage: %s [-j <max-threads>] [<mesh.obj|mesh.ply...>]\n", program);
+}
+
+int main(int argc, char **argv)
+{
+    const char *const program = argv[0];
+    size_t max_threads = pool_hardware_threads();
+    char **file_paths = calloc((size_t) argc, sizeof(*file_paths));
+    size_t file_paths_count = 0;
+    if (file_paths == NULL) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0) {
+            if (i + 1 >= argc) {
+                usage(stderr, program);
+                fprintf(stderr, "ERROR: no value provided for -j\n");
+                exit(1);
+            }
+            max_threads = (size_t) sv_to_u64(sv_from_cstr(argv[++i]));
+            if (max_threads == 0) max_threads = 1;
+        } else {
+            file_paths[file_paths_count++] = argv[i];
+        }
+    }
+
+    Pool **pools = calloc(max_threads + 1, sizeof(*pools));
+    if (pools == NULL) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    for (size_t threads = 1; threads <= max_threads; ++threads) {
+        pools[threads] = pool_create(threads - 1);
+        if (pools[threads] == NULL) {
+            fprintf(stderr, "ERROR: could not create %zu threads: %s\n", threads, strerror(errno));
+            exit(1);
+        }
+    }
+
+    printf("up to %zu threads\n", max_threads);
+    printf("%-24s %8s %12s %10s %10s %10s\n", "mesh", "threads", "tris", "vertices", "ms", "MB/s");
+
+    if (file_paths_count == 0) {
+        Buffer obj = {0}, ply = {0};
+        generate_obj(&obj);
+        generate_ply(&ply);
+        report("grid.obj", obj.data, obj.size, pools, max_threads);
+        report("grid.ply", ply.data, ply.size, pools, max_threads);
+        free(obj.data);
+        free(ply.data);
+    }
+
+    for (size_t i = 0; i < file_paths_count; ++i) {
+        Mapped_File file = {0};
+        if (!mapped_file_open(file_paths[i], &file)) {
+            fprintf(stderr, "ERROR: could not open file %s: %s\n", file_paths[i], strerror(errno));
+            exit(1);
+        }
+        mapped_file_will_need(&file);
+        report(file_paths[i], file.data, file.size, pools, max_threads);
+        mapped_file_close(&file);
+    }
+
+    for (size_t threads = 1; threads <= max_threads; ++threads) {
+        pool_destroy(pools[threads]);
+    }
+    free(pools);
+    free(file_paths);
+
+    return 0;
+}
@@ -0,0 +1,263 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "./bvh.h"
+#include "./occlusion.h"
+#include "./timer.h"
+
+// Culls a city of towers made of unit cubes from cameras walking its
+// streets, with the frustum only and with the towers as occluders, and
+// reports how many cubes the occlusion buffer rejects, the CPU time of
+// culling and gathering the instances of a frame with and without it, and
+// how much of it goes into drawing the occluders.
+//   $ ./bench_occlusion
+
+#define BENCH_MIN_SECS 0.5
+#define BENCH_QUERIES 64
+// Towers per side of the city
+#define BENCH_TOWERS 32
+// Cubes per side of the footprint of a tower
+#define BENCH_TOWER_SIZE 4
+#define BENCH_STREET_WIDTH 4
+#define BENCH_MIN_FLOORS 8
+#define BENCH_MAX_FLOORS 24
+#define BENCH_BLOCK (BENCH_TOWER_SIZE + BENCH_STREET_WIDTH)
+#define BENCH_EYE_HEIGHT 1.7f
+
+// What a frame uploads for every visible cube, like Emote_Instance
+typedef struct {
+    float position[V3_COMPS];
+    uint32_t color;
+} Bench_Instance;
+
+typedef struct {
+    size_t count;
+    Aabb *aabbs;
+    Bench_Instance *instances;
+    Aabb towers[BENCH_TOWERS * BENCH_TOWERS];
+    Mat4 mvps[BENCH_QUERIES];
+    float eyes[BENCH_QUERIES][V3_COMPS];
+    Bvh bvh;
+    Occlusion_Buffer occlusion;
+    uint32_t *visible;
+    Bench_Instance *gathered;
+    size_t rejected;
+} Bench;
+
+typedef size_t (*Bench_Query)(Bench *bench, size_t query);
+
+static uint32_t rand_state = 0x12345678;
+
+// xorshift32, so every run builds the same city
+uint32_t rand_next(void)
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+float rand_float(float min, float max)
+{
+    return min + (max - min) * ((float) rand_next() / (float) UINT32_MAX);
+}
+
+void bench_init(Bench *bench)
+{
+    memset(bench, 0, sizeof(*bench));
+
+    size_t floors[BENCH_TOWERS * BENCH_TOWERS];
+    size_t capacity = 0;
+    for (size_t i = 0; i < BENCH_TOWERS * BENCH_TOWERS; ++i) {
+        floors[i] = BENCH_MIN_FLOORS + rand_next() % (BENCH_MAX_FLOORS - BENCH_MIN_FLOORS + 1);
+        capacity += floors[i] * BENCH_TOWER_SIZE * BENCH_TOWER_SIZE;
+    }
+
+    bench->aabbs = malloc(capacity * sizeof(*bench->aabbs));
+    bench->instances = malloc(capacity * sizeof(*bench->instances));
+    bench->visible = malloc(capacity * sizeof(*bench->visible));
+    bench->gathered = malloc(capacity * sizeof(*bench->gathered));
+    if (bench->aabbs == NULL || bench->instances == NULL ||
+            bench->visible == NULL || bench->gathered == NULL) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+
+    for (size_t tz = 0; tz < BENCH_TOWERS; ++tz) {
+        for (size_t tx = 0; tx < BENCH_TOWERS; ++tx) {
+            const size_t tower = tz * BENCH_TOWERS + tx;
+            const float x0 = (float) (tx * BENCH_BLOCK + BENCH_STREET_WIDTH);
+            const float z0 = (float) (tz * BENCH_BLOCK + BENCH_STREET_WIDTH);
+            bench->towers[tower] = (Aabb) {
+                .min = {x0, 0.0f, z0},
+                .max = {x0 + BENCH_TOWER_SIZE, (float) floors[tower], z0 + BENCH_TOWER_SIZE},
+            };
+
+            for (size_t y = 0; y < floors[tower]; ++y) {
+                for (size_t z = 0; z < BENCH_TOWER_SIZE; ++z) {
+                    for (size_t x = 0; x < BENCH_TOWER_SIZE; ++x) {
+                        const float p[V3_COMPS] = {x0 + (float) x, (float) y, z0 + (float) z};
+                        Aabb *aabb = &bench->aabbs[bench->count];
+                        Bench_Instance *instance = &bench->instances[bench->count];
+                        for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+                            aabb->min[axis] = p[axis];
+                            aabb->max[axis] = p[axis] + 1.0f;
+                            instance->position[axis] = p[axis] + 0.5f;
+                        }
+                        instance->color = rand_next();
+                        bench->count += 1;
+                    }
+                }
+            }
+        }
+    }
+
+    // Pedestrians at crossings of the streets looking anywhere around
+    const float size = (float) (BENCH_TOWERS * BENCH_BLOCK);
+    const Mat4 projection = mat4_perspective(MY_PI * 0.5f, 16.0f / 9.0f, 1.0f, size);
+    for (size_t q = 0; q < BENCH_QUERIES; ++q) {
+        const float street = 0.5f * BENCH_STREET_WIDTH;
+        float *eye = bench->eyes[q];
+        eye[X] = (float) (rand_next() % BENCH_TOWERS * BENCH_BLOCK) + street;
+        eye[Y] = BENCH_EYE_HEIGHT;
+        eye[Z] = (float) (rand_next() % BENCH_TOWERS * BENCH_BLOCK) + street;
+        const float yaw = rand_float(0.0f, 2.0f * MY_PI);
+
+        const Mat4 view = mat4_mult_mat4(mat4_rotate_y(yaw),
+                                         mat4_translate(-eye[X], -eye[Y], -eye[Z]));
+        bench->mvps[q] = mat4_mult_mat4(projection, view);
+    }
+}
+
+void bench_free(Bench *bench)
+{
+    free(bench->aabbs);
+    free(bench->instances);
+    free(bench->visible);
+    free(bench->gathered);
+}
+
+// Copies the instances of the visible cubes the way a frame does before
+// uploading them
+size_t gather(Bench *bench, size_t visible_count)
+{
+    for (size_t i = 0; i < visible_count; ++i) {
+        bench->gathered[i] = bench->instances[bench->visible[i]];
+    }
+    return visible_count;
+}
+
+size_t query_frustum(Bench *bench, size_t query)
+{
+    const Frustum frustum = frustum_from_mat4(bench->mvps[query]);
+    return gather(bench, bvh_cull(&bench->bvh, &frustum, bench->visible));
+}
+
+bool occlusion_filter(void *arg, const float min[V3_COMPS], const float max[V3_COMPS])
+{
+    return occlusion_test_box(arg, min, max);
+}
+
+// The part of query_occlusion() that the frustum culling does not do
+size_t query_occluders(Bench *bench, size_t query)
+{
+    Occlusion_Buffer *occlusion = &bench->occlusion;
+    occlusion_begin(occlusion, bench->mvps[query], bench->eyes[query]);
+    for (size_t i = 0; i < BENCH_TOWERS * BENCH_TOWERS; ++i) {
+        occlusion_draw_box(occlusion, bench->towers[i].min, bench->towers[i].max);
+    }
+    occlusion_build_hiz(occlusion);
+    return 0;
+}
+
+size_t query_occlusion(Bench *bench, size_t query)
+{
+    Occlusion_Buffer *occlusion = &bench->occlusion;
+    query_occluders(bench, query);
+
+    const Frustum frustum = frustum_from_mat4(bench->mvps[query]);
+    const size_t visible_count = bvh_cull_filtered(&bench->bvh, &frustum,
+                                                   occlusion_filter, occlusion,
+                                                   bench->visible, &bench->rejected);
+    return gather(bench, visible_count);
+}
+
+// Runs the queries round robin for at least BENCH_MIN_SECS and returns the
+// average seconds per query. `results` receives the sum of the results of
+// the first BENCH_QUERIES queries and `rejected` the sum of the objects
+// they rejected.
+double measure(Bench *bench, Bench_Query query, size_t *results, size_t *rejected)
+{
+    size_t queries = 0;
+    double elapsed = 0.0;
+    *results = 0;
+    *rejected = 0;
+
+    const double start = timer_now();
+    do {
+        bench->rejected = 0;
+        const size_t result = query(bench, queries % BENCH_QUERIES);
+        if (queries < BENCH_QUERIES) {
+            *results += result;
+            *rejected += bench->rejected;
+        }
+        queries += 1;
+        elapsed = timer_now() - start;
+    } while (elapsed < BENCH_MIN_SECS || queries < BENCH_QUERIES);
+
+    return elapsed / (double) queries;
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1) {
+        fprintf(stderr, "Usage: %s\n", argv[0]);
+        fprintf(stderr, "ERROR: unexpected argument `%s`\n", argv[1]);
+        exit(1);
+    }
+
+    static Bench bench;
+    bench_init(&bench);
+
+    Region region = region_with_capacity(bvh_memory_size(bench.count));
+    if (!bvh_build(&region, NULL, bench.aabbs, bench.count, &bench.bvh)) {
+        fprintf(stderr, "ERROR: could not build the BVH: %s\n", strerror(errno));
+        exit(1);
+    }
+
+    printf("%d towers of %zu cubes, %dx%d occlusion buffer, %d queries\n",
+           BENCH_TOWERS * BENCH_TOWERS, bench.count, OCCLUSION_WIDTH, OCCLUSION_HEIGHT, BENCH_QUERIES);
+
+    size_t frustum_visible = 0, occlusion_visible = 0;
+    size_t frustum_rejected = 0, occlusion_rejected = 0;
+    const double frustum_secs = measure(&bench, query_frustum, &frustum_visible, &frustum_rejected);
+    const double occlusion_secs = measure(&bench, query_occlusion, &occlusion_visible, &occlusion_rejected);
+    size_t occluders_visible = 0, occluders_rejected = 0;
+    const double occluders_secs = measure(&bench, query_occluders, &occluders_visible, &occluders_rejected);
+
+    printf("  frustum     %10.3f ms/frame, %zu visible on average\n",
+           frustum_secs * 1000.0, frustum_visible / BENCH_QUERIES);
+    printf("  occlusion   %10.3f ms/frame, %zu visible on average, %zu cubes under the rejected boxes\n",
+           occlusion_secs * 1000.0, occlusion_visible / BENCH_QUERIES, occlusion_rejected / BENCH_QUERIES);
+    printf("  occluders   %10.3f ms/frame of it drawing the towers and building the Hi-Z\n",
+           occluders_secs * 1000.0);
+    // Negative when rejecting the cubes early costs less than gathering them
+    printf("  overhead    %+10.3f ms/frame of CPU time over the frustum alone\n",
+           (occlusion_secs - frustum_secs) * 1000.0);
+    printf("  avoided     %10zu instances per frame not gathered, uploaded or drawn (%.1f%%)\n",
+           (frustum_visible - occlusion_visible) / BENCH_QUERIES,
+           100.0 * (1.0 - (double) occlusion_visible / (double) frustum_visible));
+
+    // Both cull the same frustum, the occlusion may only take cubes away
+    if (occlusion_visible > frustum_visible) {
+        fprintf(stderr, "ERROR: the occlusion culling found more visible cubes than the frustum\n");
+        exit(1);
+    }
+
+    region_free(&region);
+    bench_free(&bench);
+    return 0;
+}
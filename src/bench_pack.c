@@ -0,0 +1,338 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "./hash.h"
+#include "./image.h"
+#include "./pack.h"
+#include "./preload.h"
+#include "./timer.h"
+
+// Compares the ways of getting the same set of decoded images into memory:
+//   - reading the PNG files and decoding them
+//   - reading pre-decoded KRAW files one by one
+//   - opening a stored asset pack
+//   - opening an LZ4 asset pack, decompressing with 1..N threads
+//   $ ./bench_pack                    # every PNG in ./images/
+//   $ ./bench_pack -j 8 images/*.png
+// The files are in the page cache for all of them, so this measures the
+// CPU side of loading, not the disk.
+
+#define BENCH_MIN_SECS 0.5
+#define BENCH_REGION_CAPACITY (256 * 1000 * 1000)
+#define DEFAULT_IMAGES_DIR "./images"
+#define BENCH_RAW_DIR "./bench_pack-raw"
+#define BENCH_STORE_PACK_FILE_PATH "./bench_pack-store.kpak"
+#define BENCH_LZ4_PACK_FILE_PATH "./bench_pack-lz4.kpak"
+#define BENCH_RAW_FILE_PATH_CAPACITY 64
+#define BENCH_PAGE_SIZE 4096
+
+typedef struct {
+    const char *file_path;
+    const char *raw_file_path;
+} Bench_Input;
+
+typedef struct {
+    Bench_Input *inputs;
+    size_t inputs_count;
+    const char *pack_file_path;
+    Pool *pool;
+} Bench_Context;
+
+typedef void (*Bench_Load)(Bench_Context *context);
+
+// Inputs and everything derived from them, lives for the whole run
+Region region;
+// Reset on every load
+Region scratch;
+volatile uint8_t sink;
+
+void usage(FILE *stream, const char *program)
+{
+    fprintf(stream, "Usage: %s [-j <max-threads>] [<images-dir> | <image.png...>]\n", program);
+}
+
+// Reads a byte of every page, so zero-copy loads pay for faulting the data
+// in like the others do
+void touch(const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    uint8_t sum = 0;
+    for (size_t i = 0; i < size; i += BENCH_PAGE_SIZE) {
+        sum += bytes[i];
+    }
+    sink += sum;
+}
+
+void load_image_files(Bench_Context *context, bool raw)
+{
+    for (size_t i = 0; i < context->inputs_count; ++i) {
+        region_clean(&scratch);
+
+        const char *file_path = raw
+                                ? context->inputs[i].raw_file_path
+                                : context->inputs[i].file_path;
+        size_t size = 0;
+        const char *data = region_slurp_file_sized(&scratch, file_path, &size);
+        if (data == NULL) {
+            fprintf(stderr, "ERROR: could not read file %s: %s\n", file_path, strerror(errno));
+            exit(1);
+        }
+
+        Image image = {0};
+        const Image_Format format = raw ? IMAGE_FORMAT_RAW : IMAGE_FORMAT_PNG;
+        if (!image_decode(&scratch, format, data, size, &image)) {
+            fprintf(stderr, "ERROR: could not decode %s: %s\n", file_path, image_failure_reason());
+            exit(1);
+        }
+        touch(image.pixels, (size_t) image.width * image.height * IMAGE_COMPS);
+    }
+}
+
+void load_png_files(Bench_Context *context)
+{
+    load_image_files(context, false);
+}
+
+void load_raw_files(Bench_Context *context)
+{
+    load_image_files(context, true);
+}
+
+void load_pack(Bench_Context *context)
+{
+    Pack pack;
+    const char *error = NULL;
+    if (!pack_open(context->pack_file_path, &pack, context->pool, &error)) {
+        fprintf(stderr, "ERROR: could not open %s: %s\n", context->pack_file_path, error);
+        exit(1);
+    }
+
+    for (size_t i = 0; i < pack.header->entries_count; ++i) {
+        const Pack_Entry *entry = &pack.entries[i];
+        touch(pack_entry_data(&pack, entry), entry->size);
+    }
+
+    pack_close(&pack);
+}
+
+// Average seconds per load
+double bench(Bench_Load load, Bench_Context *context)
+{
+    // Warm up the page cache and the allocators
+    load(context);
+
+    size_t loads = 0;
+    double elapsed = 0.0;
+    while (elapsed < BENCH_MIN_SECS) {
+        const double start = timer_now();
+        load(context);
+        elapsed += timer_now() - start;
+        loads += 1;
+    }
+
+    return elapsed / (double) loads;
+}
+
+void report(const char *name, double secs, size_t decoded_size, size_t disk_size)
+{
+    printf("%-20s %10.3f %10.1f %12zu\n", name, secs * 1000.0, (double) decoded_size / secs / 1e6, disk_size);
+}
+
+size_t file_size_of(const char *file_path)
+{
+    struct stat st;
+    if (stat(file_path, &st) != 0) {
+        fprintf(stderr, "ERROR: could not stat %s: %s\n", file_path, strerror(errno));
+        exit(1);
+    }
+    return (size_t) st.st_size;
+}
+
+void write_file(const char *file_path, const void *data, size_t size)
+{
+    FILE *f = fopen(file_path, "wb");
+    if (f == NULL || fwrite(data, size, 1, f) != 1) {
+        fprintf(stderr, "ERROR: could not write file %s: %s\n", file_path, strerror(errno));
+        exit(1);
+    }
+    fclose(f);
+}
+
+void save_pack(Pack_Builder *builder, Pack_Codec codec, const char *file_path)
+{
+    builder->codec = codec;
+    if (!pack_builder_save(builder, file_path)) {
+        fprintf(stderr, "ERROR: could not write %s: %s\n", file_path, strerror(errno));
+        exit(1);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *const program = argv[0];
+    size_t max_threads = pool_hardware_threads();
+
+    const char **file_paths = NULL;
+    size_t file_paths_count = 0;
+
+    region = region_with_capacity(BENCH_REGION_CAPACITY);
+    scratch = region_with_capacity(BENCH_REGION_CAPACITY);
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0) {
+            if (i + 1 >= argc) {
+                usage(stderr, program);
+                fprintf(stderr, "ERROR: no value provided for -j\n");
+                exit(1);
+            }
+            max_threads = (size_t) sv_to_u64(sv_from_cstr(argv[++i]));
+            if (max_threads == 0) max_threads = 1;
+        } else {
+            const char **new_file_paths = region_realloc(
+                &region, (void*) file_paths,
+                file_paths_count * sizeof(*file_paths),
+                (file_paths_count + 1) * sizeof(*file_paths));
+            if (new_file_paths == NULL) {
+                fprintf(stderr, "ERROR: too many arguments\n");
+                exit(1);
+            }
+            file_paths = new_file_paths;
+            file_paths[file_paths_count++] = argv[i];
+        }
+    }
+
+    // A single directory argument means all of its files
+    const char *dir_path = NULL;
+    if (file_paths_count == 0) {
+        dir_path = DEFAULT_IMAGES_DIR;
+    } else if (file_paths_count == 1) {
+        DIR *dir = opendir(file_paths[0]);
+        if (dir != NULL) {
+            closedir(dir);
+            dir_path = file_paths[0];
+            file_paths_count = 0;
+        }
+    }
+
+    if (dir_path != NULL &&
+            !preload_list_dir(&region, dir_path, &file_paths, &file_paths_count)) {
+        fprintf(stderr, "ERROR: could not list directory %s: %s\n", dir_path, strerror(errno));
+        exit(1);
+    }
+
+    Bench_Input *inputs = region_malloc(&region, (file_paths_count + 1) * sizeof(*inputs));
+    if (inputs == NULL) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    size_t inputs_count = 0;
+
+    if (mkdir(BENCH_RAW_DIR, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "ERROR: could not create directory %s: %s\n", BENCH_RAW_DIR, strerror(errno));
+        exit(1);
+    }
+
+    // Decode every PNG once to produce the KRAW files and the packs
+    Pack_Builder builder = {0};
+    size_t decoded_size = 0;
+    size_t png_size = 0;
+    size_t raw_size = 0;
+    for (size_t i = 0; i < file_paths_count; ++i) {
+        const char *file_path = file_paths[i];
+        if (image_format_by_file_path(file_path) != IMAGE_FORMAT_PNG) continue;
+
+        size_t size = 0;
+        const char *data = region_slurp_file_sized(&region, file_path, &size);
+        if (data == NULL) {
+            fprintf(stderr, "ERROR: could not read file %s: %s\n", file_path, strerror(errno));
+            exit(1);
+        }
+
+        Image image = {0};
+        uint8_t *raw = NULL;
+        size_t raw_file_size = 0;
+        if (!image_decode(&region, IMAGE_FORMAT_PNG, data, size, &image) ||
+                !image_encode(&region, IMAGE_FORMAT_RAW, image, &raw, &raw_file_size)) {
+            fprintf(stderr, "ERROR: could not convert %s: %s\n", file_path, image_failure_reason());
+            exit(1);
+        }
+
+        char *raw_file_path = region_malloc(&region, BENCH_RAW_FILE_PATH_CAPACITY);
+        if (raw_file_path == NULL) {
+            fprintf(stderr, "ERROR: out of memory\n");
+            exit(1);
+        }
+        snprintf(raw_file_path, BENCH_RAW_FILE_PATH_CAPACITY, BENCH_RAW_DIR "/%zu%s",
+                 inputs_count, image_format_extension(IMAGE_FORMAT_RAW));
+        write_file(raw_file_path, raw, raw_file_size);
+
+        if (!pack_builder_add(&builder, file_path, PACK_ENTRY_IMAGE, hash_bytes(data, size), raw, raw_file_size)) {
+            fprintf(stderr, "ERROR: could not add %s: %s\n", file_path, strerror(errno));
+            exit(1);
+        }
+
+        inputs[inputs_count++] = (Bench_Input) {
+            .file_path = file_path,
+            .raw_file_path = raw_file_path,
+        };
+        decoded_size += (size_t) image.width * image.height * IMAGE_COMPS;
+        png_size += size;
+        raw_size += raw_file_size;
+    }
+
+    if (inputs_count == 0) {
+        fprintf(stderr, "ERROR: no PNG images to load\n");
+        exit(1);
+    }
+
+    save_pack(&builder, PACK_CODEC_NONE, BENCH_STORE_PACK_FILE_PATH);
+    save_pack(&builder, PACK_CODEC_LZ4, BENCH_LZ4_PACK_FILE_PATH);
+    pack_builder_free(&builder);
+
+    Bench_Context context = {
+        .inputs = inputs,
+        .inputs_count = inputs_count,
+    };
+
+    printf("%zu images, %zu bytes decoded, up to %zu threads\n", inputs_count, decoded_size, max_threads);
+    printf("%-20s %10s %10s %12s\n", "method", "ms/load", "MB/s", "disk bytes");
+
+    report("png files", bench(load_png_files, &context), decoded_size, png_size);
+    report("kraw files", bench(load_raw_files, &context), decoded_size, raw_size);
+
+    context.pack_file_path = BENCH_STORE_PACK_FILE_PATH;
+    report("pack store", bench(load_pack, &context), decoded_size,
+           file_size_of(BENCH_STORE_PACK_FILE_PATH));
+
+    context.pack_file_path = BENCH_LZ4_PACK_FILE_PATH;
+    context.pool = NULL;
+    const size_t lz4_size = file_size_of(BENCH_LZ4_PACK_FILE_PATH);
+    report("pack lz4", bench(load_pack, &context), decoded_size, lz4_size);
+    for (size_t threads = 1; threads <= max_threads; ++threads) {
+        context.pool = pool_create(threads - 1);
+        if (context.pool == NULL) {
+            fprintf(stderr, "ERROR: could not create %zu threads: %s\n", threads, strerror(errno));
+            exit(1);
+        }
+
+        char name[32];
+        snprintf(name, sizeof(name), "pack lz4 x%zu", threads);
+        report(name, bench(load_pack, &context), decoded_size, lz4_size);
+
+        pool_destroy(context.pool);
+    }
+
+    for (size_t i = 0; i < inputs_count; ++i) {
+        remove(inputs[i].raw_file_path);
+    }
+    rmdir(BENCH_RAW_DIR);
+    remove(BENCH_STORE_PACK_FILE_PATH);
+    remove(BENCH_LZ4_PACK_FILE_PATH);
+
+    return 0;
+}
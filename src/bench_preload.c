@@ -0,0 +1,144 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+
+#include "./preload.h"
+#include "./timer.h"
+
+// Decodes the same set of images with 1..N worker threads and reports the
+// throughput, to size the asset packs.
+//   $ ./bench_preload                 # every file in ./images/
+//   $ ./bench_preload -j 8 images/*.qoi
+
+#define BENCH_MIN_SECS 0.5
+#define BENCH_ARENA_CAPACITY (16 * 1000 * 1000)
+#define DEFAULT_IMAGES_DIR "./images"
+
+Region paths_region;
+
+void usage(FILE *stream, const char *program)
+{
+    fprintf(stream, "Usage: %s [-j <max-threads>] [<images-dir> | <image...>]\n", program);
+}
+
+int main(int argc, char **argv)
+{
+    const char *const program = argv[0];
+    size_t max_threads = pool_hardware_threads();
+
+    const char **file_paths = NULL;
+    size_t file_paths_count = 0;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0) {
+            if (i + 1 >= argc) {
+                usage(stderr, program);
+                fprintf(stderr, "ERROR: no value provided for -j\n");
+                exit(1);
+            }
+            max_threads = (size_t) sv_to_u64(sv_from_cstr(argv[++i]));
+            if (max_threads == 0) max_threads = 1;
+        } else {
+            const char **new_file_paths = region_realloc(
+                &paths_region, (void*) file_paths,
+                file_paths_count * sizeof(*file_paths),
+                (file_paths_count + 1) * sizeof(*file_paths));
+            if (new_file_paths == NULL) {
+                fprintf(stderr, "ERROR: too many arguments\n");
+                exit(1);
+            }
+            file_paths = new_file_paths;
+            file_paths[file_paths_count++] = argv[i];
+        }
+    }
+
+    // A single directory argument means all of its files
+    const char *dir_path = NULL;
+    if (file_paths_count == 0) {
+        dir_path = DEFAULT_IMAGES_DIR;
+    } else if (file_paths_count == 1) {
+        DIR *dir = opendir(file_paths[0]);
+        if (dir != NULL) {
+            closedir(dir);
+            dir_path = file_paths[0];
+            file_paths_count = 0;
+        }
+    }
+
+    if (dir_path != NULL &&
+            !preload_list_dir(&paths_region, dir_path, &file_paths, &file_paths_count)) {
+        fprintf(stderr, "ERROR: could not list directory %s: %s\n", dir_path, strerror(errno));
+        exit(1);
+    }
+
+    if (file_paths_count == 0) {
+        fprintf(stderr, "ERROR: no images to decode\n");
+        exit(1);
+    }
+
+    Preload_Item *items = calloc(file_paths_count, sizeof(*items));
+    if (items == NULL) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+
+    printf("%zu images, up to %zu threads\n", file_paths_count, max_threads);
+    printf("%8s %12s %12s %12s\n", "threads", "images/s", "MB/s", "speedup");
+
+    double single_thread_rate = 0.0;
+    for (size_t threads = 1; threads <= max_threads; ++threads) {
+        Pool *pool = pool_create(threads - 1);
+        if (pool == NULL) {
+            fprintf(stderr, "ERROR: could not create %zu threads: %s\n", threads, strerror(errno));
+            exit(1);
+        }
+
+        Preloader preloader;
+        if (!preloader_init(&preloader, pool, BENCH_ARENA_CAPACITY)) {
+            fprintf(stderr, "ERROR: could not create the preloader: %s\n", strerror(errno));
+            exit(1);
+        }
+
+        size_t images = 0;
+        size_t bytes = 0;
+        double elapsed = 0.0;
+        for (bool warmup = true; ; warmup = false) {
+            for (size_t i = 0; i < file_paths_count; ++i) {
+                items[i] = (Preload_Item) {.file_path = file_paths[i]};
+            }
+
+            const double start = timer_now();
+            preloader_run(&preloader, items, file_paths_count);
+            const double secs = timer_now() - start;
+
+            for (size_t i = 0; i < file_paths_count; ++i) {
+                if (!items[i].ok) {
+                    fprintf(stderr, "ERROR: could not decode %s: %s\n", items[i].file_path, items[i].error);
+                    exit(1);
+                }
+                if (!warmup) {
+                    bytes += (size_t) items[i].image.width * items[i].image.height * IMAGE_COMPS;
+                }
+            }
+
+            if (!warmup) {
+                images += file_paths_count;
+                elapsed += secs;
+                if (elapsed >= BENCH_MIN_SECS) break;
+            }
+        }
+
+        const double rate = (double) images / elapsed;
+        if (threads == 1) single_thread_rate = rate;
+        printf("%8zu %12.1f %12.1f %11.2fx\n",
+               threads, rate, (double) bytes / elapsed / 1e6, rate / single_thread_rate);
+
+        preloader_free(&preloader);
+        pool_destroy(pool);
+    }
+
+    free(items);
+    return 0;
+}
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "./sv.h"
+#include "./voxel.h"
+#include "./timer.h"
+
+// Meshes worlds of different density with the naive and the greedy mesher
+// on 1..N threads and reports triangles and milliseconds per chunk.
+//   $ ./bench_voxel -j 8
+
+#define BENCH_MIN_SECS 0.5
+#define BENCH_WORLD_CHUNKS 4
+#define BENCH_SPARSE_FILL 0.1f
+
+typedef void (*Scene_Fill)(Voxel_World *world);
+
+typedef struct {
+    const char *name;
+    Scene_Fill fill;
+} Scene;
+
+static uint32_t rand_state = 0x12345678;
+
+// xorshift32, so every run meshes the same voxels
+uint32_t rand_next(void)
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+long world_voxels(size_t chunks)
+{
+    return (long) (chunks * VOXEL_CHUNK_SIZE);
+}
+
+void fill_dense(Voxel_World *world)
+{
+    for (long z = 0; z < world_voxels(world->depth); ++z) {
+        for (long y = 0; y < world_voxels(world->height); ++y) {
+            for (long x = 0; x < world_voxels(world->width); ++x) {
+                voxel_world_set(world, x, y, z, 1);
+            }
+        }
+    }
+}
+
+void fill_sparse(Voxel_World *world)
+{
+    for (long z = 0; z < world_voxels(world->depth); ++z) {
+        for (long y = 0; y < world_voxels(world->height); ++y) {
+            for (long x = 0; x < world_voxels(world->width); ++x) {
+                const float r = (float) rand_next() / (float) UINT32_MAX;
+                if (r < BENCH_SPARSE_FILL) {
+                    voxel_world_set(world, x, y, z, (Voxel) (1 + rand_next() % 4));
+                }
+            }
+        }
+    }
+}
+
+// Rolling hills with a few materials in layers, the typical case
+void fill_terrain(Voxel_World *world)
+{
+    const long height = world_voxels(world->height);
+    for (long z = 0; z < world_voxels(world->depth); ++z) {
+        for (long x = 0; x < world_voxels(world->width); ++x) {
+            const float h = 0.5f + 0.25f * sinf((float) x * 0.07f) * cosf((float) z * 0.05f);
+            const long top = (long) (h * (float) height);
+            for (long y = 0; y < top; ++y) {
+                const Voxel material = y + 1 == top ? 1 : y + 4 >= top ? 2 : 3;
+                voxel_world_set(world, x, y, z, material);
+            }
+        }
+    }
+}
+
+size_t world_tris(const Voxel_World *world)
+{
+    size_t vertices = 0;
+    for (size_t i = 0; i < voxel_world_chunks_count(world); ++i) {
+        vertices += world->chunks[i].mesh.vertices_count;
+    }
+    return vertices / TRI_VERTICES;
+}
+
+// Average seconds per chunk when the whole world is remeshed at once
+double bench(Voxel_World *world, Pool *pool)
+{
+    size_t chunks = 0;
+    double elapsed = 0.0;
+    for (bool warmup = true; ; warmup = false) {
+        voxel_world_mark_all_dirty(world);
+
+        const double start = timer_now();
+        const size_t remeshed = voxel_world_remesh(world, pool);
+        const double secs = timer_now() - start;
+
+        if (remeshed != voxel_world_chunks_count(world)) {
+            fprintf(stderr, "ERROR: could not remesh the world: out of memory\n");
+            exit(1);
+        }
+
+        if (!warmup) {
+            chunks += remeshed;
+            elapsed += secs;
+            if (elapsed >= BENCH_MIN_SECS) break;
+        }
+    }
+    return elapsed / (double) chunks;
+}
+
+void usage(FILE *stream, const char *program)
+{
+    fprintf(stream, "Usage: %s [-j <max-threads>]\n", program);
+}
+
+int main(int argc, char **argv)
+{
+    const char *const program = argv[0];
+    size_t max_threads = pool_hardware_threads();
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            max_threads = (size_t) sv_to_u64(sv_from_cstr(argv[++i]));
+            if (max_threads == 0) max_threads = 1;
+        } else {
+            usage(stderr, program);
+            fprintf(stderr, "ERROR: unexpected argument `%s`\n", argv[i]);
+            exit(1);
+        }
+    }
+
+    static const Scene scenes[] = {
+        {"dense", fill_dense},
+        {"sparse", fill_sparse},
+        {"terrain", fill_terrain},
+    };
+    const size_t scenes_count = sizeof(scenes) / sizeof(scenes[0]);
+
+    Pool **pools = calloc(max_threads + 1, sizeof(*pools));
+    if (pools == NULL) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    for (size_t threads = 1; threads <= max_threads; ++threads) {
+        pools[threads] = pool_create(threads - 1);
+        if (pools[threads] == NULL) {
+            fprintf(stderr, "ERROR: could not create %zu threads: %s\n", threads, strerror(errno));
+            exit(1);
+        }
+    }
+
+    printf("%d^3 chunks, %dx%dx%d world, up to %zu threads\n",
+           VOXEL_CHUNK_SIZE, BENCH_WORLD_CHUNKS, BENCH_WORLD_CHUNKS, BENCH_WORLD_CHUNKS, max_threads);
+    printf("%-8s %-7s %8s %12s %10s\n", "scene", "mesher", "threads", "tris/chunk", "ms/chunk");
+
+    for (size_t i = 0; i < scenes_count; ++i) {
+        Voxel_World world;
+        if (!voxel_world_init(&world, BENCH_WORLD_CHUNKS, BENCH_WORLD_CHUNKS, BENCH_WORLD_CHUNKS)) {
+            fprintf(stderr, "ERROR: could not create the world: %s\n", strerror(errno));
+            exit(1);
+        }
+        scenes[i].fill(&world);
+
+        for (int greedy = 0; greedy <= 1; ++greedy) {
+            world.greedy = greedy;
+            for (size_t threads = 1; threads <= max_threads; ++threads) {
+                const double secs = bench(&world, pools[threads]);
+                printf("%-8s %-7s %8zu %12.1f %10.3f\n",
+                       scenes[i].name, greedy ? "greedy" : "naive", threads,
+                       (double) world_tris(&world) / (double) voxel_world_chunks_count(&world),
+                       secs * 1000.0);
+            }
+        }
+
+        // A single edit on the corner of a chunk dirties it and its three
+        // neighbors sharing the faces of the voxel
+        const long corner = VOXEL_CHUNK_SIZE;
+        const Voxel old = voxel_world_get(&world, corner, corner, corner);
+        voxel_world_set(&world, corner, corner, corner, old == VOXEL_EMPTY ? 1 : VOXEL_EMPTY);
+        const double start = timer_now();
+        const size_t remeshed = voxel_world_remesh(&world, pools[max_threads]);
+        printf("%-8s edit: %zu chunks remeshed in %.3f ms\n",
+               scenes[i].name, remeshed, (timer_now() - start) * 1000.0);
+
+        voxel_world_free(&world);
+    }
+
+    for (size_t threads = 1; threads <= max_threads; ++threads) {
+        pool_destroy(pools[threads]);
+    }
+    free(pools);
+
+    return 0;
+}
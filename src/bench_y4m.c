@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "./sv.h"
+#include "./timer.h"
+#include "./y4m.h"
+
+// Converts a 1080p RGBA frame to YUV420 one pixel at a time, with the SIMD
+// kernel on one thread and on all of them, checks that they agree and
+// reports how many frames per second each manages against the 60 of a
+// real time recording.
+//   $ ./bench_y4m -j 8
+
+#define BENCH_MIN_SECS 0.5
+#define BENCH_WIDTH 1920
+#define BENCH_HEIGHT 1080
+#define BENCH_FPS 60
+#define BENCH_COMPS 4
+
+static uint32_t rand_state = 0x12345678;
+
+// xorshift32, so every run converts the same frame
+uint32_t rand_next(void)
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+    return rand_state;
+}
+
+typedef struct {
+    const uint8_t *rgba;
+    uint8_t *planes;
+    Pool *pool;
+    bool scalar;
+} Bench;
+
+void convert(Bench *bench)
+{
+    // Bottom up, like the frames read back by the capture
+    const ptrdiff_t stride = (ptrdiff_t) BENCH_WIDTH * BENCH_COMPS;
+    const uint8_t *last_row = bench->rgba + (BENCH_HEIGHT - 1) * stride;
+    if (bench->scalar) {
+        yuv420_from_rgba_scalar(last_row, -stride, BENCH_WIDTH, BENCH_HEIGHT, bench->planes);
+    } else {
+        yuv420_from_rgba(bench->pool, last_row, -stride, BENCH_WIDTH, BENCH_HEIGHT, bench->planes);
+    }
+}
+
+// Returns the average seconds per frame over at least BENCH_MIN_SECS
+double measure(Bench *bench)
+{
+    size_t frames = 0;
+    double elapsed = 0.0;
+    const double start = timer_now();
+    do {
+        convert(bench);
+        frames += 1;
+        elapsed = timer_now() - start;
+    } while (elapsed < BENCH_MIN_SECS);
+    return elapsed / (double) frames;
+}
+
+void report(const char *name, double secs)
+{
+    printf("  %-22s %8.3f ms/frame, %7.1f fps, %5.1fx real time\n",
+           name, secs * 1000.0, 1.0 / secs, 1.0 / secs / BENCH_FPS);
+}
+
+void usage(FILE *stream, const char *program)
+{
+    fprintf(stream, "Usage: %s [-j <max-threads>]\n", program);
+}
+
+int main(int argc, char **argv)
+{
+    const char *const program = argv[0];
+    size_t threads = pool_hardware_threads();
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-j") == 0) {
+            if (i + 1 >= argc) {
+                usage(stderr, program);
+                fprintf(stderr, "ERROR: no value provided for -j\n");
+                exit(1);
+            }
+            threads = (size_t) sv_to_u64(sv_from_cstr(argv[++i]));
+        } else {
+            usage(stderr, program);
+            fprintf(stderr, "ERROR: unexpected argument `%s`\n", argv[i]);
+            exit(1);
+        }
+    }
+    if (threads == 0) threads = 1;
+
+    // Smooth gradients with noise on top, the kernel does not care but the
+    // chroma averaging gets something to average
+    const size_t pixels_size = (size_t) BENCH_WIDTH * BENCH_HEIGHT * BENCH_COMPS;
+    const size_t planes_size = yuv420_size(BENCH_WIDTH, BENCH_HEIGHT);
+    uint8_t *rgba = malloc(pixels_size);
+    uint8_t *expected = malloc(planes_size);
+    uint8_t *planes = malloc(planes_size);
+    if (rgba == NULL || expected == NULL || planes == NULL) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    for (size_t y = 0; y < BENCH_HEIGHT; ++y) {
+        for (size_t x = 0; x < BENCH_WIDTH; ++x) {
+            uint8_t *p = rgba + (y * BENCH_WIDTH + x) * BENCH_COMPS;
+            const uint32_t noise = rand_next();
+            p[0] = (uint8_t) (x * 255 / BENCH_WIDTH + (noise & 0x1F));
+            p[1] = (uint8_t) (y * 255 / BENCH_HEIGHT + ((noise >> 8) & 0x1F));
+            p[2] = (uint8_t) ((x + y) * 255 / (BENCH_WIDTH + BENCH_HEIGHT) + ((noise >> 16) & 0x1F));
+            p[3] = 255;
+        }
+    }
+
+    Pool *pool = pool_create(threads - 1);
+    if (pool == NULL) {
+        fprintf(stderr, "ERROR: could not start %zu threads: %s\n", threads, strerror(errno));
+        exit(1);
+    }
+
+    printf("%dx%d RGBA to YUV420 (%.1f MB in, %.1f MB out), %zu threads\n",
+           BENCH_WIDTH, BENCH_HEIGHT,
+           (double) pixels_size / (1024.0 * 1024.0), (double) planes_size / (1024.0 * 1024.0), threads);
+
+    Bench bench = {.rgba = rgba, .planes = expected, .scalar = true};
+    const double scalar_secs = measure(&bench);
+    report("scalar", scalar_secs);
+
+    bench = (Bench) {.rgba = rgba, .planes = planes};
+    const double simd_secs = measure(&bench);
+    if (memcmp(planes, expected, planes_size) != 0) {
+        fprintf(stderr, "ERROR: the SIMD kernel does not match the scalar one\n");
+        exit(1);
+    }
+    report("simd", simd_secs);
+
+    memset(planes, 0, planes_size);
+    bench.pool = pool;
+    const double pool_secs = measure(&bench);
+    if (memcmp(planes, expected, planes_size) != 0) {
+        fprintf(stderr, "ERROR: the threads do not match the scalar kernel\n");
+        exit(1);
+    }
+    report("simd on the threads", pool_secs);
+
+    pool_destroy(pool);
+    free(rgba);
+    free(expected);
+    free(planes);
+    return 0;
+}
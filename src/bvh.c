@@ -0,0 +1,685 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "./bvh.h"
+
+// Past this depth the splits fall back to halving the objects, which can
+// not go more than 32 levels deeper with 32 bit indices
+#define BVH_SAH_DEPTH (BVH_MAX_DEPTH - 32)
+
+#define BVH_ALL_PLANES ((1u << FRUSTUM_PLANES) - 1)
+
+static Aabb aabb_empty(void)
+{
+    return (Aabb) {
+        .min = {INFINITY, INFINITY, INFINITY},
+        .max = {-INFINITY, -INFINITY, -INFINITY},
+    };
+}
+
+// Plain comparisons rather than fminf() and fmaxf(), which are library
+// calls unless NaNs are ruled out
+static float min_float(float a, float b) { return a < b ? a : b; }
+static float max_float(float a, float b) { return a > b ? a : b; }
+
+static void aabb_grow(Aabb *aabb, const float min[V3_COMPS], const float max[V3_COMPS])
+{
+    for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+        aabb->min[axis] = min_float(aabb->min[axis], min[axis]);
+        aabb->max[axis] = max_float(aabb->max[axis], max[axis]);
+    }
+}
+
+// Half of the surface area, the factor does not matter for comparing costs
+static float aabb_area(const Aabb *aabb)
+{
+    const float dx = aabb->max[X] - aabb->min[X];
+    const float dy = aabb->max[Y] - aabb->min[Y];
+    const float dz = aabb->max[Z] - aabb->min[Z];
+    return dx * dy + dy * dz + dz * dx;
+}
+
+// Twice the center, the scale does not matter for binning either
+static float aabb_centroid(const Aabb *aabb, size_t axis)
+{
+    return aabb->min[axis] + aabb->max[axis];
+}
+
+size_t bvh_memory_size(size_t objects_count)
+{
+    // A binary tree with N leaves has 2N - 1 nodes, plus one byte because
+    // a Region can never be filled to the brim
+    return 2 * objects_count * sizeof(Bvh_Node) + objects_count * sizeof(uint32_t) + 1;
+}
+
+// The tree is first built into a sparse array where the subtree of a node
+// with N objects owns 2N - 1 slots: the node, the pair of its children,
+// then the descendants of the left child followed by the ones of the right
+// child. Every subtree knows where to put its nodes without any
+// synchronization, and the slots left over by leaves with more than one
+// object are squeezed out by compact() afterwards.
+typedef struct Bvh_Build_Queue Bvh_Build_Queue;
+
+typedef struct {
+    // Copies of the boxes kept in the order of `indices`, so every pass
+    // over the objects of a node reads memory front to back
+    Aabb *boxes;
+    uint32_t *indices;
+    Bvh_Node *sparse;
+    Pool *pool;
+    // NULL when the build runs on the calling thread alone
+    Bvh_Build_Queue *queue;
+} Bvh_Build;
+
+// Bounds of a group of boxes and of their centroids
+typedef struct {
+    Aabb boxes;
+    Aabb centroids;
+} Bvh_Bounds;
+
+typedef struct Bvh_Build_Task {
+    Bvh_Build *build;
+    size_t node;
+    size_t first;
+    size_t count;
+    Bvh_Bounds bounds;
+    size_t children;
+    size_t depth;
+    struct Bvh_Build_Task *next;
+} Bvh_Build_Task;
+
+// Subtrees handed out to the pool. Every one gets a job, but whoever is
+// free first builds it, the caller of bvh_build() included, so the build
+// never waits for other work queued on the pool. The queue is freed by
+// whoever lets go of it last, because a job can start long after its
+// subtree was taken and the build is over.
+struct Bvh_Build_Queue {
+    pthread_mutex_t mutex;
+    // Signaled when a subtree is queued or the last one running is done
+    pthread_cond_t changed;
+    // Guarded by `mutex`
+    Bvh_Build_Task *pending;
+    size_t running;
+    // The caller and every job that has not returned yet
+    size_t refs;
+};
+
+typedef struct {
+    Aabb bounds;
+    size_t count;
+} Bvh_Bin;
+
+static Bvh_Bounds bounds_empty(void)
+{
+    return (Bvh_Bounds) {
+        .boxes = aabb_empty(),
+        .centroids = aabb_empty(),
+    };
+}
+
+static void bounds_add(Bvh_Bounds *bounds, const Aabb *box)
+{
+    float c[V3_COMPS];
+    for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+        c[axis] = aabb_centroid(box, axis);
+    }
+    aabb_grow(&bounds->boxes, box->min, box->max);
+    aabb_grow(&bounds->centroids, c, c);
+}
+
+static Bvh_Bounds range_bounds(const Bvh_Build *build, size_t first, size_t count)
+{
+    Bvh_Bounds bounds = bounds_empty();
+    for (size_t i = first; i < first + count; ++i) {
+        bounds_add(&bounds, &build->boxes[i]);
+    }
+    return bounds;
+}
+
+static size_t bin_of(float centroid, float min, float scale)
+{
+    const size_t bin = (size_t) ((centroid - min) * scale);
+    return bin < BVH_BINS ? bin : BVH_BINS - 1;
+}
+
+static void build_node(Bvh_Build *build, size_t node, size_t first, size_t count,
+                       const Bvh_Bounds *bounds, size_t children, size_t depth);
+
+static void queue_release(Bvh_Build_Queue *queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    const bool last = queue->refs == 1;
+    queue->refs -= 1;
+    pthread_mutex_unlock(&queue->mutex);
+
+    if (last) {
+        pthread_cond_destroy(&queue->changed);
+        pthread_mutex_destroy(&queue->mutex);
+        free(queue);
+    }
+}
+
+// Builds the subtree queued last. Expects the mutex locked and returns with
+// it locked again.
+static void queue_run_pending(Bvh_Build_Queue *queue)
+{
+    Bvh_Build_Task *task = queue->pending;
+    queue->pending = task->next;
+    queue->running += 1;
+    pthread_mutex_unlock(&queue->mutex);
+
+    build_node(task->build, task->node, task->first, task->count, &task->bounds,
+               task->children, task->depth);
+    free(task);
+
+    pthread_mutex_lock(&queue->mutex);
+    queue->running -= 1;
+    if (queue->running == 0) pthread_cond_broadcast(&queue->changed);
+}
+
+static void build_node_task(void *arg, size_t worker)
+{
+    (void) worker;
+    Bvh_Build_Queue *queue = arg;
+    pthread_mutex_lock(&queue->mutex);
+    if (queue->pending != NULL) queue_run_pending(queue);
+    pthread_mutex_unlock(&queue->mutex);
+    queue_release(queue);
+}
+
+// Helps with the queued subtrees until every one of them is built
+static void queue_finish(Bvh_Build_Queue *queue)
+{
+    pthread_mutex_lock(&queue->mutex);
+    for (;;) {
+        if (queue->pending != NULL) {
+            queue_run_pending(queue);
+        } else if (queue->running > 0) {
+            pthread_cond_wait(&queue->changed, &queue->mutex);
+        } else {
+            break;
+        }
+    }
+    pthread_mutex_unlock(&queue->mutex);
+}
+
+// Picks the cheapest split of the objects among the borders of the bins
+// on every axis and moves the objects of the left side to the front.
+// Returns the amount of objects on the left side.
+static size_t split_objects(Bvh_Build *build, size_t first, size_t count,
+                            const Bvh_Bounds *bounds, size_t depth,
+                            Bvh_Bounds *left_bounds, Bvh_Bounds *right_bounds)
+{
+    Aabb *boxes = build->boxes + first;
+    uint32_t *indices = build->indices + first;
+
+    float best_cost = INFINITY;
+    size_t best_axis = V3_COMPS;
+    size_t best_bin = 0;
+    Bvh_Bin bins[V3_COMPS][BVH_BINS];
+    float scales[V3_COMPS] = {0};
+
+    if (depth < BVH_SAH_DEPTH) {
+        for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+            const float extent = bounds->centroids.max[axis] - bounds->centroids.min[axis];
+            if (extent > 0.0f) scales[axis] = (float) BVH_BINS / extent;
+            for (size_t b = 0; b < BVH_BINS; ++b) {
+                bins[axis][b].bounds = aabb_empty();
+                bins[axis][b].count = 0;
+            }
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+                if (scales[axis] == 0.0f) continue;
+                Bvh_Bin *bin = &bins[axis][bin_of(aabb_centroid(&boxes[i], axis),
+                                                  bounds->centroids.min[axis], scales[axis])];
+                aabb_grow(&bin->bounds, boxes[i].min, boxes[i].max);
+                bin->count += 1;
+            }
+        }
+
+        // Cost of a split is the amount of objects on each side weighted
+        // by the area of the side, the chance of a ray or a frustum to hit
+        // it. The right sides are swept first, then every split after bin
+        // `b` is priced while sweeping the left sides.
+        for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+            if (scales[axis] == 0.0f) continue;
+
+            float right_areas[BVH_BINS];
+            size_t right_counts[BVH_BINS];
+            Aabb right = aabb_empty();
+            size_t right_count = 0;
+            for (size_t b = BVH_BINS - 1; b > 0; --b) {
+                aabb_grow(&right, bins[axis][b].bounds.min, bins[axis][b].bounds.max);
+                right_count += bins[axis][b].count;
+                right_areas[b] = right_count > 0 ? aabb_area(&right) : 0.0f;
+                right_counts[b] = right_count;
+            }
+
+            Aabb left = aabb_empty();
+            size_t left_count = 0;
+            for (size_t b = 0; b + 1 < BVH_BINS; ++b) {
+                aabb_grow(&left, bins[axis][b].bounds.min, bins[axis][b].bounds.max);
+                left_count += bins[axis][b].count;
+                if (left_count == 0 || right_counts[b + 1] == 0) continue;
+
+                const float cost = (float) left_count * aabb_area(&left) +
+                                   (float) right_counts[b + 1] * right_areas[b + 1];
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin = b;
+                }
+            }
+        }
+    }
+
+    // Too deep, or every centroid is in the same spot
+    if (best_axis == V3_COMPS) {
+        *left_bounds = range_bounds(build, first, count / 2);
+        *right_bounds = range_bounds(build, first + count / 2, count - count / 2);
+        return count / 2;
+    }
+
+    // The bounds of the boxes on each side are the ones of their bins, the
+    // bounds of the centroids are gathered while moving them
+    *left_bounds = bounds_empty();
+    *right_bounds = bounds_empty();
+    for (size_t b = 0; b < BVH_BINS; ++b) {
+        Bvh_Bounds *side = b <= best_bin ? left_bounds : right_bounds;
+        aabb_grow(&side->boxes, bins[best_axis][b].bounds.min, bins[best_axis][b].bounds.max);
+    }
+
+    size_t left = 0;
+    size_t right = count;
+    while (left < right) {
+        float c[V3_COMPS];
+        for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+            c[axis] = aabb_centroid(&boxes[left], axis);
+        }
+
+        if (bin_of(c[best_axis], bounds->centroids.min[best_axis], scales[best_axis]) <= best_bin) {
+            aabb_grow(&left_bounds->centroids, c, c);
+            left += 1;
+        } else {
+            aabb_grow(&right_bounds->centroids, c, c);
+            right -= 1;
+            const Aabb box = boxes[left];
+            boxes[left] = boxes[right];
+            boxes[right] = box;
+            const uint32_t index = indices[left];
+            indices[left] = indices[right];
+            indices[right] = index;
+        }
+    }
+
+    return left;
+}
+
+static void build_node(Bvh_Build *build, size_t node, size_t first, size_t count,
+                       const Bvh_Bounds *bounds, size_t children, size_t depth)
+{
+    Bvh_Node *n = &build->sparse[node];
+    memcpy(n->min, bounds->boxes.min, sizeof(n->min));
+    memcpy(n->max, bounds->boxes.max, sizeof(n->max));
+
+    if (count <= BVH_LEAF_SIZE) {
+        n->first = (uint32_t) first;
+        n->count = (uint32_t) count;
+        return;
+    }
+
+    Bvh_Bounds left_bounds, right_bounds;
+    const size_t left_count = split_objects(build, first, count, bounds, depth,
+                                            &left_bounds, &right_bounds);
+    n->first = (uint32_t) children;
+    n->count = 0;
+
+    const size_t left_children = children + 2;
+    const size_t right_children = children + 2 * left_count;
+
+    Bvh_Build_Queue *queue = build->queue;
+    if (queue != NULL && count - left_count >= BVH_PARALLEL_COUNT) {
+        Bvh_Build_Task *task = malloc(sizeof(*task));
+        if (task != NULL) {
+            *task = (Bvh_Build_Task) {
+                .build = build,
+                .node = children + 1,
+                .first = first + left_count,
+                .count = count - left_count,
+                .bounds = right_bounds,
+                .children = right_children,
+                .depth = depth + 1,
+            };
+            pthread_mutex_lock(&queue->mutex);
+            task->next = queue->pending;
+            queue->pending = task;
+            queue->refs += 1;
+            pthread_cond_broadcast(&queue->changed);
+            pthread_mutex_unlock(&queue->mutex);
+
+            // Stays queued for the caller when no job could be submitted
+            if (!pool_submit(build->pool, build_node_task, queue)) queue_release(queue);
+            build_node(build, children, first, left_count, &left_bounds, left_children, depth + 1);
+            return;
+        }
+    }
+
+    build_node(build, children, first, left_count, &left_bounds, left_children, depth + 1);
+    build_node(build, children + 1, first + left_count, count - left_count, &right_bounds,
+               right_children, depth + 1);
+}
+
+// Copies the used nodes of `sparse` into `nodes` in depth first order with
+// the children of every node next to each other. Returns the amount of
+// nodes.
+static size_t compact(const Bvh_Node *sparse, Bvh_Node *nodes)
+{
+    size_t stack[BVH_MAX_DEPTH + 1];
+    size_t stack_count = 0;
+
+    nodes[0] = sparse[0];
+    size_t nodes_count = 1;
+    stack[stack_count++] = 0;
+
+    while (stack_count > 0) {
+        const size_t node = stack[--stack_count];
+        if (nodes[node].count > 0) continue;
+
+        const size_t children = nodes[node].first;
+        nodes[nodes_count] = sparse[children];
+        nodes[nodes_count + 1] = sparse[children + 1];
+        nodes[node].first = (uint32_t) nodes_count;
+
+        stack[stack_count++] = nodes_count + 1;
+        stack[stack_count++] = nodes_count;
+        nodes_count += 2;
+    }
+
+    return nodes_count;
+}
+
+bool bvh_build(Region *region, Pool *pool, const Aabb *aabbs, size_t count, Bvh *bvh)
+{
+    memset(bvh, 0, sizeof(*bvh));
+    bvh->aabbs = aabbs;
+    if (count == 0) return true;
+
+    if (count > UINT32_MAX / 2) {
+        errno = EOVERFLOW;
+        return false;
+    }
+
+    Bvh_Node *nodes = region_malloc(region, (2 * count - 1) * sizeof(*nodes));
+    uint32_t *indices = region_malloc(region, count * sizeof(*indices));
+    Bvh_Node *sparse = malloc((2 * count - 1) * sizeof(*sparse));
+    Aabb *boxes = malloc(count * sizeof(*boxes));
+    if (nodes == NULL || indices == NULL || sparse == NULL || boxes == NULL) {
+        free(sparse);
+        free(boxes);
+        errno = ENOMEM;
+        return false;
+    }
+
+    memcpy(boxes, aabbs, count * sizeof(*boxes));
+    for (size_t i = 0; i < count; ++i) {
+        indices[i] = (uint32_t) i;
+    }
+
+    Bvh_Build build = {
+        .boxes = boxes,
+        .indices = indices,
+        .sparse = sparse,
+        .pool = pool,
+    };
+    if (pool != NULL && count >= BVH_PARALLEL_COUNT) {
+        build.queue = malloc(sizeof(*build.queue));
+        if (build.queue != NULL) {
+            *build.queue = (Bvh_Build_Queue) {.refs = 1};
+            pthread_mutex_init(&build.queue->mutex, NULL);
+            pthread_cond_init(&build.queue->changed, NULL);
+        }
+    }
+
+    const Bvh_Bounds bounds = range_bounds(&build, 0, count);
+    build_node(&build, 0, 0, count, &bounds, 1, 0);
+    if (build.queue != NULL) {
+        queue_finish(build.queue);
+        queue_release(build.queue);
+    }
+
+    bvh->nodes = nodes;
+    bvh->nodes_count = compact(sparse, nodes);
+    bvh->indices = indices;
+    bvh->objects_count = count;
+
+    free(sparse);
+    free(boxes);
+    return true;
+}
+
+typedef enum {
+    BVH_OUTSIDE,
+    BVH_INTERSECTS,
+    BVH_INSIDE,
+} Bvh_Overlap;
+
+// Tests the box against the planes in `*planes` and drops the ones it is
+// completely inside of, so they are not tested again for its children
+static Bvh_Overlap overlap(const Frustum *frustum, const float min[V3_COMPS],
+                           const float max[V3_COMPS], unsigned *planes)
+{
+    for (size_t p = 0; p < FRUSTUM_PLANES; ++p) {
+        if (!(*planes & (1u << p))) continue;
+
+        const float *cs = frustum->planes[p].cs;
+        // Corners of the box furthest along the normal and against it
+        float far = cs[W];
+        float near = cs[W];
+        for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+            if (cs[axis] >= 0.0f) {
+                far += cs[axis] * max[axis];
+                near += cs[axis] * min[axis];
+            } else {
+                far += cs[axis] * min[axis];
+                near += cs[axis] * max[axis];
+            }
+        }
+
+        if (far < 0.0f) return BVH_OUTSIDE;
+        if (near >= 0.0f) *planes &= ~(1u << p);
+    }
+    return *planes == 0 ? BVH_INSIDE : BVH_INTERSECTS;
+}
+
+// The objects of a subtree span from its leftmost to its rightmost leaf
+static void subtree_objects(const Bvh *bvh, const Bvh_Node *node, size_t *first, size_t *end)
+{
+    const Bvh_Node *leftmost = node;
+    while (leftmost->count == 0) leftmost = &bvh->nodes[leftmost->first];
+    const Bvh_Node *rightmost = node;
+    while (rightmost->count == 0) rightmost = &bvh->nodes[rightmost->first + 1];
+
+    *first = leftmost->first;
+    *end = rightmost->first + rightmost->count;
+}
+
+size_t bvh_cull(const Bvh *bvh, const Frustum *frustum, uint32_t *visible)
+{
+    size_t rejected = 0;
+    return bvh_cull_filtered(bvh, frustum, NULL, NULL, visible, &rejected);
+}
+
+size_t bvh_cull_filtered(const Bvh *bvh, const Frustum *frustum,
+                         Bvh_Filter filter, void *arg,
+                         uint32_t *visible, size_t *rejected)
+{
+    *rejected = 0;
+    if (bvh->nodes_count == 0) return 0;
+
+    struct {
+        uint32_t node;
+        unsigned planes;
+    } stack[BVH_MAX_DEPTH + 1];
+    size_t stack_count = 0;
+    size_t visible_count = 0;
+
+    stack[stack_count].node = 0;
+    stack[stack_count].planes = BVH_ALL_PLANES;
+    stack_count += 1;
+
+    while (stack_count > 0) {
+        stack_count -= 1;
+        const Bvh_Node *node = &bvh->nodes[stack[stack_count].node];
+        unsigned planes = stack[stack_count].planes;
+
+        const Bvh_Overlap o = overlap(frustum, node->min, node->max, &planes);
+        if (o == BVH_OUTSIDE) continue;
+
+        if (filter != NULL && !filter(arg, node->min, node->max)) {
+            size_t first, end;
+            subtree_objects(bvh, node, &first, &end);
+            *rejected += end - first;
+            continue;
+        }
+
+        if (o == BVH_INSIDE && filter == NULL) {
+            size_t first, end;
+            subtree_objects(bvh, node, &first, &end);
+            for (size_t i = first; i < end; ++i) {
+                visible[visible_count++] = bvh->indices[i];
+            }
+        } else if (node->count > 0) {
+            for (size_t i = node->first; i < node->first + node->count; ++i) {
+                const uint32_t index = bvh->indices[i];
+                const Aabb *aabb = &bvh->aabbs[index];
+                unsigned object_planes = planes;
+                if (overlap(frustum, aabb->min, aabb->max, &object_planes) == BVH_OUTSIDE) continue;
+
+                // A leaf with a single object was just filtered as a node
+                if (filter != NULL && node->count > 1 && !filter(arg, aabb->min, aabb->max)) {
+                    *rejected += 1;
+                    continue;
+                }
+                visible[visible_count++] = index;
+            }
+        } else {
+            for (uint32_t child = 0; child < PAIR_COMPS; ++child) {
+                stack[stack_count].node = node->first + child;
+                stack[stack_count].planes = planes;
+                stack_count += 1;
+            }
+        }
+    }
+
+    return visible_count;
+}
+
+// Slab test, returns the distance at which the ray enters the box or
+// INFINITY when it misses it or enters it further than `limit`
+static float ray_enter(const float origin[V3_COMPS], const float inv_direction[V3_COMPS],
+                       const float min[V3_COMPS], const float max[V3_COMPS], float limit)
+{
+    float enter = 0.0f;
+    float leave = limit;
+    for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+        const float t1 = (min[axis] - origin[axis]) * inv_direction[axis];
+        const float t2 = (max[axis] - origin[axis]) * inv_direction[axis];
+        // A NaN from a ray parallel to the slab and starting on it loses
+        // both comparisons and leaves the interval as it is
+        enter = max_float(min_float(t1, t2), enter);
+        leave = min_float(max_float(t1, t2), leave);
+    }
+    return enter <= leave ? enter : INFINITY;
+}
+
+bool bvh_raycast(const Bvh *bvh, const float origin[V3_COMPS], const float direction[V3_COMPS],
+                 uint32_t *hit, float *t)
+{
+    if (bvh->nodes_count == 0) return false;
+
+    float inv_direction[V3_COMPS];
+    for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+        inv_direction[axis] = 1.0f / direction[axis];
+    }
+
+    struct {
+        uint32_t node;
+        float enter;
+    } stack[BVH_MAX_DEPTH + 1];
+    size_t stack_count = 0;
+    float nearest = INFINITY;
+
+    const Bvh_Node *root = &bvh->nodes[0];
+    const float root_enter = ray_enter(origin, inv_direction, root->min, root->max, nearest);
+    if (root_enter == INFINITY) return false;
+    stack[stack_count].node = 0;
+    stack[stack_count].enter = root_enter;
+    stack_count += 1;
+
+    while (stack_count > 0) {
+        stack_count -= 1;
+        if (stack[stack_count].enter >= nearest) continue;
+        const Bvh_Node *node = &bvh->nodes[stack[stack_count].node];
+
+        if (node->count > 0) {
+            for (size_t i = node->first; i < node->first + node->count; ++i) {
+                const uint32_t index = bvh->indices[i];
+                const float enter = ray_enter(origin, inv_direction,
+                                              bvh->aabbs[index].min, bvh->aabbs[index].max, nearest);
+                if (enter < nearest) {
+                    nearest = enter;
+                    *hit = index;
+                }
+            }
+            continue;
+        }
+
+        // The nearer child goes on top, so it is searched first and
+        // shortens the ray for the other one
+        const Bvh_Node *left = &bvh->nodes[node->first];
+        const Bvh_Node *right = &bvh->nodes[node->first + 1];
+        float enters[PAIR_COMPS] = {
+            ray_enter(origin, inv_direction, left->min, left->max, nearest),
+            ray_enter(origin, inv_direction, right->min, right->max, nearest),
+        };
+        const uint32_t near = enters[1] < enters[0];
+        for (uint32_t i = 0; i < PAIR_COMPS; ++i) {
+            const uint32_t child = i == 0 ? 1 - near : near;
+            if (enters[child] == INFINITY) continue;
+            stack[stack_count].node = node->first + child;
+            stack[stack_count].enter = enters[child];
+            stack_count += 1;
+        }
+    }
+
+    if (nearest == INFINITY) return false;
+    *t = nearest;
+    return true;
+}
+
+bool bvh_raycast_brute(const Bvh *bvh, const float origin[V3_COMPS], const float direction[V3_COMPS],
+                       uint32_t *hit, float *t)
+{
+    float inv_direction[V3_COMPS];
+    for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+        inv_direction[axis] = 1.0f / direction[axis];
+    }
+
+    float nearest = INFINITY;
+    for (size_t i = 0; i < bvh->objects_count; ++i) {
+        const float enter = ray_enter(origin, inv_direction, bvh->aabbs[i].min, bvh->aabbs[i].max, nearest);
+        if (enter < nearest) {
+            nearest = enter;
+            *hit = (uint32_t) i;
+        }
+    }
+
+    if (nearest == INFINITY) return false;
+    *t = nearest;
+    return true;
+}
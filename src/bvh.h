@@ -0,0 +1,76 @@
+#ifndef BVH_H_
+#define BVH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "./geo.h"
+#include "./region.h"
+#include "./pool.h"
+
+// Bounding volume hierarchy over axis aligned boxes, built with binned SAH
+// and stored as a flat array of nodes in depth first order, so frustum
+// culling and ray picking only touch the parts of the scene they hit.
+
+// Objects per leaf at most
+#define BVH_LEAF_SIZE 4
+// Candidate split planes per axis are the borders of this many bins
+#define BVH_BINS 16
+// Subtrees with at least this many objects are built on the pool
+#define BVH_PARALLEL_COUNT (64 * 1024)
+// Deepest possible leaf, bounds the stacks of the queries
+#define BVH_MAX_DEPTH 64
+
+// 32 bytes, two nodes per cache line. A leaf has `count` objects starting
+// at `indices[first]`. An inner node has a `count` of 0 and its children at
+// nodes[first] and nodes[first + 1]. The objects of every subtree are
+// contiguous in `indices`.
+typedef struct {
+    float min[V3_COMPS];
+    uint32_t first;
+    float max[V3_COMPS];
+    uint32_t count;
+} Bvh_Node;
+
+typedef struct {
+    Bvh_Node *nodes;
+    size_t nodes_count;
+    // Objects ordered by leaf
+    uint32_t *indices;
+    size_t objects_count;
+    const Aabb *aabbs;
+} Bvh;
+
+// Bytes of the Region bvh_build() allocates from at most
+size_t bvh_memory_size(size_t objects_count);
+
+// Builds the hierarchy over `aabbs`, which must outlive it. The nodes and
+// the indices are allocated from `region`, the subtrees are built on
+// `pool` when it is not NULL. Returns false and sets errno on failure.
+bool bvh_build(Region *region, Pool *pool, const Aabb *aabbs, size_t count, Bvh *bvh);
+
+// Writes the indices of the objects intersecting the frustum into
+// `visible`, which must hold objects_count indices, in no particular
+// order. Returns the amount of visible objects.
+size_t bvh_cull(const Bvh *bvh, const Frustum *frustum, uint32_t *visible);
+
+// Extra test for the boxes that intersect the frustum, returning false
+// rejects the box and everything inside of it
+typedef bool (*Bvh_Filter)(void *arg, const float min[V3_COMPS], const float max[V3_COMPS]);
+
+// Same as bvh_cull() with `filter` applied top down to the nodes and the
+// objects. `rejected` receives the amount of objects under the boxes the
+// filter rejected.
+size_t bvh_cull_filtered(const Bvh *bvh, const Frustum *frustum,
+                         Bvh_Filter filter, void *arg,
+                         uint32_t *visible, size_t *rejected);
+
+// Finds the nearest object hit by the ray origin + t * direction for t >= 0.
+// Returns false when nothing is hit.
+bool bvh_raycast(const Bvh *bvh, const float origin[V3_COMPS], const float direction[V3_COMPS],
+                 uint32_t *hit, float *t);
+// Same as bvh_raycast() by testing every object, for reference
+bool bvh_raycast_brute(const Bvh *bvh, const float origin[V3_COMPS], const float direction[V3_COMPS],
+                       uint32_t *hit, float *t);
+
+#endif // BVH_H_
@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#define GLEW_STATIC
+#include "./timer.h"
+#include "./capture.h"
+
+// Nanoseconds, same as the stream buffers
+#define CAPTURE_FENCE_TIMEOUT 1000000000ull
+
+bool capture_init(Capture *capture, Capture_Write write, void *write_arg)
+{
+    memset(capture, 0, sizeof(*capture));
+    capture->write = write;
+    capture->write_arg = write_arg;
+
+    // A single thread keeps the frames in order
+    capture->writer = pool_create(1);
+    if (capture->writer == NULL) return false;
+
+    glGenBuffers(CAPTURE_PBOS, capture->pbos);
+    for (size_t i = 0; i < CAPTURE_QUEUE; ++i) {
+        capture->slots[i].capture = capture;
+    }
+    return true;
+}
+
+void capture_free(Capture *capture)
+{
+    if (capture->writer == NULL) return;
+
+    capture_flush(capture);
+    pool_destroy(capture->writer);
+    glDeleteBuffers(CAPTURE_PBOS, capture->pbos);
+    for (size_t i = 0; i < CAPTURE_QUEUE; ++i) {
+        free(capture->slots[i].frame.pixels);
+    }
+    memset(capture, 0, sizeof(*capture));
+}
+
+static void capture_write_task(void *arg, size_t worker)
+{
+    (void) worker;
+    Capture_Slot *slot = arg;
+    slot->capture->write(slot->capture->write_arg, &slot->frame);
+}
+
+// Hands the oldest frame being read back over to the writer. Returns false
+// when there is none, or when it is not there yet and `wait` is false.
+static bool capture_retire(Capture *capture, bool wait)
+{
+    if (capture->pbo_count == 0) return false;
+
+    const size_t pbo = capture->pbo_first;
+    if (glClientWaitSync(capture->fences[pbo], 0, 0) == GL_TIMEOUT_EXPIRED) {
+        if (!wait) return false;
+        capture->fence_waits += 1;
+        glClientWaitSync(capture->fences[pbo], GL_SYNC_FLUSH_COMMANDS_BIT, CAPTURE_FENCE_TIMEOUT);
+    }
+    glDeleteSync(capture->fences[pbo]);
+    capture->fences[pbo] = NULL;
+    capture->pbo_first = (capture->pbo_first + 1) % CAPTURE_PBOS;
+    capture->pbo_count -= 1;
+
+    Capture_Slot *slot = &capture->slots[capture->slot_next];
+    if (!pool_async_done(&slot->async)) {
+        capture->writer_waits += 1;
+        pool_async_wait(&slot->async);
+    }
+
+    const size_t size = capture->pbo_sizes[pbo];
+    if (slot->capacity < size) {
+        uint8_t *pixels = realloc(slot->frame.pixels, size);
+        if (pixels == NULL) {
+            fprintf(stderr, "ERROR: not enough memory for captured frame %zu\n",
+                    capture->pbo_frames[pbo].index);
+            return true;
+        }
+        slot->frame.pixels = pixels;
+        slot->capacity = size;
+    }
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pbos[pbo]);
+    const void *pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr) size, GL_MAP_READ_BIT);
+    if (pixels != NULL) {
+        memcpy(slot->frame.pixels, pixels, size);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+
+        uint8_t *const slot_pixels = slot->frame.pixels;
+        slot->frame = capture->pbo_frames[pbo];
+        slot->frame.pixels = slot_pixels;
+        pool_async(capture->writer, &slot->async, capture_write_task, slot);
+        capture->slot_next = (capture->slot_next + 1) % CAPTURE_QUEUE;
+    } else {
+        fprintf(stderr, "ERROR: could not map captured frame %zu\n", capture->pbo_frames[pbo].index);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    return true;
+}
+
+void capture_poll(Capture *capture)
+{
+    while (capture_retire(capture, false)) {}
+}
+
+void capture_frame(Capture *capture, uint32_t width, uint32_t height)
+{
+    const double start = timer_now();
+
+    capture_poll(capture);
+    if (capture->pbo_count == CAPTURE_PBOS) capture_retire(capture, true);
+
+    const size_t pbo = (capture->pbo_first + capture->pbo_count) % CAPTURE_PBOS;
+    const size_t size = (size_t) width * height * IMAGE_COMPS;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, capture->pbos[pbo]);
+    if (capture->pbo_sizes[pbo] != size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr) size, NULL, GL_STREAM_READ);
+        capture->pbo_sizes[pbo] = size;
+    }
+    // Into the buffer, glReadPixels() returns right away
+    glReadPixels(0, 0, (GLsizei) width, (GLsizei) height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    capture->fences[pbo] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    capture->pbo_frames[pbo] = (Capture_Frame) {
+        .width = width,
+        .height = height,
+        .index = capture->frames_count++,
+    };
+    capture->pbo_count += 1;
+
+    capture->frames_captured += 1;
+    capture->main_secs += timer_now() - start;
+}
+
+void capture_flush(Capture *capture)
+{
+    while (capture_retire(capture, true)) {}
+    for (size_t i = 0; i < CAPTURE_QUEUE; ++i) {
+        pool_async_wait(&capture->slots[i].async);
+    }
+}
+
+void capture_reset_stats(Capture *capture)
+{
+    capture->frames_captured = 0;
+    capture->fence_waits = 0;
+    capture->writer_waits = 0;
+    capture->main_secs = 0.0;
+}
+
+bool capture_images_init(Capture_Images *images, const char *file_path, const char **error)
+{
+    memset(images, 0, sizeof(*images));
+    images->file_path = file_path;
+    images->format = image_format_by_file_path(file_path);
+    if (images->format != IMAGE_FORMAT_QOI && images->format != IMAGE_FORMAT_RAW) {
+        *error = "only .qoi and .kraw frames can be written";
+        return false;
+    }
+    return true;
+}
+
+static char *capture_image_file_path(Region *region, const char *file_path, size_t index)
+{
+    const char *extension = strrchr(file_path, '.');
+    const char *slash = strrchr(file_path, '/');
+    if (extension == NULL || (slash != NULL && extension < slash)) {
+        extension = file_path + strlen(file_path);
+    }
+    const int stem = (int) (extension - file_path);
+
+    const char *const fmt = "%.*s-%06zu%s";
+    const int n = snprintf(NULL, 0, fmt, stem, file_path, index, extension);
+    char *result = region_malloc(region, (size_t) n + 1);
+    if (result == NULL) return NULL;
+    snprintf(result, (size_t) n + 1, fmt, stem, file_path, index, extension);
+    return result;
+}
+
+void capture_images_write(void *arg, const Capture_Frame *frame)
+{
+    Capture_Images *images = arg;
+    const size_t row_size = (size_t) frame->width * IMAGE_COMPS;
+    const size_t size = row_size * frame->height;
+
+    // The flipped pixels, then the encoded ones: up to 5 bytes per pixel
+    // for QOI
+    const size_t capacity = size + size * 5 / 4 + 1024;
+    if (images->region.capacity < capacity) {
+        region_free(&images->region);
+        images->region = region_with_capacity(capacity);
+    }
+    Region *region = &images->region;
+    region_clean(region);
+
+    uint8_t *pixels = region_malloc(region, size);
+    const char *file_path = capture_image_file_path(region, images->file_path, frame->index);
+    if (pixels == NULL || file_path == NULL) {
+        fprintf(stderr, "ERROR: not enough memory to write captured frame %zu\n", frame->index);
+        return;
+    }
+    // The images go top row first
+    for (size_t y = 0; y < frame->height; ++y) {
+        memcpy(pixels + y * row_size, frame->pixels + (frame->height - 1 - y) * row_size, row_size);
+    }
+
+    const Image image = {
+        .width = frame->width,
+        .height = frame->height,
+        .pixels = pixels,
+    };
+    uint8_t *data = NULL;
+    size_t data_size = 0;
+    if (!image_encode(region, images->format, image, &data, &data_size)) {
+        fprintf(stderr, "ERROR: could not encode captured frame %zu: %s\n",
+                frame->index, image_failure_reason());
+        return;
+    }
+
+    FILE *f = fopen(file_path, "wb");
+    bool ok = f != NULL && fwrite(data, data_size, 1, f) == 1;
+    if (f != NULL && fclose(f) != 0) ok = false;
+    if (!ok) {
+        fprintf(stderr, "ERROR: could not write file %s: %s\n", file_path, strerror(errno));
+        return;
+    }
+    images->written += 1;
+}
+
+void capture_y4m_write(void *arg, const Capture_Frame *frame)
+{
+    Y4m_Writer *writer = arg;
+    if (writer->file == NULL) return;
+
+    if (frame->width != writer->width || frame->height != writer->height) {
+        fprintf(stderr, "ERROR: captured frame %zu is %ux%u, the video is %ux%u\n",
+                frame->index, frame->width, frame->height, writer->width, writer->height);
+        return;
+    }
+    // Straight from the bottom up rows glReadPixels() returns
+    const ptrdiff_t stride = (ptrdiff_t) frame->width * IMAGE_COMPS;
+    const uint8_t *last_row = frame->pixels + (ptrdiff_t) (frame->height - 1) * stride;
+    if (!y4m_writer_write(writer, last_row, -stride)) {
+        fprintf(stderr, "ERROR: could not write frame %zu of the video: %s\n", frame->index, strerror(errno));
+        y4m_writer_close(writer);
+    }
+}
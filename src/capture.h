@@ -0,0 +1,110 @@
+#ifndef CAPTURE_H_
+#define CAPTURE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <GL/glew.h>
+
+#include "./pool.h"
+#include "./region.h"
+#include "./image.h"
+#include "./y4m.h"
+
+// Reads the rendered frames back without stalling the pipeline. Every
+// captured frame is glReadPixels()ed into the next pixel pack buffer of a
+// ring of CAPTURE_PBOS with a fence after it, and only mapped once the
+// fence has signaled, a frame or two later, so the GPU copies frame N
+// while N+1 renders. The mapped pixels are copied into one of
+// CAPTURE_QUEUE frames on the CPU and written out by a thread of the
+// capture's own, the workers of the scene are never blocked by the disk.
+//
+// Only the ring being full waits for a fence and only the writer falling
+// behind by CAPTURE_QUEUE frames waits for the writer, both are counted.
+
+#define CAPTURE_PBOS 3
+#define CAPTURE_QUEUE 4
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    // Since capture_init()
+    size_t index;
+    // RGBA8, bottom row first as glReadPixels() returns them
+    uint8_t *pixels;
+} Capture_Frame;
+
+// Called on the writer thread, one frame at a time in order
+typedef void (*Capture_Write)(void *arg, const Capture_Frame *frame);
+
+typedef struct Capture Capture;
+
+typedef struct {
+    Capture *capture;
+    Capture_Frame frame;
+    size_t capacity;
+    Pool_Async async;
+} Capture_Slot;
+
+struct Capture {
+    Capture_Write write;
+    void *write_arg;
+    Pool *writer;
+
+    GLuint pbos[CAPTURE_PBOS];
+    GLsync fences[CAPTURE_PBOS];
+    size_t pbo_sizes[CAPTURE_PBOS];
+    Capture_Frame pbo_frames[CAPTURE_PBOS];
+    // The oldest frame being read back and how many are
+    size_t pbo_first;
+    size_t pbo_count;
+
+    Capture_Slot slots[CAPTURE_QUEUE];
+    size_t slot_next;
+    size_t frames_count;
+
+    // Since capture_reset_stats()
+    size_t frames_captured;
+    size_t fence_waits;
+    size_t writer_waits;
+    // On the thread calling capture_frame()
+    double main_secs;
+};
+
+// Returns false and sets errno when the writer thread could not be started
+bool capture_init(Capture *capture, Capture_Write write, void *write_arg);
+// Writes out whatever is still being read back first
+void capture_free(Capture *capture);
+
+// After the draws of the frame and before swapping the buffers. Starts
+// reading the framebuffer of `width` by `height` pixels and hands the
+// frames read back by now over to the writer.
+void capture_frame(Capture *capture, uint32_t width, uint32_t height);
+// What capture_frame() does with the frames read back by now, for the
+// frames that are not captured
+void capture_poll(Capture *capture);
+// Hands every frame over to the writer and waits for it to write them
+void capture_flush(Capture *capture);
+
+void capture_reset_stats(Capture *capture);
+
+// Capture_Write into an image file per frame, `file_path` with the index
+// of the frame before the extension: shot.qoi is shot-000042.qoi
+typedef struct {
+    const char *file_path;
+    Image_Format format;
+    // Writer thread only
+    Region region;
+    size_t written;
+} Capture_Images;
+
+// Only the formats image_encode() supports. Returns false and leaves the
+// reason in `error` otherwise.
+bool capture_images_init(Capture_Images *images, const char *file_path, const char **error);
+void capture_images_write(void *arg, const Capture_Frame *frame);
+
+// Capture_Write into the Y4m_Writer `arg`, the frames must be of its size.
+// Stops writing at the first error.
+void capture_y4m_write(void *arg, const Capture_Frame *frame);
+
+#endif // CAPTURE_H_
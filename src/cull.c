@@ -0,0 +1,205 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "./cull.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULL_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define CULL_SSE2
+#endif
+
+#define CULL_LANES 8
+
+// 8 floats and the handful of operations the tests need
+#if defined(CULL_AVX)
+typedef __m256 F8;
+
+static F8 f8_load(const float *p) { return _mm256_loadu_ps(p); }
+static F8 f8_set1(float x) { return _mm256_set1_ps(x); }
+static F8 f8_add(F8 a, F8 b) { return _mm256_add_ps(a, b); }
+static F8 f8_mul(F8 a, F8 b) { return _mm256_mul_ps(a, b); }
+// Bit i is set when a[i] < b[i]
+static int f8_lt_mask(F8 a, F8 b) { return _mm256_movemask_ps(_mm256_cmp_ps(a, b, _CMP_LT_OQ)); }
+#elif defined(CULL_SSE2)
+typedef struct {
+    __m128 lo, hi;
+} F8;
+
+static F8 f8_load(const float *p) { return (F8) {_mm_loadu_ps(p), _mm_loadu_ps(p + 4)}; }
+static F8 f8_set1(float x) { return (F8) {_mm_set1_ps(x), _mm_set1_ps(x)}; }
+static F8 f8_add(F8 a, F8 b) { return (F8) {_mm_add_ps(a.lo, b.lo), _mm_add_ps(a.hi, b.hi)}; }
+static F8 f8_mul(F8 a, F8 b) { return (F8) {_mm_mul_ps(a.lo, b.lo), _mm_mul_ps(a.hi, b.hi)}; }
+static int f8_lt_mask(F8 a, F8 b)
+{
+    return _mm_movemask_ps(_mm_cmplt_ps(a.lo, b.lo)) |
+           _mm_movemask_ps(_mm_cmplt_ps(a.hi, b.hi)) << 4;
+}
+#else
+typedef struct {
+    float v[CULL_LANES];
+} F8;
+
+static F8 f8_load(const float *p) { F8 r; memcpy(r.v, p, sizeof(r.v)); return r; }
+static F8 f8_set1(float x) { F8 r; for (int i = 0; i < CULL_LANES; ++i) r.v[i] = x; return r; }
+static F8 f8_add(F8 a, F8 b) { for (int i = 0; i < CULL_LANES; ++i) a.v[i] += b.v[i]; return a; }
+static F8 f8_mul(F8 a, F8 b) { for (int i = 0; i < CULL_LANES; ++i) a.v[i] *= b.v[i]; return a; }
+static int f8_lt_mask(F8 a, F8 b)
+{
+    int mask = 0;
+    for (int i = 0; i < CULL_LANES; ++i) mask |= (a.v[i] < b.v[i]) << i;
+    return mask;
+}
+#endif
+
+// A volume is outside of the frustum when its center is further than
+// `radius` behind any of the planes. For boxes the radius is the extent
+// projected on the normal of the plane, |a|*ex + |b|*ey + |c|*ez.
+static size_t cull(const Frustum *frustum,
+                   const float *const center[V3_COMPS],
+                   const float *const extent[V3_COMPS], bool uniform_extent,
+                   const float *radius,
+                   size_t first, size_t count, uint32_t *visible)
+{
+    F8 planes[FRUSTUM_PLANES][V4_COMPS];
+    F8 abs_normals[FRUSTUM_PLANES][V3_COMPS];
+    for (size_t p = 0; p < FRUSTUM_PLANES; ++p) {
+        for (size_t c = 0; c < V4_COMPS; ++c) {
+            planes[p][c] = f8_set1(frustum->planes[p].cs[c]);
+        }
+        for (size_t c = 0; c < V3_COMPS; ++c) {
+            abs_normals[p][c] = f8_set1(fabsf(frustum->planes[p].cs[c]));
+        }
+    }
+
+    const F8 zero = f8_set1(0.0f);
+    size_t visible_count = 0;
+    const size_t end = first + count;
+    size_t i = first;
+
+    for (; i + CULL_LANES <= end; i += CULL_LANES) {
+        const F8 cx = f8_load(center[X] + i);
+        const F8 cy = f8_load(center[Y] + i);
+        const F8 cz = f8_load(center[Z] + i);
+
+        F8 ex = zero, ey = zero, ez = zero, r = zero;
+        if (radius != NULL) {
+            r = f8_load(radius + i);
+        } else if (uniform_extent) {
+            ex = f8_set1(extent[X][0]);
+            ey = f8_set1(extent[Y][0]);
+            ez = f8_set1(extent[Z][0]);
+        } else {
+            ex = f8_load(extent[X] + i);
+            ey = f8_load(extent[Y] + i);
+            ez = f8_load(extent[Z] + i);
+        }
+
+        int outside = 0;
+        for (size_t p = 0; p < FRUSTUM_PLANES; ++p) {
+            F8 distance = f8_add(f8_add(f8_mul(planes[p][X], cx), f8_mul(planes[p][Y], cy)),
+                                 f8_add(f8_mul(planes[p][Z], cz), planes[p][W]));
+            if (radius == NULL) {
+                r = f8_add(f8_add(f8_mul(abs_normals[p][X], ex), f8_mul(abs_normals[p][Y], ey)),
+                           f8_mul(abs_normals[p][Z], ez));
+            }
+            outside |= f8_lt_mask(f8_add(distance, r), zero);
+        }
+
+        // Every lane is written, but the slot only advances for visible
+        // ones, so the result comes out compacted
+        const int inside = ~outside;
+        for (int lane = 0; lane < CULL_LANES; ++lane) {
+            visible[visible_count] = (uint32_t) (i + (size_t) lane);
+            visible_count += (size_t) ((inside >> lane) & 1);
+        }
+    }
+
+    for (; i < end; ++i) {
+        bool inside = true;
+        for (size_t p = 0; p < FRUSTUM_PLANES && inside; ++p) {
+            const V4 plane = frustum->planes[p];
+            const float distance = plane.cs[X] * center[X][i] +
+                                   plane.cs[Y] * center[Y][i] +
+                                   plane.cs[Z] * center[Z][i] + plane.cs[W];
+            float r;
+            if (radius != NULL) {
+                r = radius[i];
+            } else {
+                const size_t e = uniform_extent ? 0 : i;
+                r = fabsf(plane.cs[X]) * extent[X][e] +
+                    fabsf(plane.cs[Y]) * extent[Y][e] +
+                    fabsf(plane.cs[Z]) * extent[Z][e];
+            }
+            inside = distance + r >= 0.0f;
+        }
+        if (inside) visible[visible_count++] = (uint32_t) i;
+    }
+
+    return visible_count;
+}
+
+size_t cull_aabbs(const Frustum *frustum, const Cull_Aabbs *aabbs,
+                  size_t first, size_t count, uint32_t *visible)
+{
+    return cull(frustum, aabbs->center, aabbs->extent, aabbs->uniform_extent, NULL,
+                first, count, visible);
+}
+
+size_t cull_spheres(const Frustum *frustum, const Cull_Spheres *spheres,
+                    size_t first, size_t count, uint32_t *visible)
+{
+    return cull(frustum, spheres->center, NULL, false, spheres->radius,
+                first, count, visible);
+}
+
+typedef struct {
+    const Frustum *frustum;
+    const Cull_Aabbs *aabbs;
+    uint32_t *visible;
+    size_t *block_counts;
+} Cull_Batch;
+
+static void cull_block(void *arg, size_t block, size_t worker)
+{
+    (void) worker;
+    Cull_Batch *batch = arg;
+    const size_t first = block * CULL_BLOCK_SIZE;
+    const size_t left = batch->aabbs->count - first;
+    const size_t count = left < CULL_BLOCK_SIZE ? left : CULL_BLOCK_SIZE;
+    batch->block_counts[block] = cull_aabbs(batch->frustum, batch->aabbs, first, count,
+                                            batch->visible + first);
+}
+
+size_t cull_aabbs_parallel(Pool *pool, const Frustum *frustum,
+                           const Cull_Aabbs *aabbs, uint32_t *visible)
+{
+    const size_t blocks = (aabbs->count + CULL_BLOCK_SIZE - 1) / CULL_BLOCK_SIZE;
+    size_t *block_counts = malloc(blocks * sizeof(*block_counts));
+    if (block_counts == NULL) {
+        return cull_aabbs(frustum, aabbs, 0, aabbs->count, visible);
+    }
+
+    // Every block culls into its own part of `visible`, then the parts are
+    // moved together
+    Cull_Batch batch = {
+        .frustum = frustum,
+        .aabbs = aabbs,
+        .visible = visible,
+        .block_counts = block_counts,
+    };
+    pool_for(pool, blocks, cull_block, &batch);
+
+    size_t visible_count = 0;
+    for (size_t block = 0; block < blocks; ++block) {
+        memmove(visible + visible_count, visible + block * CULL_BLOCK_SIZE,
+                block_counts[block] * sizeof(*visible));
+        visible_count += block_counts[block];
+    }
+
+    free(block_counts);
+    return visible_count;
+}
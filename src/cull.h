@@ -0,0 +1,45 @@
+#ifndef CULL_H_
+#define CULL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "./geo.h"
+#include "./pool.h"
+
+// Frustum culling of bounding volumes stored as structure of arrays. The
+// volumes are tested 8 at a time: with AVX when the compiler targets it,
+// as two SSE halves otherwise, and with plain C on anything else.
+
+// Amount of volumes culled by a single task of cull_aabbs_parallel()
+#define CULL_BLOCK_SIZE (16 * 1024)
+
+typedef struct {
+    const float *center[V3_COMPS];
+    // Half sizes of the boxes. When `uniform_extent` is set every array
+    // holds a single value shared by all of the boxes.
+    const float *extent[V3_COMPS];
+    bool uniform_extent;
+    size_t count;
+} Cull_Aabbs;
+
+typedef struct {
+    const float *center[V3_COMPS];
+    const float *radius;
+    size_t count;
+} Cull_Spheres;
+
+// Tests the volumes [first, first + count) and writes the indices of the
+// ones intersecting the frustum into `visible` in ascending order. Returns
+// the amount of visible volumes. `visible` must hold `count` indices.
+size_t cull_aabbs(const Frustum *frustum, const Cull_Aabbs *aabbs,
+                  size_t first, size_t count, uint32_t *visible);
+size_t cull_spheres(const Frustum *frustum, const Cull_Spheres *spheres,
+                    size_t first, size_t count, uint32_t *visible);
+
+// Same as cull_aabbs() over all of `aabbs`, split into blocks across `pool`
+// when it is not NULL
+size_t cull_aabbs_parallel(Pool *pool, const Frustum *frustum,
+                           const Cull_Aabbs *aabbs, uint32_t *visible);
+
+#endif // CULL_H_
@@ -0,0 +1,319 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "./emote.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define EMOTE_SSE2
+#endif
+
+size_t emote_instances_capacity(Image image)
+{
+    return (size_t) image.width * image.height;
+}
+
+static size_t build_row_scalar(const uint8_t *pixels, size_t count,
+                               float x, float y, float z,
+                               Emote_Instance *instances)
+{
+    size_t result = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t *pixel = &pixels[i * IMAGE_COMPS];
+        if (pixel[3] < EMOTE_ALPHA_THRESHOLD) continue;
+
+        Emote_Instance *instance = &instances[result++];
+        instance->position[X] = x + (float) i;
+        instance->position[Y] = y;
+        instance->position[Z] = z;
+        memcpy(&instance->color, pixel, sizeof(instance->color));
+    }
+    return result;
+}
+
+#ifdef EMOTE_SSE2
+// Four pixels at a time: the positions and the colors are transposed into
+// four ready instances, and the lanes up to the last opaque one are stored
+// unconditionally into the next free slot, which only advances for the
+// opaque ones. Nothing is ever written past the last opaque pixel, so
+// emotes of a wall can be built side by side without extra room.
+static size_t build_row_sse2(const uint8_t *pixels, size_t count,
+                             float x, float y, float z,
+                             Emote_Instance *instances)
+{
+    _Static_assert(sizeof(Emote_Instance) == sizeof(__m128), "Emote_Instance must fit a register");
+
+    const __m128i threshold = _mm_set1_epi32(EMOTE_ALPHA_THRESHOLD - 1);
+    const __m128 step = _mm_set1_ps(4.0f);
+    __m128 xs = _mm_add_ps(_mm_set1_ps(x), _mm_setr_ps(0.0f, 1.0f, 2.0f, 3.0f));
+    const __m128 ys = _mm_set1_ps(y);
+    const __m128 zs = _mm_set1_ps(z);
+
+    size_t result = 0;
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i colors = _mm_loadu_si128((const __m128i*) &pixels[i * IMAGE_COMPS]);
+        const __m128i alphas = _mm_srli_epi32(colors, 24);
+        const int opaque = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(alphas, threshold)));
+
+        if (opaque != 0) {
+            __m128 lanes[4] = {xs, ys, zs, _mm_castsi128_ps(colors)};
+            _MM_TRANSPOSE4_PS(lanes[0], lanes[1], lanes[2], lanes[3]);
+            for (int lane = 0; (opaque >> lane) != 0; ++lane) {
+                _mm_storeu_ps((float*) &instances[result], lanes[lane]);
+                result += (opaque >> lane) & 1;
+            }
+        }
+
+        xs = _mm_add_ps(xs, step);
+    }
+
+    return result + build_row_scalar(&pixels[i * IMAGE_COMPS], count - i,
+                                     x + (float) i, y, z, &instances[result]);
+}
+#endif // EMOTE_SSE2
+
+size_t emote_build_instances_scalar(Image image, float x, float y, float z, Emote_Instance *instances)
+{
+    size_t count = 0;
+    for (uint32_t row = 0; row < image.height; ++row) {
+        // Images are stored top to bottom, the world goes up
+        const float row_y = y + (float) (image.height - 1 - row);
+        count += build_row_scalar(&image.pixels[(size_t) row * image.width * IMAGE_COMPS],
+                                  image.width, x, row_y, z, &instances[count]);
+    }
+    return count;
+}
+
+size_t emote_build_instances(Image image, float x, float y, float z, Emote_Instance *instances)
+{
+#ifdef EMOTE_SSE2
+    size_t count = 0;
+    for (uint32_t row = 0; row < image.height; ++row) {
+        const float row_y = y + (float) (image.height - 1 - row);
+        count += build_row_sse2(&image.pixels[(size_t) row * image.width * IMAGE_COMPS],
+                                image.width, x, row_y, z, &instances[count]);
+    }
+    return count;
+#else
+    return emote_build_instances_scalar(image, x, y, z, instances);
+#endif
+}
+
+typedef struct {
+    Image image;
+    size_t wall;
+    size_t emote_instances;
+    Emote_Instance *instances;
+} Emote_Wall;
+
+static void emote_wall_origin(const Emote_Wall *wall, size_t index, float *x, float *y, float *z)
+{
+    const size_t layer_index = index % (wall->wall * wall->wall);
+    *x = (float) ((layer_index % wall->wall) * (wall->image.width + EMOTE_WALL_GAP));
+    *y = (float) ((layer_index / wall->wall) * (wall->image.height + EMOTE_WALL_GAP));
+    *z = (float) (index / (wall->wall * wall->wall));
+}
+
+static void build_wall_emote(void *arg, size_t index, size_t worker)
+{
+    (void) worker;
+    Emote_Wall *wall = arg;
+
+    // The first emote is already built
+    index += 1;
+
+    float x, y, z;
+    emote_wall_origin(wall, index, &x, &y, &z);
+    emote_build_instances(wall->image, x, y, z, &wall->instances[index * wall->emote_instances]);
+}
+
+size_t emote_build_wall(Pool *pool, Image image, size_t wall, size_t layers,
+                        Emote_Instance *instances, float extent[V3_COMPS])
+{
+    extent[X] = (float) (wall * image.width + (wall > 0 ? wall - 1 : 0) * EMOTE_WALL_GAP);
+    extent[Y] = (float) (wall * image.height + (wall > 0 ? wall - 1 : 0) * EMOTE_WALL_GAP);
+    extent[Z] = (float) layers;
+
+    if (wall == 0 || layers == 0) return 0;
+
+    // Every emote of the wall has the same amount of opaque pixels, so
+    // once the first one is built the others know where their instances go
+    Emote_Wall ctx = {
+        .image = image,
+        .wall = wall,
+        .instances = instances,
+    };
+    ctx.emote_instances = emote_build_instances(image, 0.0f, 0.0f, 0.0f, instances);
+
+    const size_t rest = wall * wall * layers - 1;
+    pool_for(pool, rest, build_wall_emote, &ctx);
+
+    return wall * wall * layers * ctx.emote_instances;
+}
+
+size_t emote_build_occluders(Image image, size_t wall, size_t layers, Aabb *occluders)
+{
+    if (wall == 0 || layers == 0) return 0;
+
+    uint8_t *opaque = malloc((size_t) image.width * image.height + 1);
+    if (opaque == NULL) return 0;
+    for (size_t i = 0; i < (size_t) image.width * image.height; ++i) {
+        opaque[i] = image.pixels[i * IMAGE_COMPS + 3] >= EMOTE_ALPHA_THRESHOLD;
+    }
+
+    // Greedy rectangles of opaque pixels, the same way voxel.c merges the
+    // faces of a slice: as wide as possible, then as high as possible
+    size_t count = 0;
+    for (size_t row = 0; row < image.height; ++row) {
+        for (size_t col = 0; col < image.width; ) {
+            if (!opaque[row * image.width + col]) {
+                col += 1;
+                continue;
+            }
+
+            size_t w = 1;
+            while (col + w < image.width && opaque[row * image.width + col + w]) {
+                w += 1;
+            }
+
+            size_t h = 1;
+            for (; row + h < image.height; ++h) {
+                bool full = true;
+                for (size_t i = 0; i < w && full; ++i) {
+                    full = opaque[(row + h) * image.width + col + i];
+                }
+                if (!full) break;
+            }
+
+            for (size_t j = 0; j < h; ++j) {
+                memset(&opaque[(row + j) * image.width + col], 0, w);
+            }
+
+            if (w * h >= EMOTE_OCCLUDER_MIN_AREA) {
+                // Rows go down in the image and up in the world
+                Aabb *occluder = &occluders[count++];
+                occluder->min[X] = (float) col;
+                occluder->min[Y] = (float) (image.height - row - h);
+                occluder->min[Z] = 0.0f;
+                occluder->max[X] = (float) (col + w);
+                occluder->max[Y] = (float) (image.height - row);
+                occluder->max[Z] = (float) layers;
+            }
+            col += w;
+        }
+    }
+    free(opaque);
+
+    // The same rectangles for every emote of the wall
+    const Emote_Wall ctx = {
+        .image = image,
+        .wall = wall,
+    };
+    const size_t emote_occluders = count;
+    for (size_t index = 1; index < wall * wall; ++index) {
+        float x, y, z;
+        emote_wall_origin(&ctx, index, &x, &y, &z);
+        for (size_t i = 0; i < emote_occluders; ++i) {
+            Aabb *occluder = &occluders[count++];
+            *occluder = occluders[i];
+            occluder->min[X] += x;
+            occluder->max[X] += x;
+            occluder->min[Y] += y;
+            occluder->max[Y] += y;
+        }
+    }
+
+    return count;
+}
+
+void emote_wall_bounds(Image image, size_t wall, size_t layers, size_t index, Aabb *bounds)
+{
+    const Emote_Wall ctx = {
+        .image = image,
+        .wall = wall,
+    };
+    float x, y, z;
+    emote_wall_origin(&ctx, index, &x, &y, &z);
+    *bounds = (Aabb) {
+        .min = {x, y, 0.0f},
+        .max = {x + (float) image.width, y + (float) image.height, (float) layers},
+    };
+}
+
+size_t emote_lod_capacity(Image image, size_t layers, size_t level)
+{
+    const size_t size = (size_t) 1 << level;
+    return ((image.width + size - 1) >> level) *
+           ((image.height + size - 1) >> level) *
+           ((layers + size - 1) >> level);
+}
+
+size_t emote_build_lod(Image image, size_t wall, size_t layers, size_t level, Emote_Instance *instances)
+{
+    if (wall == 0 || layers == 0) return 0;
+
+    // The blocks of the first layer of the first emote
+    const size_t size = (size_t) 1 << level;
+    size_t count = 0;
+    for (size_t row = 0; row < image.height; row += size) {
+        for (size_t col = 0; col < image.width; col += size) {
+            uint32_t sums[IMAGE_COMPS] = {0};
+            size_t opaque = 0;
+            size_t total = 0;
+            for (size_t y = row; y < row + size && y < image.height; ++y) {
+                for (size_t x = col; x < col + size && x < image.width; ++x) {
+                    const uint8_t *pixel = &image.pixels[(y * image.width + x) * IMAGE_COMPS];
+                    total += 1;
+                    if (pixel[3] < EMOTE_ALPHA_THRESHOLD) continue;
+                    opaque += 1;
+                    for (size_t c = 0; c < IMAGE_COMPS; ++c) {
+                        sums[c] += pixel[c];
+                    }
+                }
+            }
+            if (opaque * 2 < total) continue;
+
+            uint8_t color[IMAGE_COMPS];
+            for (size_t c = 0; c < IMAGE_COMPS; ++c) {
+                color[c] = (uint8_t) (sums[c] / opaque);
+            }
+
+            // Rows go down in the image and up in the world
+            Emote_Instance *instance = &instances[count++];
+            instance->position[X] = (float) col;
+            instance->position[Y] = (float) image.height - (float) (row + size);
+            instance->position[Z] = 0.0f;
+            memcpy(&instance->color, color, sizeof(instance->color));
+        }
+    }
+
+    // The other layers of the first emote
+    const size_t blocks = count;
+    for (size_t layer = size; layer < layers; layer += size) {
+        for (size_t i = 0; i < blocks; ++i) {
+            Emote_Instance *instance = &instances[count++];
+            *instance = instances[i];
+            instance->position[Z] = (float) layer;
+        }
+    }
+
+    // The other emotes of the wall
+    const Emote_Wall ctx = {
+        .image = image,
+        .wall = wall,
+    };
+    const size_t emote_count = count;
+    for (size_t index = 1; index < wall * wall; ++index) {
+        float x, y, z;
+        emote_wall_origin(&ctx, index, &x, &y, &z);
+        for (size_t i = 0; i < emote_count; ++i) {
+            Emote_Instance *instance = &instances[count++];
+            *instance = instances[i];
+            instance->position[X] += x;
+            instance->position[Y] += y;
+        }
+    }
+
+    return count;
+}
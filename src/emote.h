@@ -0,0 +1,69 @@
+#ifndef EMOTE_H_
+#define EMOTE_H_
+
+#include <stdint.h>
+
+#include "./geo.h"
+#include "./image.h"
+#include "./pool.h"
+
+// Extrudes pixel-art emotes into voxels: every opaque pixel becomes a unit
+// cube instance colored like the pixel, and a wall of emotes becomes as
+// many instances as there are opaque pixels on it.
+
+// Pixels with a lower alpha are culled
+#define EMOTE_ALPHA_THRESHOLD 128
+// Empty voxels between the emotes of a wall
+#define EMOTE_WALL_GAP 4
+// Smaller rectangles of opaque pixels do not hide enough to be occluders
+#define EMOTE_OCCLUDER_MIN_AREA 16
+
+// Coarser copies of the wall for the distance LOD, level `l` merges blocks
+// of 2^l by 2^l pixels and 2^l layers into cubes 2^l voxels big, or as
+// deep as the wall when it is thinner
+#define EMOTE_LOD_LEVELS 4
+
+// Exactly 16 bytes, so the SIMD builder writes one register per instance
+typedef struct {
+    float position[V3_COMPS];
+    // RGBA8 of the pixel, uploaded as a normalized attribute
+    uint32_t color;
+} Emote_Instance;
+
+// Instances a single emote produces at most
+size_t emote_instances_capacity(Image image);
+
+// Writes an instance for every opaque pixel of `image` with the bottom left
+// corner of the emote at (x, y, z). Returns the amount of instances.
+size_t emote_build_instances(Image image, float x, float y, float z, Emote_Instance *instances);
+// Portable version of emote_build_instances() without SIMD
+size_t emote_build_instances_scalar(Image image, float x, float y, float z, Emote_Instance *instances);
+
+// Lays out `wall` by `wall` copies of the emote on the XY plane, `layers`
+// deep along Z, spreading the emotes across `pool` when it is not NULL.
+// `instances` must hold wall * wall * layers * emote_instances_capacity(image)
+// instances. `extent` receives the size of the wall in voxels.
+size_t emote_build_wall(Pool *pool, Image image, size_t wall, size_t layers,
+                        Emote_Instance *instances, float extent[V3_COMPS]);
+
+// Boxes covering the opaque rectangles of at least EMOTE_OCCLUDER_MIN_AREA
+// pixels of every emote of the same wall, through all of its layers.
+// `occluders` must hold wall * wall * emote_instances_capacity(image)
+// boxes. Returns the amount of boxes, 0 when out of memory.
+size_t emote_build_occluders(Image image, size_t wall, size_t layers, Aabb *occluders);
+
+// Bounds of emote `index` of the wall through all of its layers
+void emote_wall_bounds(Image image, size_t wall, size_t layers, size_t index, Aabb *bounds);
+
+// Instances a single emote with all of its layers produces at most at `level`
+size_t emote_lod_capacity(Image image, size_t layers, size_t level);
+
+// Lays out the wall at `level` of detail: a cube for every block that is
+// at least half opaque, colored with the average of its opaque pixels.
+// Unlike in emote_build_wall() all of the layers of an emote are next to
+// each other, so emote `i` owns the instances [i * n, (i + 1) * n) for n
+// the result over wall * wall. `instances` must hold wall * wall *
+// emote_lod_capacity() instances. The positions are the min corners.
+size_t emote_build_lod(Image image, size_t wall, size_t layers, size_t level, Emote_Instance *instances);
+
+#endif // EMOTE_H_
@@ -20,6 +20,12 @@ V4 v4_scale(V4 a, float s)
     return a;
 }
 
+const size_t cube_face_pairs[CUBE_FACE_PAIRS][V3_COMPS] = {
+    {X, Y, Z},
+    {Z, Y, X},
+    {X, Z, Y}
+};
+
 void generate_cube_mesh(V4 mesh[TRIS_PER_CUBE][TRI_VERTICES],
                         RGBA colors[TRIS_PER_CUBE][TRI_VERTICES],
                         V2 uvs[TRIS_PER_CUBE][TRI_VERTICES],
@@ -33,20 +39,14 @@ void generate_cube_mesh(V4 mesh[TRIS_PER_CUBE][TRI_VERTICES],
         {PURPLE, CYAN},
     };
 
-    static const size_t face_pairs[CUBE_FACE_PAIRS][V3_COMPS] = {
-        {X, Y, Z},
-        {Z, Y, X},
-        {X, Z, Y}
-    };
-
     for (size_t face_pair_index = 0; face_pair_index < CUBE_FACE_PAIRS; ++face_pair_index) {
         for (size_t pair_comp_index = 0; pair_comp_index < PAIR_COMPS; ++pair_comp_index) {
             for (size_t tri = 0; tri < TRIS_PER_FACE; ++tri) {
                 for (size_t vert = 0; vert < TRI_VERTICES; ++vert) {
                     const size_t strip_index = tri + vert;
-                    const size_t A = face_pairs[face_pair_index][0];
-                    const size_t B = face_pairs[face_pair_index][1];
-                    const size_t C = face_pairs[face_pair_index][2];
+                    const size_t A = cube_face_pairs[face_pair_index][0];
+                    const size_t B = cube_face_pairs[face_pair_index][1];
+                    const size_t C = cube_face_pairs[face_pair_index][2];
 
                     // Mesh
                     {
@@ -123,6 +123,45 @@ Mat4 mat4_mult_mat4(Mat4 m1, Mat4 m2)
     return result;
 }
 
+// Gauss-Jordan elimination with partial pivoting. A singular `mat` gives
+// a matrix of infinities and NaNs.
+Mat4 mat4_inverse(Mat4 mat)
+{
+    Mat4 result = mat4_id();
+
+    for (int col = 0; col < V4_COMPS; ++col) {
+        int pivot = col;
+        for (int row = col + 1; row < V4_COMPS; ++row) {
+            if (fabsf(mat.vs[row][col]) > fabsf(mat.vs[pivot][col])) pivot = row;
+        }
+        for (int t = 0; t < V4_COMPS; ++t) {
+            float x = mat.vs[col][t];
+            mat.vs[col][t] = mat.vs[pivot][t];
+            mat.vs[pivot][t] = x;
+            x = result.vs[col][t];
+            result.vs[col][t] = result.vs[pivot][t];
+            result.vs[pivot][t] = x;
+        }
+
+        const float scale = 1.0f / mat.vs[col][col];
+        for (int t = 0; t < V4_COMPS; ++t) {
+            mat.vs[col][t] *= scale;
+            result.vs[col][t] *= scale;
+        }
+
+        for (int row = 0; row < V4_COMPS; ++row) {
+            if (row == col) continue;
+            const float factor = mat.vs[row][col];
+            for (int t = 0; t < V4_COMPS; ++t) {
+                mat.vs[row][t] -= factor * mat.vs[col][t];
+                result.vs[row][t] -= factor * result.vs[col][t];
+            }
+        }
+    }
+
+    return result;
+}
+
 Mat4 mat4_translate(float x, float y, float z)
 {
     return (Mat4) {
@@ -185,3 +224,31 @@ Mat4 mat4_perspective(float fovy, float aspect, float near, float far)
     result.vs[3][2] = -(far * near) / (far - near);
     return result;
 }
+
+// Gribb & Hartmann, "Fast Extraction of Viewing Frustum Planes from the
+// World-View-Projection Matrix". A clip space point is visible when
+// -w <= x, y, z <= w, and every one of these inequalities is a plane made of
+// the rows of the matrix.
+Frustum frustum_from_mat4(Mat4 mat)
+{
+    Frustum frustum = {0};
+    for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+        for (size_t side = 0; side < PAIR_COMPS; ++side) {
+            const float sign = side == 0 ? 1.0f : -1.0f;
+            V4 *plane = &frustum.planes[axis * PAIR_COMPS + side];
+            for (size_t col = 0; col < V4_COMPS; ++col) {
+                plane->cs[col] = mat.vs[W][col] + sign * mat.vs[axis][col];
+            }
+
+            const float length = sqrtf(plane->cs[X] * plane->cs[X] +
+                                       plane->cs[Y] * plane->cs[Y] +
+                                       plane->cs[Z] * plane->cs[Z]);
+            if (length > 0.0f) {
+                for (size_t col = 0; col < V4_COMPS; ++col) {
+                    plane->cs[col] /= length;
+                }
+            }
+        }
+    }
+    return frustum;
+}
@@ -1,6 +1,8 @@
 #ifndef GEO_H_
 #define GEO_H_
 
+#include <stddef.h>
+
 #include "./rgba.h"
 
 #define MY_PI 3.14159265359f
@@ -40,17 +42,29 @@ V4 v4_scale(V4 a, float s);
 #define TRIS_PER_FACE 2
 #define TRIS_PER_CUBE (CUBE_FACES * TRIS_PER_FACE)
 
+// Axes of every pair of opposite cube faces: the face spans the first two,
+// the last one is the axis of its normal
+extern const size_t cube_face_pairs[CUBE_FACE_PAIRS][V3_COMPS];
+
 void generate_cube_mesh(V4 mesh[TRIS_PER_CUBE][TRI_VERTICES],
                         RGBA colors[TRIS_PER_CUBE][TRI_VERTICES],
                         V2 uvs[TRIS_PER_CUBE][TRI_VERTICES],
                         V4 normals[TRIS_PER_CUBE][TRI_VERTICES]);
 
+// The attributes of the cube as they are uploaded to the GPU
+typedef struct {
+    V4 mesh[TRIS_PER_CUBE][TRI_VERTICES];
+    V2 uvs[TRIS_PER_CUBE][TRI_VERTICES];
+    V4 normals[TRIS_PER_CUBE][TRI_VERTICES];
+} Cube_Mesh;
+
 typedef struct {
     float vs[V4_COMPS][V4_COMPS];
 } Mat4;
 
 V4 mat4_mult_v4(Mat4 mat, V4 vec);
 Mat4 mat4_mult_mat4(Mat4 m1, Mat4 m2);
+Mat4 mat4_inverse(Mat4 mat);
 
 Mat4 mat4_id(void);
 Mat4 mat4_translate(float x, float y, float z);
@@ -59,4 +73,22 @@ Mat4 mat4_rotate_y(float angle);
 Mat4 mat4_rotate_z(float angle);
 Mat4 mat4_perspective(float fovy, float aspect, float near, float far);
 
+typedef struct {
+    float min[V3_COMPS];
+    float max[V3_COMPS];
+} Aabb;
+
+#define FRUSTUM_PLANES 6
+
+// Planes (a, b, c, d) with normalized (a, b, c) pointing inside, so a point
+// is inside of a plane when a*x + b*y + c*z + d >= 0
+typedef struct {
+    V4 planes[FRUSTUM_PLANES];
+} Frustum;
+
+// Extracts the clipping planes of `mat` in the space it transforms from.
+// Passing projection * view gives world space planes, adding the model
+// matrix gives them in model space.
+Frustum frustum_from_mat4(Mat4 mat);
+
 #endif // GEO_H_
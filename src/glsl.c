@@ -0,0 +1,270 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#include "./hash.h"
+#include "./glsl.h"
+
+typedef struct {
+    Region *region;
+    Glsl_Load load;
+    void *arg;
+    const String_View *defines;
+    size_t defines_count;
+
+    Glsl_Source *source;
+    String_View pieces[GLSL_MAX_PIECES];
+    size_t pieces_count;
+    bool defines_emitted;
+    const char *error;
+} Glsl_Expander;
+
+static uint64_t glsl_hash_defines(const String_View *defines, size_t defines_count)
+{
+    uint64_t hash = hash_bytes(NULL, 0);
+    for (size_t i = 0; i < defines_count; ++i) {
+        hash = hash_combine(hash, defines[i].data, defines[i].count);
+        hash = hash_combine(hash, "\n", 1);
+    }
+    return hash;
+}
+
+static uint64_t glsl_hash_file(uint64_t hash, const char *file_path, String_View content)
+{
+    // The path goes in too, so moving code between files is a change
+    hash = hash_combine(hash, file_path, strlen(file_path) + 1);
+    return hash_combine(hash, content.data, content.count);
+}
+
+static void glsl_fail(Glsl_Expander *e, const char *format, const char *a, const char *b)
+{
+    if (e->error != NULL) return;
+    const size_t n = strlen(format) + strlen(a) + strlen(b) + 1;
+    char *error = region_malloc(e->region, n);
+    if (error != NULL) snprintf(error, n, format, a, b);
+    e->error = error != NULL ? error : "out of memory";
+}
+
+static bool glsl_emit(Glsl_Expander *e, String_View piece)
+{
+    if (piece.count == 0) return true;
+    if (e->pieces_count >= GLSL_MAX_PIECES) {
+        e->error = "too many includes";
+        return false;
+    }
+    e->pieces[e->pieces_count++] = piece;
+    return true;
+}
+
+// The leading newline ends the previous line in case the file did not
+static bool glsl_emit_line(Glsl_Expander *e, size_t line, size_t file)
+{
+    char buffer[64];
+    const int n = snprintf(buffer, sizeof(buffer), "\n#line %zu %zu\n", line, file);
+    char *directive = region_malloc(e->region, (size_t) n);
+    if (directive == NULL) {
+        e->error = "out of memory";
+        return false;
+    }
+    memcpy(directive, buffer, (size_t) n);
+    return glsl_emit(e, (String_View) {.count = (size_t) n, .data = directive});
+}
+
+static bool glsl_emit_defines(Glsl_Expander *e)
+{
+    e->defines_emitted = true;
+    for (size_t i = 0; i < e->defines_count; ++i) {
+        if (!glsl_emit(e, SV("#define ")) ||
+                !glsl_emit(e, e->defines[i]) ||
+                !glsl_emit(e, SV("\n"))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Next to `including`, unless `name` is absolute
+static const char *glsl_include_path(Region *region, const char *including, String_View name)
+{
+    size_t dir_count = 0;
+    if (name.count == 0 || name.data[0] != '/') {
+        const char *slash = strrchr(including, '/');
+        if (slash != NULL) dir_count = (size_t) (slash - including) + 1;
+    }
+
+    char *path = region_malloc(region, dir_count + name.count + 1);
+    if (path == NULL) return NULL;
+    memcpy(path, including, dir_count);
+    memcpy(path + dir_count, name.data, name.count);
+    path[dir_count + name.count] = '\0';
+    return path;
+}
+
+static String_View glsl_directive(String_View line)
+{
+    String_View directive = sv_trim_left(line);
+    if (directive.count == 0 || directive.data[0] != '#') return SV_NULL;
+    sv_chop_left(&directive, 1);
+    return sv_trim_left(directive);
+}
+
+static bool glsl_has_version(String_View content)
+{
+    while (content.count > 0) {
+        if (sv_starts_with(glsl_directive(sv_chop_by_delim(&content, '\n')), SV("version"))) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool glsl_expand_file(Glsl_Expander *e, size_t file, String_View content)
+{
+    const char *file_path = e->source->files[file];
+    const char *segment = content.data;
+
+    for (size_t line_number = 1; content.count > 0; ++line_number) {
+        const char *line_begin = content.data;
+        String_View directive = glsl_directive(sv_chop_by_delim(&content, '\n'));
+        if (directive.count == 0) continue;
+
+        if (file == 0 && !e->defines_emitted && sv_starts_with(directive, SV("version"))) {
+            // Everything up to and including #version stays where it is
+            if (!glsl_emit(e, (String_View) {.count = (size_t) (content.data - segment), .data = segment}) ||
+                    !glsl_emit(e, SV("\n")) ||
+                    !glsl_emit_defines(e) ||
+                    !glsl_emit_line(e, line_number + 1, file)) {
+                return false;
+            }
+            segment = content.data;
+            continue;
+        }
+
+        if (!sv_starts_with(directive, SV("include"))) continue;
+
+        sv_chop_left(&directive, SV("include").count);
+        directive = sv_trim(directive);
+        if (directive.count < 2 || directive.data[0] != '"' || directive.data[directive.count - 1] != '"') {
+            glsl_fail(e, "%s: %s", file_path, "expected `#include \"file\"`");
+            return false;
+        }
+        const String_View name = {.count = directive.count - 2, .data = directive.data + 1};
+
+        if (!glsl_emit(e, (String_View) {.count = (size_t) (line_begin - segment), .data = segment})) {
+            return false;
+        }
+        segment = content.data;
+
+        const char *include_path = glsl_include_path(e->region, file_path, name);
+        if (include_path == NULL) {
+            e->error = "out of memory";
+            return false;
+        }
+
+        bool included = false;
+        for (size_t i = 0; i < e->source->files_count; ++i) {
+            included = included || strcmp(e->source->files[i], include_path) == 0;
+        }
+        if (!included) {
+            if (e->source->files_count >= GLSL_MAX_FILES) {
+                e->error = "too many included files";
+                return false;
+            }
+            const size_t include = e->source->files_count++;
+            e->source->files[include] = include_path;
+
+            String_View include_content = {0};
+            if (!e->load(e->arg, e->region, include_path, &include_content)) {
+                glsl_fail(e, "could not read file %s: %s", include_path, strerror(errno));
+                return false;
+            }
+            e->source->hash = glsl_hash_file(e->source->hash, include_path, include_content);
+
+            if (!glsl_emit_line(e, 1, include) ||
+                    !glsl_expand_file(e, include, include_content)) {
+                return false;
+            }
+        }
+        if (!glsl_emit_line(e, line_number + 1, file)) return false;
+    }
+
+    return glsl_emit(e, (String_View) {
+        .count = (size_t) (content.data - segment),
+        .data = segment,
+    });
+}
+
+bool glsl_expand(Region *region, const char *file_path,
+                 const String_View *defines, size_t defines_count,
+                 Glsl_Load load, void *arg,
+                 Glsl_Source *source, const char **error)
+{
+    memset(source, 0, sizeof(*source));
+    source->files[source->files_count++] = file_path;
+    source->hash = glsl_hash_defines(defines, defines_count);
+
+    Glsl_Expander *e = region_malloc(region, sizeof(*e));
+    if (e == NULL) {
+        *error = "out of memory";
+        return false;
+    }
+    memset(e, 0, sizeof(*e));
+    e->region = region;
+    e->load = load;
+    e->arg = arg;
+    e->defines = defines;
+    e->defines_count = defines_count;
+    e->source = source;
+
+    String_View content = {0};
+    if (!load(arg, region, file_path, &content)) {
+        glsl_fail(e, "could not read file %s: %s", file_path, strerror(errno));
+        *error = e->error;
+        return false;
+    }
+    source->hash = glsl_hash_file(source->hash, file_path, content);
+
+    // Without #version the defines go first
+    if (!glsl_has_version(content) && defines_count > 0 &&
+            (!glsl_emit_defines(e) || !glsl_emit_line(e, 1, 0))) {
+        *error = e->error;
+        return false;
+    }
+    if (!glsl_expand_file(e, 0, content)) {
+        *error = e->error;
+        return false;
+    }
+
+    size_t size = 0;
+    for (size_t i = 0; i < e->pieces_count; ++i) {
+        size += e->pieces[i].count;
+    }
+    char *result = region_malloc(region, size + 1);
+    if (result == NULL) {
+        *error = "out of memory";
+        return false;
+    }
+    size_t offset = 0;
+    for (size_t i = 0; i < e->pieces_count; ++i) {
+        memcpy(result + offset, e->pieces[i].data, e->pieces[i].count);
+        offset += e->pieces[i].count;
+    }
+    result[size] = '\0';
+
+    source->source = result;
+    source->source_size = size;
+    return true;
+}
+
+bool glsl_hash_files(Region *region, const char *const *files, size_t files_count,
+                     const String_View *defines, size_t defines_count,
+                     Glsl_Load load, void *arg, uint64_t *hash)
+{
+    *hash = glsl_hash_defines(defines, defines_count);
+    for (size_t i = 0; i < files_count; ++i) {
+        String_View content = {0};
+        if (!load(arg, region, files[i], &content)) return false;
+        *hash = glsl_hash_file(*hash, files[i], content);
+    }
+    return true;
+}
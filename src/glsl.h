@@ -0,0 +1,55 @@
+#ifndef GLSL_H_
+#define GLSL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "./sv.h"
+#include "./region.h"
+
+// Preprocessor for the shaders, on top of the one of the GLSL compiler:
+//   - `#include "file"` is replaced by the file, which is looked up next to
+//     the file that includes it. Every file is included once per shader no
+//     matter how many times it is asked for, so the includes need no guards
+//     and cannot loop.
+//   - the defines (`NAME` or `NAME VALUE`) go right after `#version`
+//   - `#line` directives number the files in the order they were met, so
+//     `2:14(3): error` in a compile log is line 14 of files[2]
+// The directives are recognized at the beginning of a line only, comments
+// are not parsed.
+
+#define GLSL_MAX_FILES 32
+#define GLSL_MAX_PIECES 256
+
+// Reads `file_path` into `region`. Returns false and sets errno on failure.
+typedef bool (*Glsl_Load)(void *arg, Region *region, const char *file_path, String_View *content);
+
+typedef struct {
+    // The root first, then the included files. Live in the region.
+    const char *files[GLSL_MAX_FILES];
+    size_t files_count;
+    // Of the defines and of the paths and contents of all the files
+    uint64_t hash;
+
+    // Zero terminated
+    const char *source;
+    size_t source_size;
+} Glsl_Source;
+
+// Everything, the sources of the files and the expanded one, is allocated
+// from `region`. On failure `error` lives in the region as well, and the
+// files met so far are still listed, the missing one included.
+bool glsl_expand(Region *region, const char *file_path,
+                 const String_View *defines, size_t defines_count,
+                 Glsl_Load load, void *arg,
+                 Glsl_Source *source, const char **error);
+
+// The hash glsl_expand() would compute for the same files and defines,
+// without expanding anything. Unchanged files give an unchanged hash, and
+// any change in the includes changes one of the files, so it is enough to
+// tell whether the last expansion is still up to date.
+bool glsl_hash_files(Region *region, const char *const *files, size_t files_count,
+                     const String_View *defines, size_t defines_count,
+                     Glsl_Load load, void *arg, uint64_t *hash);
+
+#endif // GLSL_H_
@@ -0,0 +1,19 @@
+#include "./hash.h"
+
+#define FNV1A_OFFSET_BASIS 0xcbf29ce484222325ULL
+#define FNV1A_PRIME        0x100000001b3ULL
+
+uint64_t hash_combine(uint64_t hash, const void *data, size_t size)
+{
+    const uint8_t *bytes = data;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= FNV1A_PRIME;
+    }
+    return hash;
+}
+
+uint64_t hash_bytes(const void *data, size_t size)
+{
+    return hash_combine(FNV1A_OFFSET_BASIS, data, size);
+}
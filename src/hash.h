@@ -0,0 +1,15 @@
+#ifndef HASH_H_
+#define HASH_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#define HASH_Fmt "%016llx"
+#define HASH_Arg(hash) (unsigned long long) (hash)
+
+// 64-bit FNV-1a. Not cryptographic, only used for content addressing
+// of cached assets.
+uint64_t hash_bytes(const void *data, size_t size);
+uint64_t hash_combine(uint64_t hash, const void *data, size_t size);
+
+#endif // HASH_H_
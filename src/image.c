@@ -0,0 +1,364 @@
+#include <string.h>
+
+#include "./image.h"
+
+#if defined(_MSC_VER)
+#define IMAGE_THREAD_LOCAL __declspec(thread)
+#else
+#define IMAGE_THREAD_LOCAL _Thread_local
+#endif
+
+// Images are decoded concurrently by the preloader, each thread into its
+// own region
+static IMAGE_THREAD_LOCAL Region *stbi_region = NULL;
+
+#define STBI_MALLOC(size) region_malloc(stbi_region, size)
+#define STBI_FREE(ignored) do {(void)ignored;} while(0)
+#define STBI_REALLOC_SIZED(ptr, oldsz, newsz) \
+    region_realloc(stbi_region, ptr, oldsz, newsz)
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "./stb_image.h"
+
+static IMAGE_THREAD_LOCAL const char *failure_reason = NULL;
+
+#define FAIL(reason) \
+    do { \
+        failure_reason = (reason); \
+        return false; \
+    } while (0)
+
+const char *image_failure_reason(void)
+{
+    return failure_reason;
+}
+
+static const char *const image_format_names[COUNT_IMAGE_FORMATS] = {
+    [IMAGE_FORMAT_PNG] = "png",
+    [IMAGE_FORMAT_QOI] = "qoi",
+    [IMAGE_FORMAT_RAW] = "kraw",
+};
+
+static const char *const image_format_extensions[COUNT_IMAGE_FORMATS] = {
+    [IMAGE_FORMAT_PNG] = ".png",
+    [IMAGE_FORMAT_QOI] = ".qoi",
+    [IMAGE_FORMAT_RAW] = ".kraw",
+};
+
+const char *image_format_name(Image_Format format)
+{
+    return image_format_names[format];
+}
+
+const char *image_format_extension(Image_Format format)
+{
+    return image_format_extensions[format];
+}
+
+Image_Format image_format_by_file_path(const char *file_path)
+{
+    const String_View sv = sv_from_cstr(file_path);
+    for (Image_Format format = 0; format < COUNT_IMAGE_FORMATS; ++format) {
+        if (sv_ends_with(sv, sv_from_cstr(image_format_extensions[format]))) {
+            return format;
+        }
+    }
+    // stb_image sniffs the actual format from the content
+    return IMAGE_FORMAT_PNG;
+}
+
+static uint32_t read_u32_be(const uint8_t *bytes)
+{
+    return (uint32_t) bytes[0] << 24 |
+           (uint32_t) bytes[1] << 16 |
+           (uint32_t) bytes[2] << 8 |
+           (uint32_t) bytes[3];
+}
+
+static void write_u32_be(uint8_t *bytes, uint32_t x)
+{
+    bytes[0] = (x >> 24) & 0xFF;
+    bytes[1] = (x >> 16) & 0xFF;
+    bytes[2] = (x >> 8) & 0xFF;
+    bytes[3] = x & 0xFF;
+}
+
+// QOI begin
+
+#define QOI_MAGIC "qoif"
+#define QOI_HEADER_SIZE 14
+#define QOI_PIXELS_MAX 400000000u
+#define QOI_INDEX_SIZE 64
+
+#define QOI_OP_INDEX 0x00
+#define QOI_OP_DIFF  0x40
+#define QOI_OP_LUMA  0x80
+#define QOI_OP_RUN   0xc0
+#define QOI_OP_RGB   0xfe
+#define QOI_OP_RGBA  0xff
+#define QOI_MASK_2   0xc0
+
+static const uint8_t qoi_padding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+
+static size_t qoi_hash(const uint8_t px[IMAGE_COMPS])
+{
+    return (px[0] * 3 + px[1] * 5 + px[2] * 7 + px[3] * 11) % QOI_INDEX_SIZE;
+}
+
+static bool qoi_decode(Region *region, const uint8_t *bytes, size_t size, Image *image)
+{
+    if (size < QOI_HEADER_SIZE + sizeof(qoi_padding)) FAIL("not enough data for QOI header");
+    if (memcmp(bytes, QOI_MAGIC, 4) != 0) FAIL("invalid QOI magic");
+
+    const uint32_t width = read_u32_be(bytes + 4);
+    const uint32_t height = read_u32_be(bytes + 8);
+    const uint8_t channels = bytes[12];
+    const uint8_t colorspace = bytes[13];
+    if (width == 0 || height == 0 ||
+            channels < 3 || channels > 4 ||
+            colorspace > 1 ||
+            height >= QOI_PIXELS_MAX / width) {
+        FAIL("invalid QOI header");
+    }
+
+    const size_t pixels_size = (size_t) width * height * IMAGE_COMPS;
+    uint8_t *pixels = region_malloc(region, pixels_size);
+    if (pixels == NULL) FAIL("out of memory");
+
+    uint8_t index[QOI_INDEX_SIZE][IMAGE_COMPS] = {0};
+    uint8_t px[IMAGE_COMPS] = {0, 0, 0, 255};
+    const size_t chunks_end = size - sizeof(qoi_padding);
+    size_t p = QOI_HEADER_SIZE;
+    size_t run = 0;
+
+    for (size_t px_pos = 0; px_pos < pixels_size; px_pos += IMAGE_COMPS) {
+        if (run > 0) {
+            run -= 1;
+        } else if (p < chunks_end) {
+            const uint8_t b1 = bytes[p++];
+
+            if (b1 == QOI_OP_RGB) {
+                px[0] = bytes[p++];
+                px[1] = bytes[p++];
+                px[2] = bytes[p++];
+            } else if (b1 == QOI_OP_RGBA) {
+                px[0] = bytes[p++];
+                px[1] = bytes[p++];
+                px[2] = bytes[p++];
+                px[3] = bytes[p++];
+            } else if ((b1 & QOI_MASK_2) == QOI_OP_INDEX) {
+                memcpy(px, index[b1], IMAGE_COMPS);
+            } else if ((b1 & QOI_MASK_2) == QOI_OP_DIFF) {
+                px[0] += ((b1 >> 4) & 0x03) - 2;
+                px[1] += ((b1 >> 2) & 0x03) - 2;
+                px[2] += ( b1       & 0x03) - 2;
+            } else if ((b1 & QOI_MASK_2) == QOI_OP_LUMA) {
+                const uint8_t b2 = bytes[p++];
+                const int vg = (b1 & 0x3f) - 32;
+                px[0] += vg - 8 + ((b2 >> 4) & 0x0f);
+                px[1] += vg;
+                px[2] += vg - 8 +  (b2       & 0x0f);
+            } else if ((b1 & QOI_MASK_2) == QOI_OP_RUN) {
+                run = b1 & 0x3f;
+            }
+
+            memcpy(index[qoi_hash(px)], px, IMAGE_COMPS);
+        }
+
+        memcpy(pixels + px_pos, px, IMAGE_COMPS);
+    }
+
+    image->width = width;
+    image->height = height;
+    image->pixels = pixels;
+    return true;
+}
+
+static bool qoi_encode(Region *region, Image image, uint8_t **data, size_t *size)
+{
+    const size_t pixels_count = (size_t) image.width * image.height;
+    const size_t max_size =
+        QOI_HEADER_SIZE + pixels_count * (IMAGE_COMPS + 1) + sizeof(qoi_padding);
+    uint8_t *bytes = region_malloc(region, max_size);
+    if (bytes == NULL) FAIL("out of memory");
+
+    size_t p = 0;
+    memcpy(bytes, QOI_MAGIC, 4);
+    write_u32_be(bytes + 4, image.width);
+    write_u32_be(bytes + 8, image.height);
+    bytes[12] = IMAGE_COMPS;
+    bytes[13] = 0;
+    p += QOI_HEADER_SIZE;
+
+    uint8_t index[QOI_INDEX_SIZE][IMAGE_COMPS] = {0};
+    uint8_t px_prev[IMAGE_COMPS] = {0, 0, 0, 255};
+    size_t run = 0;
+
+    for (size_t i = 0; i < pixels_count; ++i) {
+        const uint8_t *px = image.pixels + i * IMAGE_COMPS;
+
+        if (memcmp(px, px_prev, IMAGE_COMPS) == 0) {
+            run += 1;
+            if (run == 62 || i + 1 == pixels_count) {
+                bytes[p++] = QOI_OP_RUN | (uint8_t) (run - 1);
+                run = 0;
+            }
+            continue;
+        }
+
+        if (run > 0) {
+            bytes[p++] = QOI_OP_RUN | (uint8_t) (run - 1);
+            run = 0;
+        }
+
+        const size_t index_pos = qoi_hash(px);
+        if (memcmp(index[index_pos], px, IMAGE_COMPS) == 0) {
+            bytes[p++] = QOI_OP_INDEX | (uint8_t) index_pos;
+        } else {
+            memcpy(index[index_pos], px, IMAGE_COMPS);
+
+            if (px[3] == px_prev[3]) {
+                const int8_t vr = (int8_t) (px[0] - px_prev[0]);
+                const int8_t vg = (int8_t) (px[1] - px_prev[1]);
+                const int8_t vb = (int8_t) (px[2] - px_prev[2]);
+                const int8_t vg_r = (int8_t) (vr - vg);
+                const int8_t vg_b = (int8_t) (vb - vg);
+
+                if (vr > -3 && vr < 2 &&
+                        vg > -3 && vg < 2 &&
+                        vb > -3 && vb < 2) {
+                    bytes[p++] = QOI_OP_DIFF | (uint8_t) ((vr + 2) << 4 | (vg + 2) << 2 | (vb + 2));
+                } else if (vg_r > -9 && vg_r < 8 &&
+                           vg > -33 && vg < 32 &&
+                           vg_b > -9 && vg_b < 8) {
+                    bytes[p++] = QOI_OP_LUMA | (uint8_t) (vg + 32);
+                    bytes[p++] = (uint8_t) ((vg_r + 8) << 4 | (vg_b + 8));
+                } else {
+                    bytes[p++] = QOI_OP_RGB;
+                    bytes[p++] = px[0];
+                    bytes[p++] = px[1];
+                    bytes[p++] = px[2];
+                }
+            } else {
+                bytes[p++] = QOI_OP_RGBA;
+                memcpy(bytes + p, px, IMAGE_COMPS);
+                p += IMAGE_COMPS;
+            }
+        }
+
+        memcpy(px_prev, px, IMAGE_COMPS);
+    }
+
+    memcpy(bytes + p, qoi_padding, sizeof(qoi_padding));
+    p += sizeof(qoi_padding);
+
+    *data = bytes;
+    *size = p;
+    return true;
+}
+
+// QOI end
+
+// RAW begin
+
+#define RAW_MAGIC "KRAW"
+
+typedef struct {
+    char magic[4];
+    uint32_t width;
+    uint32_t height;
+    uint32_t pixels_offset;
+} Raw_Image_Header;
+
+static bool raw_decode(const uint8_t *bytes, size_t size, Image *image)
+{
+    Raw_Image_Header header;
+    if (size < sizeof(header)) FAIL("not enough data for KRAW header");
+    memcpy(&header, bytes, sizeof(header));
+
+    if (memcmp(header.magic, RAW_MAGIC, sizeof(header.magic)) != 0) FAIL("invalid KRAW magic");
+    if (header.width == 0 || header.height == 0 ||
+            header.pixels_offset < sizeof(header) ||
+            header.pixels_offset > size) {
+        FAIL("invalid KRAW header");
+    }
+
+    const size_t pixels_size = (size_t) header.width * header.height * IMAGE_COMPS;
+    if (pixels_size / IMAGE_COMPS / header.width != header.height ||
+            size - header.pixels_offset < pixels_size) {
+        FAIL("KRAW pixels are truncated");
+    }
+
+    image->width = header.width;
+    image->height = header.height;
+    image->pixels = bytes + header.pixels_offset;
+    return true;
+}
+
+static bool raw_encode(Region *region, Image image, uint8_t **data, size_t *size)
+{
+    const size_t pixels_size = (size_t) image.width * image.height * IMAGE_COMPS;
+    const Raw_Image_Header header = {
+        .magic = RAW_MAGIC,
+        .width = image.width,
+        .height = image.height,
+        .pixels_offset = sizeof(Raw_Image_Header),
+    };
+
+    uint8_t *bytes = region_malloc(region, sizeof(header) + pixels_size);
+    if (bytes == NULL) FAIL("out of memory");
+    memcpy(bytes, &header, sizeof(header));
+    memcpy(bytes + sizeof(header), image.pixels, pixels_size);
+
+    *data = bytes;
+    *size = sizeof(header) + pixels_size;
+    return true;
+}
+
+// RAW end
+
+bool image_decode(Region *region, Image_Format format,
+                  const void *data, size_t size,
+                  Image *image)
+{
+    switch (format) {
+    case IMAGE_FORMAT_QOI:
+        return qoi_decode(region, data, size, image);
+
+    case IMAGE_FORMAT_RAW:
+        return raw_decode(data, size, image);
+
+    case IMAGE_FORMAT_PNG:
+    case COUNT_IMAGE_FORMATS:
+    default: {
+        int w, h;
+        stbi_region = region;
+        const stbi_uc *pixels = stbi_load_from_memory(data, (int) size, &w, &h, NULL, IMAGE_COMPS);
+        stbi_region = NULL;
+        if (pixels == NULL) FAIL(stbi_failure_reason());
+
+        image->width = (uint32_t) w;
+        image->height = (uint32_t) h;
+        image->pixels = pixels;
+        return true;
+    }
+    }
+}
+
+bool image_encode(Region *region, Image_Format format,
+                  Image image,
+                  uint8_t **data, size_t *size)
+{
+    switch (format) {
+    case IMAGE_FORMAT_QOI:
+        return qoi_encode(region, image, data, size);
+
+    case IMAGE_FORMAT_RAW:
+        return raw_encode(region, image, data, size);
+
+    case IMAGE_FORMAT_PNG:
+    case COUNT_IMAGE_FORMATS:
+    default:
+        FAIL("encoding of this format is not supported");
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef IMAGE_H_
+#define IMAGE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "./region.h"
+
+// Texture source images. The format is picked by the extension of the
+// file:
+//   .qoi  - The Quite OK Image format https://qoiformat.org/
+//   .kraw - 16 byte header followed by tightly packed RGBA8 pixels. Can be
+//           memory mapped and uploaded without any decoding
+//   anything else goes through stb_image (PNG, JPEG, BMP, ...)
+
+#define IMAGE_COMPS 4
+
+typedef enum {
+    IMAGE_FORMAT_PNG = 0,
+    IMAGE_FORMAT_QOI,
+    IMAGE_FORMAT_RAW,
+    COUNT_IMAGE_FORMATS,
+} Image_Format;
+
+typedef struct {
+    uint32_t width;
+    uint32_t height;
+    const uint8_t *pixels;
+} Image;
+
+const char *image_format_name(Image_Format format);
+const char *image_format_extension(Image_Format format);
+Image_Format image_format_by_file_path(const char *file_path);
+
+// Decoded pixels are allocated from `region`, except for IMAGE_FORMAT_RAW
+// where they point straight into `data`.
+bool image_decode(Region *region, Image_Format format,
+                  const void *data, size_t size,
+                  Image *image);
+// Only IMAGE_FORMAT_QOI and IMAGE_FORMAT_RAW can be encoded
+bool image_encode(Region *region, Image_Format format,
+                  Image image,
+                  uint8_t **data, size_t *size);
+// Human readable reason of the last image_decode()/image_encode() failure
+const char *image_failure_reason(void);
+
+#endif // IMAGE_H_
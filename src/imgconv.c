@@ -0,0 +1,115 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "./image.h"
+
+// Converts texture images into the fast path formats. The output is
+// written next to the input with the extension replaced:
+//   $ ./imgconv qoi images/*.png
+//   images/ayaya.png -> images/ayaya.qoi
+
+Region region;
+
+void usage(FILE *stream, const char *program)
+{
+    fprintf(stream, "Usage: %s <qoi|kraw> <image...>\n", program);
+}
+
+char *output_file_path(Region *region, const char *input_file_path, Image_Format format)
+{
+    String_View path = sv_from_cstr(input_file_path);
+    size_t dot = 0;
+    size_t slash = 0;
+    bool has_slash = false;
+    for (size_t i = 0; i < path.count; ++i) {
+        if (path.data[i] == '/' || path.data[i] == '\\') {
+            slash = i;
+            has_slash = true;
+        } else if (path.data[i] == '.') {
+            dot = i;
+        }
+    }
+    if (dot > 0 && (!has_slash || dot > slash + 1)) {
+        path.count = dot;
+    }
+
+    const char *ext = image_format_extension(format);
+    const size_t n = path.count + strlen(ext) + 1;
+    char *result = region_malloc(region, n);
+    if (result == NULL) return NULL;
+    snprintf(result, n, SV_Fmt"%s", SV_Arg(path), ext);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    const char *const program = argv[0];
+
+    if (argc < 3) {
+        usage(stderr, program);
+        fprintf(stderr, "ERROR: not enough arguments\n");
+        exit(1);
+    }
+
+    Image_Format format;
+    if (strcmp(argv[1], image_format_name(IMAGE_FORMAT_QOI)) == 0) {
+        format = IMAGE_FORMAT_QOI;
+    } else if (strcmp(argv[1], image_format_name(IMAGE_FORMAT_RAW)) == 0) {
+        format = IMAGE_FORMAT_RAW;
+    } else {
+        usage(stderr, program);
+        fprintf(stderr, "ERROR: unknown format `%s`\n", argv[1]);
+        exit(1);
+    }
+
+    int result = 0;
+    for (int i = 2; i < argc; ++i) {
+        const char *const input_file_path = argv[i];
+        region_clean(&region);
+
+        size_t size = 0;
+        const char *data = region_slurp_file_sized(&region, input_file_path, &size);
+        if (data == NULL) {
+            fprintf(stderr, "ERROR: could not read file %s: %s\n", input_file_path, strerror(errno));
+            result = 1;
+            continue;
+        }
+
+        Image image = {0};
+        if (!image_decode(&region, image_format_by_file_path(input_file_path), data, size, &image)) {
+            fprintf(stderr, "ERROR: could not decode file %s: %s\n", input_file_path, image_failure_reason());
+            result = 1;
+            continue;
+        }
+
+        uint8_t *output = NULL;
+        size_t output_size = 0;
+        if (!image_encode(&region, format, image, &output, &output_size)) {
+            fprintf(stderr, "ERROR: could not encode file %s: %s\n", input_file_path, image_failure_reason());
+            result = 1;
+            continue;
+        }
+
+        const char *output_path = output_file_path(&region, input_file_path, format);
+        if (output_path == NULL) {
+            fprintf(stderr, "ERROR: out of memory\n");
+            result = 1;
+            continue;
+        }
+
+        FILE *f = fopen(output_path, "wb");
+        if (f == NULL || fwrite(output, output_size, 1, f) != 1) {
+            fprintf(stderr, "ERROR: could not write file %s: %s\n", output_path, strerror(errno));
+            if (f) fclose(f);
+            result = 1;
+            continue;
+        }
+        fclose(f);
+
+        printf("%s -> %s (%zu bytes)\n", input_file_path, output_path, output_size);
+    }
+
+    return result;
+}
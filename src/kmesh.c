@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stddef.h>
+
+#include "./kmesh.h"
+
+static const char *const kmesh_attribute_names[COUNT_KMESH_ATTRIBUTES] = {
+    [KMESH_ATTRIBUTE_POSITION] = "position",
+    [KMESH_ATTRIBUTE_NORMAL]   = "normal",
+    [KMESH_ATTRIBUTE_UV]       = "uv",
+};
+
+const Kmesh_Attribute kmesh_mesh_vertex_attributes[KMESH_MESH_VERTEX_ATTRIBUTES] = {
+    {KMESH_ATTRIBUTE_POSITION, KMESH_TYPE_FLOAT32, V3_COMPS, offsetof(Mesh_Vertex, position)},
+    {KMESH_ATTRIBUTE_NORMAL,   KMESH_TYPE_FLOAT32, V3_COMPS, offsetof(Mesh_Vertex, normal)},
+    {KMESH_ATTRIBUTE_UV,       KMESH_TYPE_FLOAT32, V2_COMPS, offsetof(Mesh_Vertex, uv)},
+};
+
+static const size_t kmesh_type_sizes[COUNT_KMESH_TYPES] = {
+    [KMESH_TYPE_FLOAT32] = sizeof(float),
+};
+
+const char *kmesh_attribute_name(Kmesh_Attribute_Kind kind)
+{
+    if (kind >= COUNT_KMESH_ATTRIBUTES) return "unknown";
+    return kmesh_attribute_names[kind];
+}
+
+static size_t align_up(size_t x, size_t alignment)
+{
+    return (x + alignment - 1) / alignment * alignment;
+}
+
+#define KMESH_FAIL(reason) \
+    do { \
+        *error = (reason); \
+        kmesh_close(kmesh); \
+        return false; \
+    } while (0)
+
+// Nothing in here looks at the vertices or the indices, so a mesh of any
+// size is validated in constant time
+bool kmesh_view(const void *data, size_t size, Kmesh *kmesh, const char **error)
+{
+    memset(kmesh, 0, sizeof(*kmesh));
+    const uint8_t *bytes = data;
+
+    if (size < sizeof(Kmesh_Header)) KMESH_FAIL("not enough data for the header");
+    kmesh->header = (const Kmesh_Header*) bytes;
+    const Kmesh_Header *header = kmesh->header;
+
+    if (memcmp(header->magic, KMESH_MAGIC, sizeof(header->magic)) != 0) KMESH_FAIL("invalid magic");
+    if (header->version != KMESH_VERSION) KMESH_FAIL("unsupported version");
+    if (header->file_size != size) KMESH_FAIL("truncated file");
+    if (header->attributes_count > KMESH_MAX_ATTRIBUTES) KMESH_FAIL("too many attributes");
+    if (header->lods_count == 0 || header->lods_count > KMESH_MAX_LODS) KMESH_FAIL("invalid amount of levels");
+
+    const size_t tables_size = sizeof(Kmesh_Header) +
+        header->attributes_count * sizeof(Kmesh_Attribute) +
+        header->lods_count * sizeof(Kmesh_Lod);
+    if (tables_size > size) KMESH_FAIL("tables do not fit into the file");
+    kmesh->attributes = (const Kmesh_Attribute*) (bytes + sizeof(Kmesh_Header));
+    kmesh->lods = (const Kmesh_Lod*) (kmesh->attributes + header->attributes_count);
+
+    for (size_t i = 0; i < header->attributes_count; ++i) {
+        const Kmesh_Attribute *attribute = &kmesh->attributes[i];
+        if (attribute->kind >= COUNT_KMESH_ATTRIBUTES) KMESH_FAIL("unknown attribute");
+        if (attribute->type >= COUNT_KMESH_TYPES) KMESH_FAIL("unknown attribute type");
+        if (attribute->components == 0 || attribute->components > V4_COMPS ||
+                attribute->offset + attribute->components * kmesh_type_sizes[attribute->type] > header->vertex_size) {
+            KMESH_FAIL("attribute does not fit into the vertex");
+        }
+    }
+
+    if (header->vertices_offset % KMESH_ALIGNMENT != 0 ||
+            header->vertices_offset > size ||
+            header->vertex_size == 0 ||
+            header->vertices_count > (size - header->vertices_offset) / header->vertex_size) {
+        KMESH_FAIL("vertices are out of bounds");
+    }
+    kmesh->vertices = bytes + header->vertices_offset;
+
+    // The levels go one after another, so the readers can take all of the
+    // indices from the first level to the end of the last one in one piece
+    size_t lods_end = 0;
+    for (size_t i = 0; i < header->lods_count; ++i) {
+        const Kmesh_Lod *lod = &kmesh->lods[i];
+        if (lod->indices_offset % KMESH_ALIGNMENT != 0 ||
+                lod->indices_offset > size ||
+                lod->indices_count > (size - lod->indices_offset) / sizeof(uint32_t)) {
+            KMESH_FAIL("indices are out of bounds");
+        }
+        if (lod->indices_offset < lods_end) KMESH_FAIL("levels are out of order");
+        lods_end = lod->indices_offset + lod->indices_count * sizeof(uint32_t);
+    }
+
+    return true;
+}
+
+bool kmesh_open(const char *file_path, Kmesh *kmesh, const char **error)
+{
+    Mapped_File file = {0};
+    if (!mapped_file_open(file_path, &file)) {
+        memset(kmesh, 0, sizeof(*kmesh));
+        *error = strerror(errno);
+        return false;
+    }
+    mapped_file_will_need(&file);
+
+    if (!kmesh_view(file.data, file.size, kmesh, error)) {
+        mapped_file_close(&file);
+        return false;
+    }
+    kmesh->file = file;
+    return true;
+}
+
+void kmesh_close(Kmesh *kmesh)
+{
+    mapped_file_close(&kmesh->file);
+    memset(kmesh, 0, sizeof(*kmesh));
+}
+
+const uint32_t *kmesh_lod_indices(const Kmesh *kmesh, size_t lod)
+{
+    return (const uint32_t*) ((const uint8_t*) kmesh->header + kmesh->lods[lod].indices_offset);
+}
+
+static bool write_zeros(FILE *f, size_t n)
+{
+    static const uint8_t zeros[KMESH_ALIGNMENT] = {0};
+    while (n > 0) {
+        const size_t chunk = n < sizeof(zeros) ? n : sizeof(zeros);
+        if (fwrite(zeros, chunk, 1, f) != 1) return false;
+        n -= chunk;
+    }
+    return true;
+}
+
+bool kmesh_save(const char *file_path, const Mesh *mesh, const Kmesh_Lod_Source *lods, size_t lods_count,
+                uint32_t flags)
+{
+    if (lods_count + 1 > KMESH_MAX_LODS) {
+        errno = EINVAL;
+        return false;
+    }
+
+    const Kmesh_Attribute *attributes = kmesh_mesh_vertex_attributes;
+    const size_t attributes_count = KMESH_MESH_VERTEX_ATTRIBUTES;
+
+    // Level 0 is the mesh itself
+    Kmesh_Lod_Source sources[KMESH_MAX_LODS] = {
+        {mesh->indices, mesh->indices_count, 0.0f},
+    };
+    if (lods_count > 0) memcpy(&sources[1], lods, lods_count * sizeof(*lods));
+    const size_t levels = lods_count + 1;
+
+    Kmesh_Lod table[KMESH_MAX_LODS] = {0};
+    size_t offset = sizeof(Kmesh_Header) + attributes_count * sizeof(Kmesh_Attribute) + levels * sizeof(Kmesh_Lod);
+    const size_t vertices_offset = align_up(offset, KMESH_ALIGNMENT);
+    offset = vertices_offset + mesh->vertices_count * sizeof(Mesh_Vertex);
+    for (size_t i = 0; i < levels; ++i) {
+        offset = align_up(offset, KMESH_ALIGNMENT);
+        table[i].indices_offset = offset;
+        table[i].indices_count = sources[i].indices_count;
+        table[i].error = sources[i].error;
+        offset += sources[i].indices_count * sizeof(uint32_t);
+    }
+
+    Kmesh_Header header = {0};
+    memcpy(header.magic, KMESH_MAGIC, sizeof(header.magic));
+    header.version = KMESH_VERSION;
+    header.attributes_count = (uint32_t) attributes_count;
+    header.lods_count = (uint32_t) levels;
+    header.vertex_size = sizeof(Mesh_Vertex);
+    header.flags = flags;
+    header.vertices_count = mesh->vertices_count;
+    header.vertices_offset = vertices_offset;
+    header.file_size = offset;
+    memcpy(header.bounds_min, mesh->bounds.min, sizeof(header.bounds_min));
+    memcpy(header.bounds_max, mesh->bounds.max, sizeof(header.bounds_max));
+
+    FILE *f = fopen(file_path, "wb");
+    if (f == NULL) return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1 &&
+        fwrite(attributes, attributes_count * sizeof(*attributes), 1, f) == 1 &&
+        fwrite(table, levels * sizeof(*table), 1, f) == 1;
+
+    size_t written = sizeof(Kmesh_Header) + attributes_count * sizeof(Kmesh_Attribute) + levels * sizeof(Kmesh_Lod);
+    if (ok) ok = write_zeros(f, vertices_offset - written);
+    if (ok && mesh->vertices_count > 0) {
+        ok = fwrite(mesh->vertices, mesh->vertices_count * sizeof(Mesh_Vertex), 1, f) == 1;
+    }
+    written = vertices_offset + mesh->vertices_count * sizeof(Mesh_Vertex);
+    for (size_t i = 0; ok && i < levels; ++i) {
+        ok = write_zeros(f, table[i].indices_offset - written);
+        if (ok && sources[i].indices_count > 0) {
+            ok = fwrite(sources[i].indices, sources[i].indices_count * sizeof(uint32_t), 1, f) == 1;
+        }
+        written = table[i].indices_offset + sources[i].indices_count * sizeof(uint32_t);
+    }
+
+    const int saved_errno = errno;
+    if (fclose(f) != 0) ok = false;
+    errno = saved_errno;
+    return ok;
+}
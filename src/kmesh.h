@@ -0,0 +1,112 @@
+#ifndef KMESH_H_
+#define KMESH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "./mapped_file.h"
+#include "./mesh.h"
+
+// Binary mesh cache that is memory mapped and handed to glBufferData()
+// as is, without touching a single vertex:
+//
+//   Kmesh_Header
+//   Kmesh_Attribute[attributes_count]   layout of a vertex
+//   Kmesh_Lod[lods_count]               index ranges, level 0 first
+//   vertices                            aligned to KMESH_ALIGNMENT
+//   indices of every level              each aligned to KMESH_ALIGNMENT
+//
+// Like the packs, all the integers are in the native byte order of the
+// machine that wrote the file. `meshconv` makes them out of OBJ and PLY.
+
+#define KMESH_MAGIC "KMSH"
+#define KMESH_VERSION 1
+#define KMESH_ALIGNMENT 64
+#define KMESH_EXTENSION ".kmesh"
+#define KMESH_MAX_ATTRIBUTES 8
+#define KMESH_MAX_LODS 8
+
+// The triangles and the vertices are in the order of ./src/meshopt.h
+#define KMESH_FLAG_OPTIMIZED (1u << 0)
+
+typedef enum {
+    KMESH_ATTRIBUTE_POSITION = 0,
+    KMESH_ATTRIBUTE_NORMAL,
+    KMESH_ATTRIBUTE_UV,
+    COUNT_KMESH_ATTRIBUTES,
+} Kmesh_Attribute_Kind;
+
+typedef enum {
+    KMESH_TYPE_FLOAT32 = 0,
+    COUNT_KMESH_TYPES,
+} Kmesh_Type;
+
+typedef struct {
+    uint32_t kind;
+    uint32_t type;
+    uint32_t components;
+    // Bytes from the start of the vertex
+    uint32_t offset;
+} Kmesh_Attribute;
+
+typedef struct {
+    uint64_t indices_offset;
+    // uint32_t indices, three per triangle
+    uint64_t indices_count;
+    // Of the simplification that made the level, 0 for level 0
+    float error;
+    uint32_t reserved;
+} Kmesh_Lod;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t attributes_count;
+    uint32_t lods_count;
+    uint32_t vertex_size;
+    // KMESH_FLAG_*
+    uint32_t flags;
+    uint64_t vertices_count;
+    uint64_t vertices_offset;
+    uint64_t file_size;
+    float bounds_min[V3_COMPS];
+    float bounds_max[V3_COMPS];
+} Kmesh_Header;
+
+typedef struct {
+    // Empty when the mesh was viewed in memory owned by someone else
+    Mapped_File file;
+    const Kmesh_Header *header;
+    const Kmesh_Attribute *attributes;
+    const Kmesh_Lod *lods;
+    const void *vertices;
+} Kmesh;
+
+// Additional levels of detail to store after the indices of the mesh
+typedef struct {
+    const uint32_t *indices;
+    size_t indices_count;
+    float error;
+} Kmesh_Lod_Source;
+
+// Layout of Mesh_Vertex, the one kmesh_save() writes
+#define KMESH_MESH_VERTEX_ATTRIBUTES 3
+extern const Kmesh_Attribute kmesh_mesh_vertex_attributes[KMESH_MESH_VERTEX_ATTRIBUTES];
+
+const char *kmesh_attribute_name(Kmesh_Attribute_Kind kind);
+
+// Validates `size` bytes of `data` without copying them, `data` must stay
+// alive for as long as the Kmesh is used. On failure returns false and
+// points `error` to a human readable reason.
+bool kmesh_view(const void *data, size_t size, Kmesh *kmesh, const char **error);
+// Maps the file and validates it like kmesh_view()
+bool kmesh_open(const char *file_path, Kmesh *kmesh, const char **error);
+void kmesh_close(Kmesh *kmesh);
+const uint32_t *kmesh_lod_indices(const Kmesh *kmesh, size_t lod);
+
+// Writes Mesh_Vertex vertices and the levels of detail. Sets errno on
+// failure.
+bool kmesh_save(const char *file_path, const Mesh *mesh, const Kmesh_Lod_Source *lods, size_t lods_count,
+                uint32_t flags);
+
+#endif // KMESH_H_
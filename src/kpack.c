@@ -0,0 +1,228 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#include "./geo.h"
+#include "./hash.h"
+#include "./image.h"
+#include "./texcomp.h"
+#include "./pack.h"
+#include "./glsl.h"
+
+// Packs ./scene.conf and everything it references into a single asset
+// pack for `kidito -pack`:
+//   - every value of scene.conf that names an existing file is stored as is,
+//     the shaders along with the files they include
+//   - the texture is stored pre-decoded, plus its compressed version when
+//     `texture_format` asks for one
+//   - the cube mesh is stored ready to be uploaded
+// Entries are LZ4 compressed unless `-store` is given or they do not shrink.
+
+#define SCENE_CONF_FILE_PATH "./scene.conf"
+#define KPACK_REGION_CAPACITY (256 * 1000 * 1000)
+
+Region region;
+Pack_Builder builder;
+
+void usage(FILE *stream, const char *program)
+{
+    fprintf(stream, "Usage: %s [-store] <output.kpak>\n", program);
+}
+
+bool is_regular_file(const char *file_path)
+{
+    struct stat st;
+    return stat(file_path, &st) == 0 && S_ISREG(st.st_mode);
+}
+
+void add_entry(const char *name, Pack_Entry_Kind kind, uint64_t hash, const void *data, size_t size)
+{
+    if (!pack_builder_add(&builder, name, kind, hash, data, size)) {
+        if (errno == EEXIST) return;
+        fprintf(stderr, "ERROR: could not add %s: %s\n", name, strerror(errno));
+        exit(1);
+    }
+}
+
+String_View add_file(const char *file_path)
+{
+    size_t size = 0;
+    const char *data = region_slurp_file_sized(&region, file_path, &size);
+    if (data == NULL) {
+        fprintf(stderr, "ERROR: could not read file %s: %s\n", file_path, strerror(errno));
+        exit(1);
+    }
+    add_entry(file_path, PACK_ENTRY_FILE, hash_bytes(data, size), data, size);
+
+    return (String_View) {
+        .count = size,
+        .data = data,
+    };
+}
+
+bool load_shader_file(void *arg, Region *region, const char *file_path, String_View *content)
+{
+    (void) arg;
+    (void) region;
+    *content = add_file(file_path);
+    return true;
+}
+
+// The defines do not change which files are included, the expansion is
+// only there to find them
+void add_shader(const char *file_path)
+{
+    Glsl_Source source = {0};
+    const char *error = NULL;
+    if (!glsl_expand(&region, file_path, NULL, 0, load_shader_file, NULL, &source, &error)) {
+        fprintf(stderr, "ERROR: could not expand shader %s: %s\n", file_path, error);
+        exit(1);
+    }
+}
+
+void add_texture(const char *file_path, Texture_Format format)
+{
+    size_t size = 0;
+    const char *data = region_slurp_file_sized(&region, file_path, &size);
+    if (data == NULL) {
+        fprintf(stderr, "ERROR: could not read file %s: %s\n", file_path, strerror(errno));
+        exit(1);
+    }
+    const uint64_t source_hash = hash_bytes(data, size);
+
+    Image image = {0};
+    if (!image_decode(&region, image_format_by_file_path(file_path), data, size, &image)) {
+        fprintf(stderr, "ERROR: could not decode %s: %s\n", file_path, image_failure_reason());
+        exit(1);
+    }
+
+    uint8_t *raw = NULL;
+    size_t raw_size = 0;
+    if (!image_encode(&region, IMAGE_FORMAT_RAW, image, &raw, &raw_size)) {
+        fprintf(stderr, "ERROR: could not encode %s: %s\n", file_path, image_failure_reason());
+        exit(1);
+    }
+    add_entry(file_path, PACK_ENTRY_IMAGE, source_hash, raw, raw_size);
+
+    if (format == TEXTURE_FORMAT_RGBA) return;
+
+    Compressed_Texture texture = {0};
+    if (!texcomp_cache_load(&region, TEXCOMP_CACHE_DIR, source_hash, format, &texture) &&
+            !texcomp_build(&region, format, source_hash, image.pixels, image.width, image.height, &texture)) {
+        fprintf(stderr, "ERROR: could not encode %s as %s: %s\n",
+                file_path, texture_format_name(format), strerror(errno));
+        exit(1);
+    }
+
+    uint8_t *serialized = NULL;
+    size_t serialized_size = 0;
+    if (!texcomp_cache_serialize(&region, &texture, &serialized, &serialized_size)) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+
+    // Named after the cache file, which is exactly what reload_scene() is
+    // looking for
+    const char *name = texcomp_cache_file_path(&region, TEXCOMP_CACHE_DIR, source_hash, format);
+    add_entry(name, PACK_ENTRY_TEXTURE, source_hash, serialized, serialized_size);
+}
+
+void add_cube_mesh(void)
+{
+    Cube_Mesh *cube = region_malloc(&region, sizeof(*cube));
+    if (cube == NULL) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    memset(cube, 0, sizeof(*cube));
+
+    RGBA colors[TRIS_PER_CUBE][TRI_VERTICES] = {0};
+    generate_cube_mesh(cube->mesh, colors, cube->uvs, cube->normals);
+    add_entry(PACK_CUBE_MESH_NAME, PACK_ENTRY_MESH, hash_bytes(cube, sizeof(*cube)), cube, sizeof(*cube));
+}
+
+int main(int argc, char **argv)
+{
+    const char *const program = argv[0];
+    const char *output_file_path = NULL;
+    builder.codec = PACK_CODEC_LZ4;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-store") == 0) {
+            builder.codec = PACK_CODEC_NONE;
+        } else if (output_file_path == NULL) {
+            output_file_path = argv[i];
+        } else {
+            usage(stderr, program);
+            fprintf(stderr, "ERROR: expected exactly one output file\n");
+            exit(1);
+        }
+    }
+
+    if (output_file_path == NULL) {
+        usage(stderr, program);
+        fprintf(stderr, "ERROR: no output file is provided\n");
+        exit(1);
+    }
+
+    region = region_with_capacity(KPACK_REGION_CAPACITY);
+
+    printf("Packing %s into %s\n", SCENE_CONF_FILE_PATH, output_file_path);
+
+    String_View content = add_file(SCENE_CONF_FILE_PATH);
+
+    const char *texture_file_path = NULL;
+    Texture_Format texture_format = TEXTURE_FORMAT_RGBA;
+
+    while (content.count > 0) {
+        String_View line = sv_chop_by_delim(&content, '\n');
+        line = sv_trim(sv_chop_by_delim(&line, '#'));
+        if (line.count == 0) continue;
+
+        const String_View key = sv_trim(sv_chop_by_delim(&line, '='));
+        const String_View value = sv_trim(line);
+
+        if (sv_eq(key, SV("texture"))) {
+            texture_file_path = region_cstr_from_sv(&region, value);
+        } else if (sv_eq(key, SV("texture_format"))) {
+            if (!texture_format_by_name(value, &texture_format)) {
+                texture_format = TEXTURE_FORMAT_RGBA;
+            }
+        } else if (sv_eq(key, SV("vert_shader")) || sv_eq(key, SV("frag_shader"))) {
+            add_shader(region_cstr_from_sv(&region, value));
+        } else {
+            const char *file_path = region_cstr_from_sv(&region, value);
+            if (is_regular_file(file_path)) {
+                add_file(file_path);
+            }
+        }
+    }
+
+    if (texture_file_path != NULL) {
+        add_texture(texture_file_path, texture_format);
+    }
+
+    add_cube_mesh();
+
+    if (!pack_builder_save(&builder, output_file_path)) {
+        fprintf(stderr, "ERROR: could not write %s: %s\n", output_file_path, strerror(errno));
+        exit(1);
+    }
+
+    size_t total_size = 0;
+    size_t total_stored_size = 0;
+    for (size_t i = 0; i < builder.items_count; ++i) {
+        const Pack_Entry *entry = &builder.items[i].entry;
+        printf("  %-8s %-4s %-48s %10zu -> %10zu bytes\n",
+               pack_entry_kind_name(entry->kind), pack_codec_name(entry->codec), entry->name,
+               (size_t) entry->size, (size_t) entry->stored_size);
+        total_size += entry->size;
+        total_stored_size += entry->stored_size;
+    }
+    printf("Total: %zu -> %zu bytes\n", total_size, total_stored_size);
+
+    pack_builder_free(&builder);
+    return 0;
+}
@@ -0,0 +1,45 @@
+#include <math.h>
+
+#include "./lod.h"
+
+float lod_box_distance(const float point[V3_COMPS], const float min[V3_COMPS], const float max[V3_COMPS])
+{
+    float squared = 0.0f;
+    for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+        float d = 0.0f;
+        if (point[axis] < min[axis]) d = min[axis] - point[axis];
+        if (point[axis] > max[axis]) d = point[axis] - max[axis];
+        squared += d * d;
+    }
+    return sqrtf(squared);
+}
+
+size_t lod_select(const Lod_Config *config, float feature_size, float distance,
+                  float focal, float height, size_t levels)
+{
+    if (distance >= config->fog_distance) return LOD_FOGGED;
+    if (distance <= 0.0f || levels == 0) return 0;
+
+    // Half of the height of the viewport spans tan(fovy / 2) * distance
+    float pixels = feature_size * focal * 0.5f * height / distance;
+    size_t level = 0;
+    while (level + 1 < levels && pixels * 2.0f <= config->pixels) {
+        pixels *= 2.0f;
+        level += 1;
+    }
+    return level;
+}
+
+size_t lod_select_by_error(const Lod_Config *config, const float *errors, size_t levels,
+                           float distance, float focal, float height)
+{
+    if (distance >= config->fog_distance) return LOD_FOGGED;
+    if (distance <= 0.0f || levels == 0) return 0;
+
+    const float pixels_per_unit = focal * 0.5f * height / distance;
+    size_t level = 0;
+    while (level + 1 < levels && errors[level + 1] * pixels_per_unit <= config->pixels) {
+        level += 1;
+    }
+    return level;
+}
@@ -0,0 +1,43 @@
+#ifndef LOD_H_
+#define LOD_H_
+
+#include <stddef.h>
+
+#include "./geo.h"
+
+// Distance based level of detail. Level 0 is the full detail and every
+// next level of a chain doubles the size of its smallest feature. Objects
+// pick the coarsest level whose features still cover enough pixels, and
+// objects beyond the fog are not drawn at all.
+
+// Defaults of the scene.conf keys `lod_pixels` and `fog_distance`
+#define LOD_DEFAULT_PIXELS 2.0f
+#define LOD_DEFAULT_FOG_DISTANCE 100.0f
+
+// lod_select() of an object that is completely fogged
+#define LOD_FOGGED ((size_t) -1)
+
+typedef struct {
+    // Objects get coarser for as long as the features of the coarser level
+    // project to at most this many pixels
+    float pixels;
+    // The fog is opaque from this distance on
+    float fog_distance;
+} Lod_Config;
+
+// Distance from `point` to the nearest point of the box, 0 inside of it
+float lod_box_distance(const float point[V3_COMPS], const float min[V3_COMPS], const float max[V3_COMPS]);
+
+// Level out of `levels` for an object at `distance` whose finest features
+// are `feature_size` big. `focal` is projection.vs[1][1] and `height` the
+// height of the viewport in pixels, like the GPU maps them.
+size_t lod_select(const Lod_Config *config, float feature_size, float distance,
+                  float focal, float height, size_t levels);
+
+// Same for a chain of simplified meshes, where level `l` deviates from the
+// original by up to `errors[l]` and the errors only grow: the coarsest
+// level whose error still projects to at most `pixels`
+size_t lod_select_by_error(const Lod_Config *config, const float *errors, size_t levels,
+                           float distance, float focal, float height);
+
+#endif // LOD_H_
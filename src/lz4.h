@@ -0,0 +1,250 @@
+/* lz4.h - minimal single-header codec for the LZ4 block format
+   https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+
+   Do this:
+      #define LZ4_IMPLEMENTATION
+   before you include this file in *one* C file to create the implementation.
+
+   Only the raw block format is supported (no frames, no checksums), which
+   is all an asset pack needs since it stores the sizes in its own index.
+   The compressor is the classic single-probe hash table greedy parser: it
+   trades ratio for speed exactly like the reference LZ4_compress_fast().
+   The decompressor is bounds checked and never writes past `dst_size`.
+*/
+
+#ifndef LZ4_H_
+#define LZ4_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Worst case size of compressing `size` bytes
+size_t lz4_compress_bound(size_t size);
+
+// Returns the compressed size, or 0 when `dst_capacity` is too small
+size_t lz4_compress(const uint8_t *src, size_t src_size,
+                    uint8_t *dst, size_t dst_capacity);
+
+// `dst_size` must be the exact decompressed size. Returns 0 on success,
+// -1 on malformed input.
+int lz4_decompress(const uint8_t *src, size_t src_size,
+                   uint8_t *dst, size_t dst_size);
+
+#endif // LZ4_H_
+
+#ifdef LZ4_IMPLEMENTATION
+
+#include <string.h>
+
+#define LZ4_MIN_MATCH 4
+#define LZ4_LAST_LITERALS 5
+#define LZ4_MF_LIMIT 12
+#define LZ4_MAX_OFFSET 65535
+#define LZ4_HASH_LOG 16
+#define LZ4_SKIP_TRIGGER 6
+
+static uint32_t lz4__read32(const uint8_t *p)
+{
+    uint32_t x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+}
+
+static uint32_t lz4__hash(uint32_t sequence)
+{
+    return (sequence * 2654435761u) >> (32 - LZ4_HASH_LOG);
+}
+
+// Copies `n` rounded up to 8 bytes, the caller guarantees the slack
+static void lz4__wild_copy(uint8_t *dst, const uint8_t *src, size_t n)
+{
+    uint8_t *const end = dst + n;
+    do {
+        memcpy(dst, src, 8);
+        dst += 8;
+        src += 8;
+    } while (dst < end);
+}
+
+size_t lz4_compress_bound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+static uint8_t *lz4__write_length(uint8_t *op, size_t length)
+{
+    while (length >= 255) {
+        *op++ = 255;
+        length -= 255;
+    }
+    *op++ = (uint8_t) length;
+    return op;
+}
+
+static uint8_t *lz4__write_sequence(uint8_t *op,
+                                    const uint8_t *literals, size_t literals_count,
+                                    size_t offset, size_t match_length)
+{
+    uint8_t *token = op++;
+    *token = 0;
+
+    if (literals_count >= 15) {
+        *token = 15 << 4;
+        op = lz4__write_length(op, literals_count - 15);
+    } else {
+        *token = (uint8_t) (literals_count << 4);
+    }
+
+    memcpy(op, literals, literals_count);
+    op += literals_count;
+
+    if (match_length > 0) {
+        *op++ = offset & 0xFF;
+        *op++ = (offset >> 8) & 0xFF;
+
+        const size_t ml = match_length - LZ4_MIN_MATCH;
+        if (ml >= 15) {
+            *token |= 15;
+            op = lz4__write_length(op, ml - 15);
+        } else {
+            *token |= (uint8_t) ml;
+        }
+    }
+
+    return op;
+}
+
+size_t lz4_compress(const uint8_t *src, size_t src_size,
+                    uint8_t *dst, size_t dst_capacity)
+{
+    if (dst_capacity < lz4_compress_bound(src_size)) {
+        return 0;
+    }
+
+    // Positions are stored +1, so zero means an empty slot
+    static _Thread_local uint32_t table[1 << LZ4_HASH_LOG];
+    memset(table, 0, sizeof(table));
+
+    uint8_t *op = dst;
+    size_t anchor = 0;
+    size_t ip = 0;
+
+    if (src_size > LZ4_MF_LIMIT) {
+        const size_t mf_limit = src_size - LZ4_MF_LIMIT;
+        const size_t match_limit = src_size - LZ4_LAST_LITERALS;
+        size_t search_attempts = 1 << LZ4_SKIP_TRIGGER;
+
+        while (ip < mf_limit) {
+            const uint32_t sequence = lz4__read32(src + ip);
+            const uint32_t h = lz4__hash(sequence);
+            const size_t candidate = table[h];
+            table[h] = (uint32_t) ip + 1;
+
+            if (candidate == 0 ||
+                    ip - (candidate - 1) > LZ4_MAX_OFFSET ||
+                    lz4__read32(src + candidate - 1) != sequence) {
+                // Skip faster and faster through incompressible data
+                ip += search_attempts++ >> LZ4_SKIP_TRIGGER;
+                continue;
+            }
+            search_attempts = 1 << LZ4_SKIP_TRIGGER;
+
+            size_t match = candidate - 1;
+            while (ip > anchor && match > 0 && src[ip - 1] == src[match - 1]) {
+                ip -= 1;
+                match -= 1;
+            }
+
+            size_t length = LZ4_MIN_MATCH;
+            while (ip + length < match_limit && src[match + length] == src[ip + length]) {
+                length += 1;
+            }
+
+            op = lz4__write_sequence(op, src + anchor, ip - anchor, ip - match, length);
+            ip += length;
+            anchor = ip;
+        }
+    }
+
+    op = lz4__write_sequence(op, src + anchor, src_size - anchor, 0, 0);
+    return (size_t) (op - dst);
+}
+
+int lz4_decompress(const uint8_t *src, size_t src_size,
+                   uint8_t *dst, size_t dst_size)
+{
+    const uint8_t *ip = src;
+    const uint8_t *const iend = src + src_size;
+    uint8_t *op = dst;
+    uint8_t *const oend = dst + dst_size;
+
+    while (ip < iend) {
+        const uint8_t token = *ip++;
+
+        size_t literals_count = token >> 4;
+        if (literals_count == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                literals_count += b;
+            } while (b == 255);
+        }
+
+        if ((size_t) (iend - ip) < literals_count || (size_t) (oend - op) < literals_count) {
+            return -1;
+        }
+        // Most sequences are short, so unless we are near the end of either
+        // buffer copy in fixed chunks instead of an exact memcpy()
+        if ((size_t) (iend - ip) >= literals_count + 8 && (size_t) (oend - op) >= literals_count + 8) {
+            lz4__wild_copy(op, ip, literals_count);
+        } else {
+            memcpy(op, ip, literals_count);
+        }
+        ip += literals_count;
+        op += literals_count;
+
+        // The last sequence has no match part
+        if (ip >= iend) break;
+
+        if (iend - ip < 2) return -1;
+        const size_t offset = (size_t) ip[0] | (size_t) ip[1] << 8;
+        ip += 2;
+        if (offset == 0 || offset > (size_t) (op - dst)) return -1;
+
+        size_t length = token & 15;
+        if (length == 15) {
+            uint8_t b;
+            do {
+                if (ip >= iend) return -1;
+                b = *ip++;
+                length += b;
+            } while (b == 255);
+        }
+        length += LZ4_MIN_MATCH;
+
+        if ((size_t) (oend - op) < length) return -1;
+
+        const uint8_t *match = op - offset;
+        if (offset >= 8 && (size_t) (oend - op) >= length + 8) {
+            lz4__wild_copy(op, match, length);
+            op += length;
+            continue;
+        }
+
+        // An overlapping match repeats the last `offset` bytes. Every copy
+        // doubles the repeated run, so short offsets (like a solid RGBA
+        // color) take a few memcpy()s instead of a byte loop.
+        while (length > 0) {
+            const size_t available = (size_t) (op - match);
+            const size_t n = available < length ? available : length;
+            memcpy(op, match, n);
+            op += n;
+            length -= n;
+        }
+    }
+
+    return op == oend ? 0 : -1;
+}
+
+#endif // LZ4_IMPLEMENTATION
@@ -4,6 +4,8 @@
 #include <stdbool.h>
 #include <string.h>
 #include <errno.h>
+#include <stddef.h>
+#include <math.h>
 
 #define GLEW_STATIC
 #include <GL/glew.h>
@@ -14,16 +16,59 @@
 #include "./geo.h"
 #include "./sv.h"
 #include "./region.h"
+#include "./hash.h"
+#include "./texcomp.h"
+#include "./image.h"
+#include "./pool.h"
+#include "./pack.h"
+#include "./emote.h"
+#include "./cull.h"
+#include "./bvh.h"
+#include "./occlusion.h"
+#include "./lod.h"
+#include "./mesh.h"
+#include "./kmesh.h"
+#include "./simplify.h"
+#include "./stream.h"
+#include "./vpack.h"
+#include "./glsl.h"
+#include "./watch.h"
+#include "./progcache.h"
+#include "./uniforms.h"
+#include "./capture.h"
+#include "./mapped_file.h"
+#include "./timer.h"
 
 Region hot_reload_memory;
 
-#define STBI_MALLOC(size) region_malloc(&hot_reload_memory, size)
-#define STBI_FREE(ignored) do {(void)ignored;} while(0)
-#define STBI_REALLOC_SIZED(ptr, oldsz, newsz) \
-    region_realloc(&hot_reload_memory, ptr, oldsz, newsz)
+// Background workers, NULL if they could not be started
+Pool *workers = NULL;
 
-#define STB_IMAGE_IMPLEMENTATION
-#include "./stb_image.h"
+// Optional asset pack that takes precedence over the file system
+const char *asset_pack_file_path = NULL;
+Pack asset_pack = {0};
+
+typedef struct {
+    const char *data;
+    size_t size;
+    // NULL when the asset was read from the file system
+    const Pack_Entry *entry;
+} Asset;
+
+// Pack assets are served straight from the pack, everything else is read
+// into `region`. Either way `data` is zero terminated.
+bool asset_load(Region *region, const char *file_path, Asset *asset)
+{
+    asset->entry = pack_find(&asset_pack, file_path);
+    if (asset->entry != NULL) {
+        asset->data = pack_entry_data(&asset_pack, asset->entry);
+        asset->size = asset->entry->size;
+        return true;
+    }
+
+    asset->data = region_slurp_file_sized(region, file_path, &asset->size);
+    return asset->data != NULL;
+}
 
 #define VERTEX_CAPACITY 1000
 
@@ -31,19 +76,48 @@ Region hot_reload_memory;
 #define HOT_RELOAD_ERROR_COLOR 0.5f, 0.0f, 0.0f, 1.0f
 #define BACKGROUND_COLOR 0.0f, 0.0f, 0.0f, 0.0f
 
-bool compile_shader_source(const GLchar *source, GLenum shader_type, GLuint *shader)
+// The emote wall is scaled to this size in world units whatever the amount
+// of emotes, and looked at from EMOTE_WALL_DISTANCE give or take
+// EMOTE_WALL_SWING, so parts of it leave the screen
+#define EMOTE_WALL_SIZE 50.0f
+#define EMOTE_WALL_DISTANCE 30.0f
+#define EMOTE_WALL_SWING 25.0f
+
+// The mesh is scaled so its bounding box is this long diagonally and
+// orbited from MESH_DISTANCE give or take MESH_SWING, so its levels of
+// detail take turns
+#define MESH_SIZE 25.0f
+#define MESH_DISTANCE 30.0f
+#define MESH_SWING 15.0f
+
+#define STATS_INTERVAL_SECS 1.0
+// How often the files of the scene are checked for changes
+#define WATCH_INTERVAL_SECS 0.5
+// Attribute locations of the instances in ./shaders/emote.vert
+#define INSTANCE_POSITION_INDEX 3
+#define INSTANCE_COLOR_INDEX 4
+
+// The compilation and the linking are only kicked off here, the results
+// are asked for by shader_compiled() and program_linked() as late as
+// possible. With GL_KHR_parallel_shader_compile the driver works on them
+// on its own threads in the meantime.
+GLuint compile_shader_source(const GLchar *source, GLenum shader_type)
 {
-    *shader = glCreateShader(shader_type);
-    glShaderSource(*shader, 1, &source, NULL);
-    glCompileShader(*shader);
+    GLuint shader = glCreateShader(shader_type);
+    glShaderSource(shader, 1, &source, NULL);
+    glCompileShader(shader);
+    return shader;
+}
 
+bool shader_compiled(GLuint shader)
+{
     GLint compiled = 0;
-    glGetShaderiv(*shader, GL_COMPILE_STATUS, &compiled);
+    glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
 
     if (!compiled) {
         GLchar message[1024];
         GLsizei message_size = 0;
-        glGetShaderInfoLog(*shader, sizeof(message), &message_size, message);
+        glGetShaderInfoLog(shader, sizeof(message), &message_size, message);
         fprintf(stderr, "%.*s\n", message_size, message);
         return false;
     }
@@ -51,42 +125,1186 @@ bool compile_shader_source(const GLchar *source, GLenum shader_type, GLuint *sha
     return true;
 }
 
-bool link_program(GLuint vert_shader, GLuint frag_shader, GLuint *program)
+// The shaders belong to the shader cache, deleting the program only
+// detaches them
+GLuint link_program(GLuint vert_shader, GLuint frag_shader)
 {
-    *program = glCreateProgram();
+    GLuint program = glCreateProgram();
+
+    glAttachShader(program, vert_shader);
+    glAttachShader(program, frag_shader);
+    progcache_hint(program);
+    glLinkProgram(program);
 
-    glAttachShader(*program, vert_shader);
-    glAttachShader(*program, frag_shader);
-    glLinkProgram(*program);
+    return program;
+}
 
+bool program_linked(GLuint program)
+{
     GLint linked = 0;
-    glGetProgramiv(*program, GL_LINK_STATUS, &linked);
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
     if (!linked) {
         GLsizei message_size = 0;
         GLchar message[1024];
 
-        glGetProgramInfoLog(*program, sizeof(message), &message_size, message);
+        glGetProgramInfoLog(program, sizeof(message), &message_size, message);
         fprintf(stderr, "Program Linking: %.*s\n", message_size, message);
+        return false;
     }
 
-    glDeleteShader(vert_shader);
-    glDeleteShader(frag_shader);
+    return true;
+}
 
-    return program;
+GLenum texture_format_gl(Texture_Format format)
+{
+    switch (format) {
+    case TEXTURE_FORMAT_BC1:      return GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    case TEXTURE_FORMAT_BC3:      return GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    case TEXTURE_FORMAT_ETC2:     return GL_COMPRESSED_RGB8_ETC2;
+    case TEXTURE_FORMAT_ETC2_EAC: return GL_COMPRESSED_RGBA8_ETC2_EAC;
+    case TEXTURE_FORMAT_RGBA:
+    case COUNT_TEXTURE_FORMATS:
+    default:
+        return GL_RGBA;
+    }
+}
+
+bool texture_format_supported(Texture_Format format)
+{
+    switch (format) {
+    case TEXTURE_FORMAT_BC1:
+    case TEXTURE_FORMAT_BC3:
+        return GLEW_EXT_texture_compression_s3tc;
+    case TEXTURE_FORMAT_ETC2:
+    case TEXTURE_FORMAT_ETC2_EAC:
+        return GLEW_ARB_ES3_compatibility;
+    case TEXTURE_FORMAT_RGBA:
+    case COUNT_TEXTURE_FORMATS:
+    default:
+        return true;
+    }
+}
+
+// shader cache begin
+// Compiled shaders by the file they were expanded from. The hash of the
+// files of the last expansion tells whether a shader is still up to date
+// without expanding or compiling it again.
+#define SHADER_CACHE_CAPACITY 8
+
+typedef struct {
+    GLenum type;
+    // The root first, as in Glsl_Source, malloc()ed
+    char *files[GLSL_MAX_FILES];
+    size_t files_count;
+    uint64_t hash;
+    GLuint shader;
+    // Of the least recently used entry, which goes first
+    size_t used;
+} Shader_Cache_Entry;
+
+Shader_Cache_Entry shader_cache[SHADER_CACHE_CAPACITY] = {0};
+size_t shader_cache_clock = 0;
+// Since the last reload
+size_t shader_cache_hits = 0;
+size_t shader_cache_misses = 0;
+
+Shader_Cache_Entry *shader_cache_find(GLenum type, const char *file_path)
+{
+    for (size_t i = 0; i < SHADER_CACHE_CAPACITY; ++i) {
+        Shader_Cache_Entry *entry = &shader_cache[i];
+        if (entry->shader != 0 && entry->type == type && strcmp(entry->files[0], file_path) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+void shader_cache_evict(Shader_Cache_Entry *entry)
+{
+    glDeleteShader(entry->shader);
+    for (size_t i = 0; i < entry->files_count; ++i) {
+        free(entry->files[i]);
+    }
+    memset(entry, 0, sizeof(*entry));
+}
+
+// Takes the ownership of `shader`
+Shader_Cache_Entry *shader_cache_put(GLenum type, const Glsl_Source *source, GLuint shader)
+{
+    Shader_Cache_Entry *entry = shader_cache_find(type, source->files[0]);
+    if (entry == NULL) {
+        entry = &shader_cache[0];
+        for (size_t i = 1; i < SHADER_CACHE_CAPACITY; ++i) {
+            if (shader_cache[i].used < entry->used) entry = &shader_cache[i];
+        }
+    }
+    if (entry->shader != 0) shader_cache_evict(entry);
+
+    entry->type = type;
+    entry->hash = source->hash;
+    entry->shader = shader;
+    entry->used = ++shader_cache_clock;
+    for (size_t i = 0; i < source->files_count; ++i) {
+        const size_t n = strlen(source->files[i]) + 1;
+        entry->files[i] = malloc(n);
+        if (entry->files[i] == NULL) {
+            // Never matches, so it is just compiled again next time
+            entry->hash = ~source->hash;
+            break;
+        }
+        memcpy(entry->files[i], source->files[i], n);
+        entry->files_count += 1;
+    }
+    return entry;
+}
+// shader cache end
+
+// reload files begin
+// The files named by scene.conf are read, and the texture decoded or
+// compressed, on the workers while the main thread goes on with the GL
+// work that does not need them yet. Every file has an arena of its own,
+// hot_reload_memory belongs to the main thread.
+
+// Decoded images go into the arena of the texture
+#define RELOAD_TEXTURE_ARENA_CAPACITY (64 * 1000 * 1000)
+
+typedef enum {
+    RELOAD_VERTEX_SHADER = 0,
+    RELOAD_FRAGMENT_SHADER,
+    RELOAD_TEXTURE,
+    COUNT_RELOAD_FILES,
+} Reload_File_Index;
+
+// Optional parts of the shaders, compiled in or out by a define each
+// instead of being branched on at runtime, see shader variants below
+typedef enum {
+    SHADER_FEATURE_FOG = 0,
+    SHADER_FEATURE_LIGHTING,
+    SHADER_FEATURE_EXPLODE,
+    COUNT_SHADER_FEATURES,
+} Shader_Feature;
+
+static const char *const shader_feature_defines[COUNT_SHADER_FEATURES] = {
+    [SHADER_FEATURE_FOG] = "FOG",
+    [SHADER_FEATURE_LIGHTING] = "LIGHTING",
+    [SHADER_FEATURE_EXPLODE] = "EXPLODE",
+};
+
+// `shader_define`s of scene.conf followed by the features of the variant
+// being built, the same for both shaders. Everything the variants are
+// built from lives in shader_variant_memory until the next reload.
+#define SHADER_MAX_DEFINES 32
+String_View shader_defines[SHADER_MAX_DEFINES + COUNT_SHADER_FEATURES] = {0};
+size_t shader_scene_defines_count = 0;
+size_t shader_defines_count = 0;
+Region shader_variant_memory = {0};
+const char *shader_variant_vert_file_path = NULL;
+const char *shader_variant_frag_file_path = NULL;
+
+// Puts the features of `variant`, one bit per Shader_Feature, after the
+// defines of scene.conf
+void shader_variant_defines(unsigned variant)
+{
+    shader_defines_count = shader_scene_defines_count;
+    for (size_t feature = 0; feature < COUNT_SHADER_FEATURES; ++feature) {
+        if (variant & (1u << feature)) {
+            shader_defines[shader_defines_count++] = sv_from_cstr(shader_feature_defines[feature]);
+        }
+    }
+}
+
+typedef struct {
+    const char *file_path;
+    size_t def_line;
+    // The shaders only
+    GLenum shader_type;
+    // Up to date unless the files changed, read by the worker
+    const Shader_Cache_Entry *cached;
+    // RELOAD_TEXTURE only
+    Texture_Format texture_format;
+    // The emote wall needs the pixels whatever the texture format
+    bool decode_pixels;
+
+    Region arena;
+    Pool_Async async;
+    double secs;
+
+    bool ok;
+    Asset asset;
+    // RELOAD_TEXTURE only, `asset` of a .kraw file outside the pack. Closed
+    // once the reload is done with the pixels.
+    Mapped_File mapping;
+    // The expanded shader, unless `cached` turned out to be up to date
+    bool cache_hit;
+    Glsl_Source glsl;
+    // The pixels when the format is TEXTURE_FORMAT_RGBA or decode_pixels
+    Image image;
+    // The levels for the compressed formats
+    Compressed_Texture texture;
+    char error[256];
+} Reload_File;
+
+Reload_File reload_files[COUNT_RELOAD_FILES] = {
+    [RELOAD_VERTEX_SHADER] = {.shader_type = GL_VERTEX_SHADER},
+    [RELOAD_FRAGMENT_SHADER] = {.shader_type = GL_FRAGMENT_SHADER},
+    [RELOAD_TEXTURE] = {.arena = {.capacity = RELOAD_TEXTURE_ARENA_CAPACITY}},
+};
+
+// The image format is picked by the extension of `file_path` unless the
+// asset comes pre-decoded from the pack.
+Image_Format asset_image_format(Asset asset, const char *file_path)
+{
+    return asset.entry != NULL && asset.entry->kind == PACK_ENTRY_IMAGE
+           ? IMAGE_FORMAT_RAW
+           : image_format_by_file_path(file_path);
+}
+
+// Everything of the texture that does not need GL
+bool reload_texture_prepare(Reload_File *file)
+{
+    Region *region = &file->arena;
+    const Asset texture_asset = file->asset;
+    const char *texture_file_path = file->file_path;
+    const Texture_Format texture_format = file->texture_format;
+    const Image_Format image_format = asset_image_format(texture_asset, texture_file_path);
+
+    if (texture_format == TEXTURE_FORMAT_RGBA || file->decode_pixels) {
+        // KRAW pixels are uploaded straight from the pack or the file
+        if (!image_decode(region, image_format,
+                          texture_asset.data, texture_asset.size, &file->image)) {
+            snprintf(file->error, sizeof(file->error), "could not decode %s: %s",
+                     texture_file_path, image_failure_reason());
+            return false;
+        }
+    }
+
+    if (texture_format == TEXTURE_FORMAT_RGBA) return true;
+
+    // The cache is keyed by the hash of the source file, so editing the
+    // image invalidates its compressed version automatically. Pack entries
+    // remember the hash of the file they were produced from.
+    const uint64_t source_hash = texture_asset.entry != NULL
+        ? texture_asset.entry->hash
+        : hash_bytes(texture_asset.data, texture_asset.size);
+
+    Compressed_Texture *texture = &file->texture;
+    bool cached = false;
+    {
+        const char *cache_file_path = texcomp_cache_file_path(
+            region, TEXCOMP_CACHE_DIR, source_hash, texture_format);
+        const Pack_Entry *entry = cache_file_path ? pack_find(&asset_pack, cache_file_path) : NULL;
+        if (entry != NULL && entry->kind == PACK_ENTRY_TEXTURE) {
+            cached = texcomp_cache_parse(pack_entry_data(&asset_pack, entry), entry->size,
+                                         source_hash, texture_format, texture);
+        }
+    }
+
+    if (!cached) {
+        cached = texcomp_cache_load(region, TEXCOMP_CACHE_DIR,
+                                    source_hash, texture_format, texture);
+    }
+
+    if (!cached) {
+        Image image = file->image;
+        if (image.pixels == NULL &&
+                !image_decode(region, image_format,
+                              texture_asset.data, texture_asset.size, &image)) {
+            snprintf(file->error, sizeof(file->error), "could not decode %s: %s",
+                     texture_file_path, image_failure_reason());
+            return false;
+        }
+
+        if (!texcomp_build(region, texture_format, source_hash,
+                           image.pixels, image.width, image.height, texture)) {
+            snprintf(file->error, sizeof(file->error), "could not encode %s as %s: %s",
+                     texture_file_path, texture_format_name(texture_format), strerror(errno));
+            return false;
+        }
+
+        if (!texcomp_cache_save(region, TEXCOMP_CACHE_DIR, texture)) {
+            printf("WARNING: could not save %s into texture cache %s: %s\n",
+                   texture_file_path, TEXCOMP_CACHE_DIR, strerror(errno));
+        }
+    }
+
+    return true;
+}
+
+// Same as asset_load(), except that .kraw files outside the pack are
+// mapped instead of read, so their pixels go to the GL without a copy. The
+// mapping is not zero terminated, the images do not need it to be.
+bool reload_texture_load(Reload_File *file)
+{
+    file->asset.entry = pack_find(&asset_pack, file->file_path);
+    if (file->asset.entry == NULL && image_format_by_file_path(file->file_path) == IMAGE_FORMAT_RAW) {
+        if (!mapped_file_open(file->file_path, &file->mapping)) return false;
+        mapped_file_will_need(&file->mapping);
+        file->asset.data = file->mapping.data;
+        file->asset.size = file->mapping.size;
+        return true;
+    }
+    return asset_load(&file->arena, file->file_path, &file->asset);
+}
+
+bool reload_glsl_load(void *arg, Region *region, const char *file_path, String_View *content)
+{
+    (void) arg;
+    Asset asset = {0};
+    if (!asset_load(region, file_path, &asset)) return false;
+    content->data = asset.data;
+    content->count = asset.size;
+    return true;
+}
+
+bool reload_shader_prepare(Reload_File *file)
+{
+    if (file->cached != NULL) {
+        uint64_t hash = 0;
+        if (glsl_hash_files(&file->arena, (const char *const *) file->cached->files, file->cached->files_count,
+                            shader_defines, shader_defines_count, reload_glsl_load, NULL, &hash) &&
+                hash == file->cached->hash) {
+            file->cache_hit = true;
+            return true;
+        }
+        // Whatever failed to load fails the expansion below as well
+        region_clean(&file->arena);
+    }
+
+    const char *error = NULL;
+    if (!glsl_expand(&file->arena, file->file_path, shader_defines, shader_defines_count,
+                     reload_glsl_load, NULL, &file->glsl, &error)) {
+        snprintf(file->error, sizeof(file->error), "%s", error);
+        return false;
+    }
+    return true;
+}
+
+void reload_file_task(void *arg, size_t worker)
+{
+    (void) worker;
+    Reload_File *file = arg;
+    const double start = timer_now();
+
+    if (file->shader_type != 0) {
+        file->ok = reload_shader_prepare(file);
+    } else {
+        file->ok = reload_texture_load(file);
+        if (!file->ok) {
+            snprintf(file->error, sizeof(file->error), "could not read file %s: %s",
+                     file->file_path, strerror(errno));
+        } else {
+            file->ok = reload_texture_prepare(file);
+        }
+    }
+
+    file->secs = timer_now() - start;
+}
+
+// Whatever the task left in `file` is only reset here, so it never races
+// with a worker that is still busy with the previous reload
+void reload_file_start(Reload_File *file, const char *file_path, size_t def_line)
+{
+    pool_async_wait(&file->async);
+    region_clean(&file->arena);
+    mapped_file_close(&file->mapping);
+    file->file_path = file_path;
+    file->def_line = def_line;
+    file->ok = false;
+    file->cached = file->shader_type != 0 ? shader_cache_find(file->shader_type, file_path) : NULL;
+    file->cache_hit = false;
+    memset(&file->glsl, 0, sizeof(file->glsl));
+    memset(&file->image, 0, sizeof(file->image));
+    memset(&file->texture, 0, sizeof(file->texture));
+    file->error[0] = '\0';
+    pool_async(workers, &file->async, reload_file_task, file);
+}
+
+// Edited files trigger a reload, see watch_changed() in main()
+Watch scene_watch = {0};
+
+bool reload_file_wait(Reload_File *file, const char *scene_conf_file_path)
+{
+    pool_async_wait(&file->async);
+
+    // Includes that failed to load are watched too, so creating them
+    // reloads the scene
+    watch_add(&scene_watch, file->file_path);
+    if (file->cache_hit) {
+        for (size_t i = 0; i < file->cached->files_count; ++i) {
+            watch_add(&scene_watch, file->cached->files[i]);
+        }
+    }
+    for (size_t i = 0; i < file->glsl.files_count; ++i) {
+        watch_add(&scene_watch, file->glsl.files[i]);
+    }
+
+    if (!file->ok) {
+        fprintf(stderr, "%s:%zu: ERROR: %s\n",
+                scene_conf_file_path, file->def_line, file->error);
+    }
+    return file->ok;
+}
+
+// Makes the entry `file` hit on the most recently used, so compiling the
+// other shader of the program cannot evict it. Called for both shaders
+// before either is compiled.
+void reload_shader_touch(const Reload_File *file)
+{
+    if (file->cache_hit) {
+        Shader_Cache_Entry *entry = (Shader_Cache_Entry *) file->cached;
+        entry->used = ++shader_cache_clock;
+    }
+}
+
+// Compiled or taken from the shader cache, either way the shader is in
+// the cache afterwards until it turns out not to compile
+GLuint reload_shader_compile(const Reload_File *file)
+{
+    if (file->cache_hit) {
+        shader_cache_hits += 1;
+        return file->cached->shader;
+    }
+
+    shader_cache_misses += 1;
+    const GLuint shader = compile_shader_source(file->glsl.source, file->shader_type);
+    shader_cache_put(file->shader_type, &file->glsl, shader);
+    return shader;
+}
+
+// Of the expansion the shader of `file` was compiled from
+uint64_t reload_shader_hash(const Reload_File *file)
+{
+    return file->cache_hit ? file->cached->hash : file->glsl.hash;
+}
+
+// Tells which file is which in the compile log and forgets the shader
+void reload_shader_failed(GLuint shader)
+{
+    for (size_t i = 0; i < SHADER_CACHE_CAPACITY; ++i) {
+        Shader_Cache_Entry *entry = &shader_cache[i];
+        if (entry->shader != shader) continue;
+        for (size_t file = 0; entry->files_count > 1 && file < entry->files_count; ++file) {
+            fprintf(stderr, "  %zu: %s\n", file, entry->files[file]);
+        }
+        shader_cache_evict(entry);
+    }
+}
+
+// Uploads the texture prepared by the workers into the currently bound
+// texture
+void reload_texture_upload(const Reload_File *file)
+{
+    const Texture_Format texture_format = file->texture_format;
+
+    if (texture_format == TEXTURE_FORMAT_RGBA) {
+        glTexImage2D(GL_TEXTURE_2D,
+                     0,
+                     GL_RGBA,
+                     file->image.width,
+                     file->image.height,
+                     0,
+                     GL_RGBA,
+                     GL_UNSIGNED_BYTE,
+                     file->image.pixels);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        return;
+    }
+
+    const Compressed_Texture *texture = &file->texture;
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint) texture->levels_count - 1);
+    for (uint32_t level = 0; level < texture->levels_count; ++level) {
+        glCompressedTexImage2D(GL_TEXTURE_2D,
+                               (GLint) level,
+                               texture_format_gl(texture_format),
+                               (GLsizei) texcomp_level_width(texture, level),
+                               (GLsizei) texcomp_level_height(texture, level),
+                               0,
+                               (GLsizei) texture->level_sizes[level],
+                               texture->level_data[level]);
+    }
+
+    printf("Texture %s: %s, %zu bytes\n",
+           file->file_path,
+           texture_format_name(texture_format),
+           texcomp_total_size(texture));
 }
+// reload files end
 
 // Global variables (fragile people with CS degree look away)
 bool program_failed = false;
 GLuint program = 0;
+// Blocked on the driver finishing the shaders at the end of the last reload
+double reload_shader_wait_secs = 0.0;
 
 double time = 0.0;
-GLint time_location = 0;
 bool pause = false;
-GLint resolution_location = 0;
 
 GLuint texture_id = 0;
 
-void reload_scene(void)
+// Cube instances of the emote wall, the single cube is drawn when there
+// are none. They stay on the CPU and only the ones that pass the frustum
+// culling are written into instance_stream every frame. F6 switches the
+// stream between the persistent mapping and glBufferSubData().
+Stream_Buffer instance_stream = {0};
+bool use_persistent_stream = true;
+// Instances of every level of detail that may be visible at once
+size_t visible_capacity = 0;
+Emote_Instance *instances = NULL;
+size_t instances_count = 0;
+float instances_extent[V3_COMPS] = {0};
+// Centers of the instances as structure of arrays for cull.c
+float *instance_centers = NULL;
+uint32_t *visible_indices = NULL;
+
+// Hierarchy over the instances for culling and picking, rebuilt with them
+// into its own Region. F2 switches back to testing every instance.
+Aabb *instance_aabbs = NULL;
+Region bvh_memory = {0};
+Bvh instances_bvh = {0};
+bool use_bvh = true;
+// Of the last frame, the clicks are picked against what is on the screen
+Mat4 wall_projection = {0};
+Mat4 wall_view = {0};
+
+// Big opaque rectangles of the emotes are rasterized every frame and hide
+// the instances behind them. F3 turns it off.
+Aabb *occluders = NULL;
+size_t occluders_count = 0;
+Occlusion_Buffer occlusion = {0};
+bool use_occlusion = true;
+
+// Every emote of the wall picks a level of detail every frame by its
+// distance. Level 0 goes through the culling of the instances above, the
+// coarser levels are drawn from their own copies of the wall and the
+// emotes beyond the fog are not drawn at all. F4 turns it off.
+Lod_Config lod_config = {
+    .pixels = LOD_DEFAULT_PIXELS,
+    .fog_distance = LOD_DEFAULT_FOG_DISTANCE,
+};
+bool use_lod = true;
+size_t wall_emotes = 0;
+size_t wall_side = 0;
+size_t wall_layers = 0;
+// Distance between the origins of the neighbouring emotes
+float wall_pitch[2] = {0};
+// Bounds of the emotes through all of the layers as structure of arrays
+// for cull.c
+float *emote_centers = NULL;
+float *emote_extents = NULL;
+uint32_t *visible_emotes = NULL;
+// Level of every emote in the last frame, EMOTE_LOD_LEVELS when not drawn
+uint8_t *emote_levels = NULL;
+// Index 0 is unused, level 0 is `instances`
+Emote_Instance *lod_instances[EMOTE_LOD_LEVELS] = {0};
+size_t lod_emote_instances[EMOTE_LOD_LEVELS] = {0};
+
+// With ./shaders/emote_mdi.vert all of the levels of the wall are drawn
+// by a single glMultiDrawArraysIndirect(), the shader picks the size of
+// the cubes by gl_DrawIDARB. F7 switches back to a draw per level.
+typedef struct {
+    uint32_t count;
+    uint32_t instance_count;
+    uint32_t first;
+    uint32_t base_instance;
+} Draw_Arrays_Indirect_Command;
+
+Stream_Buffer indirect_stream = {0};
+bool use_indirect = true;
+// Whether the program reads gl_DrawIDARB
+bool program_draws_indirect = false;
+
+bool indirect_supported(void)
+{
+    return indirect_stream.buffer != 0 && program_draws_indirect;
+}
+
+// Indexed mesh of the `mesh` key of scene.conf, drawn instead of the emote
+// wall and the cube. Only the bounds and the levels stay on the CPU.
+GLuint mesh_vao = 0;
+GLuint mesh_vertex_buffer_id = 0;
+GLuint mesh_index_buffer_id = 0;
+size_t mesh_indices_count = 0;
+size_t mesh_vertices_count = 0;
+Aabb mesh_bounds = {0};
+// All the levels share the vertices, their indices follow each other in
+// mesh_index_buffer_id at `indices_offset` bytes
+Kmesh_Lod mesh_lods[KMESH_MAX_LODS] = {0};
+size_t mesh_lods_count = 0;
+// With ./shaders/mesh_pull.vert the VAO only has the indices and
+// mesh_vertex_buffer_id holds Vpack_Vertex for the shader to pull from,
+// next to the Vpack_Instance the mesh is drawn with
+bool program_pulls_vertices = false;
+bool mesh_pulled = false;
+GLuint mesh_instance_buffer_id = 0;
+
+// Shader locations of the mesh attributes, the same as of the cube
+static const GLuint mesh_attribute_locations[COUNT_KMESH_ATTRIBUTES] = {
+    [KMESH_ATTRIBUTE_POSITION] = 0,
+    [KMESH_ATTRIBUTE_UV]       = 1,
+    [KMESH_ATTRIBUTE_NORMAL]   = 2,
+};
+
+// Uploads the vertices with the layout of `attributes` into the mesh VAO,
+// or packed for the shader to pull them, and `indices_size` bytes of
+// `indices` where `lods` are. Returns false with a message in `error` on
+// failure.
+bool upload_mesh(const void *vertices, size_t vertices_count, size_t vertex_size,
+                 const Kmesh_Attribute *attributes, size_t attributes_count,
+                 const void *indices, size_t indices_size,
+                 const Kmesh_Lod *lods, size_t lods_count,
+                 const Aabb *bounds, const char **error)
+{
+    mesh_pulled = false;
+    glBindVertexArray(mesh_vao);
+    for (size_t kind = 0; kind < COUNT_KMESH_ATTRIBUTES; ++kind) {
+        glDisableVertexAttribArray(mesh_attribute_locations[kind]);
+    }
+
+    if (program_pulls_vertices) {
+        // Only Mesh_Vertex is packed so far, and that is all meshconv writes
+        if (vertex_size != sizeof(Mesh_Vertex) || attributes_count != KMESH_MESH_VERTEX_ATTRIBUTES ||
+                memcmp(attributes, kmesh_mesh_vertex_attributes, sizeof(kmesh_mesh_vertex_attributes)) != 0) {
+            glBindVertexArray(0);
+            *error = "only the vertex layout of meshconv can be pulled";
+            return false;
+        }
+        Vpack_Vertex *packed = malloc(vertices_count * sizeof(*packed) + 1);
+        if (packed == NULL) {
+            glBindVertexArray(0);
+            *error = strerror(ENOMEM);
+            return false;
+        }
+        const double start = timer_now();
+        vpack_vertices(workers, vertices, vertices_count, bounds, packed);
+        const double pack_secs = timer_now() - start;
+
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, mesh_vertex_buffer_id);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, vertices_count * sizeof(*packed), packed, GL_STATIC_DRAW);
+        const Vpack_Instance instance = vpack_instance(bounds);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, mesh_instance_buffer_id);
+        glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(instance), &instance, GL_STATIC_DRAW);
+        free(packed);
+        mesh_pulled = true;
+
+        printf("Packed %zu vertices for pulling in %.3f ms: %zu bytes instead of %zu\n",
+               vertices_count, pack_secs * 1000.0,
+               vertices_count * sizeof(*packed), vertices_count * vertex_size);
+    } else {
+        glBindBuffer(GL_ARRAY_BUFFER, mesh_vertex_buffer_id);
+        glBufferData(GL_ARRAY_BUFFER, vertices_count * vertex_size, vertices, GL_STATIC_DRAW);
+    }
+    for (size_t i = 0; !mesh_pulled && i < attributes_count; ++i) {
+        // KMESH_TYPE_FLOAT32 is the only type so far
+        const GLuint location = mesh_attribute_locations[attributes[i].kind];
+        glEnableVertexAttribArray(location);
+        glVertexAttribPointer(location, (GLint) attributes[i].components, GL_FLOAT, GL_FALSE,
+                              (GLsizei) vertex_size, (void*) (size_t) attributes[i].offset);
+    }
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh_index_buffer_id);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices_size, indices, GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    memcpy(mesh_lods, lods, lods_count * sizeof(*lods));
+    mesh_lods_count = lods_count;
+    mesh_indices_count = lods[0].indices_count;
+    mesh_vertices_count = vertices_count;
+    mesh_bounds = *bounds;
+    return true;
+}
+
+// Accumulated over STATS_INTERVAL_SECS and printed when enabled
+typedef struct {
+    size_t frames;
+    size_t visible;
+    size_t culled;
+    // Under the BVH nodes the occlusion or the LOD rejected
+    size_t rejected;
+    size_t triangles;
+    // Of instance_stream
+    size_t streamed;
+    size_t fence_waits;
+    size_t draw_calls;
+    // From the upload of the instances to the last draw of the wall
+    double submit_secs;
+    double cull_secs;
+    double occlusion_secs;
+    double gpu_secs;
+    size_t gpu_frames;
+    // Spent in capture_frame() on the main thread
+    double capture_secs;
+} Frame_Stats;
+
+// GPU time of the draws of a frame. The query is only read back once the
+// result is there, the frames in between are not timed.
+GLuint frame_query = 0;
+bool frame_query_pending = false;
+
+bool show_stats = false;
+Frame_Stats stats = {0};
+double stats_start = 0.0;
+
+// Frames read back asynchronously by capture.c and written as images by
+// its thread. F11 starts and stops capturing every frame, F12 captures the
+// next one, and `-capture` captures from the first frame on.
+#define CAPTURE_DEFAULT_FILE_PATH "./capture.qoi"
+Capture capture = {0};
+Capture_Images capture_images = {0};
+bool capturing = false;
+bool capture_next = false;
+double capture_start_time = 0.0;
+
+// `-record` renders into `record_fbo`, of the size of the video whatever
+// the window, advances the time by exactly 1/fps every frame however long
+// the frame took, and captures every frame into a Y4M stream converted on
+// `record_workers`. So the same scene gives the same video on any machine
+// and at any speed. `-headless` keeps the window hidden and never swaps.
+#define RECORD_DEFAULT_FPS 60
+const char *record_file_path = NULL;
+uint32_t record_fps = RECORD_DEFAULT_FPS;
+// Until the window is closed when 0
+size_t record_frames = 0;
+// Of the window when 0
+uint32_t record_width = 0;
+uint32_t record_height = 0;
+bool headless = false;
+GLuint record_fbo = 0;
+Y4m_Writer record_writer = {0};
+Pool *record_workers = NULL;
+
+void capture_start(void)
+{
+    // The screenshots taken before are not of this capture
+    capture_flush(&capture);
+    capture_reset_stats(&capture);
+    capture_images.written = 0;
+    capture_start_time = glfwGetTime();
+    capturing = true;
+    printf("Capturing every frame into %s\n", capture_images.file_path);
+}
+
+// Waits for the frames of the capture to be written and tells what the
+// capture cost the main thread
+void capture_stop(void)
+{
+    capturing = false;
+    const double secs = glfwGetTime() - capture_start_time;
+    capture_flush(&capture);
+
+    const double frames = (double) capture.frames_captured;
+    printf("Captured %zu frames in %.3f s (%.1f fps): "
+           "%.3f ms/frame on the main thread (%.1f%% of the frame time), %zu fence waits, %zu writer waits\n",
+           capture.frames_captured, secs,
+           secs > 0.0 ? frames / secs : 0.0,
+           frames > 0.0 ? capture.main_secs * 1000.0 / frames : 0.0,
+           secs > 0.0 ? capture.main_secs * 100.0 / secs : 0.0,
+           capture.fence_waits, capture.writer_waits);
+    if (record_file_path == NULL) {
+        printf("Wrote %zu frames into %s\n", capture_images.written, capture_images.file_path);
+    }
+}
+
+bool record_init(GLFWwindow *window)
+{
+    if (record_width == 0 || record_height == 0) {
+        int width, height;
+        glfwGetFramebufferSize(window, &width, &height);
+        record_width = (uint32_t) width;
+        record_height = (uint32_t) height;
+    }
+
+    GLuint renderbuffers[2];
+    glGenFramebuffers(1, &record_fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, record_fbo);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, (GLsizei) record_width, (GLsizei) record_height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, (GLsizei) record_width, (GLsizei) record_height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    const GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "ERROR: could not create the %ux%u framebuffer of the recording: status 0x%x\n",
+                record_width, record_height, status);
+        return false;
+    }
+
+    record_workers = pool_create(pool_hardware_threads() - 1);
+    if (record_workers == NULL) {
+        fprintf(stderr, "WARNING: could not start the threads converting the video: %s\n", strerror(errno));
+    }
+    if (!y4m_writer_open(&record_writer, record_file_path, record_width, record_height,
+                         record_fps, record_workers)) {
+        fprintf(stderr, "ERROR: could not write the video into %s: %s\n", record_file_path, strerror(errno));
+        return false;
+    }
+
+    // Offline, as fast as the frames go
+    glfwSwapInterval(0);
+    capture_start_time = glfwGetTime();
+    capturing = true;
+    printf("Recording %ux%u at %u fps into %s%s\n",
+           record_width, record_height, record_fps, record_file_path, headless ? ", headless" : "");
+    return true;
+}
+
+// After capture_stop()
+void record_finish(void)
+{
+    const double secs = glfwGetTime() - capture_start_time;
+    const double frames = (double) record_writer.frames_written;
+    const double video_secs = frames / (double) record_fps;
+    printf("Recorded %zu frames (%.3f s of video) into %s in %.3f s, %.2fx real time: "
+           "converting %.3f ms/frame on %zu threads, writing %.3f ms/frame\n",
+           record_writer.frames_written, video_secs, record_file_path, secs,
+           secs > 0.0 ? video_secs / secs : 0.0,
+           frames > 0.0 ? record_writer.convert_secs * 1000.0 / frames : 0.0,
+           pool_workers_count(record_workers),
+           frames > 0.0 ? record_writer.write_secs * 1000.0 / frames : 0.0);
+    if (!y4m_writer_close(&record_writer)) {
+        fprintf(stderr, "ERROR: could not finish the video %s: %s\n", record_file_path, strerror(errno));
+    }
+    if (record_workers != NULL) pool_destroy(record_workers);
+    record_workers = NULL;
+}
+
+// Of what the frame renders into
+void frame_size(GLFWwindow *window, int *width, int *height)
+{
+    if (record_fbo != 0) {
+        *width = (int) record_width;
+        *height = (int) record_height;
+    } else {
+        glfwGetFramebufferSize(window, width, height);
+    }
+}
+
+void free_instances(void)
+{
+    free(instances);
+    free(instance_centers);
+    free(visible_indices);
+    free(instance_aabbs);
+    free(occluders);
+    free(emote_centers);
+    free(emote_extents);
+    free(visible_emotes);
+    free(emote_levels);
+    for (size_t level = 1; level < EMOTE_LOD_LEVELS; ++level) {
+        free(lod_instances[level]);
+        lod_instances[level] = NULL;
+        lod_emote_instances[level] = 0;
+    }
+    instances = NULL;
+    instance_centers = NULL;
+    visible_indices = NULL;
+    instance_aabbs = NULL;
+    occluders = NULL;
+    emote_centers = NULL;
+    emote_extents = NULL;
+    visible_emotes = NULL;
+    emote_levels = NULL;
+    instances_count = 0;
+    occluders_count = 0;
+    wall_emotes = 0;
+    wall_side = 0;
+    wall_layers = 0;
+
+    region_free(&bvh_memory);
+    memset(&instances_bvh, 0, sizeof(instances_bvh));
+}
+
+// uniform blocks begin
+// The blocks of a frame go into uniform_stream one after the other, each
+// at its own multiple of uniform_block_stride: Frame_Uniforms,
+// View_Uniforms, then a Material_Uniforms per level of detail of the emote
+// wall. They are bound by range to the bindings of Uniform_Binding, which
+// every program is told about once it is linked, so nothing is looked up
+// by name while drawing.
+#define UNIFORM_MATERIALS EMOTE_LOD_LEVELS
+#define UNIFORM_BLOCKS (2 + UNIFORM_MATERIALS)
+
+static const char *const uniform_block_names[COUNT_UNIFORM_BINDINGS] = {
+    [UNIFORM_BINDING_FRAME] = "Frame",
+    [UNIFORM_BINDING_VIEW] = "View",
+    [UNIFORM_BINDING_MATERIAL] = "Material",
+};
+
+Stream_Buffer uniform_stream = {0};
+// The biggest block rounded up to GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT
+size_t uniform_block_stride = 0;
+// Of the blocks of the current frame
+size_t uniform_stream_offset = 0;
+
+bool uniform_blocks_init(void)
+{
+    GLint alignment = 0;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    if (alignment <= 0) alignment = 1;
+
+    size_t size = sizeof(Frame_Uniforms);
+    if (size < sizeof(View_Uniforms)) size = sizeof(View_Uniforms);
+    if (size < sizeof(Material_Uniforms)) size = sizeof(Material_Uniforms);
+    uniform_block_stride = (size + (size_t) alignment - 1) / (size_t) alignment * (size_t) alignment;
+
+    return stream_buffer_init(&uniform_stream, GL_UNIFORM_BUFFER,
+                              UNIFORM_BLOCKS * uniform_block_stride, true);
+}
+
+// The bindings are a part of the program, set again for every program
+void uniform_blocks_bind(GLuint program)
+{
+    for (size_t binding = 0; binding < COUNT_UNIFORM_BINDINGS; ++binding) {
+        const GLuint index = glGetUniformBlockIndex(program, uniform_block_names[binding]);
+        if (index != GL_INVALID_INDEX) glUniformBlockBinding(program, index, (GLuint) binding);
+    }
+}
+
+void uniform_material_bind(size_t material)
+{
+    glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BINDING_MATERIAL, uniform_stream.buffer,
+                      (GLintptr) (uniform_stream_offset + (2 + material) * uniform_block_stride),
+                      sizeof(Material_Uniforms));
+}
+
+// Once per frame, before the draws. Binds the frame, the view and the
+// first material, the draws bind the others with uniform_material_bind().
+void uniform_blocks_stream(const Frame_Uniforms *frame, const View_Uniforms *view,
+                           const Material_Uniforms materials[UNIFORM_MATERIALS])
+{
+    unsigned char *data = stream_buffer_map(&uniform_stream);
+    memcpy(data, frame, sizeof(*frame));
+    memcpy(data + uniform_block_stride, view, sizeof(*view));
+    for (size_t material = 0; material < UNIFORM_MATERIALS; ++material) {
+        memcpy(data + (2 + material) * uniform_block_stride, &materials[material], sizeof(*materials));
+    }
+    uniform_stream_offset = stream_buffer_unmap(&uniform_stream, UNIFORM_BLOCKS * uniform_block_stride);
+
+    glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BINDING_FRAME, uniform_stream.buffer,
+                      (GLintptr) uniform_stream_offset, sizeof(Frame_Uniforms));
+    glBindBufferRange(GL_UNIFORM_BUFFER, UNIFORM_BINDING_VIEW, uniform_stream.buffer,
+                      (GLintptr) (uniform_stream_offset + uniform_block_stride), sizeof(View_Uniforms));
+    uniform_material_bind(0);
+}
+// uniform blocks end
+
+void program_use(GLuint program)
+{
+    glUseProgram(program);
+    uniform_blocks_bind(program);
+    // The mesh needs to know whether the program pulls the vertices, the
+    // emote wall whether it can be drawn with a single multi-draw
+    program_pulls_vertices =
+        (GLEW_VERSION_4_3 || GLEW_ARB_shader_storage_buffer_object) &&
+        glGetProgramResourceIndex(program, GL_SHADER_STORAGE_BLOCK, "Mesh_Vertices") != GL_INVALID_INDEX;
+    program_draws_indirect =
+        (GLEW_VERSION_4_3 || GLEW_ARB_program_interface_query) &&
+        glGetProgramResourceIndex(program, GL_PROGRAM_INPUT, "gl_DrawIDARB") != GL_INVALID_INDEX;
+}
+
+// shader variants begin
+// Every combination of the Shader_Features is a variant of the program of
+// scene.conf. The reload builds the current one, the others are built the
+// first time they are switched to and kept until the next reload. Built
+// programs go into the program cache on disk too, so across reloads and
+// runs they are neither compiled nor linked again while their files stay
+// the same.
+#define COUNT_SHADER_VARIANTS (1u << COUNT_SHADER_FEATURES)
+
+typedef struct {
+    GLuint program;
+    // Not tried again until the next reload
+    bool failed;
+} Shader_Variant;
+
+// Since the start
+typedef struct {
+    size_t lookups;
+    size_t memory_hits;
+    size_t disk_hits;
+    size_t compiled;
+    double compile_secs;
+} Shader_Variant_Stats;
+
+Shader_Variant shader_variants[COUNT_SHADER_VARIANTS] = {0};
+// Everything on. F8, F9 and F10 toggle the features.
+unsigned shader_variant = COUNT_SHADER_VARIANTS - 1;
+Shader_Variant_Stats shader_variant_stats = {0};
+
+// Long enough for every feature at once
+#define SHADER_VARIANT_NAME_CAPACITY 64
+
+// Into `name`, so two names can go into the same printf()
+const char *shader_variant_name(unsigned variant, char name[SHADER_VARIANT_NAME_CAPACITY])
+{
+    size_t size = 0;
+    name[0] = '\0';
+    for (size_t feature = 0; feature < COUNT_SHADER_FEATURES; ++feature) {
+        if (variant & (1u << feature)) {
+            size += (size_t) snprintf(name + size, SHADER_VARIANT_NAME_CAPACITY - size, "%s%s",
+                                      size > 0 ? " " : "", shader_feature_defines[feature]);
+        }
+    }
+    return size > 0 ? name : "without features";
+}
+
+// Also deletes the program of a reload that failed after creating it,
+// which never made it into `shader_variants`
+void shader_variants_reset(void)
+{
+    bool program_stored = false;
+    for (size_t i = 0; i < COUNT_SHADER_VARIANTS; ++i) {
+        if (shader_variants[i].program == program) program_stored = true;
+        glDeleteProgram(shader_variants[i].program);
+    }
+    if (!program_stored) glDeleteProgram(program);
+    memset(shader_variants, 0, sizeof(shader_variants));
+    program = 0;
+}
+
+void shader_variant_built(unsigned variant, GLuint program, double secs, bool from_disk)
+{
+    shader_variants[variant] = (Shader_Variant) {.program = program};
+    shader_variant_stats.lookups += 1;
+    if (from_disk) {
+        shader_variant_stats.disk_hits += 1;
+    } else {
+        shader_variant_stats.compiled += 1;
+        shader_variant_stats.compile_secs += secs;
+    }
+    char name[SHADER_VARIANT_NAME_CAPACITY];
+    printf("Shader variant %s: %s in %.3f ms\n",
+           shader_variant_name(variant, name),
+           from_disk ? "loaded from the program cache" : "compiled and linked",
+           secs * 1000.0);
+}
+
+void shader_variant_print_stats(void)
+{
+    size_t built = 0;
+    for (size_t i = 0; i < COUNT_SHADER_VARIANTS; ++i) {
+        if (shader_variants[i].program != 0) built += 1;
+    }
+    const Shader_Variant_Stats *stats = &shader_variant_stats;
+    const size_t hits = stats->memory_hits + stats->disk_hits;
+    printf("Shader variants: %zu/%u built, %zu compiled in %.3f ms, %zu loaded from %s, "
+           "%zu/%zu lookups hit a cache (%.0f%%)\n",
+           built, COUNT_SHADER_VARIANTS,
+           stats->compiled, stats->compile_secs * 1000.0,
+           stats->disk_hits, progcache_supported() ? PROGCACHE_DIR : "nowhere, no program binaries",
+           hits, stats->lookups,
+           stats->lookups > 0 ? 100.0 * (double) hits / (double) stats->lookups : 0.0);
+}
+
+void shader_print_files(const char *const *files, size_t files_count)
+{
+    for (size_t file = 0; files_count > 1 && file < files_count; ++file) {
+        fprintf(stderr, "  %zu: %s\n", file, files[file]);
+    }
+}
+
+GLuint shader_variant_compile(const Glsl_Source *source, GLenum type)
+{
+    const GLuint shader = compile_shader_source(source->source, type);
+    if (!shader_compiled(shader)) {
+        fprintf(stderr, "ERROR: failed to compile %s shader `%s`\n",
+                type == GL_VERTEX_SHADER ? "vertex" : "fragment", source->files[0]);
+        shader_print_files(source->files, source->files_count);
+        glDeleteShader(shader);
+        return 0;
+    }
+    return shader;
+}
+
+// On the main thread, everything but the first variant is built while
+// drawing anyway. The files are the ones of the last reload.
+bool shader_variant_build(unsigned variant)
+{
+    Region *region = &hot_reload_memory;
+    shader_variant_defines(variant);
+
+    const double start = timer_now();
+    Glsl_Source vert_source = {0};
+    Glsl_Source frag_source = {0};
+    const char *error = NULL;
+    if (!glsl_expand(region, shader_variant_vert_file_path, shader_defines, shader_defines_count,
+                     reload_glsl_load, NULL, &vert_source, &error) ||
+            !glsl_expand(region, shader_variant_frag_file_path, shader_defines, shader_defines_count,
+                         reload_glsl_load, NULL, &frag_source, &error)) {
+        fprintf(stderr, "ERROR: %s\n", error);
+        region_clean(region);
+        return false;
+    }
+
+    const uint64_t key = progcache_key(vert_source.hash, frag_source.hash);
+    GLuint variant_program = 0;
+    const bool from_disk = progcache_load(region, PROGCACHE_DIR, key, &variant_program);
+    if (!from_disk) {
+        const GLuint vert = shader_variant_compile(&vert_source, GL_VERTEX_SHADER);
+        const GLuint frag = vert != 0 ? shader_variant_compile(&frag_source, GL_FRAGMENT_SHADER) : 0;
+        if (frag != 0) {
+            variant_program = link_program(vert, frag);
+            if (!program_linked(variant_program)) {
+                glDeleteProgram(variant_program);
+                variant_program = 0;
+            }
+        }
+        // Stay attached to the program until it is deleted
+        glDeleteShader(vert);
+        glDeleteShader(frag);
+    }
+    const double secs = timer_now() - start;
+
+    if (variant_program != 0 && !from_disk && progcache_supported() &&
+            !progcache_save(region, PROGCACHE_DIR, key, variant_program)) {
+        char name[SHADER_VARIANT_NAME_CAPACITY];
+        printf("WARNING: could not save shader variant %s into program cache %s: %s\n",
+               shader_variant_name(variant, name), PROGCACHE_DIR, strerror(errno));
+    }
+    region_clean(region);
+
+    if (variant_program == 0) return false;
+    shader_variant_built(variant, variant_program, secs, from_disk);
+    return true;
+}
+
+// Switches to `variant`, building it on the first use. A variant that
+// does not build leaves the current one in place.
+void shader_variant_use(unsigned variant)
+{
+    char name[SHADER_VARIANT_NAME_CAPACITY];
+    char current_name[SHADER_VARIANT_NAME_CAPACITY];
+    if (program_failed) {
+        // Whatever the next reload builds
+        shader_variant = variant;
+        printf("Shader variant %s\n", shader_variant_name(variant, name));
+        return;
+    }
+
+    Shader_Variant *v = &shader_variants[variant];
+    if (v->program != 0) {
+        shader_variant_stats.lookups += 1;
+        shader_variant_stats.memory_hits += 1;
+        printf("Shader variant %s: already built\n", shader_variant_name(variant, name));
+    } else if (v->failed || !shader_variant_build(variant)) {
+        v->failed = true;
+        fprintf(stderr, "ERROR: could not build shader variant %s, staying with %s\n",
+                shader_variant_name(variant, name), shader_variant_name(shader_variant, current_name));
+        return;
+    }
+
+    shader_variant = variant;
+    program = v->program;
+    program_use(program);
+    shader_variant_print_stats();
+}
+// shader variants end
+
+// Returns false on the first stage that fails, after printing why. The
+// workers started by it may still be running.
+bool reload_scene_stages(void)
 {
     const char *const scene_conf_file_path = "./scene.conf";
     const char *vertex_shader_file_path = NULL;
@@ -95,16 +1313,57 @@ void reload_scene(void)
     size_t fragment_shader_def_line = 0;
     const char *texture_file_path = NULL;
     size_t texture_def_line = 0;
-
-    glClearColor(HOT_RELOAD_ERROR_COLOR);
-    program_failed = true;
+    const char *mesh_file_path = NULL;
+    size_t mesh_def_line = 0;
+    Texture_Format texture_format = TEXTURE_FORMAT_RGBA;
+    size_t emote_wall = 0;
+    size_t emote_wall_layers = 1;
+    Lod_Config lod = {
+        .pixels = LOD_DEFAULT_PIXELS,
+        .fog_distance = LOD_DEFAULT_FOG_DISTANCE,
+    };
+
+    // A failed reload may have left the workers running with the defines
+    // and the pack of the last one
+    for (size_t i = 0; i < COUNT_RELOAD_FILES; ++i) {
+        pool_async_wait(&reload_files[i].async);
+    }
+    region_clean(&shader_variant_memory);
+    shader_scene_defines_count = 0;
+    shader_cache_hits = 0;
+    shader_cache_misses = 0;
+
+    // Watched even when they are broken, fixing them reloads the scene
+    watch_clear(&scene_watch);
+    watch_add(&scene_watch, scene_conf_file_path);
+    if (asset_pack_file_path != NULL) watch_add(&scene_watch, asset_pack_file_path);
+
+    // reload asset pack begin
+    if (asset_pack_file_path != NULL) {
+        // Remapped on every reload so a rebuilt pack is picked up by F5
+        pack_close(&asset_pack);
+
+        const char *error = NULL;
+        if (!pack_open(asset_pack_file_path, &asset_pack, workers, &error)) {
+            fprintf(stderr, "ERROR: could not open asset pack %s: %s\n",
+                    asset_pack_file_path, error);
+            return false;
+        }
+    }
+    // reload asset pack end
 
     // reload scene.conf begin
     {
-        String_View scene_conf_content = sv_from_cstr(region_slurp_file(&hot_reload_memory, scene_conf_file_path));
-        if (scene_conf_content.data == NULL) {
-            return;
+        Asset scene_conf_asset = {0};
+        if (!asset_load(&hot_reload_memory, scene_conf_file_path, &scene_conf_asset)) {
+            fprintf(stderr, "ERROR: could not read file %s: %s\n",
+                    scene_conf_file_path, strerror(errno));
+            return false;
         }
+        String_View scene_conf_content = {
+            .count = scene_conf_asset.size,
+            .data = scene_conf_asset.data,
+        };
 
         for (size_t line_number = 0; scene_conf_content.count > 0; line_number++) {
             String_View line = sv_chop_by_delim(&scene_conf_content, '\n');
@@ -122,6 +1381,35 @@ void reload_scene(void)
                 } else if (sv_eq(key, SV("texture"))) {
                     texture_file_path = region_cstr_from_sv(&hot_reload_memory, value);
                     texture_def_line = line_number;
+                } else if (sv_eq(key, SV("texture_format"))) {
+                    if (!texture_format_by_name(value, &texture_format)) {
+                        printf("%s:%zu: WARNING: unknown texture format `"SV_Fmt"`, falling back to `%s`\n",
+                               scene_conf_file_path, line_number,
+                               SV_Arg(value), texture_format_name(TEXTURE_FORMAT_RGBA));
+                        texture_format = TEXTURE_FORMAT_RGBA;
+                    }
+                } else if (sv_eq(key, SV("mesh"))) {
+                    mesh_file_path = region_cstr_from_sv(&hot_reload_memory, value);
+                    mesh_def_line = line_number;
+                } else if (sv_eq(key, SV("emote_wall"))) {
+                    emote_wall = (size_t) sv_to_u64(value);
+                } else if (sv_eq(key, SV("emote_wall_layers"))) {
+                    emote_wall_layers = (size_t) sv_to_u64(value);
+                    if (emote_wall_layers == 0) emote_wall_layers = 1;
+                } else if (sv_eq(key, SV("lod_pixels"))) {
+                    lod.pixels = sv_to_float(value);
+                } else if (sv_eq(key, SV("fog_distance"))) {
+                    lod.fog_distance = sv_to_float(value);
+                } else if (sv_eq(key, SV("shader_define"))) {
+                    if (shader_scene_defines_count < SHADER_MAX_DEFINES) {
+                        shader_defines[shader_scene_defines_count++] = (String_View) {
+                            .count = value.count,
+                            .data = region_cstr_from_sv(&shader_variant_memory, value),
+                        };
+                    } else {
+                        printf("%s:%zu: WARNING: more than %d shader defines, ignoring `"SV_Fmt"`\n",
+                               scene_conf_file_path, line_number, SHADER_MAX_DEFINES, SV_Arg(value));
+                    }
                 } else {
                     printf("%s:%zu: WARNING: unknown key `"SV_Fmt"`\n",
                            scene_conf_file_path, line_number,
@@ -133,63 +1421,75 @@ void reload_scene(void)
         if (vertex_shader_file_path == NULL) {
             fprintf(stderr, "ERROR: `vert_shader` is not specified in %s\n",
                     scene_conf_file_path);
-            return;
+            return false;
         }
 
         if (fragment_shader_file_path == NULL) {
             fprintf(stderr, "ERROR: `frag_shader` is not specified in %s\n",
                     scene_conf_file_path);
-            return;
+            return false;
         }
 
         if (texture_file_path == NULL) {
             fprintf(stderr, "ERROR: `texture` is not specified in %s\n",
                     scene_conf_file_path);
-            return;
+            return false;
         }
     }
     // reload scene.conf end
 
-    // reload shader program begin
+    // reload files begin
     {
-        glDeleteProgram(program);
-
-        char *vert_source = region_slurp_file(&hot_reload_memory, vertex_shader_file_path);
-        if (vert_source == NULL) {
-            fprintf(stderr, "%s:%zu: ERROR: Could not read file `%s`: %s\n",
-                    scene_conf_file_path, vertex_shader_def_line, vertex_shader_file_path, strerror(errno));
-            return;
+        if (!texture_format_supported(texture_format)) {
+            printf("%s:%zu: WARNING: texture format `%s` is not supported by the driver, falling back to `%s`\n",
+                   scene_conf_file_path, texture_def_line,
+                   texture_format_name(texture_format),
+                   texture_format_name(TEXTURE_FORMAT_RGBA));
+            texture_format = TEXTURE_FORMAT_RGBA;
         }
 
-        GLuint vert = 0;
-        if (!compile_shader_source(vert_source, GL_VERTEX_SHADER, &vert)) {
-            fprintf(stderr, "%s:%zu: ERROR: Failed to compile vertex shader `%s`\n",
-                    scene_conf_file_path, vertex_shader_def_line, vertex_shader_file_path);
-            return;
-        }
+        watch_add(&scene_watch, texture_file_path);
+        if (mesh_file_path != NULL) watch_add(&scene_watch, mesh_file_path);
 
-        char *frag_source = region_slurp_file(&hot_reload_memory, fragment_shader_file_path);
-        if (frag_source == NULL) {
-            fprintf(stderr, "%s:%zu: ERROR: Could not read file `%s`: %s\n",
-                    scene_conf_file_path, fragment_shader_def_line, fragment_shader_file_path, strerror(errno));
-            return;
-        }
+        shader_variant_vert_file_path = region_cstr_from_sv(&shader_variant_memory, sv_from_cstr(vertex_shader_file_path));
+        shader_variant_frag_file_path = region_cstr_from_sv(&shader_variant_memory, sv_from_cstr(fragment_shader_file_path));
+        shader_variant_defines(shader_variant);
 
-        GLuint frag = 0;
-        if (!compile_shader_source(frag_source, GL_FRAGMENT_SHADER, &frag)) {
-            fprintf(stderr, "%s:%zu: ERROR: Failed to compile fragment shader `%s`\n",
-                    scene_conf_file_path, fragment_shader_def_line, fragment_shader_file_path);
-            return;
-        }
+        // The texture goes first, it takes the longest
+        reload_files[RELOAD_TEXTURE].texture_format = texture_format;
+        reload_files[RELOAD_TEXTURE].decode_pixels = emote_wall > 0;
+        reload_file_start(&reload_files[RELOAD_TEXTURE], texture_file_path, texture_def_line);
+        reload_file_start(&reload_files[RELOAD_VERTEX_SHADER], vertex_shader_file_path, vertex_shader_def_line);
+        reload_file_start(&reload_files[RELOAD_FRAGMENT_SHADER], fragment_shader_file_path, fragment_shader_def_line);
+    }
+    // reload files end
 
-        if (!link_program(vert, frag, &program)) {
-            fprintf(stderr, "ERROR: failed to link shader program\n");
-            return;
+    // reload shader program begin
+    GLuint vert = 0;
+    GLuint frag = 0;
+    uint64_t program_key = 0;
+    bool program_cached = false;
+    {
+        shader_variants_reset();
+
+        if (!reload_file_wait(&reload_files[RELOAD_VERTEX_SHADER], scene_conf_file_path) ||
+                !reload_file_wait(&reload_files[RELOAD_FRAGMENT_SHADER], scene_conf_file_path)) {
+            return false;
         }
 
-        glUseProgram(program);
-        time_location = glGetUniformLocation(program, "time");
-        resolution_location = glGetUniformLocation(program, "resolution");
+        // A program from the program cache needs neither of the shaders
+        program_key = progcache_key(reload_shader_hash(&reload_files[RELOAD_VERTEX_SHADER]),
+                                    reload_shader_hash(&reload_files[RELOAD_FRAGMENT_SHADER]));
+        program_cached = progcache_load(&hot_reload_memory, PROGCACHE_DIR, program_key, &program);
+        if (!program_cached) {
+            reload_shader_touch(&reload_files[RELOAD_VERTEX_SHADER]);
+            reload_shader_touch(&reload_files[RELOAD_FRAGMENT_SHADER]);
+            vert = reload_shader_compile(&reload_files[RELOAD_VERTEX_SHADER]);
+            frag = reload_shader_compile(&reload_files[RELOAD_FRAGMENT_SHADER]);
+
+            // Whether it worked is asked after the texture and the emote wall
+            program = link_program(vert, frag);
+        }
     }
     // reload shader program end
 
@@ -197,12 +1497,10 @@ void reload_scene(void)
     {
         glDeleteTextures(1, &texture_id);
 
-        int w, h;
-        uint32_t *pixels = (uint32_t*) stbi_load(texture_file_path, &w, &h, NULL, 4);
-        if (pixels == NULL) {
-            fprintf(stderr, "%s:%zu: ERROR: could not load file %s: %s\n",
-                    scene_conf_file_path, texture_def_line, texture_file_path, strerror(errno));
-            return;
+        if (!reload_file_wait(&reload_files[RELOAD_TEXTURE], scene_conf_file_path)) {
+            fprintf(stderr, "%s:%zu: ERROR: could not load texture %s\n",
+                    scene_conf_file_path, texture_def_line, texture_file_path);
+            return false;
         }
 
         glGenTextures(1, &texture_id);
@@ -214,24 +1512,328 @@ void reload_scene(void)
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
         glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 
-        glTexImage2D(GL_TEXTURE_2D,
-                     0,
-                     GL_RGBA,
-                     w,
-                     h,
-                     0,
-                     GL_RGBA,
-                     GL_UNSIGNED_BYTE,
-                     pixels);
-        glGenerateMipmap(GL_TEXTURE_2D);
+        reload_texture_upload(&reload_files[RELOAD_TEXTURE]);
     }
     // reload texture end
 
+    // reload emote wall begin
+    {
+        free_instances();
+        glDisableVertexAttribArray(INSTANCE_POSITION_INDEX);
+        glDisableVertexAttribArray(INSTANCE_COLOR_INDEX);
+
+        if (emote_wall > 0) {
+            // Decoded by the workers along with the texture
+            const Image image = reload_files[RELOAD_TEXTURE].image;
+
+            // Millions of instances do not belong in hot_reload_memory,
+            // which is cleaned after every reload
+            const size_t emotes = emote_wall * emote_wall;
+            const size_t capacity = emotes * emote_wall_layers * emote_instances_capacity(image);
+            // Every level of detail may be visible at once
+            visible_capacity = capacity;
+            for (size_t level = 1; level < EMOTE_LOD_LEVELS; ++level) {
+                const size_t lod_capacity = emotes * emote_lod_capacity(image, emote_wall_layers, level);
+                lod_instances[level] = malloc(lod_capacity * sizeof(*lod_instances[level]) + 1);
+                if (lod_instances[level] == NULL) {
+                    fprintf(stderr, "ERROR: not enough memory for %zu emote instances\n", lod_capacity);
+                    free_instances();
+                    return false;
+                }
+                visible_capacity += lod_capacity;
+            }
+            instances = malloc(capacity * sizeof(*instances) + 1);
+            instance_centers = malloc(capacity * V3_COMPS * sizeof(*instance_centers) + 1);
+            visible_indices = malloc(capacity * sizeof(*visible_indices) + 1);
+            instance_aabbs = malloc(capacity * sizeof(*instance_aabbs) + 1);
+            occluders = malloc(emotes * emote_instances_capacity(image) * sizeof(*occluders) + 1);
+            emote_centers = malloc(emotes * V3_COMPS * sizeof(*emote_centers) + 1);
+            emote_extents = malloc(emotes * V3_COMPS * sizeof(*emote_extents) + 1);
+            visible_emotes = malloc(emotes * sizeof(*visible_emotes) + 1);
+            emote_levels = malloc(emotes * sizeof(*emote_levels) + 1);
+            if (instances == NULL || instance_centers == NULL ||
+                    visible_indices == NULL ||
+                    instance_aabbs == NULL || occluders == NULL ||
+                    emote_centers == NULL || emote_extents == NULL ||
+                    visible_emotes == NULL || emote_levels == NULL) {
+                fprintf(stderr, "ERROR: not enough memory for %zu emote instances\n", capacity);
+                free_instances();
+                return false;
+            }
+
+            const double start = timer_now();
+            instances_count = emote_build_wall(workers, image, emote_wall, emote_wall_layers,
+                                               instances, instances_extent);
+            occluders_count = emote_build_occluders(image, emote_wall, emote_wall_layers, occluders);
+            size_t lod_count = 0;
+            for (size_t level = 1; level < EMOTE_LOD_LEVELS; ++level) {
+                const size_t count = emote_build_lod(image, emote_wall, emote_wall_layers, level, lod_instances[level]);
+                lod_emote_instances[level] = count / emotes;
+                lod_count += count;
+            }
+            const double build_secs = timer_now() - start;
+
+            wall_emotes = emotes;
+            wall_side = emote_wall;
+            wall_layers = emote_wall_layers;
+            wall_pitch[X] = (float) (image.width + EMOTE_WALL_GAP);
+            wall_pitch[Y] = (float) (image.height + EMOTE_WALL_GAP);
+            for (size_t i = 0; i < emotes; ++i) {
+                Aabb bounds;
+                emote_wall_bounds(image, emote_wall, emote_wall_layers, i, &bounds);
+                for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+                    emote_centers[axis * emotes + i] = 0.5f * (bounds.min[axis] + bounds.max[axis]);
+                    emote_extents[axis * emotes + i] = 0.5f * (bounds.max[axis] - bounds.min[axis]);
+                }
+            }
+
+            for (size_t i = 0; i < instances_count; ++i) {
+                for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+                    instance_centers[axis * instances_count + i] = instances[i].position[axis] + 0.5f;
+                    instance_aabbs[i].min[axis] = instances[i].position[axis];
+                    instance_aabbs[i].max[axis] = instances[i].position[axis] + 1.0f;
+                }
+            }
+
+            // Without the hierarchy the wall is still culled, just slower
+            const double bvh_start = timer_now();
+            bvh_memory = region_with_capacity(bvh_memory_size(instances_count));
+            if (!bvh_build(&bvh_memory, workers, instance_aabbs, instances_count, &instances_bvh)) {
+                fprintf(stderr, "WARNING: could not build the BVH of the emote wall: %s\n",
+                        strerror(errno));
+            }
+            const double bvh_secs = timer_now() - bvh_start;
+
+            // Filled with the visible instances every frame
+            stream_buffer_free(&instance_stream);
+            if (!stream_buffer_init(&instance_stream, GL_ARRAY_BUFFER,
+                                    visible_capacity * sizeof(Emote_Instance), use_persistent_stream)) {
+                fprintf(stderr, "ERROR: not enough memory for %zu emote instances\n", visible_capacity);
+                free_instances();
+                return false;
+            }
+
+            glEnableVertexAttribArray(INSTANCE_POSITION_INDEX);
+            glVertexAttribPointer(INSTANCE_POSITION_INDEX,
+                                  V3_COMPS,
+                                  GL_FLOAT,
+                                  GL_FALSE,
+                                  sizeof(Emote_Instance),
+                                  (void*) offsetof(Emote_Instance, position));
+            glVertexAttribDivisor(INSTANCE_POSITION_INDEX, 1);
+
+            glEnableVertexAttribArray(INSTANCE_COLOR_INDEX);
+            glVertexAttribPointer(INSTANCE_COLOR_INDEX,
+                                  RGBA_COMPS,
+                                  GL_UNSIGNED_BYTE,
+                                  GL_TRUE,
+                                  sizeof(Emote_Instance),
+                                  (void*) offsetof(Emote_Instance, color));
+            glVertexAttribDivisor(INSTANCE_COLOR_INDEX, 1);
+
+            printf("Emote wall: %zux%zux%zu of %s, %zu cubes, %zu cubes of the coarser levels and %zu occluders built in %.3f ms\n",
+                   emote_wall, emote_wall, emote_wall_layers, texture_file_path,
+                   instances_count, lod_count, occluders_count, build_secs * 1000.0);
+            printf("Emote wall: BVH of %zu nodes built in %.3f ms\n",
+                   instances_bvh.nodes_count, bvh_secs * 1000.0);
+        }
+    }
+    // reload emote wall end
+
+    // link shader program begin
+    {
+        const double start = timer_now();
+        if (!program_cached) {
+            const bool vert_compiled = shader_compiled(vert);
+            const bool frag_compiled = shader_compiled(frag);
+            if (!vert_compiled) {
+                fprintf(stderr, "%s:%zu: ERROR: Failed to compile vertex shader `%s`\n",
+                        scene_conf_file_path, vertex_shader_def_line, vertex_shader_file_path);
+                reload_shader_failed(vert);
+            }
+            if (!frag_compiled) {
+                fprintf(stderr, "%s:%zu: ERROR: Failed to compile fragment shader `%s`\n",
+                        scene_conf_file_path, fragment_shader_def_line, fragment_shader_file_path);
+                reload_shader_failed(frag);
+            }
+            if (!vert_compiled || !frag_compiled) return false;
+            if (!program_linked(program)) {
+                fprintf(stderr, "ERROR: failed to link shader program\n");
+                return false;
+            }
+        }
+        reload_shader_wait_secs = timer_now() - start;
+
+        if (!program_cached && progcache_supported() &&
+                !progcache_save(&hot_reload_memory, PROGCACHE_DIR, program_key, program)) {
+            printf("WARNING: could not save shader program into program cache %s: %s\n",
+                   PROGCACHE_DIR, strerror(errno));
+        }
+        shader_variant_built(shader_variant, program, reload_shader_wait_secs, program_cached);
+        program_use(program);
+    }
+    // link shader program end
+
+    // reload mesh begin
+    {
+        mesh_indices_count = 0;
+        mesh_lods_count = 0;
+
+        if (mesh_file_path != NULL) {
+            // Meshes of millions of triangles do not fit hot_reload_memory,
+            // they are loaded straight from the pack or a memory mapping
+            const double start = timer_now();
+            Mapped_File file = {0};
+            const char *data = NULL;
+            size_t size = 0;
+            const Pack_Entry *entry = pack_find(&asset_pack, mesh_file_path);
+            if (entry != NULL) {
+                data = pack_entry_data(&asset_pack, entry);
+                size = entry->size;
+            } else if (mapped_file_open(mesh_file_path, &file)) {
+                mapped_file_will_need(&file);
+                data = file.data;
+                size = file.size;
+            } else {
+                fprintf(stderr, "%s:%zu: ERROR: could not read file %s: %s\n",
+                        scene_conf_file_path, mesh_def_line, mesh_file_path, strerror(errno));
+                return false;
+            }
+
+            // The binary cache goes to the GPU straight from the mapping,
+            // the text formats are parsed first
+            const char *error = NULL;
+            bool ok = false;
+            const char *how = NULL;
+            if (sv_ends_with(sv_from_cstr(mesh_file_path), SV(KMESH_EXTENSION))) {
+                Kmesh kmesh = {0};
+                ok = kmesh_view(data, size, &kmesh, &error);
+                if (ok) {
+                    // The levels are stored one after another, so they go
+                    // in one piece, padding included
+                    const size_t lods_count = kmesh.header->lods_count;
+                    const uint64_t first = kmesh.lods[0].indices_offset;
+                    Kmesh_Lod lods[KMESH_MAX_LODS];
+                    for (size_t level = 0; level < lods_count; ++level) {
+                        lods[level] = kmesh.lods[level];
+                        lods[level].indices_offset -= first;
+                    }
+                    const Kmesh_Lod *last = &lods[lods_count - 1];
+                    Aabb bounds = {0};
+                    memcpy(bounds.min, kmesh.header->bounds_min, sizeof(bounds.min));
+                    memcpy(bounds.max, kmesh.header->bounds_max, sizeof(bounds.max));
+                    ok = upload_mesh(kmesh.vertices, kmesh.header->vertices_count, kmesh.header->vertex_size,
+                                     kmesh.attributes, kmesh.header->attributes_count,
+                                     kmesh_lod_indices(&kmesh, 0),
+                                     last->indices_offset + last->indices_count * sizeof(uint32_t),
+                                     lods, lods_count, &bounds, &error);
+                    how = "mapped";
+                }
+            } else {
+                Mesh mesh = {0};
+                Simplify_Lod simplified[SIMPLIFY_LEVELS] = {0};
+                uint32_t *indices = NULL;
+                ok = mesh_parse(mesh_file_path, data, size, workers, &mesh, &error);
+                // The levels meshconv would store are simplified on the
+                // workers, one level each
+                if (ok && !simplify_lods(workers, &mesh, 1, simplified)) {
+                    ok = false;
+                    error = strerror(errno);
+                }
+                size_t indices_count = mesh.indices_count;
+                for (size_t level = 0; ok && level < SIMPLIFY_LEVELS; ++level) {
+                    indices_count += simplified[level].indices_count;
+                }
+                if (ok) {
+                    indices = malloc(indices_count * sizeof(*indices) + 1);
+                    if (indices == NULL) {
+                        ok = false;
+                        error = strerror(ENOMEM);
+                    }
+                }
+                if (ok) {
+                    Kmesh_Lod lods[SIMPLIFY_LEVELS + 1] = {
+                        {.indices_count = mesh.indices_count},
+                    };
+                    memcpy(indices, mesh.indices, mesh.indices_count * sizeof(*indices));
+                    size_t offset = mesh.indices_count;
+                    for (size_t level = 0; level < SIMPLIFY_LEVELS; ++level) {
+                        lods[level + 1] = (Kmesh_Lod) {
+                            .indices_offset = offset * sizeof(*indices),
+                            .indices_count = simplified[level].indices_count,
+                            .error = simplified[level].error,
+                        };
+                        memcpy(&indices[offset], simplified[level].indices,
+                               simplified[level].indices_count * sizeof(*indices));
+                        offset += simplified[level].indices_count;
+                    }
+                    ok = upload_mesh(mesh.vertices, mesh.vertices_count, sizeof(*mesh.vertices),
+                                     kmesh_mesh_vertex_attributes, KMESH_MESH_VERTEX_ATTRIBUTES,
+                                     indices, indices_count * sizeof(*indices),
+                                     lods, SIMPLIFY_LEVELS + 1, &mesh.bounds, &error);
+                    how = "parsed, simplified";
+                }
+                free(indices);
+                for (size_t level = 0; level < SIMPLIFY_LEVELS; ++level) {
+                    simplify_lod_free(&simplified[level]);
+                }
+                mesh_free(&mesh);
+            }
+            mapped_file_close(&file);
+            const double load_secs = timer_now() - start;
+            if (!ok) {
+                mesh_indices_count = 0;
+                mesh_lods_count = 0;
+                fprintf(stderr, "%s:%zu: ERROR: could not load mesh %s: %s\n",
+                        scene_conf_file_path, mesh_def_line, mesh_file_path, error);
+                return false;
+            }
+
+            // Compare with the same mesh through ./meshconv
+            printf("Mesh %s: %zu vertices, %zu triangles %s and uploaded in %.3f ms (%.1f MB/s)\n",
+                   mesh_file_path, mesh_vertices_count, mesh_indices_count / TRI_VERTICES, how,
+                   load_secs * 1000.0, (double) size / load_secs / (1000.0 * 1000.0));
+            for (size_t level = 1; level < mesh_lods_count; ++level) {
+                printf("  lod%zu: %zu triangles, error %g\n", level,
+                       mesh_lods[level].indices_count / TRI_VERTICES, mesh_lods[level].error);
+            }
+        }
+    }
+    // reload mesh end
+
+    lod_config = lod;
+    return true;
+}
+
+void reload_scene(void)
+{
+    glClearColor(HOT_RELOAD_ERROR_COLOR);
+    program_failed = true;
+
+    const double start = timer_now();
+    const bool ok = reload_scene_stages();
+    // A failed stage leaves the workers behind, the next reload waits for
+    // them before it reuses their files
+    if (!ok) return;
+    const double reload_secs = timer_now() - start;
+    // The texture and the emote wall are made of the pixels by now
+    mapped_file_close(&reload_files[RELOAD_TEXTURE].mapping);
+
     glClearColor(BACKGROUND_COLOR);
     program_failed = false;
 
-    printf("Successfully reloaded scene\n");
-    printf("Memory %zu/%zu bytes\n", hot_reload_memory.size, (size_t) REGION_CAPACITY);
+    double files_secs = 0.0;
+    for (size_t i = 0; i < COUNT_RELOAD_FILES; ++i) {
+        files_secs += reload_files[i].secs;
+    }
+    printf("Successfully reloaded scene in %.3f ms\n", reload_secs * 1000.0);
+    printf("Reload: %.3f ms of reading and decoding on the workers, %.3f ms waiting for the shaders%s, "
+           "%zu shaders compiled, %zu cached\n",
+           files_secs * 1000.0, reload_shader_wait_secs * 1000.0,
+           GLEW_KHR_parallel_shader_compile ? " compiled in parallel" : "",
+           shader_cache_misses, shader_cache_hits);
+    shader_variant_print_stats();
+    printf("Memory %zu/%zu bytes\n", hot_reload_memory.size, hot_reload_memory.capacity);
     region_clean(&hot_reload_memory);
 }
 
@@ -245,6 +1847,66 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     if (action == GLFW_PRESS) {
         if (key == GLFW_KEY_F5) {
             reload_scene();
+        } else if (key == GLFW_KEY_F1) {
+            show_stats = !show_stats;
+            memset(&stats, 0, sizeof(stats));
+            stats_start = glfwGetTime();
+        } else if (key == GLFW_KEY_F2) {
+            use_bvh = !use_bvh;
+            printf("Culling the emote wall %s\n", use_bvh ? "with the BVH" : "instance by instance");
+            memset(&stats, 0, sizeof(stats));
+            stats_start = glfwGetTime();
+        } else if (key == GLFW_KEY_F3) {
+            use_occlusion = !use_occlusion;
+            printf("Occlusion culling of the emote wall %s\n", use_occlusion ? "on" : "off");
+            memset(&stats, 0, sizeof(stats));
+            stats_start = glfwGetTime();
+        } else if (key == GLFW_KEY_F4) {
+            use_lod = !use_lod;
+            printf("Distance LOD of the emote wall and the mesh %s\n", use_lod ? "on" : "off");
+            memset(&stats, 0, sizeof(stats));
+            stats_start = glfwGetTime();
+        } else if (key == GLFW_KEY_F6) {
+            use_persistent_stream = !use_persistent_stream;
+            // Recreated in the other mode, the storage of the persistent
+            // one is immutable
+            if (instance_stream.buffer != 0) {
+                stream_buffer_free(&instance_stream);
+                if (!stream_buffer_init(&instance_stream, GL_ARRAY_BUFFER,
+                                        visible_capacity * sizeof(Emote_Instance), use_persistent_stream)) {
+                    fprintf(stderr, "ERROR: not enough memory for %zu emote instances\n", visible_capacity);
+                    free_instances();
+                }
+            }
+            printf("Streaming the emote wall with %s\n",
+                   instance_stream.persistent ? "the persistent mapped ring" : "glBufferSubData()");
+            memset(&stats, 0, sizeof(stats));
+            stats_start = glfwGetTime();
+        } else if (key == GLFW_KEY_F7) {
+            use_indirect = !use_indirect;
+            printf("Drawing the emote wall %s\n",
+                   !indirect_supported() ? "a level at a time, the multi-draw needs ./shaders/emote_mdi.vert and GL 4.3" :
+                   use_indirect ? "with a single multi-draw" : "a level at a time");
+            memset(&stats, 0, sizeof(stats));
+            stats_start = glfwGetTime();
+        } else if (key == GLFW_KEY_F8) {
+            shader_variant_use(shader_variant ^ (1u << SHADER_FEATURE_FOG));
+        } else if (key == GLFW_KEY_F9) {
+            shader_variant_use(shader_variant ^ (1u << SHADER_FEATURE_LIGHTING));
+        } else if (key == GLFW_KEY_F10) {
+            shader_variant_use(shader_variant ^ (1u << SHADER_FEATURE_EXPLODE));
+        } else if ((key == GLFW_KEY_F11 || key == GLFW_KEY_F12) && record_file_path != NULL) {
+            printf("The capture is recording %s\n", record_file_path);
+        } else if (key == GLFW_KEY_F11) {
+            if (capturing) {
+                capture_stop();
+            } else {
+                capture_start();
+            }
+            memset(&stats, 0, sizeof(stats));
+            stats_start = glfwGetTime();
+        } else if (key == GLFW_KEY_F12) {
+            capture_next = true;
         } else if (key == GLFW_KEY_SPACE) {
             pause = !pause;
         }
@@ -259,6 +1921,110 @@ void key_callback(GLFWwindow* window, int key, int scancode, int action, int mod
     }
 }
 
+// Picks the level of every emote of the wall for the frame
+void select_emote_levels(const Frustum *frustum, const float eye[V3_COMPS], float scale, float focal, float height)
+{
+    const Cull_Aabbs bounds = {
+        .center = {emote_centers, emote_centers + wall_emotes, emote_centers + 2 * wall_emotes},
+        .extent = {emote_extents, emote_extents + wall_emotes, emote_extents + 2 * wall_emotes},
+        .count = wall_emotes,
+    };
+    memset(emote_levels, EMOTE_LOD_LEVELS, wall_emotes);
+    const size_t visible_count = cull_aabbs(frustum, &bounds, 0, wall_emotes, visible_emotes);
+
+    for (size_t i = 0; i < visible_count; ++i) {
+        const uint32_t emote = visible_emotes[i];
+        if (!use_lod) {
+            emote_levels[emote] = 0;
+            continue;
+        }
+
+        float min[V3_COMPS], max[V3_COMPS];
+        for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+            min[axis] = bounds.center[axis][emote] - bounds.extent[axis][emote];
+            max[axis] = bounds.center[axis][emote] + bounds.extent[axis][emote];
+        }
+        // The distances of the instances are scaled into the world, where
+        // the fog is
+        const float distance = lod_box_distance(eye, min, max) * scale;
+        const size_t level = lod_select(&lod_config, scale, distance, focal, height, EMOTE_LOD_LEVELS);
+        emote_levels[emote] = level == LOD_FOGGED ? EMOTE_LOD_LEVELS : (uint8_t) level;
+    }
+}
+
+// Passes the boxes overlapping an emote drawn at level 0 that are not
+// hidden by the occluders
+bool wall_filter(void *arg, const float min[V3_COMPS], const float max[V3_COMPS])
+{
+    const bool *occlusion_enabled = arg;
+
+    if (use_lod) {
+        size_t x0 = (size_t) (min[X] / wall_pitch[X]);
+        size_t x1 = (size_t) (max[X] / wall_pitch[X]);
+        size_t y0 = (size_t) (min[Y] / wall_pitch[Y]);
+        size_t y1 = (size_t) (max[Y] / wall_pitch[Y]);
+        if (x1 >= wall_side) x1 = wall_side - 1;
+        if (y1 >= wall_side) y1 = wall_side - 1;
+
+        bool full_detail = false;
+        for (size_t y = y0; y <= y1 && !full_detail; ++y) {
+            for (size_t x = x0; x <= x1 && !full_detail; ++x) {
+                full_detail = emote_levels[y * wall_side + x] == 0;
+            }
+        }
+        if (!full_detail) return false;
+    }
+
+    return !*occlusion_enabled || occlusion_test_box(&occlusion, min, max);
+}
+
+// Casts a ray from the camera through the cursor and prints the cube of
+// the emote wall it hits first
+void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
+{
+    (void) mods;
+
+    if (button != GLFW_MOUSE_BUTTON_LEFT || action != GLFW_PRESS) return;
+    if (instances_bvh.nodes_count == 0) return;
+
+    double x, y;
+    int width, height;
+    glfwGetCursorPos(window, &x, &y);
+    glfwGetWindowSize(window, &width, &height);
+    if (width <= 0 || height <= 0) return;
+
+    // The eye and a point under the cursor, unprojected from clip space
+    // into the space of the instances
+    const V4 ndc = {{
+        2.0f * (float) x / (float) width - 1.0f,
+        1.0f - 2.0f * (float) y / (float) height,
+        0.0f,
+        1.0f,
+    }};
+    const V4 eye = mat4_mult_v4(mat4_inverse(wall_view), (V4) {{0.0f, 0.0f, 0.0f, 1.0f}});
+    const V4 point = mat4_mult_v4(mat4_inverse(mat4_mult_mat4(wall_projection, wall_view)), ndc);
+
+    float origin[V3_COMPS];
+    float direction[V3_COMPS];
+    for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+        origin[axis] = eye.cs[axis] / eye.cs[W];
+        direction[axis] = point.cs[axis] / point.cs[W] - origin[axis];
+    }
+
+    uint32_t hit = 0;
+    float t = 0.0f;
+    if (bvh_raycast(&instances_bvh, origin, direction, &hit, &t)) {
+        const Emote_Instance *instance = &instances[hit];
+        uint8_t color[RGBA_COMPS];
+        memcpy(color, &instance->color, sizeof(color));
+        printf("Picked cube %u at (%.0f, %.0f, %.0f), color #%02X%02X%02X%02X\n",
+               hit, instance->position[X], instance->position[Y], instance->position[Z],
+               color[0], color[1], color[2], color[3]);
+    } else {
+        printf("Picked nothing\n");
+    }
+}
+
 void window_size_callback(GLFWwindow* window, int width, int height)
 {
     (void) window;
@@ -282,17 +2048,73 @@ void MessageCallback(GLenum source,
             type, severity, message);
 }
 
-int main()
+void usage(FILE *stream, const char *program)
+{
+    fprintf(stream, "Usage: %s [-pack <assets.kpak>] [-capture <frame.qoi|frame.kraw>]\n"
+                    "          [-record <video.y4m|-> [-fps <fps>] [-frames <count>] [-size <width>x<height>] [-headless]]\n",
+            program);
+}
+
+int main(int argc, char **argv)
 {
+    const char *const program = argv[0];
+    const char *capture_file_path = CAPTURE_DEFAULT_FILE_PATH;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "-pack") == 0 && i + 1 < argc) {
+            asset_pack_file_path = argv[++i];
+        } else if (strcmp(argv[i], "-capture") == 0 && i + 1 < argc) {
+            capture_file_path = argv[++i];
+            capturing = true;
+        } else if (strcmp(argv[i], "-record") == 0 && i + 1 < argc) {
+            record_file_path = argv[++i];
+        } else if (strcmp(argv[i], "-fps") == 0 && i + 1 < argc) {
+            record_fps = (uint32_t) sv_to_u64(sv_from_cstr(argv[++i]));
+        } else if (strcmp(argv[i], "-frames") == 0 && i + 1 < argc) {
+            record_frames = (size_t) sv_to_u64(sv_from_cstr(argv[++i]));
+        } else if (strcmp(argv[i], "-size") == 0 && i + 1 < argc) {
+            String_View size = sv_from_cstr(argv[++i]);
+            record_width = (uint32_t) sv_to_u64(sv_chop_by_delim(&size, 'x'));
+            record_height = (uint32_t) sv_to_u64(size);
+            if (record_width == 0 || record_height == 0) {
+                usage(stderr, program);
+                fprintf(stderr, "ERROR: expected <width>x<height>, got `%s`\n", argv[i]);
+                exit(1);
+            }
+        } else if (strcmp(argv[i], "-headless") == 0) {
+            headless = true;
+        } else {
+            usage(stderr, program);
+            fprintf(stderr, "ERROR: unexpected argument `%s`\n", argv[i]);
+            exit(1);
+        }
+    }
+    if (record_file_path == NULL && headless) {
+        usage(stderr, program);
+        fprintf(stderr, "ERROR: -headless only makes sense with -record\n");
+        exit(1);
+    }
+    if (record_file_path != NULL && record_fps == 0) {
+        usage(stderr, program);
+        fprintf(stderr, "ERROR: -fps must be at least 1\n");
+        exit(1);
+    }
+
+    workers = pool_create(pool_hardware_threads());
+    if (workers == NULL) {
+        fprintf(stderr, "WARNING: could not start worker threads: %s\n", strerror(errno));
+    }
+
     if (!glfwInit()) {
         fprintf(stderr, "ERROR: could not initialize GLFW\n");
         exit(1);
     }
 
+    // Still a window, GLFW has no context without one
+    if (headless) glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
     GLFWwindow * const window =
         glfwCreateWindow(
-            800,
-            600,
+            record_width > 0 ? (int) record_width : 800,
+            record_height > 0 ? (int) record_height : 600,
             "kidito",
             NULL,
             NULL);
@@ -309,6 +2131,12 @@ int main()
         exit(1);
     }
 
+    // Let the driver compile the shaders of a reload on as many threads as
+    // it likes while the rest of the scene loads
+    if (GLEW_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFFu);
+    }
+
 
     glEnable(GL_DEBUG_OUTPUT);
     glDebugMessageCallback(MessageCallback, 0);
@@ -318,23 +2146,65 @@ int main()
     glEnable(GL_BLEND);
     glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
-    reload_scene();
+    // The multi-draw of the emote wall is optional
+    if ((GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect) && GLEW_ARB_shader_draw_parameters &&
+            !stream_buffer_init(&indirect_stream, GL_DRAW_INDIRECT_BUFFER,
+                                EMOTE_LOD_LEVELS * sizeof(Draw_Arrays_Indirect_Command), true)) {
+        fprintf(stderr, "WARNING: could not allocate the indirect draws: %s\n", strerror(errno));
+    }
+    if (!uniform_blocks_init()) {
+        fprintf(stderr, "ERROR: could not allocate the uniform blocks: %s\n", strerror(errno));
+        exit(1);
+    }
+    {
+        const char *error = NULL;
+        if (!capture_images_init(&capture_images, capture_file_path, &error)) {
+            fprintf(stderr, "ERROR: could not capture into %s: %s\n", capture_file_path, error);
+            exit(1);
+        }
+        if (record_file_path != NULL) {
+            if (!record_init(window)) exit(1);
+            if (!capture_init(&capture, capture_y4m_write, &record_writer)) {
+                fprintf(stderr, "ERROR: could not start the capture thread: %s\n", strerror(errno));
+                exit(1);
+            }
+        } else {
+            if (!capture_init(&capture, capture_images_write, &capture_images)) {
+                fprintf(stderr, "ERROR: could not start the capture thread: %s\n", strerror(errno));
+                exit(1);
+            }
+            if (capturing) capture_start();
+        }
+    }
+    glGenVertexArrays(1, &mesh_vao);
+    glGenBuffers(1, &mesh_vertex_buffer_id);
+    glGenBuffers(1, &mesh_index_buffer_id);
+    glGenBuffers(1, &mesh_instance_buffer_id);
+    if (GLEW_VERSION_3_3 || GLEW_ARB_timer_query) glGenQueries(1, &frame_query);
 
+    reload_scene();
 
-    V4 mesh[TRIS_PER_CUBE][TRI_VERTICES] = {0};
-    RGBA colors[TRIS_PER_CUBE][TRI_VERTICES] = {0};
-    V2 uvs[TRIS_PER_CUBE][TRI_VERTICES] = {0};
-    V4 normals[TRIS_PER_CUBE][TRI_VERTICES] = {0};
 
-    generate_cube_mesh(mesh, colors, uvs, normals);
+    static Cube_Mesh generated_cube = {0};
+    const Cube_Mesh *cube = NULL;
+    {
+        const Pack_Entry *entry = pack_find(&asset_pack, PACK_CUBE_MESH_NAME);
+        if (entry != NULL && entry->kind == PACK_ENTRY_MESH && entry->size == sizeof(Cube_Mesh)) {
+            cube = pack_entry_data(&asset_pack, entry);
+        } else {
+            RGBA colors[TRIS_PER_CUBE][TRI_VERTICES] = {0};
+            generate_cube_mesh(generated_cube.mesh, colors, generated_cube.uvs, generated_cube.normals);
+            cube = &generated_cube;
+        }
+    }
 
     {
         GLuint position_buffer_id;
         glGenBuffers(1, &position_buffer_id);
         glBindBuffer(GL_ARRAY_BUFFER, position_buffer_id);
         glBufferData(GL_ARRAY_BUFFER,
-                     sizeof(mesh),
-                     mesh,
+                     sizeof(cube->mesh),
+                     cube->mesh,
                      GL_STATIC_DRAW);
         GLuint position_index = 0;
         glEnableVertexAttribArray(position_index);
@@ -351,8 +2221,8 @@ int main()
         glGenBuffers(1, &uv_buffer_id);
         glBindBuffer(GL_ARRAY_BUFFER, uv_buffer_id);
         glBufferData(GL_ARRAY_BUFFER,
-                     sizeof(uvs),
-                     uvs,
+                     sizeof(cube->uvs),
+                     cube->uvs,
                      GL_STATIC_DRAW);
         GLuint uv_index = 1;
         glEnableVertexAttribArray(uv_index);
@@ -369,8 +2239,8 @@ int main()
         glGenBuffers(1, &normal_buffer_id);
         glBindBuffer(GL_ARRAY_BUFFER, normal_buffer_id);
         glBufferData(GL_ARRAY_BUFFER,
-                     sizeof(normals),
-                     normals,
+                     sizeof(cube->normals),
+                     cube->normals,
                      GL_STATIC_DRAW);
         GLuint normal_index = 2;
         glEnableVertexAttribArray(normal_index);
@@ -383,27 +2253,347 @@ int main()
     }
 
     glfwSetKeyCallback(window, key_callback);
+    glfwSetMouseButtonCallback(window, mouse_button_callback);
     glfwSetFramebufferSizeCallback(window, window_size_callback);
     double prev_time = 0.0;
+    double watch_time = 0.0;
     while (!glfwWindowShouldClose(window)) {
+        if (frame_query_pending) {
+            GLint available = 0;
+            glGetQueryObjectiv(frame_query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (available) {
+                GLuint64 elapsed = 0;
+                glGetQueryObjectui64v(frame_query, GL_QUERY_RESULT, &elapsed);
+                stats.gpu_secs += (double) elapsed * 1e-9;
+                stats.gpu_frames += 1;
+                frame_query_pending = false;
+            }
+        }
+        if (record_fbo != 0) {
+            glBindFramebuffer(GL_FRAMEBUFFER, record_fbo);
+            glViewport(0, 0, (GLsizei) record_width, (GLsizei) record_height);
+        }
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+        const bool timed = frame_query != 0 && !frame_query_pending;
+        if (timed) glBeginQuery(GL_TIME_ELAPSED, frame_query);
+
         if (!program_failed) {
             int width, height;
-            glfwGetFramebufferSize(window, &width, &height);
-            glUniform2f(resolution_location, width, height);
-            glUniform1f(time_location, time);
-            glDrawArrays(GL_TRIANGLES, 0, TRIS_PER_CUBE * TRI_VERTICES);
+            frame_size(window, &width, &height);
+            const Frame_Uniforms frame = {
+                .resolution = {(float) width, (float) height},
+                .time = (float) time,
+            };
+            // The cube has no camera of its own
+            View_Uniforms view_uniforms = {.fog_distance = lod_config.fog_distance};
+            // A wall thinner than the cubes stays as thin
+            Material_Uniforms materials[UNIFORM_MATERIALS] = {0};
+            for (size_t material = 0; material < UNIFORM_MATERIALS; ++material) {
+                for (size_t level = 0; level < EMOTE_LOD_LEVELS; ++level) {
+                    const float size = (float) (1 << level);
+                    materials[material].instance_sizes[level][X] = size;
+                    materials[material].instance_sizes[level][Y] = size;
+                    materials[material].instance_sizes[level][Z] = fminf(size, (float) wall_layers);
+                }
+                materials[material].level = (int32_t) material;
+            }
+
+            if (mesh_indices_count > 0) {
+                float center[V3_COMPS];
+                float diagonal = 0.0f;
+                for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+                    center[axis] = 0.5f * (mesh_bounds.min[axis] + mesh_bounds.max[axis]);
+                    const float d = mesh_bounds.max[axis] - mesh_bounds.min[axis];
+                    diagonal += d * d;
+                }
+                const float scale = diagonal > 0.0f ? MESH_SIZE / sqrtf(diagonal) : 1.0f;
+                const Mat4 projection = mat4_perspective(MY_PI * 0.5f, (float) width / (float) height, 1.0f, 500.0f);
+                const float distance = MESH_DISTANCE + MESH_SWING * sinf((float) time * 0.3f);
+                const Mat4 view = mat4_mult_mat4(
+                    mat4_mult_mat4(
+                        mat4_translate(0.0f, 0.0f, -distance),
+                        mat4_rotate_y((float) time * 0.5f)),
+                    mat4_mult_mat4(
+                        mat4_scale(scale, scale, scale),
+                        mat4_translate(-center[X], -center[Y], -center[Z])));
+
+                // The coarsest level whose error still projects to at most
+                // lod_pixels pixels, in the world where the fog is
+                size_t level = 0;
+                if (use_lod) {
+                    const V4 eye = mat4_mult_v4(mat4_inverse(view), (V4) {{0.0f, 0.0f, 0.0f, 1.0f}});
+                    float errors[KMESH_MAX_LODS];
+                    for (size_t i = 0; i < mesh_lods_count; ++i) {
+                        errors[i] = mesh_lods[i].error * scale;
+                    }
+                    const float eye_distance = lod_box_distance(eye.cs, mesh_bounds.min, mesh_bounds.max) * scale;
+                    level = lod_select_by_error(&lod_config, errors, mesh_lods_count, eye_distance,
+                                                projection.vs[1][1], (float) height);
+                }
+
+                view_uniforms.projection = projection;
+                view_uniforms.view = view;
+                uniform_blocks_stream(&frame, &view_uniforms, materials);
+                if (level != LOD_FOGGED) {
+                    const Kmesh_Lod *lod = &mesh_lods[level];
+                    if (mesh_pulled) {
+                        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, mesh_vertex_buffer_id);
+                        glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, mesh_instance_buffer_id);
+                    }
+                    glBindVertexArray(mesh_vao);
+                    glDrawElements(GL_TRIANGLES, (GLsizei) lod->indices_count, GL_UNSIGNED_INT,
+                                   (void*) (size_t) lod->indices_offset);
+                    glBindVertexArray(0);
+                    stats.triangles += lod->indices_count / TRI_VERTICES;
+                    stats.draw_calls += 1;
+                }
+            } else if (instances_count > 0) {
+                const float extent = fmaxf(instances_extent[X], instances_extent[Y]);
+                const float scale = EMOTE_WALL_SIZE / extent;
+                const Mat4 projection = mat4_perspective(MY_PI * 0.5f, (float) width / (float) height, 1.0f, 500.0f);
+                const float distance = EMOTE_WALL_DISTANCE + EMOTE_WALL_SWING * sinf((float) time * 0.3f);
+                const Mat4 view = mat4_mult_mat4(
+                    mat4_mult_mat4(
+                        mat4_translate(0.0f, 0.0f, -distance),
+                        mat4_rotate_y(0.6f * sinf((float) time * 0.5f))),
+                    mat4_mult_mat4(
+                        mat4_scale(scale, scale, scale),
+                        mat4_translate(-0.5f * instances_extent[X],
+                                       -0.5f * instances_extent[Y],
+                                       -0.5f * instances_extent[Z])));
+
+                // The view includes the model transform, so the planes and
+                // the occlusion buffer are in the space of the instances
+                const Mat4 mvp = mat4_mult_mat4(projection, view);
+                const V4 eye = mat4_mult_v4(mat4_inverse(view), (V4) {{0.0f, 0.0f, 0.0f, 1.0f}});
+                bool occlusion_enabled = use_occlusion && occluders_count > 0;
+                if (occlusion_enabled) {
+                    const double occlusion_start = timer_now();
+                    occlusion_begin(&occlusion, mvp, eye.cs);
+                    for (size_t i = 0; i < occluders_count; ++i) {
+                        occlusion_draw_box(&occlusion, occluders[i].min, occluders[i].max);
+                    }
+                    occlusion_build_hiz(&occlusion);
+                    stats.occlusion_secs += timer_now() - occlusion_start;
+                }
+
+                const double cull_start = timer_now();
+                const Frustum frustum = frustum_from_mat4(mvp);
+                select_emote_levels(&frustum, eye.cs, scale, projection.vs[1][1], (float) height);
+                const Bvh_Filter filter = occlusion_enabled || use_lod ? wall_filter : NULL;
+
+                static const float cube_half_size = 0.5f;
+                const Cull_Aabbs aabbs = {
+                    .center = {
+                        instance_centers + X * instances_count,
+                        instance_centers + Y * instances_count,
+                        instance_centers + Z * instances_count,
+                    },
+                    .extent = {&cube_half_size, &cube_half_size, &cube_half_size},
+                    .uniform_extent = true,
+                    .count = instances_count,
+                };
+                size_t visible_count = 0;
+                size_t rejected = 0;
+                if (use_bvh && instances_bvh.nodes_count > 0) {
+                    visible_count = bvh_cull_filtered(&instances_bvh, &frustum,
+                                                      filter, &occlusion_enabled,
+                                                      visible_indices, &rejected);
+                } else {
+                    visible_count = cull_aabbs_parallel(workers, &frustum, &aabbs, visible_indices);
+                    if (filter != NULL) {
+                        const size_t in_frustum = visible_count;
+                        visible_count = 0;
+                        for (size_t i = 0; i < in_frustum; ++i) {
+                            const Aabb *aabb = &instance_aabbs[visible_indices[i]];
+                            if (filter(&occlusion_enabled, aabb->min, aabb->max)) {
+                                visible_indices[visible_count++] = visible_indices[i];
+                            }
+                        }
+                        rejected = in_frustum - visible_count;
+                    }
+                }
+                // Straight into the memory the GPU reads
+                Emote_Instance *visible_instances = stream_buffer_map(&instance_stream);
+                for (size_t i = 0; i < visible_count; ++i) {
+                    visible_instances[i] = instances[visible_indices[i]];
+                }
+                stats.culled += instances_count - visible_count - rejected;
+                stats.rejected += rejected;
+
+                // The coarser levels go after level 0, a level at a time.
+                // For the multi-draw the pass also writes a draw per level,
+                // empty or not, so gl_DrawIDARB is the level.
+                const bool indirect = use_indirect && indirect_supported();
+                Draw_Arrays_Indirect_Command *commands = indirect ? stream_buffer_map(&indirect_stream) : NULL;
+                size_t level_first[EMOTE_LOD_LEVELS] = {0};
+                size_t level_count[EMOTE_LOD_LEVELS] = {visible_count};
+                size_t drawn_count = visible_count;
+                for (size_t level = 1; level < EMOTE_LOD_LEVELS; ++level) {
+                    level_first[level] = drawn_count;
+                    const size_t count = lod_emote_instances[level];
+                    for (size_t emote = 0; emote < wall_emotes; ++emote) {
+                        if (emote_levels[emote] != level) continue;
+                        memcpy(&visible_instances[drawn_count], &lod_instances[level][emote * count],
+                               count * sizeof(*visible_instances));
+                        drawn_count += count;
+                    }
+                    level_count[level] = drawn_count - level_first[level];
+                }
+                for (size_t level = 0; commands != NULL && level < EMOTE_LOD_LEVELS; ++level) {
+                    commands[level] = (Draw_Arrays_Indirect_Command) {
+                        .count = TRIS_PER_CUBE * TRI_VERTICES,
+                        .instance_count = (uint32_t) level_count[level],
+                        .first = 0,
+                        .base_instance = (uint32_t) level_first[level],
+                    };
+                }
+                stats.cull_secs += timer_now() - cull_start;
+                stats.visible += drawn_count;
+                stats.triangles += drawn_count * TRIS_PER_CUBE;
+
+                const double submit_start = timer_now();
+                const size_t stream_offset = stream_buffer_unmap(&instance_stream,
+                                                                 drawn_count * sizeof(*visible_instances));
+
+                view_uniforms.projection = projection;
+                view_uniforms.view = view;
+                uniform_blocks_stream(&frame, &view_uniforms, materials);
+
+                if (indirect) {
+                    // The levels start at their base instance
+                    const size_t commands_offset = stream_buffer_unmap(&indirect_stream,
+                                                                       EMOTE_LOD_LEVELS * sizeof(*commands));
+                    glBindBuffer(GL_ARRAY_BUFFER, instance_stream.buffer);
+                    glVertexAttribPointer(INSTANCE_POSITION_INDEX, V3_COMPS, GL_FLOAT, GL_FALSE,
+                                          sizeof(Emote_Instance),
+                                          (void*) (stream_offset + offsetof(Emote_Instance, position)));
+                    glVertexAttribPointer(INSTANCE_COLOR_INDEX, RGBA_COMPS, GL_UNSIGNED_BYTE, GL_TRUE,
+                                          sizeof(Emote_Instance),
+                                          (void*) (stream_offset + offsetof(Emote_Instance, color)));
+                    uniform_material_bind(0);
+                    glMultiDrawArraysIndirect(GL_TRIANGLES, (void*) commands_offset, EMOTE_LOD_LEVELS, 0);
+                    stream_buffer_fence(&indirect_stream);
+                    stats.draw_calls += 1;
+                }
+                for (size_t level = 0; !indirect && level < EMOTE_LOD_LEVELS; ++level) {
+                    if (level_count[level] == 0) continue;
+
+                    // GLES 3 has no base instance, the attributes start at
+                    // the first instance of the level instead
+                    const size_t offset = stream_offset + level_first[level] * sizeof(*visible_instances);
+                    glVertexAttribPointer(INSTANCE_POSITION_INDEX, V3_COMPS, GL_FLOAT, GL_FALSE,
+                                          sizeof(Emote_Instance),
+                                          (void*) (offset + offsetof(Emote_Instance, position)));
+                    glVertexAttribPointer(INSTANCE_COLOR_INDEX, RGBA_COMPS, GL_UNSIGNED_BYTE, GL_TRUE,
+                                          sizeof(Emote_Instance),
+                                          (void*) (offset + offsetof(Emote_Instance, color)));
+                    uniform_material_bind(level);
+                    glDrawArraysInstanced(GL_TRIANGLES, 0, TRIS_PER_CUBE * TRI_VERTICES, (GLsizei) level_count[level]);
+                    stats.draw_calls += 1;
+                }
+                stats.submit_secs += timer_now() - submit_start;
+                stream_buffer_fence(&instance_stream);
+                stats.streamed += instance_stream.bytes_streamed;
+                stats.fence_waits += instance_stream.fence_waits;
+                stream_buffer_reset_stats(&instance_stream);
+
+                wall_projection = projection;
+                wall_view = view;
+            } else {
+                uniform_blocks_stream(&frame, &view_uniforms, materials);
+                glDrawArrays(GL_TRIANGLES, 0, TRIS_PER_CUBE * TRI_VERTICES);
+                stats.draw_calls += 1;
+            }
+            stream_buffer_fence(&uniform_stream);
         }
 
-        glfwSwapBuffers(window);
+        if (timed) {
+            glEndQuery(GL_TIME_ELAPSED);
+            frame_query_pending = true;
+        }
+
+        if (capturing || capture_next) {
+            const double capture_time = timer_now();
+            int width, height;
+            frame_size(window, &width, &height);
+            capture_frame(&capture, (uint32_t) width, (uint32_t) height);
+            stats.capture_secs += timer_now() - capture_time;
+            if (capture_next && !capturing) {
+                printf("Capturing frame %zu into %s\n", capture.frames_count - 1, capture_images.file_path);
+            }
+            capture_next = false;
+        } else {
+            capture_poll(&capture);
+        }
+        if (record_fbo != 0 && !headless) {
+            // The window shows the video scaled to fit
+            int width, height;
+            glfwGetFramebufferSize(window, &width, &height);
+            glBindFramebuffer(GL_READ_FRAMEBUFFER, record_fbo);
+            glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+            glBlitFramebuffer(0, 0, (GLint) record_width, (GLint) record_height,
+                              0, 0, width, height, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        }
+        if (!headless) glfwSwapBuffers(window);
         glfwPollEvents();
         double cur_time = glfwGetTime();
-        if (!pause) {
+        if (record_file_path != NULL) {
+            time = (double) capture.frames_count / (double) record_fps;
+            if (record_frames > 0 && capture.frames_count >= record_frames) {
+                glfwSetWindowShouldClose(window, GLFW_TRUE);
+            }
+        } else if (!pause) {
             time += cur_time - prev_time;
         }
         prev_time = cur_time;
+
+        // A reload halfway through would not be the same video twice
+        if (record_file_path == NULL && cur_time - watch_time >= WATCH_INTERVAL_SECS) {
+            watch_time = cur_time;
+            if (watch_changed(&scene_watch)) {
+                printf("The scene changed, reloading\n");
+                reload_scene();
+            }
+        }
+
+        stats.frames += 1;
+        if (show_stats && cur_time - stats_start >= STATS_INTERVAL_SECS) {
+            const double frames = (double) stats.frames;
+            printf("Stats: %.1f fps, visible %.0f, culled %.0f, rejected %.0f, tris %.0f/frame, "
+                   "cull %.3f ms/frame, occluders %.3f ms/frame, streamed %.1f KB/frame, "
+                   "fence waits %zu, draws %.1f/frame, submit %.3f ms/frame, gpu %.3f ms/frame, "
+                   "capture %.3f ms/frame (%s%s%s, %s%s%s%s)\n",
+                   frames / (cur_time - stats_start),
+                   (double) stats.visible / frames,
+                   (double) stats.culled / frames,
+                   (double) stats.rejected / frames,
+                   (double) stats.triangles / frames,
+                   stats.cull_secs * 1000.0 / frames,
+                   stats.occlusion_secs * 1000.0 / frames,
+                   (double) stats.streamed / frames / 1024.0,
+                   stats.fence_waits,
+                   (double) stats.draw_calls / frames,
+                   stats.submit_secs * 1000.0 / frames,
+                   stats.gpu_frames > 0 ? stats.gpu_secs * 1000.0 / (double) stats.gpu_frames : 0.0,
+                   stats.capture_secs * 1000.0 / frames,
+                   use_bvh && instances_bvh.nodes_count > 0 ? "bvh" : "flat",
+                   use_occlusion && occluders_count > 0 ? ", occlusion" : "",
+                   use_lod ? ", lod" : "",
+                   instance_stream.persistent ? "persistent" : "subdata",
+                   use_indirect && indirect_supported() ? ", indirect" : "",
+                   mesh_pulled ? ", pulled" : "",
+                   capturing ? ", capturing" : "");
+            memset(&stats, 0, sizeof(stats));
+            stats_start = cur_time;
+        }
     }
 
+    if (capturing) capture_stop();
+    if (record_file_path != NULL) record_finish();
+    capture_free(&capture);
+
     return 0;
 }
@@ -0,0 +1,130 @@
+#include <errno.h>
+#include <string.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "./mapped_file.h"
+
+#ifdef _WIN32
+
+bool mapped_file_open(const char *file_path, Mapped_File *file)
+{
+    memset(file, 0, sizeof(*file));
+
+    HANDLE handle = CreateFileA(file_path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                                OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (handle == INVALID_HANDLE_VALUE) {
+        errno = ENOENT;
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(handle, &size)) {
+        CloseHandle(handle);
+        errno = EIO;
+        return false;
+    }
+
+    file->file_handle = handle;
+    file->size = (size_t) size.QuadPart;
+    if (file->size == 0) {
+        // Empty files cannot be mapped, but they are still valid files
+        return true;
+    }
+
+    HANDLE mapping = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mapping == NULL) {
+        CloseHandle(handle);
+        errno = EIO;
+        return false;
+    }
+
+    file->mapping_handle = mapping;
+    file->data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (file->data == NULL) {
+        CloseHandle(mapping);
+        CloseHandle(handle);
+        errno = EIO;
+        return false;
+    }
+
+    return true;
+}
+
+void mapped_file_close(Mapped_File *file)
+{
+    if (file->data) UnmapViewOfFile(file->data);
+    if (file->mapping_handle) CloseHandle(file->mapping_handle);
+    if (file->file_handle) CloseHandle(file->file_handle);
+    memset(file, 0, sizeof(*file));
+}
+
+void mapped_file_will_need(const Mapped_File *file)
+{
+    if (file->data == NULL) return;
+
+    WIN32_MEMORY_RANGE_ENTRY range = {
+        .VirtualAddress = (PVOID) file->data,
+        .NumberOfBytes = file->size,
+    };
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+#else
+
+bool mapped_file_open(const char *file_path, Mapped_File *file)
+{
+    memset(file, 0, sizeof(*file));
+
+    int fd = open(file_path, O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        const int saved_errno = errno;
+        close(fd);
+        errno = saved_errno;
+        return false;
+    }
+
+    file->size = (size_t) st.st_size;
+    if (file->size == 0) {
+        // Empty files cannot be mapped, but they are still valid files
+        close(fd);
+        return true;
+    }
+
+    void *data = mmap(NULL, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    const int saved_errno = errno;
+    close(fd);
+    if (data == MAP_FAILED) {
+        errno = saved_errno;
+        return false;
+    }
+
+    file->data = data;
+    return true;
+}
+
+void mapped_file_close(Mapped_File *file)
+{
+    if (file->data) munmap((void*) file->data, file->size);
+    memset(file, 0, sizeof(*file));
+}
+
+void mapped_file_will_need(const Mapped_File *file)
+{
+    if (file->data == NULL) return;
+    madvise((void*) file->data, file->size, MADV_SEQUENTIAL);
+    madvise((void*) file->data, file->size, MADV_WILLNEED);
+}
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+// Read-only memory mapping of a whole file. `errno` is set on failure.
+typedef struct {
+    const void *data;
+    size_t size;
+#ifdef _WIN32
+    void *file_handle;
+    void *mapping_handle;
+#endif
+} Mapped_File;
+
+bool mapped_file_open(const char *file_path, Mapped_File *file);
+void mapped_file_close(Mapped_File *file);
+// Hints the OS to read the whole file ahead with one sequential read
+void mapped_file_will_need(const Mapped_File *file);
+
+#endif // MAPPED_FILE_H_
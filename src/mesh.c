@@ -0,0 +1,940 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "./mesh.h"
+#include "./sv.h"
+#include "./mapped_file.h"
+
+static bool mesh_alloc(Mesh *mesh, size_t vertices_count, size_t indices_count)
+{
+    memset(mesh, 0, sizeof(*mesh));
+    mesh->vertices = malloc(vertices_count * sizeof(*mesh->vertices) + 1);
+    mesh->indices = malloc(indices_count * sizeof(*mesh->indices) + 1);
+    if (mesh->vertices == NULL || mesh->indices == NULL) {
+        mesh_free(mesh);
+        return false;
+    }
+    mesh->vertices_count = vertices_count;
+    mesh->indices_count = indices_count;
+    return true;
+}
+
+void mesh_free(Mesh *mesh)
+{
+    free(mesh->vertices);
+    free(mesh->indices);
+    memset(mesh, 0, sizeof(*mesh));
+}
+
+static void mesh_compute_bounds(Mesh *mesh)
+{
+    for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+        mesh->bounds.min[axis] = mesh->vertices_count > 0 ? INFINITY : 0.0f;
+        mesh->bounds.max[axis] = mesh->vertices_count > 0 ? -INFINITY : 0.0f;
+    }
+    for (size_t i = 0; i < mesh->vertices_count; ++i) {
+        const float *p = mesh->vertices[i].position;
+        for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+            if (p[axis] < mesh->bounds.min[axis]) mesh->bounds.min[axis] = p[axis];
+            if (p[axis] > mesh->bounds.max[axis]) mesh->bounds.max[axis] = p[axis];
+        }
+    }
+}
+
+// Sums of the normals of the triangles around every vertex, weighted by
+// their areas through the length of the cross product
+static void mesh_compute_normals(Mesh *mesh)
+{
+    for (size_t i = 0; i < mesh->vertices_count; ++i) {
+        memset(mesh->vertices[i].normal, 0, sizeof(mesh->vertices[i].normal));
+    }
+
+    for (size_t i = 0; i + 2 < mesh->indices_count; i += TRI_VERTICES) {
+        Mesh_Vertex *vs[TRI_VERTICES];
+        for (size_t j = 0; j < TRI_VERTICES; ++j) {
+            vs[j] = &mesh->vertices[mesh->indices[i + j]];
+        }
+        float a[V3_COMPS], b[V3_COMPS];
+        for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+            a[axis] = vs[1]->position[axis] - vs[0]->position[axis];
+            b[axis] = vs[2]->position[axis] - vs[0]->position[axis];
+        }
+        const float n[V3_COMPS] = {
+            a[Y] * b[Z] - a[Z] * b[Y],
+            a[Z] * b[X] - a[X] * b[Z],
+            a[X] * b[Y] - a[Y] * b[X],
+        };
+        for (size_t j = 0; j < TRI_VERTICES; ++j) {
+            for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+                vs[j]->normal[axis] += n[axis];
+            }
+        }
+    }
+
+    for (size_t i = 0; i < mesh->vertices_count; ++i) {
+        float *n = mesh->vertices[i].normal;
+        const float length = sqrtf(n[X] * n[X] + n[Y] * n[Y] + n[Z] * n[Z]);
+        if (length > 0.0f) {
+            for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+                n[axis] /= length;
+            }
+        }
+    }
+}
+
+// OBJ begin
+typedef struct {
+    uint32_t position;
+    uint32_t uv;
+    uint32_t normal;
+} Obj_Corner;
+
+typedef struct {
+    String_View text;
+    // Counted by the first pass
+    size_t positions;
+    size_t uvs;
+    size_t normals;
+    size_t corners;
+    // Where the second pass writes, the sums of the counts of the chunks
+    // before this one
+    size_t positions_first;
+    size_t uvs_first;
+    size_t normals_first;
+    size_t corners_first;
+    const char *error;
+} Obj_Chunk;
+
+typedef struct {
+    Obj_Chunk *chunks;
+    float *positions;
+    float *uvs;
+    float *normals;
+    size_t positions_count;
+    size_t uvs_count;
+    size_t normals_count;
+    Obj_Corner *corners;
+    size_t corners_count;
+
+    // Deduplication
+    uint32_t *hashes;
+    uint32_t *first_of;
+    size_t partitions_count;
+    size_t blocks_count;
+    size_t *block_vertices;
+    bool out_of_memory;
+    Mesh *mesh;
+} Obj;
+
+static bool obj_is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static String_View obj_next_token(String_View *line)
+{
+    sv_chop_left_while(line, obj_is_space);
+    size_t n = 0;
+    while (n < line->count && !obj_is_space(line->data[n])) n += 1;
+    return sv_chop_left(line, n);
+}
+
+static size_t obj_count_tokens(String_View line)
+{
+    size_t count = 0;
+    while (obj_next_token(&line).count > 0) count += 1;
+    return count;
+}
+
+static void obj_count_chunk(void *arg, size_t index, size_t worker)
+{
+    (void) worker;
+    Obj_Chunk *chunk = &((Obj*) arg)->chunks[index];
+
+    String_View text = chunk->text;
+    while (text.count > 0) {
+        String_View line = sv_chop_by_delim(&text, '\n');
+        const String_View keyword = obj_next_token(&line);
+        if (sv_eq(keyword, SV("v"))) {
+            chunk->positions += 1;
+        } else if (sv_eq(keyword, SV("vt"))) {
+            chunk->uvs += 1;
+        } else if (sv_eq(keyword, SV("vn"))) {
+            chunk->normals += 1;
+        } else if (sv_eq(keyword, SV("f"))) {
+            const size_t n = obj_count_tokens(line);
+            if (n >= TRI_VERTICES) chunk->corners += (n - 2) * TRI_VERTICES;
+        }
+    }
+}
+
+// OBJ indices start at 1, the negative ones count back from the last
+// element so far. `so_far` is the amount of elements before the line.
+static bool obj_resolve_index(String_View sv, size_t so_far, size_t total, uint32_t *index)
+{
+    if (sv.count == 0) {
+        *index = MESH_NO_INDEX;
+        return true;
+    }
+
+    int64_t value = 0;
+    if (sv.data[0] == '-') {
+        sv_chop_left(&sv, 1);
+        value = (int64_t) so_far - (int64_t) sv_to_u64(sv);
+    } else {
+        value = (int64_t) sv_to_u64(sv) - 1;
+    }
+
+    if (value < 0 || value >= (int64_t) total) return false;
+    *index = (uint32_t) value;
+    return true;
+}
+
+static void obj_parse_floats(String_View *line, float *out, size_t count)
+{
+    for (size_t i = 0; i < count; ++i) {
+        out[i] = sv_to_float(obj_next_token(line));
+    }
+}
+
+static void obj_parse_chunk(void *arg, size_t index, size_t worker)
+{
+    (void) worker;
+    Obj *obj = arg;
+    Obj_Chunk *chunk = &obj->chunks[index];
+
+    size_t positions = chunk->positions_first;
+    size_t uvs = chunk->uvs_first;
+    size_t normals = chunk->normals_first;
+    Obj_Corner *corner = &obj->corners[chunk->corners_first];
+
+    String_View text = chunk->text;
+    while (text.count > 0) {
+        String_View line = sv_chop_by_delim(&text, '\n');
+        const String_View keyword = obj_next_token(&line);
+        if (sv_eq(keyword, SV("v"))) {
+            obj_parse_floats(&line, &obj->positions[positions++ * V3_COMPS], V3_COMPS);
+        } else if (sv_eq(keyword, SV("vt"))) {
+            obj_parse_floats(&line, &obj->uvs[uvs++ * V2_COMPS], V2_COMPS);
+        } else if (sv_eq(keyword, SV("vn"))) {
+            obj_parse_floats(&line, &obj->normals[normals++ * V3_COMPS], V3_COMPS);
+        } else if (sv_eq(keyword, SV("f"))) {
+            if (obj_count_tokens(line) < TRI_VERTICES) continue;
+
+            // Triangle fan around the first corner
+            Obj_Corner first = {0}, previous = {0};
+            for (size_t n = 0; ; ++n) {
+                String_View token = obj_next_token(&line);
+                if (token.count == 0) break;
+
+                const String_View p = sv_chop_by_delim(&token, '/');
+                const String_View t = sv_chop_by_delim(&token, '/');
+                const String_View normal = token;
+                Obj_Corner current;
+                if (p.count == 0 ||
+                        !obj_resolve_index(p, positions, obj->positions_count, &current.position) ||
+                        !obj_resolve_index(t, uvs, obj->uvs_count, &current.uv) ||
+                        !obj_resolve_index(normal, normals, obj->normals_count, &current.normal)) {
+                    chunk->error = "face index out of range";
+                    return;
+                }
+
+                if (n == 0) {
+                    first = current;
+                } else if (n >= 2) {
+                    *corner++ = first;
+                    *corner++ = previous;
+                    *corner++ = current;
+                }
+                previous = current;
+            }
+        }
+    }
+}
+
+static uint32_t obj_hash(Obj_Corner c)
+{
+    uint64_t h = (uint64_t) c.position * 0x9E3779B97F4A7C15ull;
+    h ^= ((uint64_t) c.uv + 1) * 0xC2B2AE3D27D4EB4Full;
+    h ^= ((uint64_t) c.normal + 1) * 0x165667B19E3779F9ull;
+    return (uint32_t) (h ^ (h >> 32));
+}
+
+static bool obj_corner_eq(Obj_Corner a, Obj_Corner b)
+{
+    return a.position == b.position && a.uv == b.uv && a.normal == b.normal;
+}
+
+static void obj_hash_block(void *arg, size_t index, size_t worker)
+{
+    (void) worker;
+    Obj *obj = arg;
+    const size_t first = index * MESH_FACE_BLOCK;
+    const size_t end = first + MESH_FACE_BLOCK < obj->corners_count ? first + MESH_FACE_BLOCK : obj->corners_count;
+    for (size_t i = first; i < end; ++i) {
+        obj->hashes[i] = obj_hash(obj->corners[i]);
+    }
+}
+
+// Open addressing over the first corner of every distinct triple, with
+// the low bits of the hashes as the slots and the high bits picking the
+// partition
+#define OBJ_EMPTY UINT32_MAX
+
+static uint32_t *obj_table_alloc(size_t capacity)
+{
+    uint32_t *table = malloc(capacity * sizeof(*table));
+    if (table != NULL) memset(table, 0xff, capacity * sizeof(*table));
+    return table;
+}
+
+static void obj_dedupe_partition(void *arg, size_t partition, size_t worker)
+{
+    (void) worker;
+    Obj *obj = arg;
+
+    size_t capacity = 1024;
+    size_t count = 0;
+    uint32_t *table = obj_table_alloc(capacity);
+    if (table == NULL) {
+        obj->out_of_memory = true;
+        return;
+    }
+
+    for (size_t i = 0; i < obj->corners_count; ++i) {
+        const uint32_t hash = obj->hashes[i];
+        if ((hash >> 24) % obj->partitions_count != partition) continue;
+
+        if (2 * (count + 1) > capacity) {
+            const size_t new_capacity = capacity * 2;
+            uint32_t *new_table = obj_table_alloc(new_capacity);
+            if (new_table == NULL) {
+                free(table);
+                obj->out_of_memory = true;
+                return;
+            }
+            for (size_t j = 0; j < capacity; ++j) {
+                if (table[j] == OBJ_EMPTY) continue;
+                size_t slot = obj->hashes[table[j]] & (new_capacity - 1);
+                while (new_table[slot] != OBJ_EMPTY) slot = (slot + 1) & (new_capacity - 1);
+                new_table[slot] = table[j];
+            }
+            free(table);
+            table = new_table;
+            capacity = new_capacity;
+        }
+
+        size_t slot = hash & (capacity - 1);
+        while (table[slot] != OBJ_EMPTY &&
+                !(obj->hashes[table[slot]] == hash && obj_corner_eq(obj->corners[table[slot]], obj->corners[i]))) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if (table[slot] == OBJ_EMPTY) {
+            table[slot] = (uint32_t) i;
+            count += 1;
+        }
+        obj->first_of[i] = table[slot];
+    }
+
+    free(table);
+}
+
+static void obj_block_range(const Obj *obj, size_t block, size_t *first, size_t *end)
+{
+    *first = block * MESH_FACE_BLOCK;
+    *end = *first + MESH_FACE_BLOCK < obj->corners_count ? *first + MESH_FACE_BLOCK : obj->corners_count;
+}
+
+static void obj_count_vertices(void *arg, size_t block, size_t worker)
+{
+    (void) worker;
+    Obj *obj = arg;
+    size_t first, end;
+    obj_block_range(obj, block, &first, &end);
+
+    size_t count = 0;
+    for (size_t i = first; i < end; ++i) {
+        count += obj->first_of[i] == i;
+    }
+    obj->block_vertices[block] = count;
+}
+
+// The vertices come in the order of their first corners, like a serial
+// deduplication would have them
+static void obj_emit_vertices(void *arg, size_t block, size_t worker)
+{
+    (void) worker;
+    Obj *obj = arg;
+    size_t first, end;
+    obj_block_range(obj, block, &first, &end);
+
+    uint32_t vertex = (uint32_t) obj->block_vertices[block];
+    for (size_t i = first; i < end; ++i) {
+        if (obj->first_of[i] != i) continue;
+
+        const Obj_Corner c = obj->corners[i];
+        Mesh_Vertex *v = &obj->mesh->vertices[vertex];
+        memcpy(v->position, &obj->positions[(size_t) c.position * V3_COMPS], sizeof(v->position));
+        if (c.normal != MESH_NO_INDEX) {
+            memcpy(v->normal, &obj->normals[(size_t) c.normal * V3_COMPS], sizeof(v->normal));
+        } else {
+            memset(v->normal, 0, sizeof(v->normal));
+        }
+        if (c.uv != MESH_NO_INDEX) {
+            memcpy(v->uv, &obj->uvs[(size_t) c.uv * V2_COMPS], sizeof(v->uv));
+        } else {
+            memset(v->uv, 0, sizeof(v->uv));
+        }
+        obj->mesh->indices[i] = vertex++;
+    }
+}
+
+static void obj_emit_indices(void *arg, size_t block, size_t worker)
+{
+    (void) worker;
+    Obj *obj = arg;
+    size_t first, end;
+    obj_block_range(obj, block, &first, &end);
+
+    for (size_t i = first; i < end; ++i) {
+        if (obj->first_of[i] != i) obj->mesh->indices[i] = obj->mesh->indices[obj->first_of[i]];
+    }
+}
+
+static void obj_free(Obj *obj)
+{
+    free(obj->chunks);
+    free(obj->positions);
+    free(obj->uvs);
+    free(obj->normals);
+    free(obj->corners);
+    free(obj->hashes);
+    free(obj->first_of);
+    free(obj->block_vertices);
+}
+
+bool mesh_parse_obj(const char *data, size_t size, Pool *pool, Mesh *mesh, const char **error)
+{
+    Obj obj = {0};
+    memset(mesh, 0, sizeof(*mesh));
+
+    // Line aligned chunks
+    const size_t chunks_capacity = size / MESH_CHUNK_SIZE + 1;
+    obj.chunks = calloc(chunks_capacity, sizeof(*obj.chunks));
+    if (obj.chunks == NULL) {
+        *error = "out of memory";
+        return false;
+    }
+    size_t chunks_count = 0;
+    for (size_t start = 0; start < size; ) {
+        size_t end = start + MESH_CHUNK_SIZE < size ? start + MESH_CHUNK_SIZE : size;
+        const char *newline = memchr(data + end, '\n', size - end);
+        end = newline != NULL ? (size_t) (newline - data) + 1 : size;
+        obj.chunks[chunks_count++].text = (String_View) {
+            .count = end - start,
+            .data = data + start,
+        };
+        start = end;
+    }
+
+    pool_for(pool, chunks_count, obj_count_chunk, &obj);
+    for (size_t i = 0; i < chunks_count; ++i) {
+        Obj_Chunk *chunk = &obj.chunks[i];
+        chunk->positions_first = obj.positions_count;
+        chunk->uvs_first = obj.uvs_count;
+        chunk->normals_first = obj.normals_count;
+        chunk->corners_first = obj.corners_count;
+        obj.positions_count += chunk->positions;
+        obj.uvs_count += chunk->uvs;
+        obj.normals_count += chunk->normals;
+        obj.corners_count += chunk->corners;
+    }
+
+    if (obj.corners_count >= UINT32_MAX || obj.positions_count >= UINT32_MAX) {
+        obj_free(&obj);
+        *error = "too many elements";
+        return false;
+    }
+
+    obj.positions = malloc(obj.positions_count * V3_COMPS * sizeof(*obj.positions) + 1);
+    obj.uvs = malloc(obj.uvs_count * V2_COMPS * sizeof(*obj.uvs) + 1);
+    obj.normals = malloc(obj.normals_count * V3_COMPS * sizeof(*obj.normals) + 1);
+    obj.corners = malloc(obj.corners_count * sizeof(*obj.corners) + 1);
+    if (obj.positions == NULL || obj.uvs == NULL || obj.normals == NULL || obj.corners == NULL) {
+        obj_free(&obj);
+        *error = "out of memory";
+        return false;
+    }
+
+    pool_for(pool, chunks_count, obj_parse_chunk, &obj);
+    for (size_t i = 0; i < chunks_count; ++i) {
+        if (obj.chunks[i].error != NULL) {
+            *error = obj.chunks[i].error;
+            obj_free(&obj);
+            return false;
+        }
+    }
+
+    // Deduplication of the corners into vertices
+    obj.partitions_count = pool_workers_count(pool);
+    obj.blocks_count = (obj.corners_count + MESH_FACE_BLOCK - 1) / MESH_FACE_BLOCK;
+    obj.hashes = malloc(obj.corners_count * sizeof(*obj.hashes) + 1);
+    obj.first_of = malloc(obj.corners_count * sizeof(*obj.first_of) + 1);
+    obj.block_vertices = malloc(obj.blocks_count * sizeof(*obj.block_vertices) + 1);
+    if (obj.hashes == NULL || obj.first_of == NULL || obj.block_vertices == NULL) {
+        obj_free(&obj);
+        *error = "out of memory";
+        return false;
+    }
+
+    pool_for(pool, obj.blocks_count, obj_hash_block, &obj);
+    pool_for(pool, obj.partitions_count, obj_dedupe_partition, &obj);
+    pool_for(pool, obj.blocks_count, obj_count_vertices, &obj);
+    if (obj.out_of_memory) {
+        obj_free(&obj);
+        *error = "out of memory";
+        return false;
+    }
+
+    size_t vertices_count = 0;
+    for (size_t i = 0; i < obj.blocks_count; ++i) {
+        const size_t count = obj.block_vertices[i];
+        obj.block_vertices[i] = vertices_count;
+        vertices_count += count;
+    }
+
+    if (!mesh_alloc(mesh, vertices_count, obj.corners_count)) {
+        obj_free(&obj);
+        *error = "out of memory";
+        return false;
+    }
+    obj.mesh = mesh;
+    pool_for(pool, obj.blocks_count, obj_emit_vertices, &obj);
+    pool_for(pool, obj.blocks_count, obj_emit_indices, &obj);
+
+    if (obj.normals_count == 0) mesh_compute_normals(mesh);
+    mesh_compute_bounds(mesh);
+    obj_free(&obj);
+    return true;
+}
+// OBJ end
+
+// PLY begin
+typedef enum {
+    PLY_INT8 = 0,
+    PLY_UINT8,
+    PLY_INT16,
+    PLY_UINT16,
+    PLY_INT32,
+    PLY_UINT32,
+    PLY_FLOAT32,
+    PLY_FLOAT64,
+    COUNT_PLY_TYPES,
+} Ply_Type;
+
+static const struct {
+    const char *names[2];
+    size_t size;
+} ply_types[COUNT_PLY_TYPES] = {
+    [PLY_INT8]    = {{"char", "int8"}, 1},
+    [PLY_UINT8]   = {{"uchar", "uint8"}, 1},
+    [PLY_INT16]   = {{"short", "int16"}, 2},
+    [PLY_UINT16]  = {{"ushort", "uint16"}, 2},
+    [PLY_INT32]   = {{"int", "int32"}, 4},
+    [PLY_UINT32]  = {{"uint", "uint32"}, 4},
+    [PLY_FLOAT32] = {{"float", "float32"}, 4},
+    [PLY_FLOAT64] = {{"double", "float64"}, 8},
+};
+
+#define PLY_MAX_PROPERTIES 32
+#define PLY_MAX_ELEMENTS 8
+
+typedef struct {
+    String_View name;
+    Ply_Type type;
+    bool list;
+    Ply_Type count_type;
+} Ply_Property;
+
+typedef struct {
+    String_View name;
+    size_t count;
+    Ply_Property properties[PLY_MAX_PROPERTIES];
+    size_t properties_count;
+    // Of every item, when there is no list
+    size_t size;
+    // Where the items of the element start in the data
+    size_t offset;
+} Ply_Element;
+
+// Where every field of Mesh_Vertex comes from in a PLY vertex
+typedef struct {
+    bool present;
+    Ply_Type type;
+    size_t offset;
+} Ply_Field;
+
+#define PLY_VERTEX_FIELDS (V3_COMPS + V3_COMPS + V2_COMPS)
+
+typedef struct {
+    const uint8_t *data;
+    bool swap;
+
+    const Ply_Element *vertex;
+    Ply_Field fields[PLY_VERTEX_FIELDS];
+
+    const Ply_Element *face;
+    // Bytes of the face before and after the list of indices
+    size_t face_before;
+    size_t face_after;
+    Ply_Type count_type;
+    Ply_Type index_type;
+    // Start of every block of MESH_FACE_BLOCK faces and the first index
+    // its triangles write
+    size_t *block_offsets;
+    size_t *block_indices;
+    size_t blocks_count;
+    bool out_of_range;
+
+    Mesh *mesh;
+} Ply;
+
+static bool ply_type_by_name(String_View name, Ply_Type *type)
+{
+    for (Ply_Type t = 0; t < COUNT_PLY_TYPES; ++t) {
+        if (sv_eq(name, sv_from_cstr(ply_types[t].names[0])) ||
+                sv_eq(name, sv_from_cstr(ply_types[t].names[1]))) {
+            *type = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+static double ply_read(const uint8_t *p, Ply_Type type, bool swap)
+{
+    uint8_t bytes[8];
+    const size_t size = ply_types[type].size;
+    for (size_t i = 0; i < size; ++i) {
+        bytes[i] = swap ? p[size - 1 - i] : p[i];
+    }
+
+    switch (type) {
+    case PLY_INT8:    { int8_t x;   memcpy(&x, bytes, sizeof(x)); return x; }
+    case PLY_UINT8:   { uint8_t x;  memcpy(&x, bytes, sizeof(x)); return x; }
+    case PLY_INT16:   { int16_t x;  memcpy(&x, bytes, sizeof(x)); return x; }
+    case PLY_UINT16:  { uint16_t x; memcpy(&x, bytes, sizeof(x)); return x; }
+    case PLY_INT32:   { int32_t x;  memcpy(&x, bytes, sizeof(x)); return x; }
+    case PLY_UINT32:  { uint32_t x; memcpy(&x, bytes, sizeof(x)); return x; }
+    case PLY_FLOAT32: { float x;    memcpy(&x, bytes, sizeof(x)); return x; }
+    case PLY_FLOAT64: { double x;   memcpy(&x, bytes, sizeof(x)); return x; }
+    case COUNT_PLY_TYPES:
+    default: return 0.0;
+    }
+}
+
+static void ply_decode_vertices(void *arg, size_t block, size_t worker)
+{
+    (void) worker;
+    Ply *ply = arg;
+    const size_t first = block * MESH_FACE_BLOCK;
+    const size_t end = first + MESH_FACE_BLOCK < ply->vertex->count ? first + MESH_FACE_BLOCK : ply->vertex->count;
+
+    for (size_t i = first; i < end; ++i) {
+        const uint8_t *item = ply->data + ply->vertex->offset + i * ply->vertex->size;
+        float values[PLY_VERTEX_FIELDS] = {0};
+        for (size_t f = 0; f < PLY_VERTEX_FIELDS; ++f) {
+            const Ply_Field *field = &ply->fields[f];
+            if (field->present) values[f] = (float) ply_read(item + field->offset, field->type, ply->swap);
+        }
+        memcpy(&ply->mesh->vertices[i], values, sizeof(values));
+    }
+}
+
+static void ply_decode_faces(void *arg, size_t block, size_t worker)
+{
+    (void) worker;
+    Ply *ply = arg;
+    const size_t first = block * MESH_FACE_BLOCK;
+    const size_t end = first + MESH_FACE_BLOCK < ply->face->count ? first + MESH_FACE_BLOCK : ply->face->count;
+    const size_t count_size = ply_types[ply->count_type].size;
+    const size_t index_size = ply_types[ply->index_type].size;
+    const double vertices_count = (double) ply->vertex->count;
+
+    const uint8_t *p = ply->data + ply->block_offsets[block];
+    uint32_t *indices = &ply->mesh->indices[ply->block_indices[block]];
+    for (size_t i = first; i < end; ++i) {
+        p += ply->face_before;
+        const size_t n = (size_t) ply_read(p, ply->count_type, ply->swap);
+        p += count_size;
+
+        // Triangle fan around the first corner
+        uint32_t fan_first = 0, previous = 0;
+        for (size_t j = 0; j < n; ++j) {
+            const double value = ply_read(p, ply->index_type, ply->swap);
+            p += index_size;
+            if (value < 0.0 || value >= vertices_count) {
+                ply->out_of_range = true;
+                return;
+            }
+            const uint32_t current = (uint32_t) value;
+            if (j == 0) {
+                fan_first = current;
+            } else if (j >= 2) {
+                *indices++ = fan_first;
+                *indices++ = previous;
+                *indices++ = current;
+            }
+            previous = current;
+        }
+        p += ply->face_after;
+    }
+}
+
+bool mesh_parse_ply(const char *data, size_t size, Pool *pool, Mesh *mesh, const char **error)
+{
+    memset(mesh, 0, sizeof(*mesh));
+
+    String_View header = {
+        .count = size,
+        .data = data,
+    };
+    const String_View magic = sv_trim(sv_chop_by_delim(&header, '\n'));
+    if (!sv_eq(magic, SV("ply"))) {
+        *error = "not a PLY file";
+        return false;
+    }
+
+    const uint16_t endianness = 1;
+    const bool little_endian = *(const uint8_t*) &endianness == 1;
+    bool swap = false;
+    Ply_Element elements[PLY_MAX_ELEMENTS];
+    size_t elements_count = 0;
+    bool has_format = false;
+    for (;;) {
+        if (header.count == 0) {
+            *error = "the header has no end_header";
+            return false;
+        }
+        String_View line = sv_trim(sv_chop_by_delim(&header, '\n'));
+        const String_View keyword = obj_next_token(&line);
+        if (sv_eq(keyword, SV("end_header"))) break;
+
+        if (sv_eq(keyword, SV("format"))) {
+            const String_View format = obj_next_token(&line);
+            if (sv_eq(format, SV("binary_little_endian"))) {
+                swap = !little_endian;
+            } else if (sv_eq(format, SV("binary_big_endian"))) {
+                swap = little_endian;
+            } else {
+                *error = "only binary PLY files are supported";
+                return false;
+            }
+            has_format = true;
+        } else if (sv_eq(keyword, SV("element"))) {
+            if (elements_count >= PLY_MAX_ELEMENTS) {
+                *error = "too many elements";
+                return false;
+            }
+            Ply_Element *element = &elements[elements_count++];
+            memset(element, 0, sizeof(*element));
+            element->name = obj_next_token(&line);
+            element->count = (size_t) sv_to_u64(obj_next_token(&line));
+        } else if (sv_eq(keyword, SV("property"))) {
+            if (elements_count == 0 || elements[elements_count - 1].properties_count >= PLY_MAX_PROPERTIES) {
+                *error = "unexpected property";
+                return false;
+            }
+            Ply_Element *element = &elements[elements_count - 1];
+            Ply_Property *property = &element->properties[element->properties_count++];
+            String_View type = obj_next_token(&line);
+            property->list = sv_eq(type, SV("list"));
+            if (property->list) {
+                if (!ply_type_by_name(obj_next_token(&line), &property->count_type)) {
+                    *error = "unknown property type";
+                    return false;
+                }
+                type = obj_next_token(&line);
+            }
+            if (!ply_type_by_name(type, &property->type)) {
+                *error = "unknown property type";
+                return false;
+            }
+            property->name = obj_next_token(&line);
+        }
+        // comment, obj_info and the rest are ignored
+    }
+    if (!has_format) {
+        *error = "the header has no format";
+        return false;
+    }
+
+    Ply ply = {
+        .data = (const uint8_t*) data,
+        .swap = swap,
+    };
+
+    // Only the elements up to the faces have to be located, and only the
+    // faces may have a list
+    size_t offset = size - header.count;
+    for (size_t i = 0; i < elements_count && ply.face == NULL; ++i) {
+        Ply_Element *element = &elements[i];
+        element->offset = offset;
+
+        if (sv_eq(element->name, SV("face"))) {
+            ply.face = element;
+            bool list_found = false;
+            for (size_t j = 0; j < element->properties_count; ++j) {
+                const Ply_Property *property = &element->properties[j];
+                if (property->list && !list_found &&
+                        (sv_eq(property->name, SV("vertex_indices")) || sv_eq(property->name, SV("vertex_index")))) {
+                    list_found = true;
+                    ply.count_type = property->count_type;
+                    ply.index_type = property->type;
+                } else if (property->list) {
+                    *error = "faces with more than one list are not supported";
+                    return false;
+                } else {
+                    *(list_found ? &ply.face_after : &ply.face_before) += ply_types[property->type].size;
+                }
+            }
+            if (!list_found) {
+                *error = "the faces have no vertex_indices";
+                return false;
+            }
+            break;
+        }
+
+        for (size_t j = 0; j < element->properties_count; ++j) {
+            const Ply_Property *property = &element->properties[j];
+            if (property->list) {
+                *error = "lists are only supported in faces";
+                return false;
+            }
+            element->size += ply_types[property->type].size;
+        }
+        if (element->count > (size - offset) / (element->size > 0 ? element->size : 1)) {
+            *error = "the file is truncated";
+            return false;
+        }
+        offset += element->count * element->size;
+
+        if (sv_eq(element->name, SV("vertex"))) ply.vertex = element;
+    }
+    if (ply.vertex == NULL || ply.face == NULL) {
+        *error = "the file has no vertices or no faces";
+        return false;
+    }
+    if (ply.vertex->count >= UINT32_MAX) {
+        *error = "too many vertices";
+        return false;
+    }
+
+    static const char *const field_names[PLY_VERTEX_FIELDS][4] = {
+        {"x"}, {"y"}, {"z"},
+        {"nx"}, {"ny"}, {"nz"},
+        {"u", "s", "texture_u", "texture_s"},
+        {"v", "t", "texture_v", "texture_t"},
+    };
+    bool has_normals = false;
+    size_t field_offset = 0;
+    for (size_t j = 0; j < ply.vertex->properties_count; ++j) {
+        const Ply_Property *property = &ply.vertex->properties[j];
+        for (size_t f = 0; f < PLY_VERTEX_FIELDS; ++f) {
+            for (size_t n = 0; n < 4 && field_names[f][n] != NULL; ++n) {
+                if (sv_eq(property->name, sv_from_cstr(field_names[f][n]))) {
+                    ply.fields[f] = (Ply_Field) {
+                        .present = true,
+                        .type = property->type,
+                        .offset = field_offset,
+                    };
+                    if (f == V3_COMPS) has_normals = true;
+                }
+            }
+        }
+        field_offset += ply_types[property->type].size;
+    }
+
+    // The faces have different sizes, a scan of their counts finds where
+    // every block starts and how many triangles come before it
+    ply.blocks_count = (ply.face->count + MESH_FACE_BLOCK - 1) / MESH_FACE_BLOCK;
+    ply.block_offsets = malloc(ply.blocks_count * sizeof(*ply.block_offsets) + 1);
+    ply.block_indices = malloc(ply.blocks_count * sizeof(*ply.block_indices) + 1);
+    if (ply.block_offsets == NULL || ply.block_indices == NULL) {
+        free(ply.block_offsets);
+        free(ply.block_indices);
+        *error = "out of memory";
+        return false;
+    }
+
+    const size_t count_size = ply_types[ply.count_type].size;
+    const size_t index_size = ply_types[ply.index_type].size;
+    size_t indices_count = 0;
+    offset = ply.face->offset;
+    for (size_t i = 0; i < ply.face->count; ++i) {
+        if (i % MESH_FACE_BLOCK == 0) {
+            ply.block_offsets[i / MESH_FACE_BLOCK] = offset;
+            ply.block_indices[i / MESH_FACE_BLOCK] = indices_count;
+        }
+        if (size - offset < ply.face_before + count_size) {
+            offset = size + 1;
+            break;
+        }
+        const size_t n = (size_t) ply_read(ply.data + offset + ply.face_before, ply.count_type, ply.swap);
+        offset += ply.face_before + count_size + n * index_size + ply.face_after;
+        if (offset > size) break;
+        if (n >= TRI_VERTICES) indices_count += (n - 2) * TRI_VERTICES;
+    }
+    if (offset > size) {
+        free(ply.block_offsets);
+        free(ply.block_indices);
+        *error = "the file is truncated";
+        return false;
+    }
+
+    if (!mesh_alloc(mesh, ply.vertex->count, indices_count)) {
+        free(ply.block_offsets);
+        free(ply.block_indices);
+        *error = "out of memory";
+        return false;
+    }
+    ply.mesh = mesh;
+
+    pool_for(pool, (ply.vertex->count + MESH_FACE_BLOCK - 1) / MESH_FACE_BLOCK, ply_decode_vertices, &ply);
+    pool_for(pool, ply.blocks_count, ply_decode_faces, &ply);
+    free(ply.block_offsets);
+    free(ply.block_indices);
+    if (ply.out_of_range) {
+        mesh_free(mesh);
+        *error = "face index out of range";
+        return false;
+    }
+
+    if (!has_normals) mesh_compute_normals(mesh);
+    mesh_compute_bounds(mesh);
+    return true;
+}
+// PLY end
+
+bool mesh_parse(const char *file_path, const char *data, size_t size, Pool *pool, Mesh *mesh, const char **error)
+{
+    const String_View path = sv_from_cstr(file_path);
+    if (sv_ends_with(path, SV(".obj"))) return mesh_parse_obj(data, size, pool, mesh, error);
+    if (sv_ends_with(path, SV(".ply"))) return mesh_parse_ply(data, size, pool, mesh, error);
+    *error = "unknown mesh format, expected .obj or .ply";
+    return false;
+}
+
+bool mesh_load_file(const char *file_path, Pool *pool, Mesh *mesh, const char **error)
+{
+    Mapped_File file = {0};
+    if (!mapped_file_open(file_path, &file)) {
+        *error = "could not map the file";
+        return false;
+    }
+    mapped_file_will_need(&file);
+    const bool ok = mesh_parse(file_path, file.data, file.size, pool, mesh, error);
+    mapped_file_close(&file);
+    return ok;
+}
@@ -0,0 +1,57 @@
+#ifndef MESH_H_
+#define MESH_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "./geo.h"
+#include "./pool.h"
+
+// Triangle meshes loaded from Wavefront OBJ and binary PLY files into an
+// indexed, interleaved vertex buffer ready for glBufferData().
+//
+// OBJ files are split into line aligned chunks that are parsed on the
+// pool in two passes: the first one counts the elements of every chunk,
+// so the second one knows where in the shared arrays every chunk writes
+// and resolves the relative indices. The position/uv/normal triples of the
+// face corners are then deduplicated into vertices with hash maps, every
+// one owning a slice of the hash space.
+//
+// PLY vertices have a fixed size and are decoded in parallel directly,
+// the faces in parallel blocks found by a quick scan of their sizes.
+
+// OBJ chunks are about this big, PLY faces are decoded this many at a time
+#define MESH_CHUNK_SIZE (512 * 1024)
+#define MESH_FACE_BLOCK (64 * 1024)
+
+// No uv or no normal for a corner of an OBJ face
+#define MESH_NO_INDEX UINT32_MAX
+
+// 32 bytes
+typedef struct {
+    float position[V3_COMPS];
+    float normal[V3_COMPS];
+    float uv[V2_COMPS];
+} Mesh_Vertex;
+
+typedef struct {
+    Mesh_Vertex *vertices;
+    size_t vertices_count;
+    // Three per triangle
+    uint32_t *indices;
+    size_t indices_count;
+    Aabb bounds;
+} Mesh;
+
+// Parses `size` bytes of `data` on `pool` when it is not NULL. The meshes
+// without normals get smooth ones. Returns false with a message in
+// `error` on failure.
+bool mesh_parse_obj(const char *data, size_t size, Pool *pool, Mesh *mesh, const char **error);
+bool mesh_parse_ply(const char *data, size_t size, Pool *pool, Mesh *mesh, const char **error);
+// Picks the parser by the extension of `file_path`, `.obj` or `.ply`
+bool mesh_parse(const char *file_path, const char *data, size_t size, Pool *pool, Mesh *mesh, const char **error);
+// Memory maps the file and parses it
+bool mesh_load_file(const char *file_path, Pool *pool, Mesh *mesh, const char **error);
+void mesh_free(Mesh *mesh);
+
+#endif // MESH_H_
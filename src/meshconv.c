@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "./sv.h"
+#include "./kmesh.h"
+#include "./meshopt.h"
+#include "./simplify.h"
+#include "./timer.h"
+
+// Converts OBJ and PLY meshes into the binary mesh cache, with the
+// triangles and the vertices reordered for the GPU and the simplified
+// levels of detail next to the original triangles. The output is written
+// next to the input with the extension replaced:
+//   $ ./meshconv models/*.obj
+//   models/bunny.obj -> models/bunny.kmesh
+
+void usage(FILE *stream, const char *program)
+{
+    fprintf(stream, "Usage: %s <mesh.obj|mesh.ply...>\n", program);
+}
+
+char *output_file_path(const char *input_file_path)
+{
+    String_View path = sv_from_cstr(input_file_path);
+    size_t dot = 0;
+    size_t slash = 0;
+    bool has_slash = false;
+    for (size_t i = 0; i < path.count; ++i) {
+        if (path.data[i] == '/' || path.data[i] == '\\') {
+            slash = i;
+            has_slash = true;
+        } else if (path.data[i] == '.') {
+            dot = i;
+        }
+    }
+    if (dot > 0 && (!has_slash || dot > slash + 1)) {
+        path.count = dot;
+    }
+
+    const size_t n = path.count + strlen(KMESH_EXTENSION) + 1;
+    char *result = malloc(n);
+    if (result == NULL) return NULL;
+    snprintf(result, n, SV_Fmt"%s", SV_Arg(path), KMESH_EXTENSION);
+    return result;
+}
+
+typedef struct {
+    Mesh *meshes;
+    Simplify_Lod *lods;
+    bool *failed;
+} Meshconv_Job;
+
+// Every mesh on its own worker, the pool is not reentrant so the passes
+// themselves are serial
+static void optimize_mesh_task(void *arg, size_t index, size_t worker)
+{
+    (void) worker;
+    Meshconv_Job *job = arg;
+    if (!meshopt_optimize(&job->meshes[index])) job->failed[index] = true;
+}
+
+static void optimize_lod_task(void *arg, size_t index, size_t worker)
+{
+    (void) worker;
+    Meshconv_Job *job = arg;
+    const Mesh *mesh = &job->meshes[index / SIMPLIFY_LEVELS];
+    Simplify_Lod *lod = &job->lods[index];
+    if (!meshopt_optimize_vertex_cache(lod->indices, lod->indices_count, mesh->vertices_count) ||
+            !meshopt_optimize_overdraw(lod->indices, lod->indices_count, mesh->vertices,
+                                       mesh->vertices_count, MESHOPT_OVERDRAW_THRESHOLD)) {
+        job->failed[index / SIMPLIFY_LEVELS] = true;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *const program = argv[0];
+
+    if (argc < 2) {
+        usage(stderr, program);
+        fprintf(stderr, "ERROR: no input files\n");
+        exit(1);
+    }
+
+    Pool *pool = pool_create(pool_hardware_threads() - 1);
+    if (pool == NULL) {
+        fprintf(stderr, "WARNING: could not start worker threads: %s\n", strerror(errno));
+    }
+
+    const size_t files_count = (size_t) argc - 1;
+    Mesh *meshes = calloc(files_count, sizeof(*meshes));
+    const char **paths = calloc(files_count, sizeof(*paths));
+    bool *failed = calloc(files_count, sizeof(*failed));
+    Simplify_Lod *lods = calloc(files_count * SIMPLIFY_LEVELS, sizeof(*lods));
+    if (meshes == NULL || paths == NULL || failed == NULL || lods == NULL) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+
+    // Every file is parsed on all of the workers, then the meshes are
+    // optimized and simplified with a task per mesh and per level
+    int result = 0;
+    size_t meshes_count = 0;
+    double parse_secs = 0.0;
+    for (int i = 1; i < argc; ++i) {
+        const char *error = NULL;
+        const double start = timer_now();
+        if (!mesh_load_file(argv[i], pool, &meshes[meshes_count], &error)) {
+            fprintf(stderr, "ERROR: could not load mesh %s: %s\n", argv[i], error);
+            result = 1;
+            continue;
+        }
+        parse_secs += timer_now() - start;
+        paths[meshes_count++] = argv[i];
+    }
+
+    Meshopt_Stats *before = calloc(meshes_count + 1, sizeof(*before));
+    if (before == NULL) {
+        fprintf(stderr, "ERROR: out of memory\n");
+        exit(1);
+    }
+    size_t triangles = 0;
+    for (size_t i = 0; i < meshes_count; ++i) {
+        before[i] = meshopt_analyze(meshes[i].indices, meshes[i].indices_count,
+                                    meshes[i].vertices_count, MESHOPT_CACHE_SIZE);
+        triangles += meshes[i].indices_count / TRI_VERTICES;
+    }
+
+    Meshconv_Job job = {
+        .meshes = meshes,
+        .lods = lods,
+        .failed = failed,
+    };
+
+    double start = timer_now();
+    pool_for(pool, meshes_count, optimize_mesh_task, &job);
+    const double optimize_secs = timer_now() - start;
+
+    start = timer_now();
+    if (!simplify_lods(pool, meshes, meshes_count, lods)) {
+        fprintf(stderr, "ERROR: could not simplify meshes: %s\n", strerror(errno));
+        exit(1);
+    }
+    const double simplify_secs = timer_now() - start;
+    pool_for(pool, meshes_count * SIMPLIFY_LEVELS, optimize_lod_task, &job);
+
+    printf("Parsed %zu meshes, %zu triangles in %.3f ms, optimized in %.3f ms, "
+           "simplified in %.3f ms (%.2f Mtris/s) on %zu threads\n",
+           meshes_count, triangles, parse_secs * 1000.0, optimize_secs * 1000.0,
+           simplify_secs * 1000.0, triangles * SIMPLIFY_LEVELS / simplify_secs / 1e6,
+           pool_workers_count(pool));
+
+    for (size_t i = 0; i < meshes_count; ++i) {
+        const Mesh *mesh = &meshes[i];
+        const Simplify_Lod *mesh_lods = &lods[i * SIMPLIFY_LEVELS];
+        if (failed[i]) {
+            fprintf(stderr, "ERROR: could not optimize mesh %s: %s\n", paths[i], strerror(ENOMEM));
+            result = 1;
+            continue;
+        }
+
+        char *output_path = output_file_path(paths[i]);
+        if (output_path == NULL) {
+            fprintf(stderr, "ERROR: out of memory\n");
+            result = 1;
+            continue;
+        }
+
+        Kmesh_Lod_Source sources[SIMPLIFY_LEVELS];
+        for (size_t level = 0; level < SIMPLIFY_LEVELS; ++level) {
+            sources[level] = (Kmesh_Lod_Source) {
+                .indices = mesh_lods[level].indices,
+                .indices_count = mesh_lods[level].indices_count,
+                .error = mesh_lods[level].error,
+            };
+        }
+
+        if (!kmesh_save(output_path, mesh, sources, SIMPLIFY_LEVELS, KMESH_FLAG_OPTIMIZED)) {
+            fprintf(stderr, "ERROR: could not write file %s: %s\n", output_path, strerror(errno));
+            result = 1;
+        } else {
+            const Meshopt_Stats after = meshopt_analyze(mesh->indices, mesh->indices_count,
+                                                        mesh->vertices_count, MESHOPT_CACHE_SIZE);
+            printf("%s -> %s (%zu vertices, %zu triangles, ACMR %.3f -> %.3f)\n",
+                   paths[i], output_path, mesh->vertices_count,
+                   mesh->indices_count / TRI_VERTICES, before[i].acmr, after.acmr);
+            for (size_t level = 0; level < SIMPLIFY_LEVELS; ++level) {
+                const size_t level_triangles = mesh_lods[level].indices_count / TRI_VERTICES;
+                printf("  lod%zu: %zu triangles (%.1f%%), error %g\n", level + 1, level_triangles,
+                       100.0 * level_triangles / (mesh->indices_count / TRI_VERTICES),
+                       mesh_lods[level].error);
+            }
+        }
+
+        free(output_path);
+    }
+
+    for (size_t i = 0; i < meshes_count * SIMPLIFY_LEVELS; ++i) simplify_lod_free(&lods[i]);
+    for (size_t i = 0; i < meshes_count; ++i) mesh_free(&meshes[i]);
+    free(before);
+    free(lods);
+    free(failed);
+    free(paths);
+    free(meshes);
+    if (pool != NULL) pool_destroy(pool);
+    return result;
+}
@@ -0,0 +1,411 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "./meshopt.h"
+
+// The FIFO cache the overdraw clusters are cut by, the smallest one of the
+// GPUs around
+#define MESHOPT_OVERDRAW_CACHE_SIZE 16
+
+#define NO_TRIANGLE UINT32_MAX
+
+Meshopt_Stats meshopt_analyze(const uint32_t *indices, size_t indices_count,
+                              size_t vertices_count, size_t cache_size)
+{
+    Meshopt_Stats stats = {0};
+    const size_t tris = indices_count / TRI_VERTICES;
+    if (tris == 0 || vertices_count == 0) return stats;
+
+    // A vertex is in the cache when fewer than `cache_size` misses happened
+    // since it was loaded, which is exactly a FIFO
+    size_t *loaded_at = malloc(vertices_count * sizeof(*loaded_at));
+    if (loaded_at == NULL) return stats;
+    for (size_t i = 0; i < vertices_count; ++i) {
+        loaded_at[i] = SIZE_MAX;
+    }
+
+    size_t misses = 0;
+    for (size_t i = 0; i < tris * TRI_VERTICES; ++i) {
+        const uint32_t v = indices[i];
+        if (loaded_at[v] == SIZE_MAX || misses - loaded_at[v] >= cache_size) {
+            loaded_at[v] = misses++;
+        }
+    }
+    free(loaded_at);
+
+    stats.acmr = (float) misses / (float) tris;
+    stats.atvr = (float) misses / (float) vertices_count;
+    return stats;
+}
+
+// Vertex cache begin
+#define FORSYTH_CACHE_DECAY_POWER 1.5f
+#define FORSYTH_LAST_TRI_SCORE 0.75f
+#define FORSYTH_VALENCE_BOOST_SCALE 2.0f
+#define FORSYTH_VALENCE_BOOST_POWER 0.5f
+// Vertices with more triangles are rare enough to not get into the table
+#define FORSYTH_MAX_VALENCE 64
+
+typedef struct {
+    // Triangles around every vertex, the ones not emitted yet first:
+    // [offsets[v], offsets[v] + active[v])
+    uint32_t *offsets;
+    uint32_t *active;
+    uint32_t *adjacency;
+    int32_t *cache_position;
+    float *vertex_score;
+    float *tri_score;
+    bool *emitted;
+    uint32_t *output;
+
+    float cache_scores[MESHOPT_CACHE_SIZE];
+    float valence_scores[FORSYTH_MAX_VALENCE];
+} Forsyth;
+
+static void forsyth_init_scores(Forsyth *f)
+{
+    for (int i = 0; i < MESHOPT_CACHE_SIZE; ++i) {
+        if (i < TRI_VERTICES) {
+            f->cache_scores[i] = FORSYTH_LAST_TRI_SCORE;
+        } else {
+            const float scale = 1.0f / (MESHOPT_CACHE_SIZE - TRI_VERTICES);
+            f->cache_scores[i] = powf(1.0f - (float) (i - TRI_VERTICES) * scale, FORSYTH_CACHE_DECAY_POWER);
+        }
+    }
+    for (int i = 1; i < FORSYTH_MAX_VALENCE; ++i) {
+        f->valence_scores[i] = FORSYTH_VALENCE_BOOST_SCALE * powf((float) i, -FORSYTH_VALENCE_BOOST_POWER);
+    }
+}
+
+// Vertices in the cache score by how recently they were used, and the
+// vertices with few triangles left get a boost so they are finished off
+// instead of leaving lonely triangles behind
+static float forsyth_score(const Forsyth *f, int cache_position, uint32_t active)
+{
+    if (active == 0) return -1.0f;
+
+    const float score = cache_position >= 0 ? f->cache_scores[cache_position] : 0.0f;
+    if (active < FORSYTH_MAX_VALENCE) return score + f->valence_scores[active];
+    return score + FORSYTH_VALENCE_BOOST_SCALE * powf((float) active, -FORSYTH_VALENCE_BOOST_POWER);
+}
+
+static void forsyth_free(Forsyth *f)
+{
+    free(f->offsets);
+    free(f->active);
+    free(f->adjacency);
+    free(f->cache_position);
+    free(f->vertex_score);
+    free(f->tri_score);
+    free(f->emitted);
+    free(f->output);
+}
+
+bool meshopt_optimize_vertex_cache(uint32_t *indices, size_t indices_count, size_t vertices_count)
+{
+    const size_t tris = indices_count / TRI_VERTICES;
+    if (tris == 0) return true;
+
+    Forsyth f = {0};
+    f.offsets = calloc(vertices_count + 1, sizeof(*f.offsets));
+    f.active = calloc(vertices_count + 1, sizeof(*f.active));
+    f.adjacency = malloc(tris * TRI_VERTICES * sizeof(*f.adjacency));
+    f.cache_position = malloc((vertices_count + 1) * sizeof(*f.cache_position));
+    f.vertex_score = malloc((vertices_count + 1) * sizeof(*f.vertex_score));
+    f.tri_score = malloc(tris * sizeof(*f.tri_score));
+    f.emitted = calloc(tris, sizeof(*f.emitted));
+    f.output = malloc(tris * TRI_VERTICES * sizeof(*f.output));
+    if (f.offsets == NULL || f.active == NULL || f.adjacency == NULL ||
+            f.cache_position == NULL || f.vertex_score == NULL ||
+            f.tri_score == NULL || f.emitted == NULL || f.output == NULL) {
+        forsyth_free(&f);
+        errno = ENOMEM;
+        return false;
+    }
+
+    forsyth_init_scores(&f);
+    for (size_t i = 0; i < tris * TRI_VERTICES; ++i) {
+        f.active[indices[i]] += 1;
+    }
+    // Inclusive sums that the filling below moves back to the starts
+    uint32_t sum = 0;
+    for (size_t v = 0; v < vertices_count; ++v) {
+        sum += f.active[v];
+        f.offsets[v] = sum;
+    }
+    f.offsets[vertices_count] = sum;
+    for (size_t t = 0; t < tris; ++t) {
+        for (size_t j = 0; j < TRI_VERTICES; ++j) {
+            f.adjacency[--f.offsets[indices[t * TRI_VERTICES + j]]] = (uint32_t) t;
+        }
+    }
+
+    for (size_t v = 0; v < vertices_count; ++v) {
+        f.cache_position[v] = -1;
+        f.vertex_score[v] = forsyth_score(&f, -1, f.active[v]);
+    }
+
+    uint32_t best = NO_TRIANGLE;
+    float best_score = -1.0f;
+    for (size_t t = 0; t < tris; ++t) {
+        const uint32_t *tri = &indices[t * TRI_VERTICES];
+        f.tri_score[t] = f.vertex_score[tri[0]] + f.vertex_score[tri[1]] + f.vertex_score[tri[2]];
+        if (f.tri_score[t] > best_score) {
+            best_score = f.tri_score[t];
+            best = (uint32_t) t;
+        }
+    }
+
+    uint32_t cache[MESHOPT_CACHE_SIZE + TRI_VERTICES];
+    size_t cache_count = 0;
+    size_t scan = 0;
+    for (size_t emitted = 0; emitted < tris; ++emitted) {
+        // Nothing in the cache has triangles left, start over from the
+        // first triangle that is not emitted yet
+        if (best == NO_TRIANGLE) {
+            while (f.emitted[scan]) scan += 1;
+            best = (uint32_t) scan;
+        }
+
+        const uint32_t *tri = &indices[best * TRI_VERTICES];
+        memcpy(&f.output[emitted * TRI_VERTICES], tri, TRI_VERTICES * sizeof(*tri));
+        f.emitted[best] = true;
+
+        for (size_t j = 0; j < TRI_VERTICES; ++j) {
+            const uint32_t v = tri[j];
+            uint32_t *around = &f.adjacency[f.offsets[v]];
+            for (uint32_t k = 0; k < f.active[v]; ++k) {
+                if (around[k] == best) {
+                    around[k] = around[f.active[v] - 1];
+                    around[f.active[v] - 1] = best;
+                    f.active[v] -= 1;
+                    break;
+                }
+            }
+        }
+
+        // The vertices of the triangle go to the front of the cache
+        uint32_t new_cache[MESHOPT_CACHE_SIZE + TRI_VERTICES];
+        size_t new_count = 0;
+        for (size_t j = 0; j < TRI_VERTICES; ++j) {
+            bool seen = false;
+            for (size_t k = 0; k < new_count; ++k) seen = seen || new_cache[k] == tri[j];
+            if (!seen) new_cache[new_count++] = tri[j];
+        }
+        const size_t front = new_count;
+        for (size_t k = 0; k < cache_count; ++k) {
+            bool seen = false;
+            for (size_t j = 0; j < front; ++j) seen = seen || new_cache[j] == cache[k];
+            if (!seen) new_cache[new_count++] = cache[k];
+        }
+
+        for (size_t k = 0; k < new_count; ++k) {
+            const uint32_t v = new_cache[k];
+            f.cache_position[v] = k < MESHOPT_CACHE_SIZE ? (int32_t) k : -1;
+            f.vertex_score[v] = forsyth_score(&f, f.cache_position[v], f.active[v]);
+        }
+
+        best = NO_TRIANGLE;
+        best_score = -1.0f;
+        for (size_t k = 0; k < new_count; ++k) {
+            const uint32_t v = new_cache[k];
+            for (uint32_t a = 0; a < f.active[v]; ++a) {
+                const uint32_t t = f.adjacency[f.offsets[v] + a];
+                const uint32_t *other = &indices[t * TRI_VERTICES];
+                f.tri_score[t] = f.vertex_score[other[0]] + f.vertex_score[other[1]] + f.vertex_score[other[2]];
+                if (f.tri_score[t] > best_score) {
+                    best_score = f.tri_score[t];
+                    best = t;
+                }
+            }
+        }
+
+        cache_count = new_count < MESHOPT_CACHE_SIZE ? new_count : MESHOPT_CACHE_SIZE;
+        memcpy(cache, new_cache, cache_count * sizeof(*cache));
+    }
+
+    memcpy(indices, f.output, tris * TRI_VERTICES * sizeof(*indices));
+    forsyth_free(&f);
+    return true;
+}
+// Vertex cache end
+
+// Overdraw begin
+typedef struct {
+    uint32_t first;
+    uint32_t count;
+    float key;
+} Overdraw_Cluster;
+
+static int compare_clusters(const void *a, const void *b)
+{
+    const Overdraw_Cluster *ca = a;
+    const Overdraw_Cluster *cb = b;
+    if (ca->key != cb->key) return ca->key > cb->key ? -1 : 1;
+    return ca->first < cb->first ? -1 : ca->first > cb->first;
+}
+
+bool meshopt_optimize_overdraw(uint32_t *indices, size_t indices_count,
+                               const Mesh_Vertex *vertices, size_t vertices_count, float threshold)
+{
+    const size_t tris = indices_count / TRI_VERTICES;
+    if (tris == 0) return true;
+
+    size_t *loaded_at = malloc(vertices_count * sizeof(*loaded_at) + 1);
+    Overdraw_Cluster *clusters = malloc(tris * sizeof(*clusters));
+    uint32_t *output = malloc(tris * TRI_VERTICES * sizeof(*output));
+    if (loaded_at == NULL || clusters == NULL || output == NULL) {
+        free(loaded_at);
+        free(clusters);
+        free(output);
+        errno = ENOMEM;
+        return false;
+    }
+
+    // A triangle that misses the cache with all of its vertices is where
+    // the ordering jumped somewhere else, so the clusters can be moved
+    // around without hurting the cache much
+    for (size_t i = 0; i < vertices_count; ++i) {
+        loaded_at[i] = SIZE_MAX;
+    }
+    size_t clusters_count = 0;
+    size_t misses = 0;
+    for (size_t t = 0; t < tris; ++t) {
+        size_t tri_misses = 0;
+        for (size_t j = 0; j < TRI_VERTICES; ++j) {
+            const uint32_t v = indices[t * TRI_VERTICES + j];
+            if (loaded_at[v] == SIZE_MAX || misses - loaded_at[v] >= MESHOPT_OVERDRAW_CACHE_SIZE) {
+                loaded_at[v] = misses++;
+                tri_misses += 1;
+            }
+        }
+        if (t == 0 || tri_misses == TRI_VERTICES) {
+            clusters[clusters_count++] = (Overdraw_Cluster) {.first = (uint32_t) t};
+        }
+        clusters[clusters_count - 1].count += 1;
+    }
+
+    // Centroids and normals weighted by the areas of the triangles
+    float mesh_centroid[V3_COMPS] = {0};
+    float mesh_area = 0.0f;
+    float (*centroids)[V3_COMPS] = malloc(clusters_count * sizeof(*centroids));
+    float (*normals)[V3_COMPS] = malloc(clusters_count * sizeof(*normals));
+    if (centroids == NULL || normals == NULL) {
+        free(centroids);
+        free(normals);
+        free(loaded_at);
+        free(clusters);
+        free(output);
+        errno = ENOMEM;
+        return false;
+    }
+
+    for (size_t c = 0; c < clusters_count; ++c) {
+        float centroid[V3_COMPS] = {0};
+        float normal[V3_COMPS] = {0};
+        float area = 0.0f;
+        for (uint32_t t = clusters[c].first; t < clusters[c].first + clusters[c].count; ++t) {
+            const float *p0 = vertices[indices[t * TRI_VERTICES + 0]].position;
+            const float *p1 = vertices[indices[t * TRI_VERTICES + 1]].position;
+            const float *p2 = vertices[indices[t * TRI_VERTICES + 2]].position;
+            float a[V3_COMPS], b[V3_COMPS];
+            for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+                a[axis] = p1[axis] - p0[axis];
+                b[axis] = p2[axis] - p0[axis];
+            }
+            const float n[V3_COMPS] = {
+                a[Y] * b[Z] - a[Z] * b[Y],
+                a[Z] * b[X] - a[X] * b[Z],
+                a[X] * b[Y] - a[Y] * b[X],
+            };
+            const float tri_area = sqrtf(n[X] * n[X] + n[Y] * n[Y] + n[Z] * n[Z]);
+            for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+                centroid[axis] += (p0[axis] + p1[axis] + p2[axis]) / 3.0f * tri_area;
+                normal[axis] += n[axis];
+            }
+            area += tri_area;
+        }
+
+        const float length = sqrtf(normal[X] * normal[X] + normal[Y] * normal[Y] + normal[Z] * normal[Z]);
+        for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+            mesh_centroid[axis] += centroid[axis];
+            centroids[c][axis] = area > 0.0f ? centroid[axis] / area : 0.0f;
+            normals[c][axis] = length > 0.0f ? normal[axis] / length : 0.0f;
+        }
+        mesh_area += area;
+    }
+    for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+        if (mesh_area > 0.0f) mesh_centroid[axis] /= mesh_area;
+    }
+
+    // The clusters that face away from the center the most are on the
+    // outside and go first
+    for (size_t c = 0; c < clusters_count; ++c) {
+        float key = 0.0f;
+        for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+            key += (centroids[c][axis] - mesh_centroid[axis]) * normals[c][axis];
+        }
+        clusters[c].key = key;
+    }
+    free(centroids);
+    free(normals);
+    qsort(clusters, clusters_count, sizeof(*clusters), compare_clusters);
+
+    size_t written = 0;
+    for (size_t c = 0; c < clusters_count; ++c) {
+        const size_t count = (size_t) clusters[c].count * TRI_VERTICES;
+        memcpy(&output[written], &indices[(size_t) clusters[c].first * TRI_VERTICES], count * sizeof(*output));
+        written += count;
+    }
+
+    const float before = meshopt_analyze(indices, indices_count, vertices_count, MESHOPT_OVERDRAW_CACHE_SIZE).acmr;
+    const float after = meshopt_analyze(output, indices_count, vertices_count, MESHOPT_OVERDRAW_CACHE_SIZE).acmr;
+    if (after <= before * threshold) {
+        memcpy(indices, output, tris * TRI_VERTICES * sizeof(*indices));
+    }
+
+    free(loaded_at);
+    free(clusters);
+    free(output);
+    return true;
+}
+// Overdraw end
+
+bool meshopt_optimize_vertex_fetch(Mesh *mesh)
+{
+    uint32_t *remap = malloc(mesh->vertices_count * sizeof(*remap) + 1);
+    Mesh_Vertex *vertices = malloc(mesh->vertices_count * sizeof(*vertices) + 1);
+    if (remap == NULL || vertices == NULL) {
+        free(remap);
+        free(vertices);
+        errno = ENOMEM;
+        return false;
+    }
+    memset(remap, 0xff, mesh->vertices_count * sizeof(*remap));
+
+    uint32_t count = 0;
+    for (size_t i = 0; i < mesh->indices_count; ++i) {
+        const uint32_t v = mesh->indices[i];
+        if (remap[v] == UINT32_MAX) {
+            vertices[count] = mesh->vertices[v];
+            remap[v] = count++;
+        }
+        mesh->indices[i] = remap[v];
+    }
+    free(remap);
+
+    free(mesh->vertices);
+    mesh->vertices = vertices;
+    mesh->vertices_count = count;
+    return true;
+}
+
+bool meshopt_optimize(Mesh *mesh)
+{
+    return meshopt_optimize_vertex_cache(mesh->indices, mesh->indices_count, mesh->vertices_count) &&
+        meshopt_optimize_overdraw(mesh->indices, mesh->indices_count,
+                                  mesh->vertices, mesh->vertices_count, MESHOPT_OVERDRAW_THRESHOLD) &&
+        meshopt_optimize_vertex_fetch(mesh);
+}
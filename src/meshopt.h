@@ -0,0 +1,49 @@
+#ifndef MESHOPT_H_
+#define MESHOPT_H_
+
+#include <stdbool.h>
+
+#include "./mesh.h"
+
+// Reorders the triangles and the vertices of a mesh for the GPU without
+// changing what is drawn:
+//   1. vertex cache: Forsyth's greedy ordering, every next triangle is the
+//      one whose vertices are the most likely still in the post-transform
+//      cache
+//   2. overdraw: the ordering is cut into clusters where the cache starts
+//      over, and the clusters facing outwards of the mesh go first, so
+//      they hide the rest behind them
+//   3. vertex fetch: the vertices are stored in the order they are first
+//      used, so the fetches of neighbouring triangles share cache lines
+
+// Size of the LRU cache the ordering is tuned for
+#define MESHOPT_CACHE_SIZE 32
+// The overdraw ordering is dropped when it makes the ACMR this much worse
+#define MESHOPT_OVERDRAW_THRESHOLD 1.05f
+
+typedef struct {
+    // Average cache miss ratio, transformed vertices per triangle: 0.5 at
+    // best for a big regular mesh, 3 at worst
+    float acmr;
+    // Average transform to vertex ratio, transformed vertices per vertex:
+    // 1 at best
+    float atvr;
+} Meshopt_Stats;
+
+// Simulates a FIFO post-transform cache of `cache_size` vertices, which is
+// how most GPUs behave
+Meshopt_Stats meshopt_analyze(const uint32_t *indices, size_t indices_count,
+                              size_t vertices_count, size_t cache_size);
+
+// Each of them sets errno and returns false when out of memory, leaving
+// the mesh as it was
+bool meshopt_optimize_vertex_cache(uint32_t *indices, size_t indices_count, size_t vertices_count);
+bool meshopt_optimize_overdraw(uint32_t *indices, size_t indices_count,
+                               const Mesh_Vertex *vertices, size_t vertices_count, float threshold);
+// Also drops the vertices no triangle uses
+bool meshopt_optimize_vertex_fetch(Mesh *mesh);
+
+// All three passes in order
+bool meshopt_optimize(Mesh *mesh);
+
+#endif // MESHOPT_H_
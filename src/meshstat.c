@@ -0,0 +1,105 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "./sv.h"
+#include "./kmesh.h"
+#include "./meshopt.h"
+#include "./timer.h"
+
+// Reports how well the triangles of meshes use the post-transform vertex
+// cache. OBJ and PLY meshes are reported as they come and after
+// meshopt_optimize(), every level of .kmesh files as it is stored, `opt`
+// when meshconv optimized it:
+//   $ ./meshstat models/bunny.obj models/bunny.kmesh
+
+// Caches of the GPUs around
+static const size_t cache_sizes[] = {16, 32};
+#define CACHE_SIZES_COUNT (sizeof(cache_sizes) / sizeof(cache_sizes[0]))
+
+void usage(FILE *stream, const char *program)
+{
+    fprintf(stream, "Usage: %s <mesh.obj|mesh.ply|mesh.kmesh...>\n", program);
+}
+
+void report(const char *name, const char *order,
+            const uint32_t *indices, size_t indices_count, size_t vertices_count)
+{
+    printf("%-24s %-10s %10zu", name, order, indices_count / TRI_VERTICES);
+    for (size_t i = 0; i < CACHE_SIZES_COUNT; ++i) {
+        const Meshopt_Stats stats = meshopt_analyze(indices, indices_count, vertices_count, cache_sizes[i]);
+        printf(" %8.3f %8.3f", stats.acmr, stats.atvr);
+    }
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *const program = argv[0];
+
+    if (argc < 2) {
+        usage(stderr, program);
+        fprintf(stderr, "ERROR: no input files\n");
+        exit(1);
+    }
+
+    Pool *pool = pool_create(pool_hardware_threads() - 1);
+    if (pool == NULL) {
+        fprintf(stderr, "WARNING: could not start worker threads: %s\n", strerror(errno));
+    }
+
+    printf("%-24s %-10s %10s", "mesh", "order", "tris");
+    for (size_t i = 0; i < CACHE_SIZES_COUNT; ++i) {
+        printf("  ACMR@%-2zu  ATVR@%-2zu", cache_sizes[i], cache_sizes[i]);
+    }
+    printf("\n");
+
+    int result = 0;
+    for (int i = 1; i < argc; ++i) {
+        const char *const file_path = argv[i];
+
+        if (sv_ends_with(sv_from_cstr(file_path), SV(KMESH_EXTENSION))) {
+            Kmesh kmesh = {0};
+            const char *error = NULL;
+            if (!kmesh_open(file_path, &kmesh, &error)) {
+                fprintf(stderr, "ERROR: could not open %s: %s\n", file_path, error);
+                result = 1;
+                continue;
+            }
+            for (size_t lod = 0; lod < kmesh.header->lods_count; ++lod) {
+                char order[32];
+                snprintf(order, sizeof(order), "%s lod%zu",
+                         kmesh.header->flags & KMESH_FLAG_OPTIMIZED ? "opt" : "raw", lod);
+                report(file_path, order, kmesh_lod_indices(&kmesh, lod),
+                       kmesh.lods[lod].indices_count, kmesh.header->vertices_count);
+            }
+            kmesh_close(&kmesh);
+            continue;
+        }
+
+        Mesh mesh = {0};
+        const char *error = NULL;
+        if (!mesh_load_file(file_path, pool, &mesh, &error)) {
+            fprintf(stderr, "ERROR: could not load mesh %s: %s\n", file_path, error);
+            result = 1;
+            continue;
+        }
+        report(file_path, "loaded", mesh.indices, mesh.indices_count, mesh.vertices_count);
+
+        const double start = timer_now();
+        if (!meshopt_optimize(&mesh)) {
+            fprintf(stderr, "ERROR: could not optimize mesh %s: %s\n", file_path, strerror(errno));
+            mesh_free(&mesh);
+            result = 1;
+            continue;
+        }
+        const double secs = timer_now() - start;
+        report(file_path, "optimized", mesh.indices, mesh.indices_count, mesh.vertices_count);
+        printf("%-24s optimized in %.3f ms\n", file_path, secs * 1000.0);
+        mesh_free(&mesh);
+    }
+
+    if (pool != NULL) pool_destroy(pool);
+    return result;
+}
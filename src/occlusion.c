@@ -0,0 +1,319 @@
+#include <math.h>
+
+#include "./occlusion.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define OCCLUSION_SSE2
+#endif
+
+#define OCCLUSION_LANES 4
+
+_Static_assert(OCCLUSION_WIDTH % OCCLUSION_LANES == 0, "rows must be made of whole lanes");
+
+typedef struct {
+    float x;
+    float y;
+    // 1/w, unlike w itself it changes linearly across the screen
+    float z;
+} Occlusion_Vertex;
+
+static float min_float(float a, float b) { return a < b ? a : b; }
+static float max_float(float a, float b) { return a > b ? a : b; }
+static float abs_float(float a) { return a < 0.0f ? -a : a; }
+
+static size_t level_width(size_t level)
+{
+    return OCCLUSION_WIDTH >> level;
+}
+
+static size_t level_height(size_t level)
+{
+    return OCCLUSION_HEIGHT >> level;
+}
+
+static float *level_texels(Occlusion_Buffer *buffer, size_t level)
+{
+    size_t offset = 0;
+    for (size_t l = 0; l < level; ++l) {
+        offset += level_width(l) * level_height(l);
+    }
+    return buffer->texels + offset;
+}
+
+static const float *level_texels_const(const Occlusion_Buffer *buffer, size_t level)
+{
+    return level_texels((Occlusion_Buffer*) buffer, level);
+}
+
+void occlusion_begin(Occlusion_Buffer *buffer, Mat4 mvp, const float eye[V3_COMPS])
+{
+    buffer->mvp = mvp;
+    for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+        buffer->eye[axis] = eye[axis];
+    }
+
+    float *texels = level_texels(buffer, 0);
+    for (size_t i = 0; i < OCCLUSION_WIDTH * OCCLUSION_HEIGHT; ++i) {
+        texels[i] = 0.0f;
+    }
+}
+
+// Clip space corners of the box. Corner `i` takes the max of every axis
+// whose bit is set in `i`, so every corner is the min corner plus some of
+// the columns of the matrix scaled by the size of the box.
+static void box_corners(Mat4 mvp, const float min[V3_COMPS], const float max[V3_COMPS],
+                        V4 corners[1 << V3_COMPS])
+{
+    V4 edges[V3_COMPS];
+    for (size_t row = 0; row < V4_COMPS; ++row) {
+        float base = mvp.vs[row][W];
+        for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+            base += mvp.vs[row][axis] * min[axis];
+            edges[axis].cs[row] = mvp.vs[row][axis] * (max[axis] - min[axis]);
+        }
+        corners[0].cs[row] = base;
+    }
+
+    for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+        const size_t bit = 1 << axis;
+        for (size_t i = 0; i < bit; ++i) {
+            for (size_t row = 0; row < V4_COMPS; ++row) {
+                corners[i | bit].cs[row] = corners[i].cs[row] + edges[axis].cs[row];
+            }
+        }
+    }
+}
+
+static Occlusion_Vertex to_screen(V4 clip)
+{
+    const float z = 1.0f / clip.cs[W];
+    return (Occlusion_Vertex) {
+        .x = (clip.cs[X] * z * 0.5f + 0.5f) * (float) OCCLUSION_WIDTH,
+        .y = (clip.cs[Y] * z * 0.5f + 0.5f) * (float) OCCLUSION_HEIGHT,
+        .z = z,
+    };
+}
+
+#define QUAD_VERTICES 4
+
+// The quad is planar and convex, so is its projection
+static void draw_quad(Occlusion_Buffer *buffer, const Occlusion_Vertex quad[QUAD_VERTICES])
+{
+    Occlusion_Vertex vs[QUAD_VERTICES];
+    float area = 0.0f;
+    for (size_t i = 0; i < QUAD_VERTICES; ++i) {
+        const Occlusion_Vertex p = quad[i];
+        const Occlusion_Vertex q = quad[(i + 1) % QUAD_VERTICES];
+        area += p.x * q.y - q.x * p.y;
+    }
+    if (area == 0.0f) return;
+    for (size_t i = 0; i < QUAD_VERTICES; ++i) {
+        vs[i] = quad[area > 0.0f ? i : QUAD_VERTICES - 1 - i];
+    }
+
+    // Edge functions A*x + B*y + C that are positive inside of the quad.
+    // Only the texels entirely inside count as covered: a texel half
+    // covered by a near face may still show something far behind it.
+    float a[QUAD_VERTICES], b[QUAD_VERTICES], c[QUAD_VERTICES];
+    for (size_t i = 0; i < QUAD_VERTICES; ++i) {
+        const Occlusion_Vertex p = vs[i];
+        const Occlusion_Vertex q = vs[(i + 1) % QUAD_VERTICES];
+        a[i] = p.y - q.y;
+        b[i] = q.x - p.x;
+        c[i] = -(a[i] * p.x + b[i] * p.y) - 0.5f * (abs_float(a[i]) + abs_float(b[i]));
+    }
+
+    float min_x = INFINITY, max_x = -INFINITY;
+    float min_y = INFINITY, max_y = -INFINITY;
+    float farthest = INFINITY;
+    for (size_t i = 0; i < QUAD_VERTICES; ++i) {
+        min_x = min_float(min_x, vs[i].x);
+        max_x = max_float(max_x, vs[i].x);
+        min_y = min_float(min_y, vs[i].y);
+        max_y = max_float(max_y, vs[i].y);
+        farthest = min_float(farthest, vs[i].z);
+    }
+    if (max_x < 0.0f || max_y < 0.0f ||
+            min_x >= (float) OCCLUSION_WIDTH || min_y >= (float) OCCLUSION_HEIGHT) return;
+
+    const long x0 = min_x > 0.0f ? (long) min_x & ~(long) (OCCLUSION_LANES - 1) : 0;
+    const long x1 = max_x < (float) OCCLUSION_WIDTH ? (long) max_x : OCCLUSION_WIDTH - 1;
+    const long y0 = min_y > 0.0f ? (long) min_y : 0;
+    const long y1 = max_y < (float) OCCLUSION_HEIGHT ? (long) max_y : OCCLUSION_HEIGHT - 1;
+
+    // Over the triangle of the first three vertices the edge function
+    // opposite of a vertex divided by the area is the weight of the
+    // vertex, which makes 1/w the plane Z_A*x + Z_B*y + Z_C of the whole
+    // quad. A texel takes the farthest 1/w of the plane over its square,
+    // and never farther than the farthest vertex.
+    const float tri_area = (vs[1].x - vs[0].x) * (vs[2].y - vs[0].y) - (vs[1].y - vs[0].y) * (vs[2].x - vs[0].x);
+    if (tri_area <= 0.0f) return;
+    float za = 0.0f, zb = 0.0f, zc = 0.0f;
+    for (size_t i = 0; i < TRI_VERTICES; ++i) {
+        const Occlusion_Vertex p = vs[i];
+        const Occlusion_Vertex q = vs[(i + 1) % TRI_VERTICES];
+        const float z = vs[(i + 2) % TRI_VERTICES].z / tri_area;
+        za += (p.y - q.y) * z;
+        zb += (q.x - p.x) * z;
+        zc += (p.x * q.y - q.x * p.y) * z;
+    }
+    zc -= 0.5f * (abs_float(za) + abs_float(zb));
+    float *texels = level_texels(buffer, 0);
+
+#ifdef OCCLUSION_SSE2
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 farthests = _mm_set1_ps(farthest);
+    const __m128 lane_offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+    const __m128 xs = _mm_add_ps(_mm_set1_ps((float) x0), lane_offsets);
+    __m128 steps[QUAD_VERTICES], starts[QUAD_VERTICES];
+    for (size_t i = 0; i < QUAD_VERTICES; ++i) {
+        steps[i] = _mm_set1_ps(a[i] * (float) OCCLUSION_LANES);
+        starts[i] = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[i]), xs), _mm_set1_ps(c[i]));
+    }
+    const __m128 z_step = _mm_set1_ps(za * (float) OCCLUSION_LANES);
+    const __m128 z_start = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(za), xs), _mm_set1_ps(zc));
+
+    for (long y = y0; y <= y1; ++y) {
+        float *row = texels + y * OCCLUSION_WIDTH;
+        const float cy = (float) y + 0.5f;
+        __m128 es[QUAD_VERTICES];
+        for (size_t i = 0; i < QUAD_VERTICES; ++i) {
+            es[i] = _mm_add_ps(starts[i], _mm_set1_ps(b[i] * cy));
+        }
+        __m128 zs = _mm_add_ps(z_start, _mm_set1_ps(zb * cy));
+
+        for (long x = x0; x <= x1; x += OCCLUSION_LANES) {
+            const __m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(es[0], zero),
+                                                        _mm_cmpge_ps(es[1], zero)),
+                                             _mm_and_ps(_mm_cmpge_ps(es[2], zero),
+                                                        _mm_cmpge_ps(es[3], zero)));
+            if (_mm_movemask_ps(inside) != 0) {
+                const __m128 old = _mm_loadu_ps(row + x);
+                const __m128 nearer = _mm_max_ps(old, _mm_max_ps(zs, farthests));
+                _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearer), _mm_andnot_ps(inside, old)));
+            }
+            for (size_t i = 0; i < QUAD_VERTICES; ++i) {
+                es[i] = _mm_add_ps(es[i], steps[i]);
+            }
+            zs = _mm_add_ps(zs, z_step);
+        }
+    }
+#else
+    for (long y = y0; y <= y1; ++y) {
+        float *row = texels + y * OCCLUSION_WIDTH;
+        const float cy = (float) y + 0.5f;
+        for (long x = x0; x <= x1; ++x) {
+            const float cx = (float) x + 0.5f;
+            bool inside = true;
+            for (size_t i = 0; i < QUAD_VERTICES && inside; ++i) {
+                inside = a[i] * cx + b[i] * cy + c[i] >= 0.0f;
+            }
+            if (inside) {
+                const float z = max_float(za * cx + zb * cy + zc, farthest);
+                row[x] = max_float(row[x], z);
+            }
+        }
+    }
+#endif
+}
+
+void occlusion_draw_box(Occlusion_Buffer *buffer, const float min[V3_COMPS], const float max[V3_COMPS])
+{
+    V4 clip[1 << V3_COMPS];
+    box_corners(buffer->mvp, min, max, clip);
+
+    for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+        for (size_t side = 0; side < PAIR_COMPS; ++side) {
+            const bool facing = side == 0
+                ? buffer->eye[axis] < min[axis]
+                : buffer->eye[axis] > max[axis];
+            if (!facing) continue;
+
+            // The four corners of the face around it
+            const size_t u = 1 << ((axis + 1) % V3_COMPS);
+            const size_t v = 1 << ((axis + 2) % V3_COMPS);
+            const size_t base = side << axis;
+            const size_t quad[QUAD_VERTICES] = {base, base | u, base | u | v, base | v};
+
+            bool in_front = true;
+            Occlusion_Vertex vertices[QUAD_VERTICES];
+            for (size_t i = 0; i < QUAD_VERTICES && in_front; ++i) {
+                in_front = clip[quad[i]].cs[W] >= OCCLUSION_NEAR;
+                vertices[i] = to_screen(clip[quad[i]]);
+            }
+            // Clipping would only make the occluder smaller, dropping the
+            // face keeps the buffer conservative
+            if (!in_front) continue;
+
+            draw_quad(buffer, vertices);
+        }
+    }
+}
+
+void occlusion_build_hiz(Occlusion_Buffer *buffer)
+{
+    for (size_t level = 1; level < OCCLUSION_LEVELS; ++level) {
+        const float *src = level_texels(buffer, level - 1);
+        float *dst = level_texels(buffer, level);
+        const size_t src_width = level_width(level - 1);
+        const size_t width = level_width(level);
+
+        for (size_t y = 0; y < level_height(level); ++y) {
+            const float *top = src + 2 * y * src_width;
+            const float *bottom = top + src_width;
+            for (size_t x = 0; x < width; ++x) {
+                dst[y * width + x] = min_float(min_float(top[2 * x], top[2 * x + 1]),
+                                               min_float(bottom[2 * x], bottom[2 * x + 1]));
+            }
+        }
+    }
+}
+
+bool occlusion_test_box(const Occlusion_Buffer *buffer, const float min[V3_COMPS], const float max[V3_COMPS])
+{
+    V4 clip[1 << V3_COMPS];
+    box_corners(buffer->mvp, min, max, clip);
+
+    float min_x = INFINITY, max_x = -INFINITY;
+    float min_y = INFINITY, max_y = -INFINITY;
+    float nearest = 0.0f;
+    for (size_t i = 0; i < (1 << V3_COMPS); ++i) {
+        if (clip[i].cs[W] < OCCLUSION_NEAR) return true;
+
+        const Occlusion_Vertex v = to_screen(clip[i]);
+        min_x = min_float(min_x, v.x);
+        max_x = max_float(max_x, v.x);
+        min_y = min_float(min_y, v.y);
+        max_y = max_float(max_y, v.y);
+        nearest = max_float(nearest, v.z);
+    }
+
+    // Off the screen is up to the frustum culling
+    if (max_x < 0.0f || max_y < 0.0f ||
+            min_x >= (float) OCCLUSION_WIDTH || min_y >= (float) OCCLUSION_HEIGHT) return true;
+
+    size_t x0 = min_x > 0.0f ? (size_t) min_x : 0;
+    size_t x1 = max_x < (float) OCCLUSION_WIDTH ? (size_t) max_x : OCCLUSION_WIDTH - 1;
+    size_t y0 = min_y > 0.0f ? (size_t) min_y : 0;
+    size_t y1 = max_y < (float) OCCLUSION_HEIGHT ? (size_t) max_y : OCCLUSION_HEIGHT - 1;
+
+    // The first level where the box covers at most 2x2 texels
+    size_t level = 0;
+    while (level + 1 < OCCLUSION_LEVELS && (x1 - x0 > 1 || y1 - y0 > 1)) {
+        level += 1;
+        x0 >>= 1;
+        x1 >>= 1;
+        y0 >>= 1;
+        y1 >>= 1;
+    }
+
+    const float *texels = level_texels_const(buffer, level);
+    const size_t width = level_width(level);
+    for (size_t y = y0; y <= y1; ++y) {
+        for (size_t x = x0; x <= x1; ++x) {
+            if (texels[y * width + x] <= nearest) return true;
+        }
+    }
+    return false;
+}
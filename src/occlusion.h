@@ -0,0 +1,45 @@
+#ifndef OCCLUSION_H_
+#define OCCLUSION_H_
+
+#include <stdbool.h>
+
+#include "./geo.h"
+
+// Software occlusion culling. Big occluders are rasterized into a low
+// resolution depth buffer on the CPU, the buffer is reduced into a
+// hierarchical-Z pyramid, and the bounds of everything else are tested
+// against the pyramid before anything is submitted to the GPU.
+
+#define OCCLUSION_WIDTH 256
+#define OCCLUSION_HEIGHT 128
+// Down to 2x1 texels
+#define OCCLUSION_LEVELS 8
+#define OCCLUSION_TEXELS (OCCLUSION_WIDTH * OCCLUSION_HEIGHT * 4 / 3 + 1)
+// Boxes closer to the eye than this are always visible and never occlude
+#define OCCLUSION_NEAR 0.01f
+
+// The texels hold 1/w, the inverse of the distance along the view
+// direction, so bigger is nearer. Every texel of a level holds the
+// farthest of the four texels under it, and the level 0 texels not
+// covered by any occluder stay at 0.
+typedef struct {
+    // From the space of the boxes to clip space
+    Mat4 mvp;
+    // The eye in the space of the boxes, to skip the faces facing away
+    float eye[V3_COMPS];
+    // Level 0 first, then every next level at half of the size
+    float texels[OCCLUSION_TEXELS];
+} Occlusion_Buffer;
+
+// Clears the buffer for a new frame
+void occlusion_begin(Occlusion_Buffer *buffer, Mat4 mvp, const float eye[V3_COMPS]);
+// Rasterizes the faces of the box facing the eye. Every covered texel
+// takes the farthest depth of the face over the texel, so the buffer
+// never claims an occluder is closer than it is.
+void occlusion_draw_box(Occlusion_Buffer *buffer, const float min[V3_COMPS], const float max[V3_COMPS]);
+// Builds the pyramid after all of the occluders are drawn
+void occlusion_build_hiz(Occlusion_Buffer *buffer);
+// False when the box is hidden behind the occluders
+bool occlusion_test_box(const Occlusion_Buffer *buffer, const float min[V3_COMPS], const float max[V3_COMPS]);
+
+#endif // OCCLUSION_H_
@@ -0,0 +1,332 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "./pack.h"
+
+#define LZ4_IMPLEMENTATION
+#include "./lz4.h"
+
+static const char *const pack_entry_kind_names[COUNT_PACK_ENTRY_KINDS] = {
+    [PACK_ENTRY_FILE]    = "file",
+    [PACK_ENTRY_IMAGE]   = "image",
+    [PACK_ENTRY_TEXTURE] = "texture",
+    [PACK_ENTRY_MESH]    = "mesh",
+};
+
+static const char *const pack_codec_names[COUNT_PACK_CODECS] = {
+    [PACK_CODEC_NONE] = "none",
+    [PACK_CODEC_LZ4]  = "lz4",
+};
+
+const char *pack_entry_kind_name(Pack_Entry_Kind kind)
+{
+    if (kind >= COUNT_PACK_ENTRY_KINDS) return "unknown";
+    return pack_entry_kind_names[kind];
+}
+
+const char *pack_codec_name(Pack_Codec codec)
+{
+    if (codec >= COUNT_PACK_CODECS) return "unknown";
+    return pack_codec_names[codec];
+}
+
+static size_t align_up(size_t x, size_t alignment)
+{
+    return (x + alignment - 1) / alignment * alignment;
+}
+
+#define PACK_FAIL(reason) \
+    do { \
+        *error = (reason); \
+        pack_close(pack); \
+        return false; \
+    } while (0)
+
+static void inflate_entry(void *arg, size_t index, size_t worker)
+{
+    (void) worker;
+    Pack *pack = arg;
+    const Pack_Entry *entry = &pack->entries[index];
+    if (entry->codec == PACK_CODEC_NONE) return;
+
+    // Every task only touches its own slot, so failures are reported by
+    // clearing it instead of sharing a flag between the workers
+    uint8_t *dst = (uint8_t*) pack->entries_data[index];
+    const uint8_t *src = (const uint8_t*) pack->file.data + entry->offset;
+    if (lz4_decompress(src, entry->stored_size, dst, entry->size) != 0) {
+        pack->entries_data[index] = NULL;
+        return;
+    }
+    dst[entry->size] = '\0';
+}
+
+bool pack_open(const char *file_path, Pack *pack, Pool *pool, const char **error)
+{
+    memset(pack, 0, sizeof(*pack));
+
+    if (!mapped_file_open(file_path, &pack->file)) {
+        *error = strerror(errno);
+        return false;
+    }
+
+    // The whole pack is needed at startup anyway, so ask the OS to read it
+    // in one go instead of faulting it in page by page
+    mapped_file_will_need(&pack->file);
+
+    const uint8_t *bytes = pack->file.data;
+    const size_t size = pack->file.size;
+
+    if (size < sizeof(Pack_Header)) PACK_FAIL("not enough data for the header");
+    pack->header = (const Pack_Header*) bytes;
+
+    if (memcmp(pack->header->magic, PACK_MAGIC, sizeof(pack->header->magic)) != 0) {
+        PACK_FAIL("invalid magic");
+    }
+    if (pack->header->version != PACK_VERSION) PACK_FAIL("unsupported version");
+    if (pack->header->file_size != size) PACK_FAIL("truncated file");
+
+    const size_t entries_count = pack->header->entries_count;
+    if (entries_count > (size - sizeof(Pack_Header)) / sizeof(Pack_Entry)) {
+        PACK_FAIL("index does not fit into the file");
+    }
+    pack->entries = (const Pack_Entry*) (bytes + sizeof(Pack_Header));
+
+    for (size_t i = 0; i < entries_count; ++i) {
+        const Pack_Entry *entry = &pack->entries[i];
+        if (memchr(entry->name, '\0', PACK_NAME_CAPACITY) == NULL) {
+            PACK_FAIL("entry name is not terminated");
+        }
+        if (i > 0 && strcmp(pack->entries[i - 1].name, entry->name) >= 0) {
+            PACK_FAIL("index is not sorted");
+        }
+        if (entry->codec >= COUNT_PACK_CODECS) PACK_FAIL("unknown entry codec");
+        if (entry->codec == PACK_CODEC_NONE && entry->stored_size != entry->size) {
+            PACK_FAIL("stored entry size mismatch");
+        }
+        if (entry->offset % PACK_ALIGNMENT != 0 ||
+                entry->offset > size ||
+                size - entry->offset <= entry->stored_size ||
+                bytes[entry->offset + entry->stored_size] != '\0') {
+            PACK_FAIL("entry is out of bounds");
+        }
+    }
+
+    pack->entries_data = malloc(entries_count * sizeof(*pack->entries_data) + 1);
+    if (pack->entries_data == NULL) PACK_FAIL("out of memory");
+
+    // Lay out every compressed entry in one buffer up front, so the workers
+    // decompress straight into their final place without allocating
+    size_t inflated_size = 0;
+    for (size_t i = 0; i < entries_count; ++i) {
+        const Pack_Entry *entry = &pack->entries[i];
+        if (entry->codec == PACK_CODEC_NONE) continue;
+        // The index is not trusted yet, so guard the sum against overflow
+        if (entry->size >= SIZE_MAX / 2 - inflated_size) PACK_FAIL("entry is too big");
+        inflated_size = align_up(inflated_size, PACK_ALIGNMENT) + entry->size + 1;
+    }
+
+    if (inflated_size > 0) {
+        pack->inflated = malloc(inflated_size);
+        if (pack->inflated == NULL) PACK_FAIL("out of memory");
+        pack->inflated_size = inflated_size;
+    }
+
+    size_t inflated_offset = 0;
+    for (size_t i = 0; i < entries_count; ++i) {
+        const Pack_Entry *entry = &pack->entries[i];
+        if (entry->codec == PACK_CODEC_NONE) {
+            pack->entries_data[i] = bytes + entry->offset;
+        } else {
+            inflated_offset = align_up(inflated_offset, PACK_ALIGNMENT);
+            pack->entries_data[i] = pack->inflated + inflated_offset;
+            inflated_offset += entry->size + 1;
+        }
+    }
+
+    pool_for(pool, entries_count, inflate_entry, pack);
+
+    for (size_t i = 0; i < entries_count; ++i) {
+        if (pack->entries_data[i] == NULL) PACK_FAIL("corrupted compressed entry");
+    }
+
+    return true;
+}
+
+void pack_close(Pack *pack)
+{
+    mapped_file_close(&pack->file);
+    free(pack->entries_data);
+    free(pack->inflated);
+    memset(pack, 0, sizeof(*pack));
+}
+
+const Pack_Entry *pack_find(const Pack *pack, const char *name)
+{
+    if (pack->header == NULL) return NULL;
+
+    size_t lo = 0;
+    size_t hi = pack->header->entries_count;
+    while (lo < hi) {
+        const size_t mid = lo + (hi - lo) / 2;
+        const int cmp = strcmp(pack->entries[mid].name, name);
+        if (cmp == 0) {
+            return &pack->entries[mid];
+        } else if (cmp < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return NULL;
+}
+
+const void *pack_entry_data(const Pack *pack, const Pack_Entry *entry)
+{
+    return pack->entries_data[entry - pack->entries];
+}
+
+bool pack_builder_add(Pack_Builder *builder, const char *name,
+                      Pack_Entry_Kind kind, uint64_t hash,
+                      const void *data, size_t size)
+{
+    if (strlen(name) >= PACK_NAME_CAPACITY) {
+        errno = ENAMETOOLONG;
+        return false;
+    }
+
+    for (size_t i = 0; i < builder->items_count; ++i) {
+        if (strcmp(builder->items[i].entry.name, name) == 0) {
+            errno = EEXIST;
+            return false;
+        }
+    }
+
+    if (builder->items_count >= builder->items_capacity) {
+        const size_t new_capacity = builder->items_capacity == 0 ? 16 : builder->items_capacity * 2;
+        Pack_Builder_Item *new_items = realloc(builder->items, new_capacity * sizeof(*new_items));
+        if (new_items == NULL) {
+            errno = ENOMEM;
+            return false;
+        }
+        builder->items = new_items;
+        builder->items_capacity = new_capacity;
+    }
+
+    Pack_Builder_Item *item = &builder->items[builder->items_count++];
+    memset(item, 0, sizeof(*item));
+    strcpy(item->entry.name, name);
+    item->entry.size = size;
+    item->entry.stored_size = size;
+    item->entry.hash = hash;
+    item->entry.kind = kind;
+    item->data = data;
+    return true;
+}
+
+static int compare_items(const void *a, const void *b)
+{
+    const Pack_Builder_Item *item_a = a;
+    const Pack_Builder_Item *item_b = b;
+    return strcmp(item_a->entry.name, item_b->entry.name);
+}
+
+static bool write_zeros(FILE *f, size_t count)
+{
+    static const char zeros[PACK_ALIGNMENT] = {0};
+    while (count > 0) {
+        const size_t n = count < sizeof(zeros) ? count : sizeof(zeros);
+        if (fwrite(zeros, 1, n, f) != n) return false;
+        count -= n;
+    }
+    return true;
+}
+
+static bool compress_item(Pack_Builder_Item *item, Pack_Codec codec)
+{
+    Pack_Entry *entry = &item->entry;
+    entry->codec = PACK_CODEC_NONE;
+    entry->stored_size = entry->size;
+    free(item->stored);
+    item->stored = NULL;
+
+    if (codec != PACK_CODEC_LZ4 || entry->size == 0) return true;
+
+    const size_t capacity = lz4_compress_bound(entry->size);
+    uint8_t *stored = malloc(capacity);
+    if (stored == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    const size_t stored_size = lz4_compress(item->data, entry->size, stored, capacity);
+    if (stored_size == 0 || stored_size >= entry->size) {
+        // Incompressible, keep it zero-copy
+        free(stored);
+        return true;
+    }
+
+    item->stored = stored;
+    entry->codec = PACK_CODEC_LZ4;
+    entry->stored_size = stored_size;
+    return true;
+}
+
+bool pack_builder_save(Pack_Builder *builder, const char *file_path)
+{
+    qsort(builder->items, builder->items_count, sizeof(*builder->items), compare_items);
+
+    for (size_t i = 0; i < builder->items_count; ++i) {
+        if (!compress_item(&builder->items[i], builder->codec)) return false;
+    }
+
+    size_t offset = sizeof(Pack_Header) + builder->items_count * sizeof(Pack_Entry);
+    for (size_t i = 0; i < builder->items_count; ++i) {
+        offset = align_up(offset, PACK_ALIGNMENT);
+        builder->items[i].entry.offset = offset;
+        // +1 for the zero byte that terminates every blob
+        offset += builder->items[i].entry.stored_size + 1;
+    }
+
+    Pack_Header header = {0};
+    memcpy(header.magic, PACK_MAGIC, sizeof(header.magic));
+    header.version = PACK_VERSION;
+    header.entries_count = (uint32_t) builder->items_count;
+    header.file_size = offset;
+
+    FILE *f = fopen(file_path, "wb");
+    if (f == NULL) return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+    for (size_t i = 0; ok && i < builder->items_count; ++i) {
+        ok = fwrite(&builder->items[i].entry, sizeof(Pack_Entry), 1, f) == 1;
+    }
+
+    size_t written = sizeof(Pack_Header) + builder->items_count * sizeof(Pack_Entry);
+    for (size_t i = 0; ok && i < builder->items_count; ++i) {
+        const Pack_Builder_Item *item = &builder->items[i];
+        const Pack_Entry *entry = &item->entry;
+        ok = write_zeros(f, entry->offset - written);
+        if (ok && entry->stored_size > 0) {
+            const void *stored = item->stored != NULL ? item->stored : item->data;
+            ok = fwrite(stored, entry->stored_size, 1, f) == 1;
+        }
+        if (ok) ok = write_zeros(f, 1);
+        written = entry->offset + entry->stored_size + 1;
+    }
+
+    const int saved_errno = errno;
+    if (fclose(f) != 0) ok = false;
+    errno = saved_errno;
+    return ok;
+}
+
+void pack_builder_free(Pack_Builder *builder)
+{
+    for (size_t i = 0; i < builder->items_count; ++i) {
+        free(builder->items[i].stored);
+    }
+    free(builder->items);
+    memset(builder, 0, sizeof(*builder));
+}
@@ -0,0 +1,117 @@
+#ifndef PACK_H_
+#define PACK_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "./mapped_file.h"
+#include "./pool.h"
+
+// Single file asset archive that is memory mapped once:
+//
+//   Pack_Header
+//   Pack_Entry[entries_count]   sorted by name
+//   entry blobs                 each aligned to PACK_ALIGNMENT and
+//                               followed by at least one zero byte
+//
+// Stored entries are served zero-copy straight from the mapping. LZ4
+// entries are decompressed in parallel by pack_open() into a single buffer
+// laid out from the sizes in the index. Either way pack_entry_data() points
+// to `size` bytes followed by a zero byte, so text entries can be used as C
+// strings directly.
+//
+// All the integers are in the native byte order of the machine that built
+// the pack.
+
+#define PACK_MAGIC "KPAK"
+#define PACK_VERSION 2
+#define PACK_ALIGNMENT 64
+#define PACK_NAME_CAPACITY 88
+
+// Name of the PACK_ENTRY_MESH entry holding a Cube_Mesh
+#define PACK_CUBE_MESH_NAME "@cube"
+
+typedef enum {
+    // Verbatim copy of a file (scene.conf, shaders, ...)
+    PACK_ENTRY_FILE = 0,
+    // Image pre-decoded into the KRAW format, `hash` is the hash of the
+    // source image file
+    PACK_ENTRY_IMAGE,
+    // Compressed texture in the texture cache format
+    PACK_ENTRY_TEXTURE,
+    // Mesh vertex data
+    PACK_ENTRY_MESH,
+    COUNT_PACK_ENTRY_KINDS,
+} Pack_Entry_Kind;
+
+typedef enum {
+    PACK_CODEC_NONE = 0,
+    PACK_CODEC_LZ4,
+    COUNT_PACK_CODECS,
+} Pack_Codec;
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t entries_count;
+    uint32_t reserved;
+    uint64_t file_size;
+} Pack_Header;
+
+typedef struct {
+    char name[PACK_NAME_CAPACITY];
+    uint64_t offset;
+    // Size of the entry once decoded
+    uint64_t size;
+    // Size of the blob in the file, equal to `size` for PACK_CODEC_NONE
+    uint64_t stored_size;
+    uint64_t hash;
+    uint32_t kind;
+    uint32_t codec;
+} Pack_Entry;
+
+typedef struct {
+    Mapped_File file;
+    const Pack_Header *header;
+    const Pack_Entry *entries;
+    // Where every entry's data lives, either the mapping or `inflated`
+    const uint8_t **entries_data;
+    uint8_t *inflated;
+    size_t inflated_size;
+} Pack;
+
+const char *pack_entry_kind_name(Pack_Entry_Kind kind);
+const char *pack_codec_name(Pack_Codec codec);
+
+// Maps the pack, validates its index and decompresses the compressed
+// entries, spreading them across `pool` when it is not NULL. On failure
+// returns false and points `error` to a human readable reason.
+bool pack_open(const char *file_path, Pack *pack, Pool *pool, const char **error);
+void pack_close(Pack *pack);
+const Pack_Entry *pack_find(const Pack *pack, const char *name);
+const void *pack_entry_data(const Pack *pack, const Pack_Entry *entry);
+
+typedef struct {
+    Pack_Entry entry;
+    const void *data;
+    // Owned compressed copy of `data` made by pack_builder_save()
+    uint8_t *stored;
+} Pack_Builder_Item;
+
+typedef struct {
+    Pack_Builder_Item *items;
+    size_t items_count;
+    size_t items_capacity;
+    // Codec to try on every entry. Entries that do not get smaller are
+    // stored as is.
+    Pack_Codec codec;
+} Pack_Builder;
+
+// `data` is not copied and must stay alive until pack_builder_save()
+bool pack_builder_add(Pack_Builder *builder, const char *name,
+                      Pack_Entry_Kind kind, uint64_t hash,
+                      const void *data, size_t size);
+bool pack_builder_save(Pack_Builder *builder, const char *file_path);
+void pack_builder_free(Pack_Builder *builder);
+
+#endif // PACK_H_
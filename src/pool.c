@@ -0,0 +1,329 @@
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "./pool.h"
+
+typedef struct {
+    Pool_Task task;
+    void *arg;
+} Pool_Job;
+
+typedef struct {
+    Pool *pool;
+    size_t index;
+} Pool_Worker;
+
+struct Pool {
+    pthread_mutex_t mutex;
+    pthread_cond_t job_available;
+    pthread_cond_t jobs_done;
+
+    Pool_Job *jobs;
+    size_t jobs_capacity;
+    size_t jobs_begin;
+    size_t jobs_count;
+    size_t jobs_running;
+    bool quit;
+
+    pthread_t *threads;
+    Pool_Worker *workers;
+    size_t workers_count;
+};
+
+size_t pool_hardware_threads(void)
+{
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (size_t) n : 1;
+}
+
+static void *pool_worker(void *arg)
+{
+    Pool_Worker *worker = arg;
+    Pool *pool = worker->pool;
+
+    pthread_mutex_lock(&pool->mutex);
+    for (;;) {
+        while (pool->jobs_count == 0 && !pool->quit) {
+            pthread_cond_wait(&pool->job_available, &pool->mutex);
+        }
+
+        if (pool->jobs_count == 0 && pool->quit) {
+            break;
+        }
+
+        const Pool_Job job = pool->jobs[pool->jobs_begin];
+        pool->jobs_begin = (pool->jobs_begin + 1) % pool->jobs_capacity;
+        pool->jobs_count -= 1;
+        pool->jobs_running += 1;
+        pthread_mutex_unlock(&pool->mutex);
+
+        job.task(job.arg, worker->index);
+
+        pthread_mutex_lock(&pool->mutex);
+        pool->jobs_running -= 1;
+        if (pool->jobs_count == 0 && pool->jobs_running == 0) {
+            pthread_cond_broadcast(&pool->jobs_done);
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+
+    return NULL;
+}
+
+Pool *pool_create(size_t workers_count)
+{
+    Pool *pool = calloc(1, sizeof(*pool));
+    if (pool == NULL) return NULL;
+
+    pool->threads = calloc(workers_count + 1, sizeof(*pool->threads));
+    pool->workers = calloc(workers_count + 1, sizeof(*pool->workers));
+    if (pool->threads == NULL || pool->workers == NULL) {
+        free(pool->threads);
+        free(pool->workers);
+        free(pool);
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->job_available, NULL);
+    pthread_cond_init(&pool->jobs_done, NULL);
+
+    for (size_t i = 0; i < workers_count; ++i) {
+        pool->workers[i].pool = pool;
+        pool->workers[i].index = i;
+        const int err = pthread_create(&pool->threads[i], NULL, pool_worker, &pool->workers[i]);
+        if (err != 0) {
+            pool_destroy(pool);
+            errno = err;
+            return NULL;
+        }
+        pool->workers_count += 1;
+    }
+
+    return pool;
+}
+
+void pool_destroy(Pool *pool)
+{
+    if (pool == NULL) return;
+
+    pthread_mutex_lock(&pool->mutex);
+    pool->quit = true;
+    pthread_cond_broadcast(&pool->job_available);
+    pthread_mutex_unlock(&pool->mutex);
+
+    for (size_t i = 0; i < pool->workers_count; ++i) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    pthread_cond_destroy(&pool->jobs_done);
+    pthread_cond_destroy(&pool->job_available);
+    pthread_mutex_destroy(&pool->mutex);
+
+    free(pool->jobs);
+    free(pool->workers);
+    free(pool->threads);
+    free(pool);
+}
+
+size_t pool_workers_count(const Pool *pool)
+{
+    if (pool == NULL) return 1;
+    return pool->workers_count + 1;
+}
+
+bool pool_submit(Pool *pool, Pool_Task task, void *arg)
+{
+    // Nobody would ever run it
+    if (pool->workers_count == 0) {
+        errno = EAGAIN;
+        return false;
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+
+    if (pool->jobs_count >= pool->jobs_capacity) {
+        const size_t new_capacity = pool->jobs_capacity == 0 ? 64 : pool->jobs_capacity * 2;
+        Pool_Job *new_jobs = malloc(new_capacity * sizeof(*new_jobs));
+        if (new_jobs == NULL) {
+            pthread_mutex_unlock(&pool->mutex);
+            errno = ENOMEM;
+            return false;
+        }
+
+        for (size_t i = 0; i < pool->jobs_count; ++i) {
+            new_jobs[i] = pool->jobs[(pool->jobs_begin + i) % pool->jobs_capacity];
+        }
+
+        free(pool->jobs);
+        pool->jobs = new_jobs;
+        pool->jobs_capacity = new_capacity;
+        pool->jobs_begin = 0;
+    }
+
+    pool->jobs[(pool->jobs_begin + pool->jobs_count) % pool->jobs_capacity] = (Pool_Job) {
+        .task = task,
+        .arg = arg,
+    };
+    pool->jobs_count += 1;
+    pthread_cond_signal(&pool->job_available);
+
+    pthread_mutex_unlock(&pool->mutex);
+    return true;
+}
+
+void pool_wait(Pool *pool)
+{
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->jobs_count > 0 || pool->jobs_running > 0) {
+        pthread_cond_wait(&pool->jobs_done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+static void pool_async_worker(void *arg, size_t worker)
+{
+    Pool_Async *async = arg;
+    async->task(async->arg, worker);
+
+    Pool *pool = async->pool;
+    pthread_mutex_lock(&pool->mutex);
+    async->done = true;
+    // Shared with pool_wait(), which checks its own condition anyway
+    pthread_cond_broadcast(&pool->jobs_done);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+void pool_async(Pool *pool, Pool_Async *async, Pool_Task task, void *arg)
+{
+    *async = (Pool_Async) {
+        .pool = pool,
+        .task = task,
+        .arg = arg,
+    };
+    if (pool == NULL || !pool_submit(pool, pool_async_worker, async)) {
+        async->pool = NULL;
+        task(arg, pool_workers_count(pool) - 1);
+        async->done = true;
+    }
+}
+
+void pool_async_wait(Pool_Async *async)
+{
+    Pool *pool = async->pool;
+    if (pool == NULL) return;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (!async->done) {
+        pthread_cond_wait(&pool->jobs_done, &pool->mutex);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+bool pool_async_done(Pool_Async *async)
+{
+    Pool *pool = async->pool;
+    if (pool == NULL) return true;
+
+    pthread_mutex_lock(&pool->mutex);
+    const bool done = async->done;
+    pthread_mutex_unlock(&pool->mutex);
+    return done;
+}
+
+typedef struct {
+    Pool_For_Task task;
+    void *arg;
+    size_t count;
+    pthread_mutex_t mutex;
+    pthread_cond_t idle;
+    // Guarded by `mutex`
+    size_t next;
+    // Jobs in the middle of an index, the only ones pool_for() waits for
+    size_t busy;
+    // The caller and every job that has not returned yet. The last one to
+    // let go frees the loop, so jobs that only start once every index is
+    // taken never touch a loop that is gone.
+    size_t refs;
+} Pool_For;
+
+static void pool_for_release(Pool_For *pf)
+{
+    const bool last = pf->refs == 1;
+    pf->refs -= 1;
+    pthread_mutex_unlock(&pf->mutex);
+
+    if (last) {
+        pthread_cond_destroy(&pf->idle);
+        pthread_mutex_destroy(&pf->mutex);
+        free(pf);
+    }
+}
+
+// Returns with the mutex of the loop locked
+static void pool_for_worker(Pool_For *pf, size_t worker)
+{
+    pthread_mutex_lock(&pf->mutex);
+    if (pf->next < pf->count) {
+        pf->busy += 1;
+        while (pf->next < pf->count) {
+            const size_t index = pf->next;
+            pf->next += 1;
+            pthread_mutex_unlock(&pf->mutex);
+
+            pf->task(pf->arg, index, worker);
+
+            pthread_mutex_lock(&pf->mutex);
+        }
+        pf->busy -= 1;
+        if (pf->busy == 0) pthread_cond_signal(&pf->idle);
+    }
+}
+
+static void pool_for_job(void *arg, size_t worker)
+{
+    Pool_For *pf = arg;
+    pool_for_worker(pf, worker);
+    pool_for_release(pf);
+}
+
+void pool_for(Pool *pool, size_t count, Pool_For_Task task, void *arg)
+{
+    const size_t caller = pool_workers_count(pool) - 1;
+    Pool_For *pf = pool != NULL && count > 1 ? malloc(sizeof(*pf)) : NULL;
+    if (pf == NULL) {
+        for (size_t i = 0; i < count; ++i) task(arg, i, caller);
+        return;
+    }
+    *pf = (Pool_For) {
+        .task = task,
+        .arg = arg,
+        .count = count,
+        .refs = 1,
+    };
+    pthread_mutex_init(&pf->mutex, NULL);
+    pthread_cond_init(&pf->idle, NULL);
+
+    // One job per worker that keeps grabbing indices, so uneven items
+    // (like images of different sizes) balance themselves out. The caller
+    // takes indices as well, so the loop finishes even when every worker
+    // is stuck in a long task queued before it.
+    const size_t jobs = pool->workers_count < count - 1 ? pool->workers_count : count - 1;
+    pf->refs += jobs;
+    for (size_t i = 0; i < jobs; ++i) {
+        if (!pool_submit(pool, pool_for_job, pf)) {
+            pthread_mutex_lock(&pf->mutex);
+            pf->refs -= jobs - i;
+            pthread_mutex_unlock(&pf->mutex);
+            break;
+        }
+    }
+
+    pool_for_worker(pf, caller);
+    while (pf->busy > 0) {
+        pthread_cond_wait(&pf->idle, &pf->mutex);
+    }
+    pool_for_release(pf);
+}
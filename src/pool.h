@@ -0,0 +1,53 @@
+#ifndef POOL_H_
+#define POOL_H_
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+// Fixed size pool of worker threads executing tasks from a shared queue.
+// Every task is told the index of the worker that runs it, so callers can
+// keep per-worker state (like arenas) without any locking. The thread that
+// calls pool_for() works through the loop too, as the last worker, so one
+// thread at a time may call it.
+
+typedef void (*Pool_Task)(void *arg, size_t worker);
+typedef void (*Pool_For_Task)(void *arg, size_t index, size_t worker);
+
+typedef struct Pool Pool;
+
+// A task that can be waited for on its own while the others keep running.
+// Must stay at the same address until pool_async_wait() returns.
+typedef struct {
+    Pool *pool;
+    Pool_Task task;
+    void *arg;
+    // Guarded by the mutex of the pool
+    bool done;
+} Pool_Async;
+
+size_t pool_hardware_threads(void);
+
+// Without workers everything runs on the threads that call pool_for() and
+// pool_async(). Returns NULL and sets errno on failure.
+Pool *pool_create(size_t workers_count);
+void pool_destroy(Pool *pool);
+// Threads of the pool plus the caller, the amount of per-worker state to
+// keep. 1 when `pool` is NULL.
+size_t pool_workers_count(const Pool *pool);
+
+// Returns false and sets errno when the task could not be queued
+bool pool_submit(Pool *pool, Pool_Task task, void *arg);
+// Blocks until every submitted task is finished
+void pool_wait(Pool *pool);
+// Runs the task right away on the calling thread, as the last worker, when
+// `pool` is NULL or the task could not be queued
+void pool_async(Pool *pool, Pool_Async *async, Pool_Task task, void *arg);
+void pool_async_wait(Pool_Async *async);
+// Whether pool_async_wait() would return right away
+bool pool_async_done(Pool_Async *async);
+// Calls task(arg, i, worker) for every i in [0, count) and waits for all of
+// them, but not for the other tasks in the queue. Runs on the calling
+// thread alone when `pool` is NULL or there is a single index.
+void pool_for(Pool *pool, size_t count, Pool_For_Task task, void *arg);
+
+#endif // POOL_H_
@@ -0,0 +1,132 @@
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "./preload.h"
+
+bool preloader_init(Preloader *preloader, Pool *pool, size_t arena_capacity)
+{
+    memset(preloader, 0, sizeof(*preloader));
+    preloader->pool = pool;
+    preloader->arenas_count = pool_workers_count(pool);
+    preloader->arenas = calloc(preloader->arenas_count, sizeof(*preloader->arenas));
+    if (preloader->arenas == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    for (size_t i = 0; i < preloader->arenas_count; ++i) {
+        preloader->arenas[i] = region_with_capacity(arena_capacity);
+    }
+
+    return true;
+}
+
+void preloader_free(Preloader *preloader)
+{
+    for (size_t i = 0; i < preloader->arenas_count; ++i) {
+        region_free(&preloader->arenas[i]);
+    }
+    free(preloader->arenas);
+    memset(preloader, 0, sizeof(*preloader));
+}
+
+typedef struct {
+    Preloader *preloader;
+    Preload_Item *items;
+} Preload_Batch;
+
+static void preload_item(void *arg, size_t index, size_t worker)
+{
+    Preload_Batch *batch = arg;
+    Preload_Item *item = &batch->items[index];
+    Region *arena = &batch->preloader->arenas[worker];
+
+    const char *data = region_slurp_file_sized(arena, item->file_path, &item->file_size);
+    if (data == NULL) {
+        item->ok = false;
+        item->error = strerror(errno);
+        return;
+    }
+
+    // KRAW pixels point into `data`, which lives in the same arena, so
+    // they stay valid as long as the decoded ones do
+    if (!image_decode(arena, image_format_by_file_path(item->file_path),
+                      data, item->file_size, &item->image)) {
+        item->ok = false;
+        item->error = image_failure_reason();
+        return;
+    }
+
+    item->ok = true;
+}
+
+void preloader_run(Preloader *preloader, Preload_Item *items, size_t items_count)
+{
+    for (size_t i = 0; i < preloader->arenas_count; ++i) {
+        region_clean(&preloader->arenas[i]);
+    }
+
+    Preload_Batch batch = {
+        .preloader = preloader,
+        .items = items,
+    };
+    pool_for(preloader->pool, items_count, preload_item, &batch);
+}
+
+static int compare_cstr(const void *a, const void *b)
+{
+    return strcmp(*(const char *const *) a, *(const char *const *) b);
+}
+
+bool preload_list_dir(Region *region, const char *dir_path,
+                      const char ***file_paths, size_t *file_paths_count)
+{
+    DIR *dir = opendir(dir_path);
+    if (dir == NULL) return false;
+
+    size_t capacity = *file_paths_count;
+    bool ok = true;
+
+    struct dirent *entry = NULL;
+    while (ok && (entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') continue;
+
+        const size_t n = strlen(dir_path) + 1 + strlen(entry->d_name) + 1;
+        char *file_path = region_malloc(region, n);
+        if (file_path == NULL) {
+            ok = false;
+            break;
+        }
+        snprintf(file_path, n, "%s/%s", dir_path, entry->d_name);
+
+        struct stat st;
+        if (stat(file_path, &st) < 0 || !S_ISREG(st.st_mode)) continue;
+
+        if (*file_paths_count >= capacity) {
+            const size_t new_capacity = capacity == 0 ? 16 : capacity * 2;
+            const char **new_file_paths = region_realloc(
+                region, (void*) *file_paths,
+                capacity * sizeof(**file_paths),
+                new_capacity * sizeof(**file_paths));
+            if (new_file_paths == NULL) {
+                ok = false;
+                break;
+            }
+            *file_paths = new_file_paths;
+            capacity = new_capacity;
+        }
+
+        (*file_paths)[(*file_paths_count)++] = file_path;
+    }
+
+    closedir(dir);
+
+    if (ok) {
+        qsort((void*) *file_paths, *file_paths_count, sizeof(**file_paths), compare_cstr);
+    }
+
+    return ok;
+}
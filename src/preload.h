@@ -0,0 +1,47 @@
+#ifndef PRELOAD_H_
+#define PRELOAD_H_
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include "./region.h"
+#include "./image.h"
+#include "./pool.h"
+
+// Decodes a batch of images concurrently. Every worker of the pool, and the
+// thread calling preloader_run(), owns an arena, so the decoders never
+// contend on an allocator.
+//
+// Only bench_preload and bench_pack use it, to measure how decoding scales
+// with threads. kidito shows a single texture, which its reload already
+// reads and decodes on a worker next to the shaders.
+
+typedef struct {
+    const char *file_path;
+
+    bool ok;
+    // Valid when ok, lives in the arena of the worker that decoded it
+    // until the next preloader_run()
+    Image image;
+    size_t file_size;
+    // Valid when !ok
+    const char *error;
+} Preload_Item;
+
+typedef struct {
+    Pool *pool;
+    Region *arenas;
+    size_t arenas_count;
+} Preloader;
+
+// `arena_capacity` bytes are reserved per worker
+bool preloader_init(Preloader *preloader, Pool *pool, size_t arena_capacity);
+void preloader_free(Preloader *preloader);
+void preloader_run(Preloader *preloader, Preload_Item *items, size_t items_count);
+
+// Appends every regular file of `dir_path` to `file_paths`. The paths are
+// allocated from `region`. Returns false and sets errno on failure.
+bool preload_list_dir(Region *region, const char *dir_path,
+                      const char ***file_paths, size_t *file_paths_count);
+
+#endif // PRELOAD_H_
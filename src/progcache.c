@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define MKDIR(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define MKDIR(path) mkdir(path, 0755)
+#endif
+
+#define GLEW_STATIC
+#include "./hash.h"
+#include "./progcache.h"
+
+bool progcache_supported(void)
+{
+    if (!GLEW_VERSION_4_1 && !GLEW_ARB_get_program_binary) return false;
+    GLint formats = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    return formats > 0;
+}
+
+static uint64_t progcache_hash_string(uint64_t hash, GLenum name)
+{
+    const char *s = (const char *) glGetString(name);
+    if (s == NULL) s = "";
+    return hash_combine(hash, s, strlen(s) + 1);
+}
+
+uint64_t progcache_key(uint64_t vert_hash, uint64_t frag_hash)
+{
+    uint64_t key = hash_bytes(&vert_hash, sizeof(vert_hash));
+    key = hash_combine(key, &frag_hash, sizeof(frag_hash));
+    key = progcache_hash_string(key, GL_VENDOR);
+    key = progcache_hash_string(key, GL_RENDERER);
+    return progcache_hash_string(key, GL_VERSION);
+}
+
+void progcache_hint(GLuint program)
+{
+    if (GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary) {
+        glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    }
+}
+
+static char *progcache_file_path(Region *region, const char *cache_dir, uint64_t key)
+{
+    const char *const fmt = "%s/"HASH_Fmt".kprog";
+    const int n = snprintf(NULL, 0, fmt, cache_dir, HASH_Arg(key));
+    char *result = region_malloc(region, (size_t) n + 1);
+    if (result == NULL) return NULL;
+    snprintf(result, (size_t) n + 1, fmt, cache_dir, HASH_Arg(key));
+    return result;
+}
+
+bool progcache_load(Region *region, const char *cache_dir, uint64_t key, GLuint *program)
+{
+    if (!progcache_supported()) return false;
+
+    const char *file_path = progcache_file_path(region, cache_dir, key);
+    if (file_path == NULL) return false;
+
+    size_t size = 0;
+    const char *content = region_slurp_file_sized(region, file_path, &size);
+    if (content == NULL) return false;
+
+    Progcache_Header header = {0};
+    if (size < sizeof(header)) return false;
+    memcpy(&header, content, sizeof(header));
+    if (memcmp(header.magic, PROGCACHE_MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != PROGCACHE_VERSION ||
+            header.key != key ||
+            header.size != size - sizeof(header)) {
+        return false;
+    }
+
+    // Drivers reject binaries of their older versions, which is the same
+    // as not having them
+    *program = glCreateProgram();
+    glProgramBinary(*program, header.format, content + sizeof(header), (GLsizei) header.size);
+    GLint linked = 0;
+    glGetProgramiv(*program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        glDeleteProgram(*program);
+        *program = 0;
+        return false;
+    }
+    return true;
+}
+
+bool progcache_save(Region *region, const char *cache_dir, uint64_t key, GLuint program)
+{
+    if (!progcache_supported()) {
+        errno = ENOTSUP;
+        return false;
+    }
+
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        errno = ENOTSUP;
+        return false;
+    }
+
+    uint8_t *data = region_malloc(region, sizeof(Progcache_Header) + (size_t) length);
+    if (data == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+    GLsizei size = 0;
+    GLenum format = 0;
+    glGetProgramBinary(program, length, &size, &format, data + sizeof(Progcache_Header));
+    if (size <= 0) {
+        errno = ENOTSUP;
+        return false;
+    }
+
+    Progcache_Header header = {0};
+    memcpy(header.magic, PROGCACHE_MAGIC, sizeof(header.magic));
+    header.version = PROGCACHE_VERSION;
+    header.key = key;
+    header.format = format;
+    header.size = (uint32_t) size;
+    memcpy(data, &header, sizeof(header));
+
+    if (MKDIR(cache_dir) < 0 && errno != EEXIST) {
+        return false;
+    }
+
+    const char *file_path = progcache_file_path(region, cache_dir, key);
+    if (file_path == NULL) return false;
+
+    // Written aside and renamed, same as the texture cache
+    const size_t n = strlen(file_path) + sizeof(".tmp");
+    char *tmp_file_path = region_malloc(region, n);
+    if (tmp_file_path == NULL) return false;
+    snprintf(tmp_file_path, n, "%s.tmp", file_path);
+
+    FILE *f = fopen(tmp_file_path, "wb");
+    if (f == NULL) return false;
+
+    bool ok = fwrite(data, sizeof(header) + (size_t) size, 1, f) == 1;
+    if (fclose(f) != 0) ok = false;
+    if (ok) ok = rename(tmp_file_path, file_path) == 0;
+    if (!ok) remove(tmp_file_path);
+
+    return ok;
+}
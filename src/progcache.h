@@ -0,0 +1,46 @@
+#ifndef PROGCACHE_H_
+#define PROGCACHE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <GL/glew.h>
+
+#include "./region.h"
+
+// Linked programs saved with glGetProgramBinary() and loaded back with
+// glProgramBinary(), which skips compiling and linking them altogether.
+// A binary only makes sense to the driver that produced it, so the key
+// mixes GL_VENDOR, GL_RENDERER and GL_VERSION into the hashes of the
+// sources, and a binary the driver rejects anyway is just a miss.
+//
+// Needs GL 4.1 or GL_ARB_get_program_binary and a driver with at least one
+// binary format, everything is a miss otherwise.
+
+#define PROGCACHE_DIR "./cache"
+#define PROGCACHE_MAGIC "KPRG"
+#define PROGCACHE_VERSION 1
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint64_t key;
+    uint32_t format;
+    uint32_t size;
+} Progcache_Header;
+
+bool progcache_supported(void);
+
+// Of the program linked from the expansions with these hashes, see
+// Glsl_Source
+uint64_t progcache_key(uint64_t vert_hash, uint64_t frag_hash);
+
+// Before glLinkProgram(), otherwise the driver may not keep the binary
+void progcache_hint(GLuint program);
+
+// Creates `program` from the binary. Returns false when there is no binary
+// for `key` or the driver did not take it.
+bool progcache_load(Region *region, const char *cache_dir, uint64_t key, GLuint *program);
+bool progcache_save(Region *region, const char *cache_dir, uint64_t key, GLuint program);
+
+#endif // PROGCACHE_H_
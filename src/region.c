@@ -3,9 +3,35 @@
 #include <string.h>
 #include "./region.h"
 
+Region region_with_capacity(size_t capacity)
+{
+    return (Region) {
+        .capacity = capacity,
+    };
+}
+
+void region_free(Region *region)
+{
+    free(region->memory);
+    region->memory = NULL;
+    region->size = 0;
+}
+
 void *region_malloc(Region *region, size_t size)
 {
-    if (region->size + size >= REGION_CAPACITY) {
+    if (region->memory == NULL) {
+        if (region->capacity == 0) {
+            region->capacity = REGION_CAPACITY;
+        }
+
+        region->memory = malloc(region->capacity);
+        if (region->memory == NULL) {
+            errno = ENOMEM;
+            return NULL;
+        }
+    }
+
+    if (region->size + size >= region->capacity) {
         errno = ENOMEM;
         return NULL;
     }
@@ -18,6 +44,9 @@ void *region_malloc(Region *region, size_t size)
 void *region_realloc(Region *region, void *old_memory, size_t old_size, size_t new_size)
 {
     void *new_memory = region_malloc(region, new_size);
+    if (new_memory == NULL) {
+        return NULL;
+    }
 
     if (old_size > new_size) {
         old_size = new_size;
@@ -41,11 +70,17 @@ char *region_cstr_from_sv(Region *region, String_View sv)
 }
 
 char *region_slurp_file(Region *region, const char *file_path)
+{
+    size_t size = 0;
+    return region_slurp_file_sized(region, file_path, &size);
+}
+
+char *region_slurp_file_sized(Region *region, const char *file_path, size_t *size_out)
 {
     FILE *f = NULL;
     char *buffer = NULL;
 
-    f = fopen(file_path, "r");
+    f = fopen(file_path, "rb");
     if (f == NULL) goto end;
     if (fseek(f, 0, SEEK_END) < 0) goto end;
 
@@ -61,6 +96,7 @@ char *region_slurp_file(Region *region, const char *file_path)
     if (ferror(f) < 0) goto end;
 
     buffer[size] = '\0';
+    *size_out = (size_t) size;
 
 end:
     if (f) fclose(f);
@@ -6,15 +6,22 @@
 
 #define REGION_CAPACITY (1 * 1000 * 1000)
 
+// A zero initialized Region is valid and lazily reserves REGION_CAPACITY
+// bytes on the first allocation. Regions that need a different size
+// (per-thread arenas, big meshes) are created with region_with_capacity().
 typedef struct {
+    size_t capacity;
     size_t size;
-    char memory[REGION_CAPACITY];
+    char *memory;
 } Region;
 
+Region region_with_capacity(size_t capacity);
+void region_free(Region *region);
 void *region_malloc(Region *region, size_t size);
 void *region_realloc(Region *region, void *old_memory, size_t old_size, size_t new_size);
 void region_clean(Region *region);
 char *region_cstr_from_sv(Region *region, String_View sv);
 char *region_slurp_file(Region *region, const char *file_path);
+char *region_slurp_file_sized(Region *region, const char *file_path, size_t *size);
 
 #endif // REGION_H_
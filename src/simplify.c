@@ -0,0 +1,449 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#include "./simplify.h"
+
+// Collapses between vertices with opposite normals cost as much as moving
+// the vertex this many edge lengths off the surface
+#define SIMPLIFY_NORMAL_WEIGHT 1.0f
+// A collapse is rejected when a triangle around the vertex turns more
+// than this, as the cosine of the angle
+#define SIMPLIFY_MIN_FLIP_COS 0.2f
+
+#define NO_VERTEX UINT32_MAX
+
+// Symmetric 4x4 matrix of the sum of squared distances to the planes,
+// weighted by the areas of their triangles
+typedef struct {
+    double a00, a01, a02, a11, a12, a22;
+    double b0, b1, b2;
+    double c;
+    double weight;
+} Quadric;
+
+static void quadric_add_plane(Quadric *q, const double n[V3_COMPS], double d, double w)
+{
+    q->a00 += w * n[X] * n[X];
+    q->a01 += w * n[X] * n[Y];
+    q->a02 += w * n[X] * n[Z];
+    q->a11 += w * n[Y] * n[Y];
+    q->a12 += w * n[Y] * n[Z];
+    q->a22 += w * n[Z] * n[Z];
+    q->b0 += w * n[X] * d;
+    q->b1 += w * n[Y] * d;
+    q->b2 += w * n[Z] * d;
+    q->c += w * d * d;
+    q->weight += w;
+}
+
+static void quadric_add(Quadric *q, const Quadric *other)
+{
+    q->a00 += other->a00;
+    q->a01 += other->a01;
+    q->a02 += other->a02;
+    q->a11 += other->a11;
+    q->a12 += other->a12;
+    q->a22 += other->a22;
+    q->b0 += other->b0;
+    q->b1 += other->b1;
+    q->b2 += other->b2;
+    q->c += other->c;
+    q->weight += other->weight;
+}
+
+static double quadric_eval(const Quadric *q, const float p[V3_COMPS])
+{
+    const double x = p[X], y = p[Y], z = p[Z];
+    const double e =
+        q->a00 * x * x + q->a11 * y * y + q->a22 * z * z +
+        2.0 * (q->a01 * x * y + q->a02 * x * z + q->a12 * y * z) +
+        2.0 * (q->b0 * x + q->b1 * y + q->b2 * z) +
+        q->c;
+    return e > 0.0 ? e : 0.0;
+}
+
+static void triangle_normal(const float *p0, const float *p1, const float *p2, double n[V3_COMPS])
+{
+    const double a[V3_COMPS] = {p1[X] - p0[X], p1[Y] - p0[Y], p1[Z] - p0[Z]};
+    const double b[V3_COMPS] = {p2[X] - p0[X], p2[Y] - p0[Y], p2[Z] - p0[Z]};
+    n[X] = a[Y] * b[Z] - a[Z] * b[Y];
+    n[Y] = a[Z] * b[X] - a[X] * b[Z];
+    n[Z] = a[X] * b[Y] - a[Y] * b[X];
+}
+
+typedef struct {
+    uint32_t from;
+    uint32_t to;
+    float cost;
+} Collapse;
+
+static int compare_collapses(const void *a, const void *b)
+{
+    const Collapse *ca = a;
+    const Collapse *cb = b;
+    if (ca->cost != cb->cost) return ca->cost < cb->cost ? -1 : 1;
+    return ca->from < cb->from ? -1 : ca->from > cb->from;
+}
+
+typedef struct {
+    const Mesh *mesh;
+    // Every vertex points to the first vertex with the same position
+    uint32_t *weld;
+    bool *locked;
+    // Indexed by the welded vertices
+    Quadric *quadrics;
+    // Triangles around the welded vertices, rebuilt every pass:
+    // [offsets[v], offsets[v + 1])
+    uint32_t *offsets;
+    uint32_t *adjacency;
+    bool *touched;
+    uint32_t *target;
+    Collapse *collapses;
+    uint32_t *indices;
+    size_t indices_count;
+} Simplifier;
+
+static void simplifier_free(Simplifier *s)
+{
+    free(s->weld);
+    free(s->locked);
+    free(s->quadrics);
+    free(s->offsets);
+    free(s->adjacency);
+    free(s->touched);
+    free(s->target);
+    free(s->collapses);
+}
+
+static uint32_t position_hash(const float p[V3_COMPS])
+{
+    uint32_t bits[V3_COMPS];
+    memcpy(bits, p, sizeof(bits));
+    uint64_t h = bits[X] * 0x9E3779B97F4A7C15ull;
+    h ^= bits[Y] * 0xC2B2AE3D27D4EB4Full;
+    h ^= bits[Z] * 0x165667B19E3779F9ull;
+    return (uint32_t) (h ^ (h >> 32));
+}
+
+static bool simplifier_weld(Simplifier *s)
+{
+    const Mesh *mesh = s->mesh;
+    size_t capacity = 1;
+    while (capacity < 2 * mesh->vertices_count) capacity *= 2;
+    uint32_t *table = malloc(capacity * sizeof(*table));
+    if (table == NULL) return false;
+    memset(table, 0xff, capacity * sizeof(*table));
+
+    for (size_t i = 0; i < mesh->vertices_count; ++i) {
+        const float *p = mesh->vertices[i].position;
+        size_t slot = position_hash(p) & (capacity - 1);
+        while (table[slot] != NO_VERTEX &&
+                memcmp(mesh->vertices[table[slot]].position, p, sizeof(mesh->vertices[i].position)) != 0) {
+            slot = (slot + 1) & (capacity - 1);
+        }
+        if (table[slot] == NO_VERTEX) {
+            table[slot] = (uint32_t) i;
+        } else {
+            // A seam, both sides stay
+            s->locked[i] = true;
+            s->locked[table[slot]] = true;
+        }
+        s->weld[i] = table[slot];
+    }
+
+    free(table);
+    return true;
+}
+
+// Edges of only one triangle are on the border, edges of more than two are
+// not manifold. Either way their vertices are locked. Counted by hashing
+// the edges between the welded vertices.
+static bool simplifier_lock_borders(Simplifier *s)
+{
+    const size_t edges = s->indices_count;
+    size_t capacity = 1;
+    while (capacity < 2 * edges) capacity *= 2;
+    uint64_t *keys = malloc(capacity * sizeof(*keys));
+    uint32_t *counts = calloc(capacity, sizeof(*counts));
+    if (keys == NULL || counts == NULL) {
+        free(keys);
+        free(counts);
+        return false;
+    }
+    memset(keys, 0xff, capacity * sizeof(*keys));
+
+    for (size_t i = 0; i < edges; ++i) {
+        const size_t first = i - i % TRI_VERTICES;
+        const uint32_t a = s->weld[s->indices[i]];
+        const uint32_t b = s->weld[s->indices[first + (i - first + 1) % TRI_VERTICES]];
+        const uint64_t key = a < b ? (uint64_t) a << 32 | b : (uint64_t) b << 32 | a;
+        size_t slot = (key * 0x9E3779B97F4A7C15ull >> 32) & (capacity - 1);
+        while (keys[slot] != UINT64_MAX && keys[slot] != key) slot = (slot + 1) & (capacity - 1);
+        keys[slot] = key;
+        counts[slot] += 1;
+    }
+
+    for (size_t slot = 0; slot < capacity; ++slot) {
+        if (keys[slot] == UINT64_MAX || counts[slot] == 2) continue;
+        const uint32_t a = (uint32_t) (keys[slot] >> 32);
+        const uint32_t b = (uint32_t) keys[slot];
+        s->locked[a] = true;
+        s->locked[b] = true;
+    }
+
+    free(keys);
+    free(counts);
+    return true;
+}
+
+// The welded vertex carries the lock of all of its copies
+static void simplifier_propagate_locks(Simplifier *s)
+{
+    const size_t n = s->mesh->vertices_count;
+    for (size_t i = 0; i < n; ++i) {
+        if (s->locked[i]) s->locked[s->weld[i]] = true;
+    }
+    for (size_t i = 0; i < n; ++i) {
+        if (s->locked[s->weld[i]]) s->locked[i] = true;
+    }
+}
+
+static void simplifier_build_adjacency(Simplifier *s)
+{
+    const size_t n = s->mesh->vertices_count;
+    memset(s->offsets, 0, (n + 1) * sizeof(*s->offsets));
+    for (size_t i = 0; i < s->indices_count; ++i) {
+        s->offsets[s->weld[s->indices[i]] + 1] += 1;
+    }
+    for (size_t v = 0; v < n; ++v) {
+        s->offsets[v + 1] += s->offsets[v];
+    }
+    // offsets[v] walks up to where the next vertex starts...
+    for (size_t i = 0; i < s->indices_count; ++i) {
+        const uint32_t v = s->weld[s->indices[i]];
+        s->adjacency[s->offsets[v]++] = (uint32_t) (i / TRI_VERTICES);
+    }
+    // ...so shifting them by one puts them back
+    for (size_t v = n; v > 0; --v) {
+        s->offsets[v] = s->offsets[v - 1];
+    }
+    s->offsets[0] = 0;
+}
+
+// Moving `from` onto `to` keeps every triangle around `from` facing the
+// same way
+static bool collapse_keeps_orientation(const Simplifier *s, uint32_t from, uint32_t to)
+{
+    const Mesh_Vertex *vertices = s->mesh->vertices;
+    const uint32_t wf = s->weld[from], wt = s->weld[to];
+    for (uint32_t a = s->offsets[wf]; a < s->offsets[wf + 1]; ++a) {
+        const uint32_t *tri = &s->indices[s->adjacency[a] * TRI_VERTICES];
+        const float *p[TRI_VERTICES];
+        const float *q[TRI_VERTICES];
+        bool removed = false;
+        for (size_t j = 0; j < TRI_VERTICES; ++j) {
+            p[j] = vertices[tri[j]].position;
+            q[j] = s->weld[tri[j]] == wf ? vertices[to].position : p[j];
+            removed = removed || s->weld[tri[j]] == wt;
+        }
+        // The triangles on the edge collapse into nothing
+        if (removed) continue;
+
+        double before[V3_COMPS], after[V3_COMPS];
+        triangle_normal(p[0], p[1], p[2], before);
+        triangle_normal(q[0], q[1], q[2], after);
+        const double dot = before[X] * after[X] + before[Y] * after[Y] + before[Z] * after[Z];
+        const double lengths = sqrt((before[X] * before[X] + before[Y] * before[Y] + before[Z] * before[Z]) *
+                                    (after[X] * after[X] + after[Y] * after[Y] + after[Z] * after[Z]));
+        if (dot <= SIMPLIFY_MIN_FLIP_COS * lengths) return false;
+    }
+    return true;
+}
+
+static float collapse_cost(const Simplifier *s, uint32_t from, uint32_t to)
+{
+    const Mesh_Vertex *vf = &s->mesh->vertices[from];
+    const Mesh_Vertex *vt = &s->mesh->vertices[to];
+    Quadric q = s->quadrics[s->weld[from]];
+    quadric_add(&q, &s->quadrics[s->weld[to]]);
+    const double distance = q.weight > 0.0 ? quadric_eval(&q, vt->position) / q.weight : 0.0;
+
+    float length = 0.0f, cos_normals = 0.0f;
+    for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+        const float d = vf->position[axis] - vt->position[axis];
+        length += d * d;
+        cos_normals += vf->normal[axis] * vt->normal[axis];
+    }
+    const float normal_cost = SIMPLIFY_NORMAL_WEIGHT * 0.5f * (1.0f - cos_normals) * length;
+    return (float) distance + normal_cost;
+}
+
+bool simplify_mesh(const Mesh *mesh, float ratio, Simplify_Lod *lod)
+{
+    memset(lod, 0, sizeof(*lod));
+    const size_t n = mesh->vertices_count;
+    const size_t target_indices = (size_t) ((float) (mesh->indices_count / TRI_VERTICES) * ratio) * TRI_VERTICES;
+
+    Simplifier s = {.mesh = mesh};
+    s.weld = malloc(n * sizeof(*s.weld) + 1);
+    s.locked = calloc(n + 1, sizeof(*s.locked));
+    s.quadrics = calloc(n + 1, sizeof(*s.quadrics));
+    s.offsets = malloc((n + 1) * sizeof(*s.offsets));
+    s.adjacency = malloc(mesh->indices_count * sizeof(*s.adjacency) + 1);
+    s.touched = calloc(n + 1, sizeof(*s.touched));
+    s.target = malloc(n * sizeof(*s.target) + 1);
+    s.collapses = malloc(mesh->indices_count * sizeof(*s.collapses) + 1);
+    s.indices = malloc(mesh->indices_count * sizeof(*s.indices) + 1);
+    if (s.weld == NULL || s.locked == NULL || s.quadrics == NULL || s.offsets == NULL ||
+            s.adjacency == NULL || s.touched == NULL || s.target == NULL ||
+            s.collapses == NULL || s.indices == NULL) {
+        free(s.indices);
+        simplifier_free(&s);
+        errno = ENOMEM;
+        return false;
+    }
+    memcpy(s.indices, mesh->indices, mesh->indices_count * sizeof(*s.indices));
+    s.indices_count = mesh->indices_count - mesh->indices_count % TRI_VERTICES;
+
+    if (!simplifier_weld(&s) || !simplifier_lock_borders(&s)) {
+        free(s.indices);
+        simplifier_free(&s);
+        errno = ENOMEM;
+        return false;
+    }
+    simplifier_propagate_locks(&s);
+
+    for (size_t t = 0; t < s.indices_count / TRI_VERTICES; ++t) {
+        const uint32_t *tri = &s.indices[t * TRI_VERTICES];
+        const float *p0 = mesh->vertices[tri[0]].position;
+        double normal[V3_COMPS];
+        triangle_normal(p0, mesh->vertices[tri[1]].position, mesh->vertices[tri[2]].position, normal);
+        const double length = sqrt(normal[X] * normal[X] + normal[Y] * normal[Y] + normal[Z] * normal[Z]);
+        if (length <= 0.0) continue;
+        for (size_t axis = 0; axis < V3_COMPS; ++axis) normal[axis] /= length;
+        const double d = -(normal[X] * p0[X] + normal[Y] * p0[Y] + normal[Z] * p0[Z]);
+        for (size_t j = 0; j < TRI_VERTICES; ++j) {
+            quadric_add_plane(&s.quadrics[s.weld[tri[j]]], normal, d, 0.5 * length);
+        }
+    }
+
+    float max_cost = 0.0f;
+    while (s.indices_count > target_indices) {
+        memset(s.touched, 0, (n + 1) * sizeof(*s.touched));
+        simplifier_build_adjacency(&s);
+
+        // Every edge of a manifold mesh is in two triangles, the one that
+        // goes from the smaller vertex does
+        size_t collapses_count = 0;
+        for (size_t i = 0; i < s.indices_count; ++i) {
+            const size_t first = i - i % TRI_VERTICES;
+            const uint32_t a = s.indices[i];
+            const uint32_t b = s.indices[first + (i - first + 1) % TRI_VERTICES];
+            if (s.weld[a] >= s.weld[b]) continue;
+            const float ab = s.locked[a] ? INFINITY : collapse_cost(&s, a, b);
+            const float ba = s.locked[b] ? INFINITY : collapse_cost(&s, b, a);
+            if (ab == INFINITY && ba == INFINITY) continue;
+            s.collapses[collapses_count++] = ab <= ba ?
+                (Collapse) {.from = a, .to = b, .cost = ab} :
+                (Collapse) {.from = b, .to = a, .cost = ba};
+        }
+        if (collapses_count == 0) break;
+        qsort(s.collapses, collapses_count, sizeof(*s.collapses), compare_collapses);
+
+        for (size_t v = 0; v < n; ++v) {
+            s.target[v] = (uint32_t) v;
+        }
+
+        // A collapse removes two triangles. The neighbourhood of every
+        // collapse is frozen until the next pass, so the orientation
+        // checks only ever see the triangles as they are.
+        const size_t wanted = (s.indices_count - target_indices) / TRI_VERTICES / 2 + 1;
+        size_t applied = 0;
+        for (size_t i = 0; i < collapses_count && applied < wanted; ++i) {
+            const Collapse c = s.collapses[i];
+            const uint32_t wf = s.weld[c.from], wt = s.weld[c.to];
+            if (s.touched[wf] || s.touched[wt]) continue;
+            if (!collapse_keeps_orientation(&s, c.from, c.to)) continue;
+
+            s.target[c.from] = c.to;
+            quadric_add(&s.quadrics[wt], &s.quadrics[wf]);
+            if (c.cost > max_cost) max_cost = c.cost;
+            for (uint32_t a = s.offsets[wf]; a < s.offsets[wf + 1]; ++a) {
+                const uint32_t *tri = &s.indices[s.adjacency[a] * TRI_VERTICES];
+                for (size_t j = 0; j < TRI_VERTICES; ++j) {
+                    s.touched[s.weld[tri[j]]] = true;
+                }
+            }
+            applied += 1;
+        }
+        if (applied == 0) break;
+
+        // Vertices that moved are not welded to anything, so `from` is the
+        // only one of its position
+        size_t kept = 0;
+        for (size_t i = 0; i < s.indices_count; i += TRI_VERTICES) {
+            uint32_t tri[TRI_VERTICES];
+            for (size_t j = 0; j < TRI_VERTICES; ++j) {
+                tri[j] = s.target[s.indices[i + j]];
+            }
+            if (s.weld[tri[0]] == s.weld[tri[1]] ||
+                    s.weld[tri[1]] == s.weld[tri[2]] ||
+                    s.weld[tri[2]] == s.weld[tri[0]]) {
+                continue;
+            }
+            memcpy(&s.indices[kept], tri, sizeof(tri));
+            kept += TRI_VERTICES;
+        }
+        s.indices_count = kept;
+    }
+
+    lod->indices = s.indices;
+    lod->indices_count = s.indices_count;
+    lod->error = sqrtf(max_cost);
+    simplifier_free(&s);
+    return true;
+}
+
+typedef struct {
+    const Mesh *meshes;
+    Simplify_Lod *lods;
+    bool failed;
+} Simplify_Job;
+
+static void simplify_task(void *arg, size_t index, size_t worker)
+{
+    (void) worker;
+    Simplify_Job *job = arg;
+    const size_t level = index % SIMPLIFY_LEVELS;
+    const float ratio = SIMPLIFY_FIRST_RATIO / (float) (1 << level);
+    if (!simplify_mesh(&job->meshes[index / SIMPLIFY_LEVELS], ratio, &job->lods[index])) {
+        job->failed = true;
+    }
+}
+
+bool simplify_lods(Pool *pool, const Mesh *meshes, size_t meshes_count, Simplify_Lod *lods)
+{
+    Simplify_Job job = {
+        .meshes = meshes,
+        .lods = lods,
+    };
+    const size_t count = meshes_count * SIMPLIFY_LEVELS;
+    pool_for(pool, count, simplify_task, &job);
+
+    if (job.failed) {
+        for (size_t i = 0; i < count; ++i) {
+            simplify_lod_free(&lods[i]);
+        }
+        errno = ENOMEM;
+        return false;
+    }
+    return true;
+}
+
+void simplify_lod_free(Simplify_Lod *lod)
+{
+    free(lod->indices);
+    memset(lod, 0, sizeof(*lod));
+}
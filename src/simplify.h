@@ -0,0 +1,45 @@
+#ifndef SIMPLIFY_H_
+#define SIMPLIFY_H_
+
+#include <stdbool.h>
+
+#include "./mesh.h"
+#include "./pool.h"
+
+// Edge collapse simplification driven by quadric error metrics. Every
+// collapse moves a vertex onto one of its neighbours, so the levels are
+// just index buffers over the vertices of the original mesh and a single
+// vertex buffer serves all of them.
+//
+// Vertices that share a position with other vertices are on a UV or a
+// normal seam and never move, neither do the ones on the borders of the
+// mesh, so the seams and the outline stay where they were. Collapses that
+// flip a triangle are rejected and the ones between vertices with
+// different normals cost more.
+
+// Levels of detail below the original, with 50%, 25% and 12.5% of the
+// triangles
+#define SIMPLIFY_LEVELS 3
+#define SIMPLIFY_FIRST_RATIO 0.5f
+
+typedef struct {
+    uint32_t *indices;
+    size_t indices_count;
+    // Largest deviation from the original surface in the units of the
+    // mesh, as the square root of the mean squared distance to the planes
+    // of the merged triangles
+    float error;
+} Simplify_Lod;
+
+// Simplifies down to `ratio` of the triangles or as close as the locked
+// vertices allow. Sets errno and returns false when out of memory.
+bool simplify_mesh(const Mesh *mesh, float ratio, Simplify_Lod *lod);
+
+// SIMPLIFY_LEVELS levels of every mesh, every level of every mesh being a
+// separate task of `pool` when it is not NULL. `lods` must hold
+// SIMPLIFY_LEVELS levels per mesh.
+bool simplify_lods(Pool *pool, const Mesh *meshes, size_t meshes_count, Simplify_Lod *lods);
+
+void simplify_lod_free(Simplify_Lod *lod);
+
+#endif // SIMPLIFY_H_
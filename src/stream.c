@@ -0,0 +1,111 @@
+#include <string.h>
+#include <errno.h>
+
+#define GLEW_STATIC
+#include "./stream.h"
+
+// Nanoseconds, a frame behind by a whole second is a lost cause anyway
+#define STREAM_FENCE_TIMEOUT 1000000000ull
+
+static size_t align_up(size_t x, size_t alignment)
+{
+    return (x + alignment - 1) / alignment * alignment;
+}
+
+bool stream_buffer_persistent_supported(void)
+{
+    return GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage;
+}
+
+bool stream_buffer_init(Stream_Buffer *stream, GLenum target, size_t capacity, bool persistent)
+{
+    memset(stream, 0, sizeof(*stream));
+    stream->target = target;
+    stream->capacity = align_up(capacity > 0 ? capacity : 1, STREAM_ALIGNMENT);
+
+    glGenBuffers(1, &stream->buffer);
+    glBindBuffer(target, stream->buffer);
+
+    if (persistent && stream_buffer_persistent_supported()) {
+        const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        const GLsizeiptr size = (GLsizeiptr) (STREAM_FRAMES * stream->capacity);
+        glBufferStorage(target, size, NULL, flags);
+        stream->data = glMapBufferRange(target, 0, size, flags);
+        if (stream->data != NULL) {
+            stream->persistent = true;
+            return true;
+        }
+
+        // The storage is immutable, the fallback needs a new buffer
+        glDeleteBuffers(1, &stream->buffer);
+        glGenBuffers(1, &stream->buffer);
+        glBindBuffer(target, stream->buffer);
+    }
+
+    stream->data = malloc(stream->capacity);
+    if (stream->data == NULL) {
+        glDeleteBuffers(1, &stream->buffer);
+        memset(stream, 0, sizeof(*stream));
+        errno = ENOMEM;
+        return false;
+    }
+    glBufferData(target, (GLsizeiptr) stream->capacity, NULL, GL_STREAM_DRAW);
+    return true;
+}
+
+void stream_buffer_free(Stream_Buffer *stream)
+{
+    for (size_t i = 0; i < STREAM_FRAMES; ++i) {
+        if (stream->fences[i] != NULL) glDeleteSync(stream->fences[i]);
+    }
+    if (stream->persistent) {
+        glBindBuffer(stream->target, stream->buffer);
+        glUnmapBuffer(stream->target);
+    } else {
+        free(stream->data);
+    }
+    if (stream->buffer != 0) glDeleteBuffers(1, &stream->buffer);
+    memset(stream, 0, sizeof(*stream));
+}
+
+void *stream_buffer_map(Stream_Buffer *stream)
+{
+    if (!stream->persistent) return stream->data;
+
+    GLsync fence = stream->fences[stream->region];
+    if (fence != NULL) {
+        // Polled first, so only the frames that actually stall are counted
+        if (glClientWaitSync(fence, 0, 0) == GL_TIMEOUT_EXPIRED) {
+            stream->fence_waits += 1;
+            glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, STREAM_FENCE_TIMEOUT);
+        }
+        glDeleteSync(fence);
+        stream->fences[stream->region] = NULL;
+    }
+    return stream->data + stream->region * stream->capacity;
+}
+
+size_t stream_buffer_unmap(Stream_Buffer *stream, size_t size)
+{
+    stream->bytes_streamed += size;
+    glBindBuffer(stream->target, stream->buffer);
+    if (!stream->persistent) {
+        if (size > 0) glBufferSubData(stream->target, 0, (GLsizeiptr) size, stream->data);
+        return 0;
+    }
+    // Coherent, so the writes are visible to the commands issued from now on
+    return stream->region * stream->capacity;
+}
+
+void stream_buffer_fence(Stream_Buffer *stream)
+{
+    if (!stream->persistent) return;
+    stream->fences[stream->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    stream->region = (stream->region + 1) % STREAM_FRAMES;
+}
+
+void stream_buffer_reset_stats(Stream_Buffer *stream)
+{
+    stream->fence_waits = 0;
+    stream->bytes_streamed = 0;
+}
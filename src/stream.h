@@ -0,0 +1,58 @@
+#ifndef STREAM_H_
+#define STREAM_H_
+
+#include <stdlib.h>
+#include <stdbool.h>
+
+#include <GL/glew.h>
+
+// Buffer for the data that changes every frame. Instead of glBufferData(),
+// which makes the driver orphan the buffer and copy the data, the buffer
+// is allocated once with glBufferStorage() in STREAM_FRAMES regions and
+// stays persistently mapped. Every frame writes into the next region
+// straight from the CPU and puts a fence after the draws that read it, so
+// a region is only waited for when the GPU is STREAM_FRAMES frames behind.
+//
+// Without GL 4.4 or GL_ARB_buffer_storage the data goes into a staging
+// buffer on the CPU and is uploaded with glBufferSubData().
+
+#define STREAM_FRAMES 3
+// Alignment of the regions, enough for any attribute or uniform block
+#define STREAM_ALIGNMENT 256
+
+typedef struct {
+    GLuint buffer;
+    GLenum target;
+    // Bytes of a single region
+    size_t capacity;
+    bool persistent;
+    // STREAM_FRAMES regions when persistent, the staging buffer otherwise
+    unsigned char *data;
+    GLsync fences[STREAM_FRAMES];
+    size_t region;
+
+    // Since the last stream_buffer_reset_stats()
+    size_t fence_waits;
+    size_t bytes_streamed;
+} Stream_Buffer;
+
+bool stream_buffer_persistent_supported(void);
+
+// Leaves `target` bound to the buffer. Falls back to glBufferSubData()
+// when `persistent` is not supported or the mapping fails. Sets errno and
+// returns false when out of memory.
+bool stream_buffer_init(Stream_Buffer *stream, GLenum target, size_t capacity, bool persistent);
+void stream_buffer_free(Stream_Buffer *stream);
+
+// Where to write up to `capacity` bytes of the frame, waits for the GPU to
+// be done with the region first
+void *stream_buffer_map(Stream_Buffer *stream);
+// The first `size` bytes were written. Leaves `target` bound to the buffer
+// and returns the offset of the data in it for the draws.
+size_t stream_buffer_unmap(Stream_Buffer *stream, size_t size);
+// After the draws that read the frame
+void stream_buffer_fence(Stream_Buffer *stream);
+
+void stream_buffer_reset_stats(Stream_Buffer *stream);
+
+#endif // STREAM_H_
@@ -165,6 +165,47 @@ uint64_t sv_to_u64(String_View sv)
     return result;
 }
 
+float sv_to_float(String_View sv)
+{
+    size_t i = 0;
+    double sign = 1.0;
+    if (i < sv.count && (sv.data[i] == '-' || sv.data[i] == '+')) {
+        if (sv.data[i] == '-') sign = -1.0;
+        i += 1;
+    }
+
+    double result = 0.0;
+    for (; i < sv.count && isdigit(sv.data[i]); ++i) {
+        result = result * 10.0 + (double) (sv.data[i] - '0');
+    }
+
+    if (i < sv.count && sv.data[i] == '.') {
+        double scale = 0.1;
+        for (i += 1; i < sv.count && isdigit(sv.data[i]); ++i) {
+            result += (double) (sv.data[i] - '0') * scale;
+            scale *= 0.1;
+        }
+    }
+
+    if (i + 1 < sv.count && (sv.data[i] == 'e' || sv.data[i] == 'E')) {
+        i += 1;
+        bool negative = false;
+        if (sv.data[i] == '-' || sv.data[i] == '+') {
+            negative = sv.data[i] == '-';
+            i += 1;
+        }
+        int exponent = 0;
+        for (; i < sv.count && isdigit(sv.data[i]) && exponent < 1000; ++i) {
+            exponent = exponent * 10 + (sv.data[i] - '0');
+        }
+        for (; exponent > 0; --exponent) {
+            result = negative ? result * 0.1 : result * 10.0;
+        }
+    }
+
+    return (float) (sign * result);
+}
+
 String_View sv_chop_left_while(String_View *sv, bool (*predicate)(char x))
 {
     size_t i = 0;
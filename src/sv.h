@@ -38,5 +38,8 @@ bool sv_eq(String_View a, String_View b);
 bool sv_starts_with(String_View sv, String_View prefix);
 bool sv_ends_with(String_View sv, String_View suffix);
 uint64_t sv_to_u64(String_View sv);
+// [-+]digits[.digits][(e|E)[-+]digits], stops at the first character that
+// does not fit like sv_to_u64()
+float sv_to_float(String_View sv);
 
 #endif  // SV_H_
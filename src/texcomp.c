@@ -0,0 +1,825 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define MKDIR(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define MKDIR(path) mkdir(path, 0755)
+#endif
+
+#include "./texcomp.h"
+
+#define RGBA_BYTES 4
+#define BLOCK_PIXELS (TEXCOMP_BLOCK_SIZE * TEXCOMP_BLOCK_SIZE)
+
+typedef uint8_t Block[BLOCK_PIXELS][RGBA_BYTES];
+
+static const char *const texture_format_names[COUNT_TEXTURE_FORMATS] = {
+    [TEXTURE_FORMAT_RGBA]     = "rgba",
+    [TEXTURE_FORMAT_BC1]      = "bc1",
+    [TEXTURE_FORMAT_BC3]      = "bc3",
+    [TEXTURE_FORMAT_ETC2]     = "etc2",
+    [TEXTURE_FORMAT_ETC2_EAC] = "etc2_eac",
+};
+
+const char *texture_format_name(Texture_Format format)
+{
+    assert(format < COUNT_TEXTURE_FORMATS);
+    return texture_format_names[format];
+}
+
+bool texture_format_by_name(String_View name, Texture_Format *format)
+{
+    for (Texture_Format i = 0; i < COUNT_TEXTURE_FORMATS; ++i) {
+        if (sv_eq(name, sv_from_cstr(texture_format_names[i]))) {
+            *format = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static size_t texture_format_block_bytes(Texture_Format format)
+{
+    switch (format) {
+    case TEXTURE_FORMAT_BC1:
+    case TEXTURE_FORMAT_ETC2:
+        return 8;
+    case TEXTURE_FORMAT_BC3:
+    case TEXTURE_FORMAT_ETC2_EAC:
+        return 16;
+    case TEXTURE_FORMAT_RGBA:
+    case COUNT_TEXTURE_FORMATS:
+    default:
+        assert(0 && "unreachable");
+        return 0;
+    }
+}
+
+size_t texcomp_level_size(Texture_Format format, uint32_t width, uint32_t height)
+{
+    if (format == TEXTURE_FORMAT_RGBA) {
+        return (size_t) width * height * RGBA_BYTES;
+    }
+
+    const size_t blocks_w = (width + TEXCOMP_BLOCK_SIZE - 1) / TEXCOMP_BLOCK_SIZE;
+    const size_t blocks_h = (height + TEXCOMP_BLOCK_SIZE - 1) / TEXCOMP_BLOCK_SIZE;
+    return blocks_w * blocks_h * texture_format_block_bytes(format);
+}
+
+uint32_t texcomp_level_width(const Compressed_Texture *texture, uint32_t level)
+{
+    const uint32_t width = texture->width >> level;
+    return width > 0 ? width : 1;
+}
+
+uint32_t texcomp_level_height(const Compressed_Texture *texture, uint32_t level)
+{
+    const uint32_t height = texture->height >> level;
+    return height > 0 ? height : 1;
+}
+
+size_t texcomp_total_size(const Compressed_Texture *texture)
+{
+    size_t result = 0;
+    for (uint32_t level = 0; level < texture->levels_count; ++level) {
+        result += texture->level_sizes[level];
+    }
+    return result;
+}
+
+static void fetch_block(const uint8_t *pixels, uint32_t width, uint32_t height,
+                        uint32_t bx, uint32_t by, Block block)
+{
+    for (uint32_t y = 0; y < TEXCOMP_BLOCK_SIZE; ++y) {
+        for (uint32_t x = 0; x < TEXCOMP_BLOCK_SIZE; ++x) {
+            // Blocks that hang over the edge of the image repeat the last
+            // row/column so they do not pull the endpoints towards garbage
+            uint32_t px = bx * TEXCOMP_BLOCK_SIZE + x;
+            uint32_t py = by * TEXCOMP_BLOCK_SIZE + y;
+            if (px >= width)  px = width - 1;
+            if (py >= height) py = height - 1;
+            memcpy(block[y * TEXCOMP_BLOCK_SIZE + x],
+                   &pixels[((size_t) py * width + px) * RGBA_BYTES],
+                   RGBA_BYTES);
+        }
+    }
+}
+
+static int clamp_byte(int x)
+{
+    if (x < 0) return 0;
+    if (x > 255) return 255;
+    return x;
+}
+
+static int color_distance(const uint8_t *a, const int *b)
+{
+    int result = 0;
+    for (size_t i = 0; i < 3; ++i) {
+        const int d = (int) a[i] - b[i];
+        result += d * d;
+    }
+    return result;
+}
+
+// BC1 begin
+
+static uint16_t pack_565(const float c[3])
+{
+    const int r = (clamp_byte((int) (c[0] + 0.5f)) * 31 + 127) / 255;
+    const int g = (clamp_byte((int) (c[1] + 0.5f)) * 63 + 127) / 255;
+    const int b = (clamp_byte((int) (c[2] + 0.5f)) * 31 + 127) / 255;
+    return (uint16_t) ((r << 11) | (g << 5) | b);
+}
+
+static void unpack_565(uint16_t c, int out[3])
+{
+    const int r = (c >> 11) & 31;
+    const int g = (c >> 5) & 63;
+    const int b = c & 31;
+    out[0] = (r << 3) | (r >> 2);
+    out[1] = (g << 2) | (g >> 4);
+    out[2] = (b << 3) | (b >> 2);
+}
+
+// Endpoints are the extremes of the block's colors projected onto the
+// principal axis of their distribution.
+static void encode_bc1_color(const Block block, uint8_t output[8])
+{
+    float mean[3] = {0};
+    for (size_t i = 0; i < BLOCK_PIXELS; ++i) {
+        for (size_t c = 0; c < 3; ++c) {
+            mean[c] += block[i][c];
+        }
+    }
+    for (size_t c = 0; c < 3; ++c) {
+        mean[c] /= BLOCK_PIXELS;
+    }
+
+    float cov[3][3] = {0};
+    for (size_t i = 0; i < BLOCK_PIXELS; ++i) {
+        const float d[3] = {
+            block[i][0] - mean[0],
+            block[i][1] - mean[1],
+            block[i][2] - mean[2],
+        };
+        for (size_t a = 0; a < 3; ++a) {
+            for (size_t b = 0; b < 3; ++b) {
+                cov[a][b] += d[a] * d[b];
+            }
+        }
+    }
+
+    float axis[3] = {1.0f, 1.0f, 1.0f};
+    for (size_t iteration = 0; iteration < 8; ++iteration) {
+        float next[3] = {0};
+        for (size_t a = 0; a < 3; ++a) {
+            for (size_t b = 0; b < 3; ++b) {
+                next[a] += cov[a][b] * axis[b];
+            }
+        }
+
+        const float len = sqrtf(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (len < 1e-6f) break;
+        for (size_t a = 0; a < 3; ++a) {
+            axis[a] = next[a] / len;
+        }
+    }
+
+    float t_min = 0.0f;
+    float t_max = 0.0f;
+    for (size_t i = 0; i < BLOCK_PIXELS; ++i) {
+        float t = 0.0f;
+        for (size_t c = 0; c < 3; ++c) {
+            t += (block[i][c] - mean[c]) * axis[c];
+        }
+        if (t < t_min) t_min = t;
+        if (t > t_max) t_max = t;
+    }
+
+    float e0[3], e1[3];
+    for (size_t c = 0; c < 3; ++c) {
+        e0[c] = mean[c] + axis[c] * t_max;
+        e1[c] = mean[c] + axis[c] * t_min;
+    }
+
+    uint16_t c0 = pack_565(e0);
+    uint16_t c1 = pack_565(e1);
+    if (c0 < c1) {
+        const uint16_t t = c0;
+        c0 = c1;
+        c1 = t;
+    }
+
+    uint32_t indices = 0;
+    if (c0 != c1) {
+        int palette[4][3];
+        unpack_565(c0, palette[0]);
+        unpack_565(c1, palette[1]);
+        for (size_t c = 0; c < 3; ++c) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (size_t i = 0; i < BLOCK_PIXELS; ++i) {
+            uint32_t best = 0;
+            int best_distance = color_distance(block[i], palette[0]);
+            for (uint32_t j = 1; j < 4; ++j) {
+                const int distance = color_distance(block[i], palette[j]);
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best = j;
+                }
+            }
+            indices |= best << (2 * i);
+        }
+    }
+
+    output[0] = c0 & 0xFF;
+    output[1] = c0 >> 8;
+    output[2] = c1 & 0xFF;
+    output[3] = c1 >> 8;
+    for (size_t i = 0; i < 4; ++i) {
+        output[4 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+}
+
+// BC1 end
+
+// BC3 begin
+
+static void encode_bc3_alpha(const Block block, uint8_t output[8])
+{
+    int a0 = 0;
+    int a1 = 255;
+    for (size_t i = 0; i < BLOCK_PIXELS; ++i) {
+        if (block[i][3] > a0) a0 = block[i][3];
+        if (block[i][3] < a1) a1 = block[i][3];
+    }
+
+    uint64_t indices = 0;
+    if (a0 != a1) {
+        int palette[8];
+        palette[0] = a0;
+        palette[1] = a1;
+        for (int k = 1; k <= 6; ++k) {
+            palette[k + 1] = ((7 - k) * a0 + k * a1) / 7;
+        }
+
+        for (size_t i = 0; i < BLOCK_PIXELS; ++i) {
+            uint64_t best = 0;
+            int best_distance = abs(block[i][3] - palette[0]);
+            for (uint64_t j = 1; j < 8; ++j) {
+                const int distance = abs(block[i][3] - palette[j]);
+                if (distance < best_distance) {
+                    best_distance = distance;
+                    best = j;
+                }
+            }
+            indices |= best << (3 * i);
+        }
+    }
+
+    output[0] = (uint8_t) a0;
+    output[1] = (uint8_t) a1;
+    for (size_t i = 0; i < 6; ++i) {
+        output[2 + i] = (indices >> (8 * i)) & 0xFF;
+    }
+}
+
+// BC3 end
+
+// ETC2 begin
+
+// ETC1 blocks are valid ETC2 RGB8 blocks, so the color part only ever
+// emits the individual and differential modes.
+
+static const int etc1_modifiers[8][2] = {
+    {2, 8}, {5, 17}, {9, 29}, {13, 42},
+    {18, 60}, {24, 80}, {33, 106}, {47, 183},
+};
+
+#define ETC1_SUBBLOCK_PIXELS 8
+
+typedef struct {
+    int table;
+    int error;
+    uint8_t indices[ETC1_SUBBLOCK_PIXELS];
+} Etc1_Subblock_Fit;
+
+static int etc1_modifier(int table, int index)
+{
+    // index: 0 => +small, 1 => +large, 2 => -small, 3 => -large
+    const int value = etc1_modifiers[table][index & 1];
+    return (index & 2) ? -value : value;
+}
+
+static Etc1_Subblock_Fit etc1_fit_subblock(const Block block, const size_t pixels[ETC1_SUBBLOCK_PIXELS],
+                                           const int base[3])
+{
+    Etc1_Subblock_Fit best = {.error = -1};
+
+    for (int table = 0; table < 8; ++table) {
+        Etc1_Subblock_Fit fit = {.table = table};
+        for (size_t i = 0; i < ETC1_SUBBLOCK_PIXELS; ++i) {
+            int best_distance = -1;
+            for (int index = 0; index < 4; ++index) {
+                const int m = etc1_modifier(table, index);
+                const int color[3] = {
+                    clamp_byte(base[0] + m),
+                    clamp_byte(base[1] + m),
+                    clamp_byte(base[2] + m),
+                };
+                const int distance = color_distance(block[pixels[i]], color);
+                if (best_distance < 0 || distance < best_distance) {
+                    best_distance = distance;
+                    fit.indices[i] = (uint8_t) index;
+                }
+            }
+            fit.error += best_distance;
+        }
+
+        if (best.error < 0 || fit.error < best.error) {
+            best = fit;
+        }
+    }
+
+    return best;
+}
+
+static int quantize_bits(float x, int bits)
+{
+    const int max = (1 << bits) - 1;
+    return (clamp_byte((int) (x + 0.5f)) * max + 127) / 255;
+}
+
+static int expand_bits(int x, int bits)
+{
+    return (x << (8 - bits)) | (x >> (2 * bits - 8));
+}
+
+static void etc1_subblock_pixels(int flip, int subblock, size_t pixels[ETC1_SUBBLOCK_PIXELS])
+{
+    size_t count = 0;
+    for (int y = 0; y < TEXCOMP_BLOCK_SIZE; ++y) {
+        for (int x = 0; x < TEXCOMP_BLOCK_SIZE; ++x) {
+            const int s = flip ? (y >= 2) : (x >= 2);
+            if (s == subblock) {
+                pixels[count++] = (size_t) (y * TEXCOMP_BLOCK_SIZE + x);
+            }
+        }
+    }
+    assert(count == ETC1_SUBBLOCK_PIXELS);
+}
+
+static void write_u64_be(uint64_t x, uint8_t output[8])
+{
+    for (size_t i = 0; i < 8; ++i) {
+        output[i] = (x >> (56 - 8 * i)) & 0xFF;
+    }
+}
+
+static void encode_etc1_color(const Block block, uint8_t output[8])
+{
+    uint64_t best_bits = 0;
+    int best_error = -1;
+
+    for (int flip = 0; flip < 2; ++flip) {
+        size_t pixels[2][ETC1_SUBBLOCK_PIXELS];
+        float avg[2][3] = {0};
+        for (int s = 0; s < 2; ++s) {
+            etc1_subblock_pixels(flip, s, pixels[s]);
+            for (size_t i = 0; i < ETC1_SUBBLOCK_PIXELS; ++i) {
+                for (size_t c = 0; c < 3; ++c) {
+                    avg[s][c] += block[pixels[s][i]][c];
+                }
+            }
+            for (size_t c = 0; c < 3; ++c) {
+                avg[s][c] /= ETC1_SUBBLOCK_PIXELS;
+            }
+        }
+
+        for (int diff = 0; diff < 2; ++diff) {
+            const int bits = diff ? 5 : 4;
+            int q[2][3];
+            int base[2][3];
+            for (int s = 0; s < 2; ++s) {
+                for (size_t c = 0; c < 3; ++c) {
+                    q[s][c] = quantize_bits(avg[s][c], bits);
+                    base[s][c] = expand_bits(q[s][c], bits);
+                }
+            }
+
+            if (diff) {
+                bool representable = true;
+                for (size_t c = 0; c < 3; ++c) {
+                    const int d = q[1][c] - q[0][c];
+                    if (d < -4 || d > 3) representable = false;
+                }
+                if (!representable) continue;
+            }
+
+            const Etc1_Subblock_Fit fits[2] = {
+                etc1_fit_subblock(block, pixels[0], base[0]),
+                etc1_fit_subblock(block, pixels[1], base[1]),
+            };
+            const int error = fits[0].error + fits[1].error;
+            if (best_error >= 0 && error >= best_error) continue;
+
+            uint64_t b = 0;
+            if (diff) {
+                b |= (uint64_t) q[0][0] << 59 | (uint64_t) ((q[1][0] - q[0][0]) & 7) << 56;
+                b |= (uint64_t) q[0][1] << 51 | (uint64_t) ((q[1][1] - q[0][1]) & 7) << 48;
+                b |= (uint64_t) q[0][2] << 43 | (uint64_t) ((q[1][2] - q[0][2]) & 7) << 40;
+            } else {
+                b |= (uint64_t) q[0][0] << 60 | (uint64_t) q[1][0] << 56;
+                b |= (uint64_t) q[0][1] << 52 | (uint64_t) q[1][1] << 48;
+                b |= (uint64_t) q[0][2] << 44 | (uint64_t) q[1][2] << 40;
+            }
+            b |= (uint64_t) fits[0].table << 37;
+            b |= (uint64_t) fits[1].table << 34;
+            b |= (uint64_t) diff << 33;
+            b |= (uint64_t) flip << 32;
+
+            for (int s = 0; s < 2; ++s) {
+                for (size_t i = 0; i < ETC1_SUBBLOCK_PIXELS; ++i) {
+                    // Pixel indices are stored in column-major order
+                    const size_t x = pixels[s][i] % TEXCOMP_BLOCK_SIZE;
+                    const size_t y = pixels[s][i] / TEXCOMP_BLOCK_SIZE;
+                    const size_t j = x * TEXCOMP_BLOCK_SIZE + y;
+                    const uint64_t index = fits[s].indices[i];
+                    b |= ((index >> 1) & 1) << (j + 16);
+                    b |= (index & 1) << j;
+                }
+            }
+
+            best_error = error;
+            best_bits = b;
+        }
+    }
+
+    write_u64_be(best_bits, output);
+}
+
+static const int eac_modifiers[16][8] = {
+    {-3, -6,  -9, -15, 2, 5, 8, 14},
+    {-3, -7, -10, -13, 2, 6, 9, 12},
+    {-2, -5,  -8, -13, 1, 4, 7, 12},
+    {-2, -4,  -6, -13, 1, 3, 5, 12},
+    {-3, -6,  -8, -12, 2, 5, 7, 11},
+    {-3, -7,  -9, -11, 2, 6, 8, 10},
+    {-4, -7,  -8, -11, 3, 6, 7, 10},
+    {-3, -5,  -8, -11, 2, 4, 7, 10},
+    {-2, -6,  -8, -10, 1, 5, 7,  9},
+    {-2, -5,  -8, -10, 1, 4, 7,  9},
+    {-2, -4,  -8, -10, 1, 3, 7,  9},
+    {-2, -5,  -7, -10, 1, 4, 6,  9},
+    {-3, -4,  -7, -10, 2, 3, 6,  9},
+    {-1, -2,  -3, -10, 0, 1, 2,  9},
+    {-4, -6,  -8,  -9, 3, 5, 7,  8},
+    {-3, -5,  -7,  -9, 2, 4, 6,  8},
+};
+
+#define EAC_ZERO_TABLE 13
+#define EAC_ZERO_INDEX 4
+
+static int eac_fit(const Block block, int base, int multiplier, int table, uint64_t *indices)
+{
+    int error = 0;
+    uint64_t result = 0;
+    for (size_t i = 0; i < BLOCK_PIXELS; ++i) {
+        const size_t x = i % TEXCOMP_BLOCK_SIZE;
+        const size_t y = i / TEXCOMP_BLOCK_SIZE;
+        const size_t j = x * TEXCOMP_BLOCK_SIZE + y;
+
+        int best_distance = -1;
+        uint64_t best = 0;
+        for (int index = 0; index < 8; ++index) {
+            const int a = clamp_byte(base + eac_modifiers[table][index] * multiplier);
+            const int d = a - block[i][3];
+            if (best_distance < 0 || d * d < best_distance) {
+                best_distance = d * d;
+                best = (uint64_t) index;
+            }
+        }
+
+        error += best_distance;
+        result |= best << (45 - 3 * j);
+    }
+
+    *indices = result;
+    return error;
+}
+
+static void encode_eac_alpha(const Block block, uint8_t output[8])
+{
+    int a_min = 255;
+    int a_max = 0;
+    for (size_t i = 0; i < BLOCK_PIXELS; ++i) {
+        if (block[i][3] < a_min) a_min = block[i][3];
+        if (block[i][3] > a_max) a_max = block[i][3];
+    }
+
+    int best_base = a_min;
+    int best_multiplier = 1;
+    int best_table = EAC_ZERO_TABLE;
+    uint64_t best_indices = 0;
+    for (size_t j = 0; j < BLOCK_PIXELS; ++j) {
+        best_indices |= (uint64_t) EAC_ZERO_INDEX << (45 - 3 * j);
+    }
+
+    if (a_min != a_max) {
+        int best_error = -1;
+        for (int table = 0; table < 16; ++table) {
+            const int lo = eac_modifiers[table][3];
+            const int hi = eac_modifiers[table][7];
+            const int guess = (int) ((float) (a_max - a_min) / (hi - lo) + 0.5f);
+
+            for (int multiplier = guess - 1; multiplier <= guess + 1; ++multiplier) {
+                if (multiplier < 1 || multiplier > 15) continue;
+
+                const int center = (a_min - lo * multiplier + a_max - hi * multiplier) / 2;
+                for (int base = center - 1; base <= center + 1; ++base) {
+                    if (base < 0 || base > 255) continue;
+
+                    uint64_t indices = 0;
+                    const int error = eac_fit(block, base, multiplier, table, &indices);
+                    if (best_error < 0 || error < best_error) {
+                        best_error = error;
+                        best_base = base;
+                        best_multiplier = multiplier;
+                        best_table = table;
+                        best_indices = indices;
+                    }
+                }
+            }
+        }
+    }
+
+    const uint64_t b =
+        (uint64_t) best_base << 56 |
+        (uint64_t) best_multiplier << 52 |
+        (uint64_t) best_table << 48 |
+        best_indices;
+    write_u64_be(b, output);
+}
+
+// ETC2 end
+
+void texcomp_encode(Texture_Format format,
+                    const uint8_t *pixels, uint32_t width, uint32_t height,
+                    uint8_t *output)
+{
+    if (format == TEXTURE_FORMAT_RGBA) {
+        memcpy(output, pixels, texcomp_level_size(format, width, height));
+        return;
+    }
+
+    const uint32_t blocks_w = (width + TEXCOMP_BLOCK_SIZE - 1) / TEXCOMP_BLOCK_SIZE;
+    const uint32_t blocks_h = (height + TEXCOMP_BLOCK_SIZE - 1) / TEXCOMP_BLOCK_SIZE;
+    const size_t block_bytes = texture_format_block_bytes(format);
+
+    for (uint32_t by = 0; by < blocks_h; ++by) {
+        for (uint32_t bx = 0; bx < blocks_w; ++bx) {
+            Block block;
+            fetch_block(pixels, width, height, bx, by, block);
+
+            uint8_t *out = output + ((size_t) by * blocks_w + bx) * block_bytes;
+            switch (format) {
+            case TEXTURE_FORMAT_BC1:
+                encode_bc1_color(block, out);
+                break;
+            case TEXTURE_FORMAT_BC3:
+                encode_bc3_alpha(block, out);
+                encode_bc1_color(block, out + 8);
+                break;
+            case TEXTURE_FORMAT_ETC2:
+                encode_etc1_color(block, out);
+                break;
+            case TEXTURE_FORMAT_ETC2_EAC:
+                encode_eac_alpha(block, out);
+                encode_etc1_color(block, out + 8);
+                break;
+            case TEXTURE_FORMAT_RGBA:
+            case COUNT_TEXTURE_FORMATS:
+            default:
+                assert(0 && "unreachable");
+            }
+        }
+    }
+}
+
+static void downsample(const uint8_t *src, uint32_t src_w, uint32_t src_h,
+                       uint8_t *dst, uint32_t dst_w, uint32_t dst_h)
+{
+    for (uint32_t y = 0; y < dst_h; ++y) {
+        for (uint32_t x = 0; x < dst_w; ++x) {
+            const uint32_t x0 = 2 * x < src_w ? 2 * x : src_w - 1;
+            const uint32_t y0 = 2 * y < src_h ? 2 * y : src_h - 1;
+            const uint32_t x1 = x0 + 1 < src_w ? x0 + 1 : x0;
+            const uint32_t y1 = y0 + 1 < src_h ? y0 + 1 : y0;
+
+            for (size_t c = 0; c < RGBA_BYTES; ++c) {
+                const unsigned sum =
+                    src[((size_t) y0 * src_w + x0) * RGBA_BYTES + c] +
+                    src[((size_t) y0 * src_w + x1) * RGBA_BYTES + c] +
+                    src[((size_t) y1 * src_w + x0) * RGBA_BYTES + c] +
+                    src[((size_t) y1 * src_w + x1) * RGBA_BYTES + c];
+                dst[((size_t) y * dst_w + x) * RGBA_BYTES + c] = (uint8_t) ((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+bool texcomp_build(Region *region, Texture_Format format, uint64_t source_hash,
+                   const uint8_t *pixels, uint32_t width, uint32_t height,
+                   Compressed_Texture *texture)
+{
+    memset(texture, 0, sizeof(*texture));
+    texture->format = format;
+    texture->source_hash = source_hash;
+    texture->width = width;
+    texture->height = height;
+
+    const uint8_t *level_pixels = pixels;
+    for (uint32_t level = 0; level < TEXCOMP_MAX_LEVELS; ++level) {
+        const uint32_t w = texcomp_level_width(texture, level);
+        const uint32_t h = texcomp_level_height(texture, level);
+
+        const size_t size = texcomp_level_size(format, w, h);
+        uint8_t *data = region_malloc(region, size);
+        if (data == NULL) return false;
+        texcomp_encode(format, level_pixels, w, h, data);
+
+        texture->level_sizes[level] = (uint32_t) size;
+        texture->level_data[level] = data;
+        texture->levels_count = level + 1;
+
+        if (w == 1 && h == 1) break;
+
+        const uint32_t next_w = texcomp_level_width(texture, level + 1);
+        const uint32_t next_h = texcomp_level_height(texture, level + 1);
+        uint8_t *next_pixels = region_malloc(region, (size_t) next_w * next_h * RGBA_BYTES);
+        if (next_pixels == NULL) return false;
+        downsample(level_pixels, w, h, next_pixels, next_w, next_h);
+        level_pixels = next_pixels;
+    }
+
+    return true;
+}
+
+// Cache begin
+
+#define TEXCOMP_CACHE_MAGIC "KTXC"
+#define TEXCOMP_CACHE_VERSION 1
+
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t format;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels_count;
+    uint64_t source_hash;
+    uint32_t level_sizes[TEXCOMP_MAX_LEVELS];
+} Texcomp_Cache_Header;
+
+char *texcomp_cache_file_path(Region *region, const char *cache_dir,
+                              uint64_t source_hash, Texture_Format format)
+{
+    const char *const fmt = "%s/%016llx-%s.ktc";
+    const char *const format_name = texture_format_name(format);
+    const int n = snprintf(NULL, 0, fmt, cache_dir, (unsigned long long) source_hash, format_name);
+    char *result = region_malloc(region, (size_t) n + 1);
+    if (result == NULL) return NULL;
+    snprintf(result, (size_t) n + 1, fmt, cache_dir, (unsigned long long) source_hash, format_name);
+    return result;
+}
+
+bool texcomp_cache_parse(const void *data, size_t size,
+                         uint64_t source_hash, Texture_Format format,
+                         Compressed_Texture *texture)
+{
+    const uint8_t *content = data;
+
+    Texcomp_Cache_Header header;
+    if (size < sizeof(header)) return false;
+    memcpy(&header, content, sizeof(header));
+
+    if (memcmp(header.magic, TEXCOMP_CACHE_MAGIC, sizeof(header.magic)) != 0 ||
+            header.version != TEXCOMP_CACHE_VERSION ||
+            header.format != (uint32_t) format ||
+            header.source_hash != source_hash ||
+            header.width == 0 || header.height == 0 ||
+            header.levels_count == 0 ||
+            header.levels_count > TEXCOMP_MAX_LEVELS) {
+        return false;
+    }
+
+    memset(texture, 0, sizeof(*texture));
+    texture->format = format;
+    texture->source_hash = source_hash;
+    texture->width = header.width;
+    texture->height = header.height;
+    texture->levels_count = header.levels_count;
+
+    size_t offset = sizeof(header);
+    for (uint32_t level = 0; level < header.levels_count; ++level) {
+        const size_t expected = texcomp_level_size(
+            format,
+            texcomp_level_width(texture, level),
+            texcomp_level_height(texture, level));
+        if (header.level_sizes[level] != expected || offset + expected > size) {
+            return false;
+        }
+
+        texture->level_sizes[level] = (uint32_t) expected;
+        texture->level_data[level] = (uint8_t*) content + offset;
+        offset += expected;
+    }
+
+    return offset == size;
+}
+
+bool texcomp_cache_load(Region *region, const char *cache_dir,
+                        uint64_t source_hash, Texture_Format format,
+                        Compressed_Texture *texture)
+{
+    const char *file_path = texcomp_cache_file_path(region, cache_dir, source_hash, format);
+    if (file_path == NULL) return false;
+
+    size_t size = 0;
+    const char *content = region_slurp_file_sized(region, file_path, &size);
+    if (content == NULL) return false;
+
+    return texcomp_cache_parse(content, size, source_hash, format, texture);
+}
+
+bool texcomp_cache_serialize(Region *region, const Compressed_Texture *texture,
+                             uint8_t **data, size_t *size)
+{
+    Texcomp_Cache_Header header = {0};
+    memcpy(header.magic, TEXCOMP_CACHE_MAGIC, sizeof(header.magic));
+    header.version = TEXCOMP_CACHE_VERSION;
+    header.format = texture->format;
+    header.width = texture->width;
+    header.height = texture->height;
+    header.levels_count = texture->levels_count;
+    header.source_hash = texture->source_hash;
+    memcpy(header.level_sizes, texture->level_sizes, sizeof(header.level_sizes));
+
+    const size_t total = sizeof(header) + texcomp_total_size(texture);
+    uint8_t *bytes = region_malloc(region, total);
+    if (bytes == NULL) return false;
+
+    memcpy(bytes, &header, sizeof(header));
+    size_t offset = sizeof(header);
+    for (uint32_t level = 0; level < texture->levels_count; ++level) {
+        memcpy(bytes + offset, texture->level_data[level], texture->level_sizes[level]);
+        offset += texture->level_sizes[level];
+    }
+
+    *data = bytes;
+    *size = total;
+    return true;
+}
+
+bool texcomp_cache_save(Region *region, const char *cache_dir,
+                        const Compressed_Texture *texture)
+{
+    if (MKDIR(cache_dir) < 0 && errno != EEXIST) {
+        return false;
+    }
+
+    const char *file_path = texcomp_cache_file_path(region, cache_dir, texture->source_hash, texture->format);
+    if (file_path == NULL) return false;
+
+    // Write into a temporary file first so a concurrent reader never
+    // observes a half written cache entry
+    const size_t n = strlen(file_path) + sizeof(".tmp");
+    char *tmp_file_path = region_malloc(region, n);
+    if (tmp_file_path == NULL) return false;
+    snprintf(tmp_file_path, n, "%s.tmp", file_path);
+
+    uint8_t *data = NULL;
+    size_t size = 0;
+    if (!texcomp_cache_serialize(region, texture, &data, &size)) return false;
+
+    FILE *f = fopen(tmp_file_path, "wb");
+    if (f == NULL) return false;
+
+    bool ok = fwrite(data, size, 1, f) == 1;
+    if (fclose(f) != 0) ok = false;
+    if (ok) ok = rename(tmp_file_path, file_path) == 0;
+    if (!ok) remove(tmp_file_path);
+
+    return ok;
+}
+
+// Cache end
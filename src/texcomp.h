@@ -0,0 +1,70 @@
+#ifndef TEXCOMP_H_
+#define TEXCOMP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "./sv.h"
+#include "./region.h"
+
+// CPU encoders for GPU block compressed texture formats and an on-disk
+// cache of their results keyed by the content hash of the source image.
+
+typedef enum {
+    TEXTURE_FORMAT_RGBA = 0,
+    TEXTURE_FORMAT_BC1,
+    TEXTURE_FORMAT_BC3,
+    TEXTURE_FORMAT_ETC2,
+    TEXTURE_FORMAT_ETC2_EAC,
+    COUNT_TEXTURE_FORMATS,
+} Texture_Format;
+
+#define TEXCOMP_BLOCK_SIZE 4
+#define TEXCOMP_MAX_LEVELS 16
+#define TEXCOMP_CACHE_DIR "./cache"
+
+typedef struct {
+    Texture_Format format;
+    uint64_t source_hash;
+    uint32_t width;
+    uint32_t height;
+    uint32_t levels_count;
+    uint32_t level_sizes[TEXCOMP_MAX_LEVELS];
+    uint8_t *level_data[TEXCOMP_MAX_LEVELS];
+} Compressed_Texture;
+
+const char *texture_format_name(Texture_Format format);
+bool texture_format_by_name(String_View name, Texture_Format *format);
+
+// Size in bytes of a single mip level of the given dimensions
+size_t texcomp_level_size(Texture_Format format, uint32_t width, uint32_t height);
+uint32_t texcomp_level_width(const Compressed_Texture *texture, uint32_t level);
+uint32_t texcomp_level_height(const Compressed_Texture *texture, uint32_t level);
+size_t texcomp_total_size(const Compressed_Texture *texture);
+
+// `pixels` are tightly packed RGBA8, `output` must hold
+// texcomp_level_size(format, width, height) bytes
+void texcomp_encode(Texture_Format format,
+                    const uint8_t *pixels, uint32_t width, uint32_t height,
+                    uint8_t *output);
+
+// Generates the full mip chain of `pixels` and encodes every level
+bool texcomp_build(Region *region, Texture_Format format, uint64_t source_hash,
+                   const uint8_t *pixels, uint32_t width, uint32_t height,
+                   Compressed_Texture *texture);
+
+char *texcomp_cache_file_path(Region *region, const char *cache_dir,
+                              uint64_t source_hash, Texture_Format format);
+// Parses the content of a cache file. `texture` points into `data`.
+bool texcomp_cache_parse(const void *data, size_t size,
+                         uint64_t source_hash, Texture_Format format,
+                         Compressed_Texture *texture);
+bool texcomp_cache_serialize(Region *region, const Compressed_Texture *texture,
+                             uint8_t **data, size_t *size);
+bool texcomp_cache_load(Region *region, const char *cache_dir,
+                        uint64_t source_hash, Texture_Format format,
+                        Compressed_Texture *texture);
+bool texcomp_cache_save(Region *region, const char *cache_dir,
+                        const Compressed_Texture *texture);
+
+#endif // TEXCOMP_H_
@@ -0,0 +1,103 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "./hash.h"
+#include "./texcomp.h"
+#include "./image.h"
+#include "./timer.h"
+
+// Offline counterpart of the load-time encoder in reload_scene(): fills
+// the texture cache ahead of time so the first launch does not pay for
+// the encoding.
+
+Region region;
+
+void usage(FILE *stream, const char *program)
+{
+    fprintf(stream, "Usage: %s <format> <image...>\n", program);
+    fprintf(stream, "Formats:");
+    for (Texture_Format format = TEXTURE_FORMAT_BC1; format < COUNT_TEXTURE_FORMATS; ++format) {
+        fprintf(stream, " %s", texture_format_name(format));
+    }
+    fprintf(stream, "\n");
+}
+
+int main(int argc, char **argv)
+{
+    const char *const program = argv[0];
+
+    if (argc < 3) {
+        usage(stderr, program);
+        fprintf(stderr, "ERROR: not enough arguments\n");
+        exit(1);
+    }
+
+    Texture_Format format = TEXTURE_FORMAT_RGBA;
+    if (!texture_format_by_name(sv_from_cstr(argv[1]), &format) ||
+            format == TEXTURE_FORMAT_RGBA) {
+        usage(stderr, program);
+        fprintf(stderr, "ERROR: unknown format `%s`\n", argv[1]);
+        exit(1);
+    }
+
+    int result = 0;
+    for (int i = 2; i < argc; ++i) {
+        const char *const file_path = argv[i];
+        region_clean(&region);
+
+        size_t size = 0;
+        const char *data = region_slurp_file_sized(&region, file_path, &size);
+        if (data == NULL) {
+            fprintf(stderr, "ERROR: could not read file %s: %s\n", file_path, strerror(errno));
+            result = 1;
+            continue;
+        }
+
+        Image image = {0};
+        if (!image_decode(&region, image_format_by_file_path(file_path), data, size, &image)) {
+            fprintf(stderr, "ERROR: could not decode file %s: %s\n", file_path, image_failure_reason());
+            result = 1;
+            continue;
+        }
+
+        const double start = timer_now();
+        Compressed_Texture texture = {0};
+        const bool built = texcomp_build(&region, format, hash_bytes(data, size),
+                                         image.pixels, image.width, image.height, &texture);
+        const double elapsed = timer_now() - start;
+
+        if (!built) {
+            fprintf(stderr, "ERROR: could not encode file %s: %s\n", file_path, strerror(errno));
+            result = 1;
+            continue;
+        }
+
+        if (!texcomp_cache_save(&region, TEXCOMP_CACHE_DIR, &texture)) {
+            fprintf(stderr, "ERROR: could not write %s into %s: %s\n",
+                    file_path, TEXCOMP_CACHE_DIR, strerror(errno));
+            result = 1;
+            continue;
+        }
+
+        Compressed_Texture uncompressed = texture;
+        uncompressed.format = TEXTURE_FORMAT_RGBA;
+        size_t uncompressed_size = 0;
+        for (uint32_t level = 0; level < texture.levels_count; ++level) {
+            uncompressed_size += texcomp_level_size(
+                TEXTURE_FORMAT_RGBA,
+                texcomp_level_width(&uncompressed, level),
+                texcomp_level_height(&uncompressed, level));
+        }
+
+        const size_t compressed_size = texcomp_total_size(&texture);
+        printf("%s: %ux%u, %u levels, %s %zu bytes (rgba %zu bytes, %.1fx) in %.2fms\n",
+               file_path, image.width, image.height, texture.levels_count,
+               texture_format_name(format), compressed_size, uncompressed_size,
+               (double) uncompressed_size / (double) compressed_size,
+               elapsed * 1000.0);
+    }
+
+    return result;
+}
@@ -0,0 +1,8 @@
+#ifndef TIMER_H_
+#define TIMER_H_
+
+// Monotonic wall clock in seconds for the tools and benchmarks that run
+// without GLFW
+double timer_now(void);
+
+#endif // TIMER_H_
@@ -0,0 +1,53 @@
+#ifndef UNIFORMS_H_
+#define UNIFORMS_H_
+
+#include <stdint.h>
+
+#include "./geo.h"
+#include "./emote.h"
+
+// Uniform blocks of ./shaders/uniforms.glsl, member by member in the std140
+// layout: a vec2 takes 8 bytes, a vec3 or vec4 and every element of an
+// array 16, and the sizes round up to 16. The blocks are row_major, so a
+// Mat4 goes in as it is.
+//
+// Every block has a binding point of its own that the programs are told
+// about after linking, the buffers stay bound to them whatever the program.
+
+typedef enum {
+    UNIFORM_BINDING_FRAME = 0,
+    UNIFORM_BINDING_VIEW,
+    UNIFORM_BINDING_MATERIAL,
+    COUNT_UNIFORM_BINDINGS,
+} Uniform_Binding;
+
+// The same for everything drawn in the frame
+typedef struct {
+    float resolution[V2_COMPS];
+    float time;
+    float pad0;
+} Frame_Uniforms;
+
+// Of the camera
+typedef struct {
+    Mat4 projection;
+    Mat4 view;
+    // `fog_distance` of scene.conf, nothing is drawn beyond it
+    float fog_distance;
+    float pad0[3];
+} View_Uniforms;
+
+// Of what a draw draws. Every level of detail of the emote wall is a
+// material of its own, its cubes are `instance_sizes[level]` big, and the
+// multi-draw of all of them at once adds gl_DrawIDARB to `level`.
+typedef struct {
+    float instance_sizes[EMOTE_LOD_LEVELS][V4_COMPS];
+    int32_t level;
+    int32_t pad0[3];
+} Material_Uniforms;
+
+_Static_assert(sizeof(Frame_Uniforms) == 16, "Frame_Uniforms must match std140");
+_Static_assert(sizeof(View_Uniforms) == 144, "View_Uniforms must match std140");
+_Static_assert(sizeof(Material_Uniforms) == 16 * EMOTE_LOD_LEVELS + 16, "Material_Uniforms must match std140");
+
+#endif // UNIFORMS_H_
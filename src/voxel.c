@@ -0,0 +1,282 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "./voxel.h"
+
+#define S VOXEL_CHUNK_SIZE
+
+bool voxel_world_init(Voxel_World *world, size_t width, size_t height, size_t depth)
+{
+    memset(world, 0, sizeof(*world));
+    world->chunks = calloc(width * height * depth, sizeof(*world->chunks));
+    if (world->chunks == NULL) {
+        errno = ENOMEM;
+        return false;
+    }
+    world->width = width;
+    world->height = height;
+    world->depth = depth;
+    world->greedy = true;
+    return true;
+}
+
+void voxel_world_free(Voxel_World *world)
+{
+    const size_t chunks_count = voxel_world_chunks_count(world);
+    for (size_t i = 0; i < chunks_count; ++i) {
+        free(world->chunks[i].mesh.vertices);
+    }
+    free(world->chunks);
+    memset(world, 0, sizeof(*world));
+}
+
+size_t voxel_world_chunks_count(const Voxel_World *world)
+{
+    return world->width * world->height * world->depth;
+}
+
+static size_t voxel_index(size_t x, size_t y, size_t z)
+{
+    return (z * S + y) * S + x;
+}
+
+static bool chunk_coords(const Voxel_World *world, long x, long y, long z,
+                         size_t *chunk_index, size_t *index)
+{
+    if (x < 0 || y < 0 || z < 0) return false;
+
+    const size_t cx = (size_t) x / S;
+    const size_t cy = (size_t) y / S;
+    const size_t cz = (size_t) z / S;
+    if (cx >= world->width || cy >= world->height || cz >= world->depth) return false;
+
+    *chunk_index = (cz * world->height + cy) * world->width + cx;
+    *index = voxel_index((size_t) x % S, (size_t) y % S, (size_t) z % S);
+    return true;
+}
+
+Voxel voxel_world_get(const Voxel_World *world, long x, long y, long z)
+{
+    size_t chunk_index, index;
+    if (!chunk_coords(world, x, y, z, &chunk_index, &index)) return VOXEL_EMPTY;
+    return world->chunks[chunk_index].voxels[index];
+}
+
+static void mark_dirty(Voxel_World *world, long x, long y, long z)
+{
+    size_t chunk_index, index;
+    if (chunk_coords(world, x, y, z, &chunk_index, &index)) {
+        world->chunks[chunk_index].dirty = true;
+    }
+}
+
+void voxel_world_set(Voxel_World *world, long x, long y, long z, Voxel voxel)
+{
+    size_t chunk_index, index;
+    if (!chunk_coords(world, x, y, z, &chunk_index, &index)) return;
+
+    Voxel_Chunk *chunk = &world->chunks[chunk_index];
+    if (chunk->voxels[index] == voxel) return;
+    chunk->voxels[index] = voxel;
+    chunk->dirty = true;
+
+    // A voxel on the border of its chunk hides or reveals a face of the
+    // neighbor chunk
+    mark_dirty(world, x - 1, y, z);
+    mark_dirty(world, x + 1, y, z);
+    mark_dirty(world, x, y - 1, z);
+    mark_dirty(world, x, y + 1, z);
+    mark_dirty(world, x, y, z - 1);
+    mark_dirty(world, x, y, z + 1);
+}
+
+void voxel_world_mark_all_dirty(Voxel_World *world)
+{
+    const size_t chunks_count = voxel_world_chunks_count(world);
+    for (size_t i = 0; i < chunks_count; ++i) {
+        world->chunks[i].dirty = true;
+    }
+}
+
+static bool mesh_reserve(Voxel_Mesh *mesh, size_t count)
+{
+    if (mesh->vertices_count + count <= mesh->vertices_capacity) return true;
+
+    size_t new_capacity = mesh->vertices_capacity == 0 ? 1024 : mesh->vertices_capacity;
+    while (new_capacity < mesh->vertices_count + count) new_capacity *= 2;
+
+    Voxel_Vertex *new_vertices = realloc(mesh->vertices, new_capacity * sizeof(*new_vertices));
+    if (new_vertices == NULL) return false;
+
+    mesh->vertices = new_vertices;
+    mesh->vertices_capacity = new_capacity;
+    return true;
+}
+
+// Same layout as a face of generate_cube_mesh(), stretched to w by h voxels
+static bool emit_quad(Voxel_Mesh *mesh, const size_t axes[V3_COMPS], const long origin[V3_COMPS],
+                      size_t side, size_t a, size_t b, size_t c, size_t w, size_t h, Voxel material)
+{
+    if (!mesh_reserve(mesh, TRIS_PER_FACE * TRI_VERTICES)) return false;
+
+    const size_t A = axes[0];
+    const size_t B = axes[1];
+    const size_t C = axes[2];
+
+    for (size_t tri = 0; tri < TRIS_PER_FACE; ++tri) {
+        for (size_t vert = 0; vert < TRI_VERTICES; ++vert) {
+            const size_t strip_index = tri + vert;
+            Voxel_Vertex *vertex = &mesh->vertices[mesh->vertices_count++];
+            memset(vertex, 0, sizeof(*vertex));
+
+            vertex->position.cs[A] = (float) (origin[A] + (long) (a + (strip_index & 1) * w));
+            vertex->position.cs[B] = (float) (origin[B] + (long) (b + (strip_index >> 1) * h));
+            vertex->position.cs[C] = (float) (origin[C] + (long) (c + side));
+            vertex->position.cs[W] = 1.0f;
+
+            vertex->uv.cs[X] = (float) ((strip_index & 1) * w);
+            vertex->uv.cs[Y] = (float) ((strip_index >> 1) * h);
+
+            vertex->normal.cs[C] = (float) (2 * (int) side - 1);
+            vertex->normal.cs[W] = 1.0f;
+
+            vertex->material = material;
+        }
+    }
+
+    return true;
+}
+
+bool voxel_chunk_remesh(Voxel_World *world, size_t chunk_index)
+{
+    Voxel_Chunk *chunk = &world->chunks[chunk_index];
+    chunk->mesh.vertices_count = 0;
+
+    const size_t cx = chunk_index % world->width;
+    const size_t cy = chunk_index / world->width % world->height;
+    const size_t cz = chunk_index / world->width / world->height;
+    const long origin[V3_COMPS] = {(long) (cx * S), (long) (cy * S), (long) (cz * S)};
+
+    // Visible faces of one slice, by material
+    Voxel mask[S * S];
+
+    for (size_t face_pair_index = 0; face_pair_index < CUBE_FACE_PAIRS; ++face_pair_index) {
+        const size_t *axes = cube_face_pairs[face_pair_index];
+        const size_t A = axes[0];
+        const size_t B = axes[1];
+        const size_t C = axes[2];
+
+        for (size_t side = 0; side < PAIR_COMPS; ++side) {
+            for (size_t c = 0; c < S; ++c) {
+                bool any = false;
+                for (size_t b = 0; b < S; ++b) {
+                    for (size_t a = 0; a < S; ++a) {
+                        size_t p[V3_COMPS];
+                        p[A] = a;
+                        p[B] = b;
+                        p[C] = c;
+                        const Voxel voxel = chunk->voxels[voxel_index(p[X], p[Y], p[Z])];
+
+                        Voxel neighbor = VOXEL_EMPTY;
+                        if (voxel != VOXEL_EMPTY) {
+                            const long nc = (long) c + 2 * (long) side - 1;
+                            if (nc >= 0 && nc < S) {
+                                p[C] = (size_t) nc;
+                                neighbor = chunk->voxels[voxel_index(p[X], p[Y], p[Z])];
+                            } else {
+                                long q[V3_COMPS];
+                                q[A] = origin[A] + (long) a;
+                                q[B] = origin[B] + (long) b;
+                                q[C] = origin[C] + nc;
+                                neighbor = voxel_world_get(world, q[X], q[Y], q[Z]);
+                            }
+                        }
+
+                        const Voxel face = neighbor == VOXEL_EMPTY ? voxel : VOXEL_EMPTY;
+                        mask[b * S + a] = face;
+                        any = any || face != VOXEL_EMPTY;
+                    }
+                }
+                if (!any) continue;
+
+                for (size_t b = 0; b < S; ++b) {
+                    for (size_t a = 0; a < S; ) {
+                        const Voxel material = mask[b * S + a];
+                        if (material == VOXEL_EMPTY) {
+                            a += 1;
+                            continue;
+                        }
+
+                        size_t w = 1;
+                        size_t h = 1;
+                        if (world->greedy) {
+                            while (a + w < S && mask[b * S + a + w] == material) {
+                                w += 1;
+                            }
+
+                            for (; b + h < S; ++h) {
+                                bool row = true;
+                                for (size_t i = 0; i < w && row; ++i) {
+                                    row = mask[(b + h) * S + a + i] == material;
+                                }
+                                if (!row) break;
+                            }
+                        }
+
+                        if (!emit_quad(&chunk->mesh, axes, origin, side, a, b, c, w, h, material)) {
+                            return false;
+                        }
+
+                        for (size_t j = 0; j < h; ++j) {
+                            memset(&mask[(b + j) * S + a], VOXEL_EMPTY, w);
+                        }
+                        a += w;
+                    }
+                }
+            }
+        }
+    }
+
+    chunk->dirty = false;
+    return true;
+}
+
+typedef struct {
+    Voxel_World *world;
+    const size_t *chunk_indices;
+} Voxel_Remesh_Batch;
+
+static void remesh_chunk(void *arg, size_t index, size_t worker)
+{
+    (void) worker;
+    Voxel_Remesh_Batch *batch = arg;
+    voxel_chunk_remesh(batch->world, batch->chunk_indices[index]);
+}
+
+size_t voxel_world_remesh(Voxel_World *world, Pool *pool)
+{
+    const size_t chunks_count = voxel_world_chunks_count(world);
+
+    size_t *dirty = malloc(chunks_count * sizeof(*dirty) + 1);
+    if (dirty == NULL) return 0;
+
+    size_t dirty_count = 0;
+    for (size_t i = 0; i < chunks_count; ++i) {
+        if (world->chunks[i].dirty) dirty[dirty_count++] = i;
+    }
+
+    Voxel_Remesh_Batch batch = {
+        .world = world,
+        .chunk_indices = dirty,
+    };
+    pool_for(pool, dirty_count, remesh_chunk, &batch);
+
+    size_t remeshed = 0;
+    for (size_t i = 0; i < dirty_count; ++i) {
+        if (!world->chunks[dirty[i]].dirty) remeshed += 1;
+    }
+
+    free(dirty);
+    return remeshed;
+}
@@ -0,0 +1,71 @@
+#ifndef VOXEL_H_
+#define VOXEL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "./geo.h"
+#include "./pool.h"
+
+// Chunked voxel world meshed into triangles the same way generate_cube_mesh()
+// builds the cube: faces between two solid voxels are skipped and, unless
+// disabled, coplanar faces of the same material are greedily merged into
+// bigger quads.
+
+#define VOXEL_CHUNK_SIZE 32
+#define VOXEL_CHUNK_VOXELS (VOXEL_CHUNK_SIZE * VOXEL_CHUNK_SIZE * VOXEL_CHUNK_SIZE)
+
+// 0 is empty space, anything else is the material of a solid voxel
+typedef uint8_t Voxel;
+#define VOXEL_EMPTY 0
+
+typedef struct {
+    V4 position;
+    // In voxels, so a texture repeats once per voxel across merged quads
+    V2 uv;
+    V4 normal;
+    uint32_t material;
+} Voxel_Vertex;
+
+typedef struct {
+    Voxel_Vertex *vertices;
+    size_t vertices_count;
+    size_t vertices_capacity;
+} Voxel_Mesh;
+
+typedef struct {
+    Voxel voxels[VOXEL_CHUNK_VOXELS];
+    // Set by every edit that can change the mesh, cleared by remeshing
+    bool dirty;
+    Voxel_Mesh mesh;
+} Voxel_Chunk;
+
+typedef struct {
+    // In chunks
+    size_t width;
+    size_t height;
+    size_t depth;
+    Voxel_Chunk *chunks;
+    bool greedy;
+} Voxel_World;
+
+// Returns false and sets errno on failure
+bool voxel_world_init(Voxel_World *world, size_t width, size_t height, size_t depth);
+void voxel_world_free(Voxel_World *world);
+size_t voxel_world_chunks_count(const Voxel_World *world);
+
+// Coordinates are in voxels. Everything outside of the world is empty.
+Voxel voxel_world_get(const Voxel_World *world, long x, long y, long z);
+// Marks the chunk dirty, together with the neighbors whose faces touch
+// the voxel
+void voxel_world_set(Voxel_World *world, long x, long y, long z, Voxel voxel);
+void voxel_world_mark_all_dirty(Voxel_World *world);
+
+// Only reads the voxels, so different chunks can be meshed concurrently
+bool voxel_chunk_remesh(Voxel_World *world, size_t chunk_index);
+// Remeshes every dirty chunk, spreading them across `pool` when it is not
+// NULL. Returns how many chunks were remeshed. Chunks that failed to
+// allocate their mesh stay dirty.
+size_t voxel_world_remesh(Voxel_World *world, Pool *pool);
+
+#endif // VOXEL_H_
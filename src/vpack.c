@@ -0,0 +1,124 @@
+#include <string.h>
+#include <math.h>
+
+#include "./vpack.h"
+
+Vpack_Instance vpack_instance(const Aabb *bounds)
+{
+    Vpack_Instance instance = {0};
+    for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+        instance.position_min[axis] = bounds->min[axis];
+        instance.position_extent[axis] = bounds->max[axis] - bounds->min[axis];
+    }
+    return instance;
+}
+
+static uint32_t pack_unorm16(float x)
+{
+    if (!(x > 0.0f)) return 0;
+    if (x >= 1.0f) return 0xFFFF;
+    return (uint32_t) lrintf(x * 65535.0f);
+}
+
+static uint32_t pack_snorm16(float x)
+{
+    if (x <= -1.0f) x = -1.0f;
+    if (x >= 1.0f) x = 1.0f;
+    return (uint32_t) (uint16_t) (int16_t) lrintf(x * 32767.0f);
+}
+
+// Round to nearest even like the GPU does, without the denormals
+uint16_t vpack_half(float x)
+{
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    const uint16_t sign = (uint16_t) ((bits >> 16) & 0x8000);
+    const uint32_t exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+
+    // NaN stays NaN, infinity stays infinity
+    if (exponent == 0xFF) return sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0);
+    const int e = (int) exponent - 127 + 15;
+    if (e >= 0x1F) return sign | 0x7C00;
+    if (e <= 0) return sign;
+
+    uint32_t half = (uint32_t) e << 10 | mantissa >> 13;
+    const uint32_t rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half += 1;
+    return sign | (uint16_t) half;
+}
+
+// Octahedral encoding: the unit sphere is projected onto the octahedron
+// |x| + |y| + |z| = 1, whose lower half is folded over the upper one
+static void octahedral_encode(const float n[V3_COMPS], float e[V2_COMPS])
+{
+    const float l1 = fabsf(n[X]) + fabsf(n[Y]) + fabsf(n[Z]);
+    if (l1 <= 0.0f) {
+        e[X] = 0.0f;
+        e[Y] = 0.0f;
+        return;
+    }
+    float x = n[X] / l1;
+    float y = n[Y] / l1;
+    if (n[Z] < 0.0f) {
+        const float fx = (1.0f - fabsf(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        const float fy = (1.0f - fabsf(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = fx;
+        y = fy;
+    }
+    e[X] = x;
+    e[Y] = y;
+}
+
+typedef struct {
+    const Mesh_Vertex *vertices;
+    size_t count;
+    float min[V3_COMPS];
+    float inverse_extent[V3_COMPS];
+    Vpack_Vertex *packed;
+} Vpack_Job;
+
+static void vpack_task(void *arg, size_t index, size_t worker)
+{
+    (void) worker;
+    const Vpack_Job *job = arg;
+    const size_t begin = index * VPACK_VERTICES_PER_TASK;
+    size_t end = begin + VPACK_VERTICES_PER_TASK;
+    if (end > job->count) end = job->count;
+
+    for (size_t i = begin; i < end; ++i) {
+        const Mesh_Vertex *v = &job->vertices[i];
+        uint32_t q[V3_COMPS];
+        for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+            q[axis] = pack_unorm16((v->position[axis] - job->min[axis]) * job->inverse_extent[axis]);
+        }
+        float e[V2_COMPS];
+        octahedral_encode(v->normal, e);
+
+        job->packed[i] = (Vpack_Vertex) {
+            .position_xy = q[X] | q[Y] << 16,
+            .position_z = q[Z],
+            .uv = (uint32_t) vpack_half(v->uv[X]) | (uint32_t) vpack_half(v->uv[Y]) << 16,
+            .normal = pack_snorm16(e[X]) | pack_snorm16(e[Y]) << 16,
+        };
+    }
+}
+
+void vpack_vertices(Pool *pool, const Mesh_Vertex *vertices, size_t count, const Aabb *bounds,
+                    Vpack_Vertex *packed)
+{
+    Vpack_Job job = {
+        .vertices = vertices,
+        .count = count,
+        .packed = packed,
+    };
+    for (size_t axis = 0; axis < V3_COMPS; ++axis) {
+        const float extent = bounds->max[axis] - bounds->min[axis];
+        job.min[axis] = bounds->min[axis];
+        // A flat mesh is flat on the GPU too
+        job.inverse_extent[axis] = extent > 0.0f ? 1.0f / extent : 0.0f;
+    }
+
+    const size_t tasks = (count + VPACK_VERTICES_PER_TASK - 1) / VPACK_VERTICES_PER_TASK;
+    pool_for(pool, tasks, vpack_task, &job);
+}
@@ -0,0 +1,43 @@
+#ifndef VPACK_H_
+#define VPACK_H_
+
+#include <stdint.h>
+
+#include "./mesh.h"
+#include "./pool.h"
+
+// Compressed vertices for the shaders that pull them from a shader storage
+// buffer by gl_VertexID instead of reading attributes, see
+// ./shaders/mesh_pull.vert. A vertex is 16 bytes instead of the 32 of
+// Mesh_Vertex:
+//   - the position is quantized to 16 bits per axis in the bounds of the
+//     mesh, which go into the instance that draws it
+//   - the UV is a pair of half floats, so it may still wrap around
+//   - the normal is octahedral encoded into two 16 bit snorms
+// Every word is unpacked with a single GLSL builtin: unpackUnorm2x16(),
+// unpackHalf2x16() and unpackSnorm2x16().
+
+#define VPACK_VERTICES_PER_TASK (64 * 1024)
+
+typedef struct {
+    uint32_t position_xy;
+    // The high half is unused
+    uint32_t position_z;
+    uint32_t uv;
+    uint32_t normal;
+} Vpack_Vertex;
+
+// std430 layout of the instances in the shader, indexed by gl_InstanceID
+typedef struct {
+    float position_min[4];
+    float position_extent[4];
+} Vpack_Instance;
+
+Vpack_Instance vpack_instance(const Aabb *bounds);
+// In parallel on `pool` when it is not NULL
+void vpack_vertices(Pool *pool, const Mesh_Vertex *vertices, size_t count, const Aabb *bounds,
+                    Vpack_Vertex *packed);
+
+uint16_t vpack_half(float x);
+
+#endif // VPACK_H_
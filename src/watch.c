@@ -0,0 +1,65 @@
+#include <string.h>
+#include <sys/stat.h>
+
+#include "./watch.h"
+
+static void watch_stat(const char *file_path, bool *exists, int64_t *mtime_ns, int64_t *size)
+{
+    struct stat st;
+    *exists = stat(file_path, &st) == 0;
+    if (!*exists) {
+        *mtime_ns = 0;
+        *size = 0;
+        return;
+    }
+#ifdef _WIN32
+    *mtime_ns = (int64_t) st.st_mtime * 1000000000;
+#else
+    *mtime_ns = (int64_t) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+#endif
+    *size = (int64_t) st.st_size;
+}
+
+void watch_clear(Watch *watch)
+{
+    for (size_t i = 0; i < watch->files_count; ++i) {
+        free(watch->files[i].file_path);
+    }
+    memset(watch, 0, sizeof(*watch));
+}
+
+void watch_add(Watch *watch, const char *file_path)
+{
+    for (size_t i = 0; i < watch->files_count; ++i) {
+        if (strcmp(watch->files[i].file_path, file_path) == 0) return;
+    }
+    if (watch->files_count >= WATCH_MAX_FILES) return;
+
+    const size_t n = strlen(file_path) + 1;
+    char *copy = malloc(n);
+    if (copy == NULL) return;
+    memcpy(copy, file_path, n);
+
+    Watch_File *file = &watch->files[watch->files_count++];
+    file->file_path = copy;
+    watch_stat(copy, &file->exists, &file->mtime_ns, &file->size);
+}
+
+bool watch_changed(Watch *watch)
+{
+    bool changed = false;
+    for (size_t i = 0; i < watch->files_count; ++i) {
+        Watch_File *file = &watch->files[i];
+        bool exists = false;
+        int64_t mtime_ns = 0;
+        int64_t size = 0;
+        watch_stat(file->file_path, &exists, &mtime_ns, &size);
+        if (exists != file->exists || mtime_ns != file->mtime_ns || size != file->size) {
+            file->exists = exists;
+            file->mtime_ns = mtime_ns;
+            file->size = size;
+            changed = true;
+        }
+    }
+    return changed;
+}
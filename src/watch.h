@@ -0,0 +1,34 @@
+#ifndef WATCH_H_
+#define WATCH_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdbool.h>
+
+// Polls the modification times of a set of files, so editing any of them
+// can trigger a reload. Files that do not exist are watched too and count
+// as changed once they show up.
+
+#define WATCH_MAX_FILES 64
+
+typedef struct {
+    char *file_path;
+    bool exists;
+    int64_t mtime_ns;
+    int64_t size;
+} Watch_File;
+
+typedef struct {
+    // Files beyond WATCH_MAX_FILES are not watched
+    Watch_File files[WATCH_MAX_FILES];
+    size_t files_count;
+} Watch;
+
+void watch_clear(Watch *watch);
+// Remembers how `file_path` looks right now. Adding a file twice is fine.
+void watch_add(Watch *watch, const char *file_path);
+// Whether any of the files changed since it was added or since the last
+// watch_changed() that said so
+bool watch_changed(Watch *watch);
+
+#endif // WATCH_H_
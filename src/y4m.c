@@ -0,0 +1,313 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#define dup _dup
+#define dup2 _dup2
+#define fileno _fileno
+#define fdopen _fdopen
+#else
+#include <unistd.h>
+#include <signal.h>
+#endif
+
+#include "./timer.h"
+#include "./y4m.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define Y4M_SSE2
+#endif
+
+#define Y4M_COMPS 4
+#define Y4M_LANES 8
+
+// BT.601 limited range, scaled by 256. U and V take the sums of the 4
+// pixels of a block, hence the extra 2 bits of their shift. The biases
+// include the rounding and the offsets of 16 and 128, so every sum is
+// positive and lands in [16, 235] and [16, 240] without clamping.
+#define YUV_YR 66
+#define YUV_YG 129
+#define YUV_YB 25
+#define YUV_Y_SHIFT 8
+#define YUV_Y_BIAS ((1 << (YUV_Y_SHIFT - 1)) + (16 << YUV_Y_SHIFT))
+#define YUV_UR -38
+#define YUV_UG -74
+#define YUV_UB 112
+#define YUV_VR 112
+#define YUV_VG -94
+#define YUV_VB -18
+#define YUV_UV_SHIFT (8 + 2)
+#define YUV_UV_BIAS ((1 << (YUV_UV_SHIFT - 1)) + (128 << YUV_UV_SHIFT))
+
+typedef struct {
+    const uint8_t *rgba;
+    ptrdiff_t stride;
+    uint32_t width;
+    uint32_t height;
+    uint8_t *y;
+    uint8_t *u;
+    uint8_t *v;
+} Yuv420_Job;
+
+static uint32_t chroma_size(uint32_t n)
+{
+    return (n + 1) / 2;
+}
+
+size_t yuv420_size(uint32_t width, uint32_t height)
+{
+    return (size_t) width * height + 2 * (size_t) chroma_size(width) * chroma_size(height);
+}
+
+static Yuv420_Job yuv420_job(const uint8_t *rgba, ptrdiff_t stride,
+                             uint32_t width, uint32_t height, uint8_t *planes)
+{
+    const size_t luma = (size_t) width * height;
+    const size_t chroma = (size_t) chroma_size(width) * chroma_size(height);
+    return (Yuv420_Job) {
+        .rgba = rgba,
+        .stride = stride,
+        .width = width,
+        .height = height,
+        .y = planes,
+        .u = planes + luma,
+        .v = planes + luma + chroma,
+    };
+}
+
+static const uint8_t *job_row(const Yuv420_Job *job, uint32_t y)
+{
+    return job->rgba + (ptrdiff_t) y * job->stride;
+}
+
+static uint8_t yuv_y(int r, int g, int b)
+{
+    return (uint8_t) ((YUV_YR * r + YUV_YG * g + YUV_YB * b + YUV_Y_BIAS) >> YUV_Y_SHIFT);
+}
+
+static uint8_t yuv_uv(int cr, int cg, int cb, int r, int g, int b)
+{
+    return (uint8_t) ((cr * r + cg * g + cb * b + YUV_UV_BIAS) >> YUV_UV_SHIFT);
+}
+
+// Columns [x0, width) of the rows `2 * pair` and `2 * pair + 1`. The last
+// row and column stand in for the missing ones of odd sizes.
+static void convert_pair_scalar(const Yuv420_Job *job, uint32_t pair, uint32_t x0)
+{
+    const uint32_t y0 = 2 * pair;
+    const uint32_t y1 = y0 + 1 < job->height ? y0 + 1 : y0;
+    const uint8_t *rows[2] = {job_row(job, y0), job_row(job, y1)};
+
+    for (uint32_t r = 0; r < 2 && y0 + r <= y1; ++r) {
+        uint8_t *ys = job->y + (size_t) (y0 + r) * job->width;
+        for (uint32_t x = x0; x < job->width; ++x) {
+            const uint8_t *p = rows[r] + (size_t) x * Y4M_COMPS;
+            ys[x] = yuv_y(p[0], p[1], p[2]);
+        }
+    }
+
+    const size_t chroma_row = (size_t) pair * chroma_size(job->width);
+    for (uint32_t x = x0; x < job->width; x += 2) {
+        const uint32_t xs[2] = {x, x + 1 < job->width ? x + 1 : x};
+        int sums[3] = {0};
+        for (size_t r = 0; r < 2; ++r) {
+            for (size_t i = 0; i < 2; ++i) {
+                const uint8_t *p = rows[r] + (size_t) xs[i] * Y4M_COMPS;
+                for (size_t c = 0; c < 3; ++c) sums[c] += p[c];
+            }
+        }
+        job->u[chroma_row + x / 2] = yuv_uv(YUV_UR, YUV_UG, YUV_UB, sums[0], sums[1], sums[2]);
+        job->v[chroma_row + x / 2] = yuv_uv(YUV_VR, YUV_VG, YUV_VB, sums[0], sums[1], sums[2]);
+    }
+}
+
+#ifdef Y4M_SSE2
+// [a0 + a1, a2 + a3, b0 + b1, b2 + b3], SSE2 has no phaddd
+static __m128i hadd_epi32(__m128i a, __m128i b)
+{
+    const __m128 fa = _mm_castsi128_ps(a);
+    const __m128 fb = _mm_castsi128_ps(b);
+    const __m128i evens = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(2, 0, 2, 0)));
+    const __m128i odds = _mm_castps_si128(_mm_shuffle_ps(fa, fb, _MM_SHUFFLE(3, 1, 3, 1)));
+    return _mm_add_epi32(evens, odds);
+}
+
+// 8 pixels as 16 bit RGBA, 2 pixels per vector
+static void unpack8(const uint8_t *pixels, __m128i ps[4])
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i lo = _mm_loadu_si128((const __m128i *) pixels);
+    const __m128i hi = _mm_loadu_si128((const __m128i *) (pixels + 16));
+    ps[0] = _mm_unpacklo_epi8(lo, zero);
+    ps[1] = _mm_unpackhi_epi8(lo, zero);
+    ps[2] = _mm_unpacklo_epi8(hi, zero);
+    ps[3] = _mm_unpackhi_epi8(hi, zero);
+}
+
+// The Y of the 8 pixels of `ps`, in the low 8 bytes
+static __m128i luma8(const __m128i ps[4], __m128i coefs)
+{
+    const __m128i biases = _mm_set1_epi32(YUV_Y_BIAS);
+    __m128i lo = hadd_epi32(_mm_madd_epi16(ps[0], coefs), _mm_madd_epi16(ps[1], coefs));
+    __m128i hi = hadd_epi32(_mm_madd_epi16(ps[2], coefs), _mm_madd_epi16(ps[3], coefs));
+    lo = _mm_srli_epi32(_mm_add_epi32(lo, biases), YUV_Y_SHIFT);
+    hi = _mm_srli_epi32(_mm_add_epi32(hi, biases), YUV_Y_SHIFT);
+    return _mm_packus_epi16(_mm_packs_epi32(lo, hi), _mm_setzero_si128());
+}
+
+// The U or V of the 4 blocks whose pixels of both rows are summed in
+// `sums`, one byte each
+static uint32_t chroma4(const __m128i sums[4], __m128i coefs)
+{
+    const __m128i pixels_lo = hadd_epi32(_mm_madd_epi16(sums[0], coefs), _mm_madd_epi16(sums[1], coefs));
+    const __m128i pixels_hi = hadd_epi32(_mm_madd_epi16(sums[2], coefs), _mm_madd_epi16(sums[3], coefs));
+    __m128i blocks = hadd_epi32(pixels_lo, pixels_hi);
+    blocks = _mm_srli_epi32(_mm_add_epi32(blocks, _mm_set1_epi32(YUV_UV_BIAS)), YUV_UV_SHIFT);
+    const __m128i packed = _mm_packus_epi16(_mm_packs_epi32(blocks, blocks), _mm_setzero_si128());
+    return (uint32_t) _mm_cvtsi128_si32(packed);
+}
+
+static void convert_pair(const Yuv420_Job *job, uint32_t pair)
+{
+    const uint32_t y0 = 2 * pair;
+    const uint32_t y1 = y0 + 1 < job->height ? y0 + 1 : y0;
+    const uint8_t *rows[2] = {job_row(job, y0), job_row(job, y1)};
+    uint8_t *ys[2] = {
+        job->y + (size_t) y0 * job->width,
+        job->y + (size_t) y1 * job->width,
+    };
+    const size_t chroma_row = (size_t) pair * chroma_size(job->width);
+
+    const __m128i y_coefs = _mm_setr_epi16(YUV_YR, YUV_YG, YUV_YB, 0, YUV_YR, YUV_YG, YUV_YB, 0);
+    const __m128i u_coefs = _mm_setr_epi16(YUV_UR, YUV_UG, YUV_UB, 0, YUV_UR, YUV_UG, YUV_UB, 0);
+    const __m128i v_coefs = _mm_setr_epi16(YUV_VR, YUV_VG, YUV_VB, 0, YUV_VR, YUV_VG, YUV_VB, 0);
+
+    uint32_t x = 0;
+    for (; x + Y4M_LANES <= job->width; x += Y4M_LANES) {
+        __m128i ps[2][4];
+        __m128i sums[4];
+        for (size_t r = 0; r < 2; ++r) {
+            unpack8(rows[r] + (size_t) x * Y4M_COMPS, ps[r]);
+            // Of an odd height the last row is written twice, the same
+            _mm_storel_epi64((__m128i *) (ys[r] + x), luma8(ps[r], y_coefs));
+        }
+        for (size_t i = 0; i < 4; ++i) {
+            sums[i] = _mm_add_epi16(ps[0][i], ps[1][i]);
+        }
+
+        const uint32_t us = chroma4(sums, u_coefs);
+        const uint32_t vs = chroma4(sums, v_coefs);
+        memcpy(job->u + chroma_row + x / 2, &us, sizeof(us));
+        memcpy(job->v + chroma_row + x / 2, &vs, sizeof(vs));
+    }
+
+    if (x < job->width) convert_pair_scalar(job, pair, x);
+}
+#else
+static void convert_pair(const Yuv420_Job *job, uint32_t pair)
+{
+    convert_pair_scalar(job, pair, 0);
+}
+#endif
+
+static void convert_band_task(void *arg, size_t index, size_t worker)
+{
+    (void) worker;
+    const Yuv420_Job *job = arg;
+    const uint32_t pairs = chroma_size(job->height);
+    const uint32_t first = (uint32_t) index * (Y4M_BAND_ROWS / 2);
+    const uint32_t last = first + Y4M_BAND_ROWS / 2 < pairs ? first + Y4M_BAND_ROWS / 2 : pairs;
+    for (uint32_t pair = first; pair < last; ++pair) {
+        convert_pair(job, pair);
+    }
+}
+
+void yuv420_from_rgba(Pool *pool, const uint8_t *rgba, ptrdiff_t stride,
+                      uint32_t width, uint32_t height, uint8_t *planes)
+{
+    Yuv420_Job job = yuv420_job(rgba, stride, width, height, planes);
+    const size_t bands = (height + Y4M_BAND_ROWS - 1) / Y4M_BAND_ROWS;
+    pool_for(pool, bands, convert_band_task, &job);
+}
+
+void yuv420_from_rgba_scalar(const uint8_t *rgba, ptrdiff_t stride,
+                             uint32_t width, uint32_t height, uint8_t *planes)
+{
+    Yuv420_Job job = yuv420_job(rgba, stride, width, height, planes);
+    for (uint32_t pair = 0; pair < chroma_size(height); ++pair) {
+        convert_pair_scalar(&job, pair, 0);
+    }
+}
+
+static FILE *y4m_open_stdout(void)
+{
+    fflush(stdout);
+    const int fd = dup(fileno(stdout));
+    if (fd < 0) return NULL;
+    if (dup2(fileno(stderr), fileno(stdout)) < 0) return NULL;
+#ifdef _WIN32
+    _setmode(fd, _O_BINARY);
+#else
+    // A reader that quits is a write error, not the end of the program
+    signal(SIGPIPE, SIG_IGN);
+#endif
+    return fdopen(fd, "wb");
+}
+
+bool y4m_writer_open(Y4m_Writer *writer, const char *file_path,
+                     uint32_t width, uint32_t height, uint32_t fps, Pool *pool)
+{
+    memset(writer, 0, sizeof(*writer));
+    if (width == 0 || height == 0 || fps == 0) {
+        errno = EINVAL;
+        return false;
+    }
+    writer->width = width;
+    writer->height = height;
+    writer->fps = fps;
+    writer->pool = pool;
+
+    writer->planes = malloc(yuv420_size(width, height));
+    if (writer->planes == NULL) return false;
+
+    writer->file = strcmp(file_path, "-") == 0 ? y4m_open_stdout() : fopen(file_path, "wb");
+    if (writer->file == NULL) {
+        free(writer->planes);
+        writer->planes = NULL;
+        return false;
+    }
+
+    if (fprintf(writer->file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg\n", width, height, fps) < 0) {
+        y4m_writer_close(writer);
+        return false;
+    }
+    return true;
+}
+
+bool y4m_writer_write(Y4m_Writer *writer, const uint8_t *rgba, ptrdiff_t stride)
+{
+    const double convert_start = timer_now();
+    yuv420_from_rgba(writer->pool, rgba, stride, writer->width, writer->height, writer->planes);
+    const double write_start = timer_now();
+    writer->convert_secs += write_start - convert_start;
+
+    const bool ok = fwrite(Y4M_FRAME_MARKER, sizeof(Y4M_FRAME_MARKER) - 1, 1, writer->file) == 1 &&
+                    fwrite(writer->planes, yuv420_size(writer->width, writer->height), 1, writer->file) == 1;
+    writer->write_secs += timer_now() - write_start;
+    if (ok) writer->frames_written += 1;
+    return ok;
+}
+
+bool y4m_writer_close(Y4m_Writer *writer)
+{
+    bool ok = true;
+    if (writer->file != NULL && fclose(writer->file) != 0) ok = false;
+    free(writer->planes);
+    writer->file = NULL;
+    writer->planes = NULL;
+    return ok;
+}
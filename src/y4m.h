@@ -0,0 +1,61 @@
+#ifndef Y4M_H_
+#define Y4M_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#include "./pool.h"
+
+// Uncompressed YUV4MPEG2 video: a text header, then every frame as
+// "FRAME\n" followed by its Y, U and V planes. ffmpeg, mpv and x264 read
+// it from a file or a pipe as it is, so recording needs no encoder.
+//
+// The frames are converted from RGBA8 to 4:2:0 with the BT.601 limited
+// range coefficients of libyuv, in 8 bit fixed point. Every 2x2 block of
+// pixels shares the U and V of its average (C420jpeg siting). Bands of
+// rows are converted on the threads of a pool, 8 pixels at a time with
+// SSE2 where there is SSE2.
+
+#define Y4M_FRAME_MARKER "FRAME\n"
+// Rows converted by a task
+#define Y4M_BAND_ROWS 32
+
+// Bytes of the Y, U and V planes of a frame
+size_t yuv420_size(uint32_t width, uint32_t height);
+
+// `stride` is the distance between rows in bytes, negative for bottom up
+// images like the ones glReadPixels() returns. Runs on the calling thread
+// when `pool` is NULL.
+void yuv420_from_rgba(Pool *pool, const uint8_t *rgba, ptrdiff_t stride,
+                      uint32_t width, uint32_t height, uint8_t *planes);
+// Same result one pixel at a time, for checking the SIMD kernel
+void yuv420_from_rgba_scalar(const uint8_t *rgba, ptrdiff_t stride,
+                             uint32_t width, uint32_t height, uint8_t *planes);
+
+typedef struct {
+    FILE *file;
+    uint32_t width;
+    uint32_t height;
+    uint32_t fps;
+    Pool *pool;
+    uint8_t *planes;
+    size_t frames_written;
+    // Of y4m_writer_write()
+    double convert_secs;
+    double write_secs;
+} Y4m_Writer;
+
+// Writes the header into `file_path`, or into stdout when it is "-": the
+// video takes over stdout and whatever the program prints goes to stderr
+// from then on. Returns false and sets errno on failure.
+bool y4m_writer_open(Y4m_Writer *writer, const char *file_path,
+                     uint32_t width, uint32_t height, uint32_t fps, Pool *pool);
+// A frame of `width` by `height` pixels, see yuv420_from_rgba(). Returns
+// false and sets errno on failure.
+bool y4m_writer_write(Y4m_Writer *writer, const uint8_t *rgba, ptrdiff_t stride);
+// Returns false and sets errno when the end of the video could not be written
+bool y4m_writer_close(Y4m_Writer *writer);
+
+#endif // Y4M_H_